@@ -0,0 +1,404 @@
+// Headless load generator: opens lots of connections to the
+// server and reports how it copes with them.
+//
+// usage: belowBot [-n clients] [-t seconds] [-h host] [-p server pid]
+//                 [-s spread] [-c 0|1] [-k 0|1] [-a 0|1] [-m pings per second]
+//
+// Every bot parses the server's messages into its own object manager
+// like the real client does. The bots look at random points up to the
+// spread away from the origin, a spread of 0 puts them all at the
+// origin. -c 0 leaves the compression out of the hello, -k 0 the
+// packed object events, for comparing their traffic, and -a 0 only
+// parses the messages without building the world, for measuring the
+// transfer of scenes too big for the object manager. With the
+// server's pid the growth of its memory is reported too. -m has every
+// client send that many pings per second on top of the periodic ones,
+// the server answers them on its I/O threads, for measuring how its
+// receiving scales. Remember to raise the open file limit (ulimit -n)
+// for thousands of clients.
+
+#include "../logger.hh"
+#include "../events/eventQueue.hh"
+#include "../network/serverConnection.hh"
+#include "../network/serverMessageParser.hh"
+#include "../network/binaryStream.hh"
+#include "../managers/clientObjectManager.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+#define BOT_REPORT_INTERVAL 5
+#define BOT_WORLD_SPREAD    500.f
+#define BOT_CLIENT_COUNT    100
+#define BOT_SECONDS         30
+
+
+namespace
+{
+	struct Bot
+	{
+		Bot( bool applyObjects ) : parser(
+			[this, applyObjects]( Event *e )
+			{
+				if( e->type == OBJECT_EVENT && e->subType == OBJECT_CREATE )
+				{
+					created++;
+					lastCreate = Clock::now();
+				}
+
+				if( applyObjects )
+				{
+					objects.HandleEvent( e );
+				}
+				delete e;
+			},
+			[this, applyObjects]( const vector<NodeTransform> &transforms, uint64_t sampleTime )
+			{
+				if( applyObjects )
+				{
+					objects.ApplyTransforms( transforms, sampleTime );
+				}
+			},
+			[this, applyObjects]( const TransformArrays &transforms, uint64_t sampleTime )
+			{
+				if( applyObjects )
+				{
+					objects.ApplyTransforms( transforms, sampleTime );
+				}
+			}
+		)
+		{
+		}
+
+		std::shared_ptr<ServerConnection> connection;
+		EventQueue                        events;
+		ClientObjectManager               objects;
+		ServerMessageParser               parser;
+
+		Clock::time_point connectStarted;
+		Clock::time_point lastSnapshot;
+		Clock::time_point lastCreate;
+		size_t            snapshotsSeen = 0;
+		size_t            created       = 0;
+		uint64_t          pingsSent     = 0;
+		bool              joined        = false;
+		bool              parted        = false;
+	};
+
+
+	struct Statistics
+	{
+		size_t        bytesIn = 0;
+		uint64_t      pongs   = 0;
+		vector<float> joinTimes;
+		vector<float> snapshotIntervals;
+	};
+
+
+	// Resident memory of the process in bytes, 0 if unknown
+	size_t ResidentMemory( const string &pid )
+	{
+		ifstream statm( "/proc/" + pid + "/statm" );
+		size_t size = 0, resident = 0;
+		if( !( statm >> size >> resident ) )
+		{
+			return 0;
+		}
+
+		return resident * sysconf( _SC_PAGESIZE );
+	}
+
+
+	float Percentile( vector<float> values, float fraction )
+	{
+		if( values.empty() )
+		{
+			return 0.f;
+		}
+
+		auto nth = values.begin() + static_cast<size_t>( fraction * ( values.size() - 1 ) );
+		nth_element( values.begin(), nth, values.end() );
+		return *nth;
+	}
+
+
+	void SendViewpoint( Bot &bot, mt19937 &random, float spread )
+	{
+		uniform_real_distribution<float> place( -spread, spread );
+
+		string packet( 1 + 2 + 4 * 4, '\0' );
+
+		BinaryWriter writer( packet );
+		writer.WriteUint8( NETWORK_EVENT );
+		writer.WriteUint16( NETWORK_VIEWPOINT );
+		writer.WriteFloat( place( random ) );
+		writer.WriteFloat( 0.f );
+		writer.WriteFloat( place( random ) );
+		writer.WriteFloat( DEFAULT_VIEW_RADIUS );
+
+		bot.connection->Write( packet );
+	}
+
+
+	// Handles what the bot's connection has received so far
+	void Poll( Bot &bot, Statistics &statistics )
+	{
+		Event *e;
+		while( ( e = bot.events.GetEvent() ) )
+		{
+			if( e->type == NETWORK_EVENT && e->subType == NETWORK_DATA_IN )
+			{
+				auto dataIn = static_cast<DataInEvent*>( e );
+				statistics.bytesIn += dataIn->data.size();
+				bot.parser.Parse( dataIn->data, bot.connection.get() );
+			}
+			else if( e->type == NETWORK_EVENT && e->subType == NETWORK_PART )
+			{
+				bot.parted = true;
+			}
+
+			delete e;
+		}
+
+		auto snapshots = bot.parser.SnapshotCount();
+		if( snapshots == bot.snapshotsSeen )
+		{
+			return;
+		}
+
+		auto now = Clock::now();
+		if( !bot.joined )
+		{
+			bot.joined = true;
+			statistics.joinTimes.push_back(
+				chrono::duration<float, milli>( now - bot.connectStarted ).count()
+			);
+		}
+		else
+		{
+			statistics.snapshotIntervals.push_back(
+				chrono::duration<float, milli>( now - bot.lastSnapshot ).count()
+			);
+		}
+
+		bot.snapshotsSeen = snapshots;
+		bot.lastSnapshot  = now;
+	}
+
+
+	void Report(
+		const vector<unique_ptr<Bot>> &bots,
+		Statistics                    &statistics,
+		float                          seconds,
+		size_t                         memoryBefore,
+		const string                  &serverPid,
+		size_t                         serverMemoryBefore )
+	{
+		size_t   joined = 0, parted = 0;
+		uint64_t pongs  = 0;
+		vector<float> sceneTimes, sceneNodes, rtts, jitters;
+		for( auto &bot : bots )
+		{
+			joined += bot->joined;
+			parted += bot->parted;
+
+			auto connection = bot->connection->GetStatistics();
+			pongs += connection.pongsReceived;
+			if( connection.pongsReceived )
+			{
+				rtts.push_back( connection.rtt );
+				jitters.push_back( connection.jitter );
+			}
+
+			if( bot->created )
+			{
+				sceneTimes.push_back( chrono::duration<float, milli>( bot->lastCreate - bot->connectStarted ).count() );
+				sceneNodes.push_back( bot->created );
+			}
+		}
+
+		cout << fixed << setprecision( 1 )
+		     << "clients " << bots.size()
+		     << ", joined " << joined
+		     << ", parted " << parted << endl
+		     << "  in " << statistics.bytesIn / 1024.f / seconds << " kB/s"
+		     << ", " << ( bots.empty() ? 0.f : statistics.bytesIn / seconds / bots.size() ) << " B/s per client" << endl
+		     << "  join ms: median " << Percentile( statistics.joinTimes, 0.5f )
+		     << ", 95% " << Percentile( statistics.joinTimes, 0.95f ) << endl
+		     << "  scene: median " << Percentile( sceneNodes, 0.5f ) << " nodes"
+		     << ", last created after median " << Percentile( sceneTimes, 0.5f ) << " ms"
+		     << ", 95% " << Percentile( sceneTimes, 0.95f ) << " ms" << endl
+		     << "  snapshot interval ms: median " << Percentile( statistics.snapshotIntervals, 0.5f )
+		     << ", 95% " << Percentile( statistics.snapshotIntervals, 0.95f )
+		     << ", max " << Percentile( statistics.snapshotIntervals, 1.f ) << endl
+		     << "  rtt ms: median " << Percentile( rtts, 0.5f )
+		     << ", 95% " << Percentile( rtts, 0.95f )
+		     << ", jitter median " << Percentile( jitters, 0.5f )
+		     << ", 95% " << Percentile( jitters, 0.95f )
+		     << ", pongs " << ( pongs - min( pongs, statistics.pongs ) ) / seconds << "/s" << endl;
+
+		if( !bots.empty() )
+		{
+			auto memory = ResidentMemory( "self" );
+			cout << "  bot memory per client " << ( memory - min( memory, memoryBefore ) ) / 1024.f / bots.size() << " kB";
+
+			auto serverMemory = serverPid.empty() ? 0 : ResidentMemory( serverPid );
+			if( serverMemory )
+			{
+				cout << ", server " << ( serverMemory - min( serverMemory, serverMemoryBefore ) ) / 1024.f / bots.size() << " kB";
+			}
+			cout << endl;
+		}
+
+		statistics.bytesIn = 0;
+		statistics.pongs   = pongs;
+		statistics.snapshotIntervals.clear();
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t   clientCount  = BOT_CLIENT_COUNT;
+	int      seconds      = BOT_SECONDS;
+	string   host         = "localhost";
+	string   serverPid;
+	float    spread       = BOT_WORLD_SPREAD;
+	bool     compression  = true;
+	bool     packed       = true;
+	bool     applyObjects = true;
+	float    pingRate     = 0.f;
+
+	int option;
+	while( ( option = getopt( argc, argv, "n:t:h:p:s:c:k:a:m:" ) ) != -1 )
+	{
+		switch( option )
+		{
+			case 'n': clientCount = atoi( optarg ); break;
+			case 't': seconds     = atoi( optarg ); break;
+			case 'h': host        = optarg; break;
+			case 'p': serverPid   = optarg; break;
+			case 's': spread      = static_cast<float>( atof( optarg ) ); break;
+			case 'c': compression  = atoi( optarg ) != 0; break;
+			case 'k': packed       = atoi( optarg ) != 0; break;
+			case 'a': applyObjects = atoi( optarg ) != 0; break;
+			case 'm': pingRate     = static_cast<float>( atof( optarg ) ); break;
+
+			default:
+				cerr << "usage: " << argv[0] << " [-n clients] [-t seconds] [-h host] [-p server pid]"
+				     << " [-s spread] [-c 0|1] [-k 0|1] [-a 0|1] [-m pings per second]" << endl;
+				return 1;
+		}
+	}
+
+	uint32_t capabilities = ( compression ? CAPABILITY_COMPRESSION : 0 ) |
+	                        ( packed ? CAPABILITY_PACKED_OBJECTS : 0 );
+
+	Logger::GetInstance().SetQuiet( true );
+
+	asio::io_service ioService;
+	asio::io_service::work work( ioService );
+
+	vector<thread> ioThreads;
+	for( unsigned int i = 0; i < max( 2u, thread::hardware_concurrency() ); i++ )
+	{
+		ioThreads.emplace_back( [&ioService](){ ioService.run(); } );
+	}
+
+	mt19937    random( 1 );
+	Statistics statistics;
+
+	vector<unique_ptr<Bot>> bots;
+	size_t memoryBefore       = ResidentMemory( "self" );
+	size_t serverMemoryBefore = serverPid.empty() ? 0 : ResidentMemory( serverPid );
+
+	auto started    = Clock::now();
+	auto lastReport = started;
+
+	while( Clock::now() - started < chrono::seconds( seconds ) )
+	{
+		// Open the connections a few at a time so the
+		// earlier ones get handled meanwhile
+		for( int i = 0; i < 20 && bots.size() < clientCount; i++ )
+		{
+			unique_ptr<Bot> bot( new Bot( applyObjects ) );
+			bot->connectStarted = Clock::now();
+
+			try
+			{
+				bot->connection = std::make_shared<ServerConnection>( ioService, host, 22001 );
+				bot->connection->SetEventQueue( &bot->events );
+				bot->connection->Connect( ioService );
+				bot->connection->SendHello( capabilities );
+				SendViewpoint( *bot, random, spread );
+			}
+			catch( std::exception &e )
+			{
+				LOG_ERROR( "Connection " << bots.size() + 1 << " failed: " << e.what() );
+				clientCount = bots.size();
+				break;
+			}
+
+			bots.push_back( move( bot ) );
+		}
+
+		for( auto &bot : bots )
+		{
+			Poll( *bot, statistics );
+
+			// Catch up with the ping rate since connecting
+			if( pingRate > 0.f )
+			{
+				auto due = static_cast<uint64_t>( chrono::duration<float>( Clock::now() - bot->connectStarted ).count() * pingRate );
+				for( ; bot->pingsSent < due; bot->pingsSent++ )
+				{
+					bot->connection->Ping();
+				}
+			}
+
+			bot->connection->Flush();
+		}
+
+		auto now = Clock::now();
+		if( now - lastReport >= chrono::seconds( BOT_REPORT_INTERVAL ) )
+		{
+			Report(
+				bots,
+				statistics,
+				chrono::duration<float>( now - lastReport ).count(),
+				memoryBefore,
+				serverPid,
+				serverMemoryBefore
+			);
+			lastReport = now;
+		}
+
+		this_thread::sleep_for( chrono::milliseconds( 1 ) );
+	}
+
+	for( auto &bot : bots )
+	{
+		bot->connection->Disconnect();
+	}
+
+	ioService.stop();
+	for( auto &ioThread : ioThreads )
+	{
+		ioThread.join();
+	}
+
+	return 0;
+}
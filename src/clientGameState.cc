@@ -2,6 +2,7 @@
 
 #include "network/serverConnection.hh"
 #include "network/serializable.hh"
+#include "network/binaryStream.hh"
 #include "world/objectEvents.hh"
 #include "task.hh"
 #include "logger.hh"
@@ -43,6 +44,26 @@ std::shared_ptr<ServerConnection> connection;
 
 
 ClientGameState::ClientGameState()
+	: messageParser(
+		[]( Event *event )
+		{
+			eventQueue.AddEvent( event );
+		},
+		[this]( const vector<NodeTransform> &transforms, uint64_t sampleTime )
+		{
+			if( objectManager )
+			{
+				objectManager->ApplyTransforms( transforms, sampleTime );
+			}
+		},
+		[this]( const TransformArrays &transforms, uint64_t sampleTime )
+		{
+			if( objectManager )
+			{
+				objectManager->ApplyTransforms( transforms, sampleTime );
+			}
+		}
+	)
 {
 	state.connected       = false;
 	state.tryingToConnect = false;
@@ -175,26 +196,36 @@ void ClientGameState::Tick( std::chrono::milliseconds deltaTime )
 	);
 	*/
 
+	// Let the server know if the camera has moved
+	if( state.connected && cam.position.Get() != sentViewpoint )
+	{
+		SendViewpoint();
+	}
+
+	// Send what this tick and the events since the last one wrote
+	if( state.connected && connection )
+	{
+		connection->Flush();
+	}
+
 	// Update transform matrices
 	if( !objectManager.get() )
 	{
 		return;
 	}
 
+	// Show the nodes a little behind the snapshots, between the two
+	// around that time rather than guessing past the newest one
+	auto renderTime = objectManager->interpolation.RenderTime();
+
 	objectManager->managerMutex.lock();
 	for( auto& node : objectManager->worldNodes )
 	{
-		node->position.Calculate( 0.9f );
-		node->rotation.Calculate();
+		node->position.Interpolate( renderTime );
+		node->rotation.Interpolate( renderTime );
 	}
 
-	for( auto& node : objectManager->worldNodes )
-	{
-		if( node->parent == 0 )
-		{
-			node->UpdateModelMatrix();
-		}
-	}
+	objectManager->UpdateTransforms();
 
 	// Check for collisions:
 	// NOTE: This is just temporarily here
@@ -300,6 +331,30 @@ void ClientGameState::Connect()
 
 
 
+void ClientGameState::SendViewpoint()
+{
+	if( !connection || !connection->IsConnected() )
+	{
+		return;
+	}
+
+	sentViewpoint = cam.position.Get();
+
+	string packet( 1 + 2 + 4 * 4, '\0' );
+
+	BinaryWriter writer( packet );
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_VIEWPOINT );
+	writer.WriteFloat( sentViewpoint.x );
+	writer.WriteFloat( sentViewpoint.y );
+	writer.WriteFloat( sentViewpoint.z );
+	writer.WriteFloat( DEFAULT_VIEW_RADIUS );
+
+	connection->Write( packet );
+}
+
+
+
 void ClientGameState::Render()
 {
 	objectManager->managerMutex.lock();
@@ -376,6 +431,9 @@ void ClientGameState::HandleEvent( Event *e )
 				// Update state
 				state.connected       = true;
 				state.tryingToConnect = false;
+				messageParser.Reset();
+				connection->SendHello( CAPABILITY_COMPRESSION | CAPABILITY_PACKED_OBJECTS );
+				SendViewpoint();
 
 				// For now, construct few events here
 				// manually and send them to the server:
@@ -384,7 +442,7 @@ void ClientGameState::HandleEvent( Event *e )
 				//SerializeUint8( stream, (uint8_t)OBJECT_EVENT );	// Event type
 				//SerializeUint16( stream, (uint16_t)OBJECT_CREATE ); // Event sub type
 				//SerializeUint8( stream, (uint8_t)1 );               // Object type
-				//stream << tmpNode.Serialize( vector<string>() );    // Serialize all
+				//stream << tmpNode.Serialize( vector<FieldId>() );    // Serialize all
 				break;
 
 
@@ -459,153 +517,5 @@ _unhandled:
 
 void ClientGameState::HandleDataInEvent( DataInEvent *e )
 {
-	char buffer[USHRT_MAX];
-
-	size_t offset = 0;
-
-	while( e->data.size() > 0 )
-	{
-		stringstream stream(
-			stringstream::in |
-			stringstream::out |
-			stringstream::binary
-		);
-
-		stream << e->data;
-
-		// Get the length
-		auto packetLength = UnserializeUint16( stream );
-		offset += packetLength;
-
-		// Cap the packet length so it can't overflow
-		if( packetLength > e->data.size() )
-		{
-			if( e->data.size() >= 2 )
-			{
-				packetLength = e->data.size() - 2;
-			}
-			else
-			{
-				packetLength = 1;
-			}
-		}
-
-		auto currentPacket = e->data.substr( 2, packetLength-2 );
-		e->data = e->data.substr( packetLength );
-
-		// Get the type
-		EventType type = static_cast<EventType>(
-			UnserializeUint8( stream )
-		);
-
-		if( type >= EVENT_TYPE_COUNT )
-		{
-			LOG_ERROR( "Received invalid type(" << static_cast<unsigned int>( type ) << ")!" );
-			return;
-		}
-
-		// Get the sub type
-		EventSubType subType = static_cast<EventSubType>(
-			UnserializeUint16( stream )
-		);
-
-		if( subType >= EVENT_SUB_TYPE_COUNT )
-		{
-			LOG_ERROR( "Received invalid sub type(" << static_cast<unsigned int>( subType ) << ")!" );
-			continue;
-		}
-
-		// Copy the data to the dataStream
-		stringstream dataStream(
-			stringstream::in |
-			stringstream::out |
-			stringstream::binary
-		);
-
-		ObjectCreateEvent    *create;
-		ObjectDestroyEvent   *destroy;
-		ObjectUpdateEvent    *update;
-		ObjectParentAddEvent *parentAdd;
-		ObjectChildAddEvent  *childAdd;
-
-		size_t dataCount;
-
-		// Construct the event
-		switch( type )
-		{
-			case OBJECT_EVENT:
-				switch( subType )
-				{
-					case( OBJECT_CREATE ):
-						create = new ObjectCreateEvent();
-						create->type = OBJECT_EVENT;
-						create->subType = OBJECT_CREATE;
-						create->objectType = static_cast<WorldObjectType>( UnserializeUint8( stream ) );
-
-						dataCount = stream.str().length() - 4;
-						stream.read( buffer, dataCount );
-						dataStream.write( buffer, dataCount );
-
-						create->data = dataStream.str();
-						eventQueue.AddEvent( create );
-						break;
-
-
-					case( OBJECT_DESTROY ):
-						destroy = new ObjectDestroyEvent();
-						destroy->type = OBJECT_EVENT;
-						destroy->subType = OBJECT_DESTROY;
-						destroy->objectId = UnserializeUint32( stream );
-						eventQueue.AddEvent( destroy );
-						break;
-
-
-					case( OBJECT_UPDATE ):
-						update = new ObjectUpdateEvent();
-						update->type = OBJECT_EVENT;
-						update->subType = OBJECT_UPDATE;
-						update->objectId = UnserializeUint32( stream );
-
-						dataCount = stream.str().length() - 7;
-						stream.read( buffer, dataCount );
-						dataStream.write( buffer, dataCount );
-
-						update->data = dataStream.str();
-						eventQueue.AddEvent( update );
-						break;
-
-
-					case( OBJECT_PARENT_ADD ):
-						parentAdd = new ObjectParentAddEvent();
-						parentAdd->type = OBJECT_EVENT;
-						parentAdd->subType = OBJECT_PARENT_ADD;
-						parentAdd->objectId = UnserializeUint32( stream );
-						parentAdd->parentId  = UnserializeUint32( stream );
-						eventQueue.AddEvent( parentAdd );
-						break;
-
-
-					case( OBJECT_CHILD_ADD ):
-						childAdd = new ObjectChildAddEvent();
-						childAdd->type = OBJECT_EVENT;
-						childAdd->subType = OBJECT_CHILD_ADD;
-						childAdd->objectId = UnserializeUint32( stream );
-						childAdd->childId  = UnserializeUint32( stream );
-						eventQueue.AddEvent( childAdd );
-						break;
-
-
-					default:
-						break;
-				}
-				break;
-
-
-			default:
-				LOG_ERROR( ToString( "Constructing event of type "
-									 << EventTypeToStr( type )
-									 << " not yet handled!" ) );
-		}
-	}
+	messageParser.Parse( e->data, connection.get() );
 }
-
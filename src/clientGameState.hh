@@ -8,6 +8,7 @@
 #include "world/entity.hh"
 
 #include "managers/clientObjectManager.hh"
+#include "network/serverMessageParser.hh"
 
 #include <vector>
 #include <memory>
@@ -38,9 +39,16 @@ class ClientGameState : public GameState, public EventListener
  protected:
 	void Connect();
 
+	// Tells the server where we're looking from
+	void SendViewpoint();
+	glm::vec3 sentViewpoint;
+
 	// Event handling
 	void HandleDataInEvent( DataInEvent* );
 
+	// Turns the server's messages into events and transforms
+	ServerMessageParser messageParser;
+
 	// State info and flags
 	struct
 	{
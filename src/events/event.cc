@@ -43,6 +43,10 @@ string EventSubTypeToStr( EventSubType type )
 		case NETWORK_DATA_IN: ret = "Network Data In"; break;
 		case NETWORK_PING:    ret = "Network Ping"; break;
 		case NETWORK_PONG:    ret = "Network Pong"; break;
+		case NETWORK_UDP_BIND: ret = "Network UDP Bind"; break;
+		case NETWORK_VIEWPOINT: ret = "Network Viewpoint"; break;
+		case NETWORK_HELLO: ret = "Network Hello"; break;
+		case NETWORK_COMPRESSED: ret = "Network Compressed"; break;
 
 		case STATE_RUN_START: ret = "State Run Start"; break;
 		case STATE_RUN_PAUSE: ret = "State Run Pause"; break;
@@ -54,6 +58,9 @@ string EventSubTypeToStr( EventSubType type )
 		case OBJECT_PARENT_REMOVE: ret = "Object Parent Remove"; break;
 		case OBJECT_CHILD_ADD:     ret = "Object Child Add"; break;
 		case OBJECT_CHILD_REMOVE:  ret = "Object Child Remove"; break;
+		case OBJECT_SNAPSHOT:      ret = "Object Snapshot"; break;
+		case OBJECT_UPDATE_BATCH:  ret = "Object Update Batch"; break;
+		case OBJECT_PACKED:        ret = "Object Packed"; break;
 
 		case SDL_MOUSE_DOWN:     ret = "SDL Mouse Down"; break;
 		case SDL_MOUSE_UP:       ret = "SDL Mouse Up"; break;
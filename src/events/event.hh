@@ -31,6 +31,10 @@ enum EventSubType : EVENT_SUB_TYPE
 	NETWORK_DATA_IN,
 	NETWORK_PING,
 	NETWORK_PONG,
+	NETWORK_UDP_BIND,
+	NETWORK_VIEWPOINT,
+	NETWORK_HELLO,
+	NETWORK_COMPRESSED,
 
 	// State events
 	STATE_RUN_START,
@@ -44,6 +48,9 @@ enum EventSubType : EVENT_SUB_TYPE
 	OBJECT_PARENT_REMOVE,
 	OBJECT_CHILD_ADD,
 	OBJECT_CHILD_REMOVE,
+	OBJECT_SNAPSHOT,
+	OBJECT_UPDATE_BATCH,
+	OBJECT_PACKED,
 
 	// SDL input events
 	SDL_MOUSE_DOWN,
@@ -69,6 +76,9 @@ struct Event
 {
 	Event();
 
+	// The events are deleted through the base
+	virtual ~Event() {}
+
 	EventType      type;
 	EventSubType   subType;
 	ExecutionTimer timer;
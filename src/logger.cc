@@ -3,7 +3,7 @@
 
 using namespace std;
 
-Logger::Logger()
+Logger::Logger() : quiet( false )
 {
 }
 
@@ -21,7 +21,10 @@ void Logger::Log( string message )
 {
 	loggerMutex.lock();
 
-	cout << message << endl;
+	if( !quiet )
+	{
+		cout << message << endl;
+	}
 
 	loggerMutex.unlock();
 }
@@ -37,3 +40,11 @@ void Logger::LogError( string message )
 	loggerMutex.unlock();
 }
 
+
+
+void Logger::SetQuiet( bool value )
+{
+	loggerMutex.lock();
+	quiet = value;
+	loggerMutex.unlock();
+}
@@ -11,6 +11,9 @@ class Logger
 	void Log( std::string );
 	void LogError( std::string );
 
+	// Drops everything but the errors
+	void SetQuiet( bool quiet );
+
 	static Logger& GetInstance();
 
 
@@ -20,6 +23,7 @@ class Logger
 	void operator=( Logger const& );
 
 	std::mutex loggerMutex;
+	bool       quiet;
 };
 
 
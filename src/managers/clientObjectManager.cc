@@ -7,13 +7,37 @@
 using namespace std;
 
 
+namespace
+{
+	// Is the node the root or anywhere under it
+	bool InSubtree( const WorldNode &root, const WorldNode *node )
+	{
+		if( &root == node )
+		{
+			return true;
+		}
+
+		for( auto &child : root.children )
+		{
+			if( InSubtree( *child, node ) )
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+
+
 void ClientObjectManager::HandleEvent( Event *e )
 {
 	lock_guard<std::mutex> lock( managerMutex );
 
 	ObjectCreateEvent  *createEvent;
 	ObjectUpdateEvent  *updateEvent;
-	//ObjectDestroyEvent *destroyEvent;
+	ObjectDestroyEvent *destroyEvent;
 
 	ObjectParentAddEvent     *parentAddEvent;
 	ObjectParentRemoveEvent  *parentRemoveEvent;
@@ -29,6 +53,8 @@ void ClientObjectManager::HandleEvent( Event *e )
 	shared_ptr<WorldNode>     newNode;
 	shared_ptr<Entity>        newEntity;
 	shared_ptr<PhysicsObject> newPhysicsObject;
+	WorldNode                *node;
+	unsigned int              id;
 
 	switch( e->subType )
 	{
@@ -46,14 +72,13 @@ void ClientObjectManager::HandleEvent( Event *e )
 				newEntity = make_shared<Entity>();
 				newEntity->Unserialize( createEvent->data );
 				newNode = newEntity;
-				entities.push_back( newEntity );
 			}
 			else if( createEvent->objectType == PHYSICS_OBJECT_TYPE )
 			{
 				newPhysicsObject = make_shared<PhysicsObject>();
 				newPhysicsObject->Unserialize( createEvent->data );
-				newNode = newPhysicsObject;
-				entities.push_back( newPhysicsObject );
+				newNode   = newPhysicsObject;
+				newEntity = newPhysicsObject;
 			}
 			else
 			{
@@ -61,13 +86,22 @@ void ClientObjectManager::HandleEvent( Event *e )
 				break;
 			}
 
+			if( newEntity )
+			{
+				AddEntity( newEntity );
+			}
+			else
+			{
+				AddNode( newNode );
+			}
+
 			LOG( "Object created in the clientobjectmanager!" );
-			worldNodes.push_back( newNode );
 			break;
 
 
 		case OBJECT_DESTROY:
-			//destroyEvent = static_cast<ObjectDestroyEvent*>( e );
+			destroyEvent = static_cast<ObjectDestroyEvent*>( e );
+			RemoveNode( destroyEvent->objectId );
 			LOG( "Object destroyed!" );
 			break;
 
@@ -75,17 +109,13 @@ void ClientObjectManager::HandleEvent( Event *e )
 		case OBJECT_UPDATE:
 			updateEvent = static_cast<ObjectUpdateEvent*>( e );
 
-			for( auto& node : worldNodes )
+			node = Find( updateEvent->objectId );
+			if( node )
 			{
-				if( node->id == updateEvent->objectId )
-				{
-					node->Unserialize( updateEvent->data );
-				}
-			}
-
-			if( newNode )
-			{
-				newNode->Unserialize( updateEvent->data );
+				// The node stays where it's indexed
+				id = node->id;
+				node->Unserialize( updateEvent->data );
+				node->id = id;
 			}
 			break;
 
@@ -129,60 +159,213 @@ void ClientObjectManager::HandleEvent( Event *e )
 
 
 
-void ClientObjectManager::AddParent( unsigned int childId, unsigned int parentId )
+void ClientObjectManager::ApplyTransforms( const vector<NodeTransform> &transforms, uint64_t sampleTime )
 {
-	for( auto& node : worldNodes )
+	if( transforms.empty() )
 	{
-		if( node->id == childId )
+		return;
+	}
+
+	// The TelemetryClock() is the steady clock in microseconds
+	Smooth<glm::vec3>::HiResTimePoint time{ chrono::microseconds( sampleTime ) };
+	interpolation.SampleArrived( time );
+
+	lock_guard<std::mutex> lock( managerMutex );
+
+	for( auto& transform : transforms )
+	{
+		auto node = Find( transform.id );
+		if( !node )
 		{
-			node->parent = parentId;
-			break;
+			continue;
 		}
+
+		node->position.Update( transform.position, time );
+		node->rotation.Update( transform.rotation, time );
 	}
 }
 
 
 
-void ClientObjectManager::RemoveParent( unsigned int childId, unsigned int parentId )
+void ClientObjectManager::ApplyTransforms( const TransformArrays &transforms, uint64_t sampleTime )
 {
-	for( auto& node : worldNodes )
+	if( !transforms.Size() )
+	{
+		return;
+	}
+
+	Smooth<glm::vec3>::HiResTimePoint time{ chrono::microseconds( sampleTime ) };
+	interpolation.SampleArrived( time );
+
+	lock_guard<std::mutex> lock( managerMutex );
+
+	// Straight from the arrays into the nodes
+	for( size_t i = 0; i < transforms.Size(); i++ )
 	{
-		if( node->id == childId )
+		auto node = Find( transforms.ids[i] );
+		if( !node )
 		{
-			node->parent = 0;
-			break;
+			continue;
 		}
+
+		node->position.Update( glm::vec3( transforms.x[i], transforms.y[i], transforms.z[i] ), time );
+		node->rotation.Update( glm::quat( transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i] ), time );
 	}
 }
 
 
 
-void ClientObjectManager::AddChild( unsigned int parentId, unsigned int childId )
+void ClientObjectManager::AddNode( const shared_ptr<WorldNode> &node )
 {
-	shared_ptr<WorldNode> parent = nullptr;
-	shared_ptr<WorldNode> child  = nullptr;
+	RemoveNode( node->id );
+
+	node->transform = transforms.Add();
+	transforms.SetLocal( node->transform, node->position.Get(), node->rotation.Get(), node->scale );
+
+	if( node->transform >= transformNodes.size() )
+	{
+		transformNodes.resize( node->transform + 1 );
+	}
+	transformNodes[node->transform] = node.get();
 
+	index.Insert( node->id, static_cast<uint32_t>( worldNodes.size() ) );
+	worldNodes.push_back( node );
+}
+
+
+
+void ClientObjectManager::AddEntity( const shared_ptr<Entity> &entity )
+{
+	AddNode( entity );
+
+	entityIndex.Insert( entity->id, static_cast<uint32_t>( entities.size() ) );
+	entities.push_back( entity );
+}
+
+
+
+WorldNode* ClientObjectManager::Find( unsigned int id ) const
+{
+	auto slot = index.Find( id );
+	return slot != NODE_INDEX_NONE ? worldNodes[slot].get() : nullptr;
+}
+
+
+
+void ClientObjectManager::UpdateTransforms()
+{
+	// Usually most of them stand still
 	for( auto& node : worldNodes )
 	{
-		if( node->id == parentId )
+		if( node->TakeMovedFields() )
 		{
-			parent = node;
+			transforms.SetLocal( node->transform, node->position.Get(), node->rotation.Get(), node->scale );
 		}
+	}
 
-		else if( node->id == childId )
-		{
-			child = node;
-		}
+	transforms.Update();
 
-		if( parent.get() && child.get() )
-		{
-			break;
-		}
+	for( auto handle : transforms.Updated() )
+	{
+		transformNodes[handle]->modelMatrix = transforms.World( handle );
+	}
+}
+
+
+
+void ClientObjectManager::RemoveNode( unsigned int id )
+{
+	auto slot = index.Find( id );
+	if( slot == NODE_INDEX_NONE )
+	{
+		return;
+	}
+
+	auto node = worldNodes[slot];
+
+	if( node->parent != 0 )
+	{
+		RemoveChild( node->parent, id );
+	}
+
+	// The server destroys the children too, but don't
+	// leave them pointing to a missing parent meanwhile
+	for( auto& child : node->children )
+	{
+		child->parent = 0;
+	}
+
+	// Its children are roots in there now
+	transformNodes[node->transform] = nullptr;
+	transforms.Remove( node->transform );
+	node->transform = TRANSFORM_NONE;
+
+	// Move the last ones to the freed slots
+	index.Remove( id );
+	if( slot + 1 < worldNodes.size() )
+	{
+		worldNodes[slot] = worldNodes.back();
+		index.Insert( worldNodes[slot]->id, slot );
+	}
+	worldNodes.pop_back();
+
+	slot = entityIndex.Find( id );
+	if( slot == NODE_INDEX_NONE )
+	{
+		return;
+	}
+
+	entityIndex.Remove( id );
+	if( slot + 1 < entities.size() )
+	{
+		entities[slot] = entities.back();
+		entityIndex.Insert( entities[slot]->id, slot );
+	}
+	entities.pop_back();
+}
+
+
+
+void ClientObjectManager::AddParent( unsigned int childId, unsigned int parentId )
+{
+	auto child = Find( childId );
+	if( child )
+	{
+		child->parent = parentId;
+	}
+}
+
+
+
+void ClientObjectManager::RemoveParent( unsigned int childId, unsigned int parentId )
+{
+	auto child = Find( childId );
+	if( child )
+	{
+		child->parent = 0;
 	}
+}
 
-	if( parent.get() && child.get() )
+
+
+void ClientObjectManager::AddChild( unsigned int parentId, unsigned int childId )
+{
+	auto parentSlot = index.Find( parentId );
+	auto childSlot  = index.Find( childId );
+	if( parentSlot == NODE_INDEX_NONE || childSlot == NODE_INDEX_NONE )
+	{
+		return;
+	}
+
+	auto &parent = worldNodes[parentSlot];
+	auto &child  = worldNodes[childSlot];
+
+	// A node under itself would never be freed and the model matrices
+	// would recurse without an end, only a broken message does that
+	if( !InSubtree( *child, parent.get() ) )
 	{
 		parent->children.push_back( child );
+		transforms.SetParent( child->transform, parent->transform );
 	}
 }
 
@@ -190,24 +373,27 @@ void ClientObjectManager::AddChild( unsigned int parentId, unsigned int childId
 
 void ClientObjectManager::RemoveChild( unsigned int parentId, unsigned int childId )
 {
-	for( auto& node : worldNodes )
+	auto parent = Find( parentId );
+	if( !parent )
 	{
-		if( node->id != parentId )
+		return;
+	}
+
+	for( auto it=parent->children.begin(); it != parent->children.end(); it++ )
+	{
+		if( (*it)->id != childId )
 		{
 			continue;
 		}
 
-
-		for( auto it=node->children.begin(); it != node->children.end(); it++ )
+		// Unless it has been added under another one since
+		auto child = ( *it )->transform;
+		if( transforms.Parent( child ) == parent->transform )
 		{
-			if( (*it)->id != childId )
-			{
-				continue;
-			}
-
-			node->children.erase( it );
-			return;
+			transforms.SetParent( child, TRANSFORM_NONE );
 		}
+
+		parent->children.erase( it );
+		return;
 	}
 }
-
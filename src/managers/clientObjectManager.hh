@@ -4,6 +4,9 @@
 #include "../events/eventDispatcher.hh"
 #include "../world/worldNode.hh"
 #include "../world/entity.hh"
+#include "../network/snapshot.hh"
+#include "../network/transformBatch.hh"
+#include "nodeIndex.hh"
 
 #include <vector>
 #include <memory>
@@ -14,17 +17,51 @@ class ClientObjectManager : public EventListener
  public:
 	void HandleEvent( Event *e );
 
+	// Applies the transforms decoded from a snapshot, sampleTime
+	// is in microseconds of the TelemetryClock()
+	void ApplyTransforms( const std::vector<NodeTransform> &transforms, uint64_t sampleTime );
+	void ApplyTransforms( const TransformArrays &transforms, uint64_t sampleTime );
+
+	// Adds the node indexed by its id, replaces the one
+	// with the same id if there's one
+	void AddNode( const std::shared_ptr<WorldNode> &node );
+	void AddEntity( const std::shared_ptr<Entity> &entity );
+
+	// Returns nullptr if there's no node with the id
+	WorldNode* Find( unsigned int id ) const;
+
+	// Computes the model matrices of the nodes that have moved
+	// and of the ones under them, the caller holds the managerMutex
+	void UpdateTransforms();
+
+	// Added through AddNode() and AddEntity(), in no particular
+	// order, the entities are among the nodes too
 	std::vector<std::shared_ptr<WorldNode>> worldNodes;
 	std::vector<std::shared_ptr<Entity>>    entities;
 
 	std::mutex managerMutex;
 
+	// How far behind the snapshots the nodes are rendered
+	InterpolationDelay interpolation;
+
  private:
+	// Removes the node and detaches it from the hierarchy
+	void RemoveNode( unsigned int id );
 
 	void AddParent( unsigned int childId, unsigned int parentId );
 	void RemoveParent( unsigned int childId, unsigned int parentId );
 
 	void AddChild( unsigned int parentId, unsigned int childId );
 	void RemoveChild( unsigned int parentId, unsigned int childId );
+
+	// Slots of the worldNodes and the entities by their ids
+	NodeIndex index;
+	NodeIndex entityIndex;
+
+	// The hierarchy of the children added with AddChild()
+	TransformSystem transforms;
+
+	// The nodes by their transforms, for the matrices to go back to
+	std::vector<WorldNode*> transformNodes;
 };
 
@@ -0,0 +1,125 @@
+#include "nodeIndex.hh"
+
+using namespace std;
+
+
+NodeIndex::NodeIndex()
+{
+	Clear();
+}
+
+
+
+void NodeIndex::Insert( uint32_t id, uint32_t slot )
+{
+	// Keep at least half of the buckets empty for short probes
+	if( ( count + 1 ) * 2 > buckets.size() )
+	{
+		Grow();
+	}
+
+	auto &bucket = buckets[Probe( id )];
+	if( bucket.slot == NODE_INDEX_NONE )
+	{
+		bucket.id = id;
+		count++;
+	}
+
+	bucket.slot = slot;
+}
+
+
+
+void NodeIndex::Remove( uint32_t id )
+{
+	auto mask = buckets.size() - 1;
+	auto hole = Probe( id );
+	if( buckets[hole].slot == NODE_INDEX_NONE )
+	{
+		return;
+	}
+
+	// Shift the following ids of the run back into the hole when it's
+	// between them and their home, so no probe stops at it too early
+	for( auto next = ( hole + 1 ) & mask; buckets[next].slot != NODE_INDEX_NONE; next = ( next + 1 ) & mask )
+	{
+		auto home = Home( buckets[next].id );
+		if( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) )
+		{
+			buckets[hole] = buckets[next];
+			hole          = next;
+		}
+	}
+
+	buckets[hole].slot = NODE_INDEX_NONE;
+	count--;
+}
+
+
+
+uint32_t NodeIndex::Find( uint32_t id ) const
+{
+	return buckets[Probe( id )].slot;
+}
+
+
+
+size_t NodeIndex::Size() const
+{
+	return count;
+}
+
+
+
+void NodeIndex::Clear()
+{
+	buckets.assign( NODE_INDEX_INITIAL_BUCKETS, Bucket{ 0, NODE_INDEX_NONE } );
+	count = 0;
+	shift = 32;
+	for( auto size = buckets.size(); size > 1; size /= 2 )
+	{
+		shift--;
+	}
+}
+
+
+
+size_t NodeIndex::Home( uint32_t id ) const
+{
+	// Fibonacci hashing, the top bits of the product are the
+	// best mixed, sequential ids end up spread out
+	return static_cast<uint32_t>( id * 2654435769u ) >> shift;
+}
+
+
+
+size_t NodeIndex::Probe( uint32_t id ) const
+{
+	auto mask  = buckets.size() - 1;
+	auto index = Home( id );
+
+	while( buckets[index].slot != NODE_INDEX_NONE && buckets[index].id != id )
+	{
+		index = ( index + 1 ) & mask;
+	}
+
+	return index;
+}
+
+
+
+void NodeIndex::Grow()
+{
+	vector<Bucket> old;
+	old.swap( buckets );
+	buckets.assign( old.size() * 2, Bucket{ 0, NODE_INDEX_NONE } );
+	shift--;
+
+	for( auto &bucket : old )
+	{
+		if( bucket.slot != NODE_INDEX_NONE )
+		{
+			buckets[Probe( bucket.id )] = bucket;
+		}
+	}
+}
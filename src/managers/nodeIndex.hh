@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+// Slot Find() gives for the ids that aren't indexed
+#define NODE_INDEX_NONE UINT32_MAX
+
+// Buckets of a new index, always a power of two
+#define NODE_INDEX_INITIAL_BUCKETS 64
+
+
+// Maps the ids of the nodes to their slots in the vector the object
+// managers keep them in. An open addressing hash table with linear
+// probing over a single array, at most half full, so a lookup is a
+// multiply and usually a bucket or two of the same cache line. Any id
+// works, the ones from the network included.
+class NodeIndex
+{
+ public:
+	NodeIndex();
+
+	// Sets the slot of the id, whether it was indexed or not
+	void Insert( uint32_t id, uint32_t slot );
+	void Remove( uint32_t id );
+
+	// Returns NODE_INDEX_NONE if the id isn't indexed
+	uint32_t Find( uint32_t id ) const;
+
+	size_t Size() const;
+	void   Clear();
+
+
+ private:
+	struct Bucket
+	{
+		uint32_t id;
+		uint32_t slot; // NODE_INDEX_NONE when empty
+	};
+
+	// Bucket the probing for the id starts from
+	size_t Home( uint32_t id ) const;
+
+	// Bucket of the id or the empty one where it would go
+	size_t Probe( uint32_t id ) const;
+
+	void Grow();
+
+	std::vector<Bucket> buckets;
+	size_t              count;
+	unsigned int        shift;
+};
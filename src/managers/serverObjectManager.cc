@@ -2,6 +2,8 @@
 #include "../logger.hh"
 #include "../world/objectEvents.hh"
 
+#include <algorithm>
+
 using namespace std;
 
 
@@ -11,7 +13,7 @@ void ServerObjectManager::HandleEvent( Event *e )
 
 	ObjectCreateEvent  *createEvent;
 	ObjectUpdateEvent  *updateEvent;
-	//ObjectDestroyEvent *destroyEvent;
+	ObjectDestroyEvent *destroyEvent;
 
 	if( e->type != OBJECT_EVENT )
 	{
@@ -34,7 +36,8 @@ void ServerObjectManager::HandleEvent( Event *e )
 
 
 		case OBJECT_DESTROY:
-			//destroyEvent = static_cast<ObjectDestroyEvent*>( e );
+			destroyEvent = static_cast<ObjectDestroyEvent*>( e );
+			RemoveNode( destroyEvent->objectId );
 			LOG( "Object destroyed!" );
 			break;
 
@@ -54,3 +57,162 @@ void ServerObjectManager::HandleEvent( Event *e )
 	}
 }
 
+
+
+void ServerObjectManager::AddNode( const shared_ptr<WorldNode> &node )
+{
+	node->transform = transforms.Add();
+	transforms.SetLocal( node->transform, node->position.Get(), node->rotation.Get(), node->scale );
+
+	if( node->transform >= transformNodes.size() )
+	{
+		transformNodes.resize( node->transform + 1 );
+	}
+	transformNodes[node->transform] = node.get();
+
+	index.Insert( node->id, static_cast<uint32_t>( worldNodes.size() ) );
+	worldNodes.push_back( node );
+	parents.push_back( node->parent );
+
+	node->TrackDirty( &dirtyNodes );
+}
+
+
+
+WorldNode* ServerObjectManager::Find( unsigned int id ) const
+{
+	auto slot = index.Find( id );
+	return slot != NODE_INDEX_NONE ? worldNodes[slot].get() : nullptr;
+}
+
+
+
+unsigned int ServerObjectManager::Parent( unsigned int id ) const
+{
+	auto slot = index.Find( id );
+	return slot != NODE_INDEX_NONE ? parents[slot] : 0;
+}
+
+
+
+void ServerObjectManager::RemoveNode( unsigned int id )
+{
+	auto slot = index.Find( id );
+	if( slot == NODE_INDEX_NONE )
+	{
+		return;
+	}
+
+	auto node   = worldNodes[slot];
+	auto parent = Find( node->parent );
+	if( parent )
+	{
+		auto &siblings = parent->children;
+		siblings.erase( remove( siblings.begin(), siblings.end(), node ), siblings.end() );
+	}
+
+	// The children are roots until they're destroyed too
+	for( auto& child : node->children )
+	{
+		child->parent = 0;
+
+		auto childSlot = index.Find( child->id );
+		if( childSlot != NODE_INDEX_NONE )
+		{
+			parents[childSlot] = 0;
+		}
+	}
+
+	node->TrackDirty( nullptr );
+
+	transformNodes[node->transform] = nullptr;
+	transforms.Remove( node->transform );
+	node->transform = TRANSFORM_NONE;
+	movedNodes.clear();
+
+	// Move the last one to the freed slot
+	index.Remove( id );
+	if( slot + 1 < worldNodes.size() )
+	{
+		worldNodes[slot] = worldNodes.back();
+		parents[slot]    = parents.back();
+		index.Insert( worldNodes[slot]->id, slot );
+	}
+	worldNodes.pop_back();
+	parents.pop_back();
+
+	// The game state keeps the entities in the order it added them
+	entities.erase(
+		remove_if( entities.begin(), entities.end(),
+			[id]( const shared_ptr<Entity> &entity )
+			{
+				return entity->id == id;
+			}
+		),
+		entities.end()
+	);
+
+	removedNodes.push_back( id );
+}
+
+
+
+vector<unsigned int> ServerObjectManager::TakeRemovedNodes()
+{
+	vector<unsigned int> removed;
+	removed.swap( removedNodes );
+	return removed;
+}
+
+
+
+vector<unsigned int> ServerObjectManager::TakeDirtyNodes()
+{
+	return dirtyNodes.Take();
+}
+
+
+
+void ServerObjectManager::AddChild( const shared_ptr<WorldNode> &parent, const shared_ptr<WorldNode> &child )
+{
+	child->parent = parent->id;
+	parent->children.push_back( child );
+
+	auto slot = index.Find( child->id );
+	if( slot != NODE_INDEX_NONE )
+	{
+		parents[slot] = parent->id;
+	}
+	transforms.SetParent( child->transform, parent->transform );
+}
+
+
+
+void ServerObjectManager::UpdateTransforms()
+{
+	// Usually most of them stand still
+	for( auto& node : worldNodes )
+	{
+		if( node->TakeMovedFields() )
+		{
+			transforms.SetLocal( node->transform, node->position.Get(), node->rotation.Get(), node->scale );
+		}
+	}
+
+	transforms.Update();
+
+	movedNodes.clear();
+	for( auto handle : transforms.Updated() )
+	{
+		auto node = transformNodes[handle];
+		node->modelMatrix = transforms.World( handle );
+		movedNodes.push_back( node );
+	}
+}
+
+
+
+const vector<WorldNode*>& ServerObjectManager::MovedNodes() const
+{
+	return movedNodes;
+}
@@ -4,9 +4,11 @@
 #include "../events/eventDispatcher.hh"
 #include "../world/worldNode.hh"
 #include "../world/entity.hh"
+#include "nodeIndex.hh"
 
 #include <map>
 #include <memory>
+#include <vector>
 
 
 class ServerObjectManager : public EventListener
@@ -14,9 +16,61 @@ class ServerObjectManager : public EventListener
  public:
 	void HandleEvent( Event *e );
 
+	// Adds the node indexed by its id, the caller holds the managerMutex
+	void AddNode( const std::shared_ptr<WorldNode> &node );
+
+	// Returns nullptr if there's no node with the id
+	WorldNode* Find( unsigned int id ) const;
+
+	// Id of the parent of the node, 0 for the roots and the ids that
+	// aren't there. Doesn't touch the node, for walking up many of them.
+	unsigned int Parent( unsigned int id ) const;
+
+	// Removes the node and detaches it from the hierarchy, the
+	// caller holds the managerMutex
+	void RemoveNode( unsigned int id );
+
+	// Ids of the nodes removed since the last call, for what
+	// keeps them elsewhere to let go of them
+	std::vector<unsigned int> TakeRemovedNodes();
+
+	// Ids of the nodes with dirty fields since the last call, the
+	// removed ones may be there too. Taken before their fields.
+	std::vector<unsigned int> TakeDirtyNodes();
+
+	// Puts the child under the parent, both added already
+	void AddChild( const std::shared_ptr<WorldNode> &parent, const std::shared_ptr<WorldNode> &child );
+
+	// Computes the model matrices of the nodes that have moved
+	// and of the ones under them, the caller holds the managerMutex
+	void UpdateTransforms();
+
+	// The nodes whose model matrices the last UpdateTransforms()
+	// changed, until the next one or a removal
+	const std::vector<WorldNode*>& MovedNodes() const;
+
+	// Added through AddNode()
 	std::vector<std::shared_ptr<WorldNode>> worldNodes;
 	std::vector<std::shared_ptr<Entity>>    entities;
 
 	std::mutex managerMutex;
+
+ private:
+	// Slots of the worldNodes by their ids
+	NodeIndex index;
+
+	// Parent ids of the worldNodes by their slots
+	std::vector<unsigned int> parents;
+
+	// The hierarchy of the children added with AddChild()
+	TransformSystem transforms;
+
+	// The nodes by their transforms, for the matrices to go back to
+	std::vector<WorldNode*> transformNodes;
+	std::vector<WorldNode*> movedNodes;
+
+	std::vector<unsigned int> removedNodes;
+
+	DirtyList dirtyNodes;
 };
 
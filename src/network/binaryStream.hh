@@ -0,0 +1,415 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+
+// Windows only runs on little endian machines
+#if defined( _WIN32 ) || ( defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+#define BINARY_STREAM_LITTLE_ENDIAN
+#endif
+
+
+// The value with its bytes in little endian order, nothing
+// to do on the little endian machines
+template<typename T>
+inline T LittleEndian( T value )
+{
+#ifdef BINARY_STREAM_LITTLE_ENDIAN
+	return value;
+#else
+	T swapped = 0;
+	for( size_t i = 0; i < sizeof( T ); i++ )
+	{
+		swapped = static_cast<T>( ( swapped << 8 ) | ( ( value >> ( 8 * i ) ) & 0xff ) );
+	}
+	return swapped;
+#endif
+}
+
+
+
+// Maps the signed values to unsigned ones keeping the small magnitudes
+// small, 0 -1 1 -2 2 ... to 0 1 2 3 4 ..., for the varints
+inline uint32_t ZigZagEncode( int32_t value )
+{
+	return ( static_cast<uint32_t>( value ) << 1 ) ^ static_cast<uint32_t>( value >> 31 );
+}
+
+inline int32_t ZigZagDecode( uint32_t value )
+{
+	return static_cast<int32_t>( ( value >> 1 ) ^ ( 0u - ( value & 1 ) ) );
+}
+
+
+// Bytes BinaryWriter::WriteVarint() takes for the value
+inline size_t VarintLength( uint64_t value )
+{
+	size_t length = 1;
+	while( value >= 0x80 )
+	{
+		value >>= 7;
+		length++;
+	}
+	return length;
+}
+
+
+
+// Writes the values into a buffer that was allocated beforehand, the
+// caller knows how long the data gets. The values are little endian
+// whatever the machine is. Writing past the end writes nothing and
+// marks the writer failed.
+class BinaryWriter
+{
+ public:
+	BinaryWriter( char *buffer, size_t bufferCapacity )
+		: data( reinterpret_cast<uint8_t*>( buffer ) ), capacity( bufferCapacity ), offset( 0 ), failed( false )
+	{
+	}
+
+	// Over the whole string, which has to be resized to the length first
+	explicit BinaryWriter( std::string &buffer )
+		: BinaryWriter( &buffer[0], buffer.size() )
+	{
+	}
+
+	void WriteUint8( uint8_t value )
+	{
+		if( Reserve( 1 ) )
+		{
+			data[offset++] = value;
+		}
+	}
+
+	void WriteUint16( uint16_t value )
+	{
+		WriteLittle( value );
+	}
+
+	void WriteUint32( uint32_t value )
+	{
+		WriteLittle( value );
+	}
+
+	void WriteUint64( uint64_t value )
+	{
+		WriteLittle( value );
+	}
+
+	void WriteFloat( float value )
+	{
+		uint32_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		WriteLittle( bits );
+	}
+
+	void WriteDouble( double value )
+	{
+		uint64_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		WriteLittle( bits );
+	}
+
+	void WriteBytes( const char *bytes, size_t length )
+	{
+		if( Reserve( length ) )
+		{
+			memcpy( data + offset, bytes, length );
+			offset += length;
+		}
+	}
+
+	void WriteBytes( const std::string &bytes )
+	{
+		WriteBytes( bytes.data(), bytes.size() );
+	}
+
+	// An array of values one after another, a single copy on the
+	// little endian machines
+	void WriteUint32Array( const uint32_t *values, size_t count )
+	{
+#ifdef BINARY_STREAM_LITTLE_ENDIAN
+		WriteBytes( reinterpret_cast<const char*>( values ), count * sizeof( uint32_t ) );
+#else
+		if( Reserve( count * sizeof( uint32_t ) ) )
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				WriteLittle( values[i] );
+			}
+		}
+#endif
+	}
+
+	// Seven bits at a time, lowest first, with the top bit of each byte
+	// telling if more follow. The values below 128 take a byte.
+	void WriteVarint( uint64_t value )
+	{
+		if( !Reserve( VarintLength( value ) ) )
+		{
+			return;
+		}
+
+		while( value >= 0x80 )
+		{
+			data[offset++] = static_cast<uint8_t>( value | 0x80 );
+			value >>= 7;
+		}
+		data[offset++] = static_cast<uint8_t>( value );
+	}
+
+	// A string of up to 255 characters with an 8 bit length in front,
+	// the longer ones are cut
+	void WriteString( const std::string &value )
+	{
+		auto length = value.size() < 255 ? value.size() : 255;
+		WriteUint8( static_cast<uint8_t>( length ) );
+		WriteBytes( value.data(), length );
+	}
+
+	// Bytes written so far
+	size_t Length() const
+	{
+		return offset;
+	}
+
+	size_t Remaining() const
+	{
+		return capacity - offset;
+	}
+
+	bool Failed() const
+	{
+		return failed;
+	}
+
+
+ private:
+	bool Reserve( size_t length )
+	{
+		if( failed || length > capacity - offset )
+		{
+			failed = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	void WriteLittle( T value )
+	{
+		if( !Reserve( sizeof( T ) ) )
+		{
+			return;
+		}
+
+		value = LittleEndian( value );
+		memcpy( data + offset, &value, sizeof( T ) );
+		offset += sizeof( T );
+	}
+
+	uint8_t *data;
+	size_t   capacity;
+	size_t   offset;
+	bool     failed;
+};
+
+
+
+// Bounds checked cursor over the bytes BinaryWriter wrote. Reading
+// past the end gives zeros and marks the reader failed.
+class BinaryReader
+{
+ public:
+	BinaryReader( const char *buffer, size_t bufferLength )
+		: data( reinterpret_cast<const uint8_t*>( buffer ) ), length( bufferLength ), offset( 0 ), failed( false )
+	{
+	}
+
+	explicit BinaryReader( const std::string &buffer )
+		: BinaryReader( buffer.data(), buffer.size() )
+	{
+	}
+
+	uint8_t ReadUint8()
+	{
+		return Available( 1 ) ? data[offset++] : 0;
+	}
+
+	uint16_t ReadUint16()
+	{
+		return ReadLittle<uint16_t>();
+	}
+
+	uint32_t ReadUint32()
+	{
+		return ReadLittle<uint32_t>();
+	}
+
+	uint64_t ReadUint64()
+	{
+		return ReadLittle<uint64_t>();
+	}
+
+	float ReadFloat()
+	{
+		auto  bits = ReadLittle<uint32_t>();
+		float value;
+		memcpy( &value, &bits, sizeof( value ) );
+		return value;
+	}
+
+	double ReadDouble()
+	{
+		auto   bits = ReadLittle<uint64_t>();
+		double value;
+		memcpy( &value, &bits, sizeof( value ) );
+		return value;
+	}
+
+	// Counterpart of BinaryWriter::WriteUint32Array(), gives
+	// false and leaves values as they were if it's cut short
+	bool ReadUint32Array( uint32_t *values, size_t count )
+	{
+		if( failed || count > Remaining() / sizeof( uint32_t ) )
+		{
+			failed = true;
+			return false;
+		}
+
+#ifdef BINARY_STREAM_LITTLE_ENDIAN
+		memcpy( values, data + offset, count * sizeof( uint32_t ) );
+		offset += count * sizeof( uint32_t );
+#else
+		for( size_t i = 0; i < count; i++ )
+		{
+			values[i] = ReadLittle<uint32_t>();
+		}
+#endif
+		return true;
+	}
+
+	// Counterpart of BinaryWriter::WriteVarint(), one longer
+	// than ten bytes marks the reader failed
+	uint64_t ReadVarint()
+	{
+		uint64_t value = 0;
+		for( unsigned shift = 0; shift < 64; shift += 7 )
+		{
+			if( !Available( 1 ) )
+			{
+				return 0;
+			}
+
+			auto group = data[offset++];
+			value |= static_cast<uint64_t>( group & 0x7f ) << shift;
+			if( !( group & 0x80 ) )
+			{
+				return value;
+			}
+		}
+
+		failed = true;
+		return 0;
+	}
+
+	// The next count bytes
+	std::string ReadBytes( size_t count )
+	{
+		if( !Available( count ) )
+		{
+			return std::string();
+		}
+
+		std::string bytes( reinterpret_cast<const char*>( data + offset ), count );
+		offset += count;
+		return bytes;
+	}
+
+	// A string with an 8 bit length in front
+	std::string ReadString()
+	{
+		auto stringLength = ReadUint8();
+		if( !Available( stringLength ) )
+		{
+			return std::string();
+		}
+
+		std::string value( reinterpret_cast<const char*>( data + offset ), stringLength );
+		offset += stringLength;
+		return value;
+	}
+
+	// Everything left in the buffer
+	std::string ReadRest()
+	{
+		if( failed )
+		{
+			return std::string();
+		}
+
+		std::string rest( reinterpret_cast<const char*>( data + offset ), length - offset );
+		offset = length;
+		return rest;
+	}
+
+	void Skip( size_t count )
+	{
+		if( Available( count ) )
+		{
+			offset += count;
+		}
+	}
+
+	// Where the unread bytes start, valid for Remaining() bytes
+	const char* Position() const
+	{
+		return reinterpret_cast<const char*>( data + offset );
+	}
+
+	size_t Remaining() const
+	{
+		return length - offset;
+	}
+
+	bool Failed() const
+	{
+		return failed;
+	}
+
+
+ private:
+	bool Available( size_t count )
+	{
+		if( failed || count > length - offset )
+		{
+			failed = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	T ReadLittle()
+	{
+		if( !Available( sizeof( T ) ) )
+		{
+			return 0;
+		}
+
+		T value;
+		memcpy( &value, data + offset, sizeof( T ) );
+		offset += sizeof( T );
+		return LittleEndian( value );
+	}
+
+	const uint8_t *data;
+	size_t         length;
+	size_t         offset;
+	bool           failed;
+};
@@ -0,0 +1,117 @@
+#include "bitStream.hh"
+
+using namespace std;
+
+
+BitWriter::BitWriter()
+{
+	Clear();
+}
+
+
+
+void BitWriter::Write( uint32_t value, unsigned int bits )
+{
+	if( bits < 32 )
+	{
+		value &= ( 1u << bits ) - 1;
+	}
+
+	scratch     |= static_cast<uint64_t>( value ) << scratchBits;
+	scratchBits += bits;
+	bitCount    += bits;
+
+	// Move the full bytes to the buffer
+	while( scratchBits >= 8 )
+	{
+		buffer.push_back( static_cast<char>( scratch & 0xff ) );
+		scratch     >>= 8;
+		scratchBits  -= 8;
+	}
+}
+
+
+
+size_t BitWriter::BitCount() const
+{
+	return bitCount;
+}
+
+
+
+string BitWriter::Data() const
+{
+	if( !scratchBits )
+	{
+		return buffer;
+	}
+
+	return buffer + static_cast<char>( scratch & 0xff );
+}
+
+
+
+void BitWriter::Clear()
+{
+	buffer.clear();
+	scratch     = 0;
+	scratchBits = 0;
+	bitCount    = 0;
+}
+
+
+
+BitReader::BitReader( const char *data, size_t length )
+	: data( reinterpret_cast<const uint8_t*>( data ) ),
+	  length( length ),
+	  bitPosition( 0 ),
+	  failed( false )
+{
+}
+
+
+
+uint32_t BitReader::Read( unsigned int bits )
+{
+	if( bits > BitsLeft() )
+	{
+		failed      = true;
+		bitPosition = length * 8;
+		return 0;
+	}
+
+	uint64_t value = 0;
+	unsigned got   = 0;
+
+	while( got < bits )
+	{
+		size_t   byte   = bitPosition / 8;
+		unsigned offset = bitPosition % 8;
+		unsigned take   = 8 - offset;
+		if( take > bits - got )
+		{
+			take = bits - got;
+		}
+
+		uint64_t part = ( data[byte] >> offset ) & ( ( 1u << take ) - 1 );
+		value       |= part << got;
+		got         += take;
+		bitPosition += take;
+	}
+
+	return static_cast<uint32_t>( value );
+}
+
+
+
+size_t BitReader::BitsLeft() const
+{
+	return length * 8 - bitPosition;
+}
+
+
+
+bool BitReader::Failed() const
+{
+	return failed;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+// Packs values of arbitrary bit widths tightly after each other,
+// least significant bits first.
+class BitWriter
+{
+ public:
+	BitWriter();
+
+	// Writes the lowest bitCount (at most 32) bits of the value
+	void Write( uint32_t value, unsigned int bitCount );
+
+	// Count of bits written so far
+	size_t BitCount() const;
+
+	// Returns the written data, the last byte padded with zeroes
+	std::string Data() const;
+
+	void Clear();
+
+
+ private:
+	std::string buffer;
+	uint64_t    scratch;
+	unsigned    scratchBits;
+	size_t      bitCount;
+};
+
+
+
+// Reads what BitWriter wrote, every read is bounds checked.
+class BitReader
+{
+ public:
+	BitReader( const char *data, size_t length );
+
+	// Reads bitCount (at most 32) bits, sets the error
+	// flag and returns 0 when reading past the end
+	uint32_t Read( unsigned int bitCount );
+
+	size_t BitsLeft() const;
+	bool   Failed() const;
+
+
+ private:
+	const uint8_t *data;
+	size_t         length;
+	size_t         bitPosition;
+	bool           failed;
+};
@@ -0,0 +1,129 @@
+#include "clientRegistry.hh"
+
+using namespace std;
+
+
+ClientRegistry::ClientRegistry()
+{
+	dense = make_shared<const vector<std::shared_ptr<Client>>>();
+}
+
+
+
+const ClientRegistry::Shard& ClientRegistry::ShardOf( unsigned int id ) const
+{
+	return shards[id % CLIENT_REGISTRY_SHARDS];
+}
+
+
+
+ClientRegistry::Shard& ClientRegistry::ShardOf( unsigned int id )
+{
+	return shards[id % CLIENT_REGISTRY_SHARDS];
+}
+
+
+
+void ClientRegistry::Add( unsigned int id, std::shared_ptr<Client> client )
+{
+	if( !client )
+	{
+		return;
+	}
+
+	lock_guard<mutex> writerLock( writerMutex );
+
+	std::shared_ptr<Client> replaced;
+	{
+		auto &shard = ShardOf( id );
+		lock_guard<mutex> shardLock( shard.shardMutex );
+
+		auto &entry = shard.clients[id];
+		replaced = entry;
+		entry    = client;
+	}
+
+	auto current = atomic_load( &dense );
+	auto clients = make_shared<vector<std::shared_ptr<Client>>>();
+	clients->reserve( current->size() + 1 );
+
+	for( auto &other : *current )
+	{
+		if( other != replaced )
+		{
+			clients->push_back( other );
+		}
+	}
+	clients->push_back( client );
+
+	atomic_store( &dense, ClientList( clients ) );
+}
+
+
+
+bool ClientRegistry::Remove( unsigned int id )
+{
+	lock_guard<mutex> writerLock( writerMutex );
+
+	std::shared_ptr<Client> removed;
+	{
+		auto &shard = ShardOf( id );
+		lock_guard<mutex> shardLock( shard.shardMutex );
+
+		auto it = shard.clients.find( id );
+		if( it == shard.clients.end() )
+		{
+			return false;
+		}
+
+		removed = it->second;
+		shard.clients.erase( it );
+	}
+
+	// The readers may still be going through the old array,
+	// it and the removed client go when they're done
+	auto current = atomic_load( &dense );
+	auto clients = make_shared<vector<std::shared_ptr<Client>>>();
+	clients->reserve( current->size() );
+
+	for( auto &other : *current )
+	{
+		if( other != removed )
+		{
+			clients->push_back( other );
+		}
+	}
+
+	atomic_store( &dense, ClientList( clients ) );
+	return true;
+}
+
+
+
+std::shared_ptr<Client> ClientRegistry::Find( unsigned int id ) const
+{
+	auto &shard = ShardOf( id );
+	lock_guard<mutex> shardLock( shard.shardMutex );
+
+	auto it = shard.clients.find( id );
+	if( it == shard.clients.end() )
+	{
+		return nullptr;
+	}
+
+	return it->second;
+}
+
+
+
+ClientList ClientRegistry::All() const
+{
+	return atomic_load( &dense );
+}
+
+
+
+size_t ClientRegistry::Size() const
+{
+	return All()->size();
+}
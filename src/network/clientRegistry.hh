@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+
+// Shards the client ids are spread over, a lookup locks only one
+#define CLIENT_REGISTRY_SHARDS 16
+
+
+struct Client;
+
+// A fixed array of clients, they stay alive as long as it does
+typedef std::shared_ptr<const std::vector<std::shared_ptr<Client>>> ClientList;
+
+
+// The connected clients. A lookup by id locks only the shard of the id.
+// The broadcasts iterate over a dense array of all the clients that is
+// copied and published again on every add and remove, so getting it is
+// an atomic load that never waits for the accepts or the disconnects and
+// they never wait for a broadcast. A removed client is freed once the
+// last of the arrays and the handlers holding it lets go of it.
+class ClientRegistry
+{
+ public:
+	ClientRegistry();
+
+	void Add( unsigned int id, std::shared_ptr<Client> client );
+
+	// Returns false if there was no such client
+	bool Remove( unsigned int id );
+
+	// Null if there's no such client
+	std::shared_ptr<Client> Find( unsigned int id ) const;
+
+	// The clients at the time of calling, hold on to it while iterating
+	// as the array is freed once a remove publishes another one
+	ClientList All() const;
+
+	size_t Size() const;
+
+
+ private:
+	struct Shard
+	{
+		mutable std::mutex shardMutex;
+		std::unordered_map<unsigned int, std::shared_ptr<Client>> clients;
+	};
+
+	const Shard& ShardOf( unsigned int id ) const;
+	Shard&       ShardOf( unsigned int id );
+
+	Shard shards[CLIENT_REGISTRY_SHARDS];
+
+	// Keeps the adds and removes in order,
+	// the readers of the array never take it
+	std::mutex writerMutex;
+	ClientList dense;
+};
@@ -0,0 +1,161 @@
+#include "clockSync.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+ClockSync::ClockSync()
+{
+	Reset();
+}
+
+
+
+void ClockSync::Reset()
+{
+	lock_guard<mutex> syncLock( syncMutex );
+
+	sampleCount  = 0;
+	nextSample   = 0;
+	minimumCount = 0;
+	nextMinimum  = 0;
+	baseLocal   = 0;
+	baseOffset  = 0;
+	drift       = 0.0;
+}
+
+
+
+void ClockSync::AddSample( uint64_t localSent, uint64_t remoteTime, uint64_t localReceived )
+{
+	if( localReceived < localSent )
+	{
+		return;
+	}
+
+	lock_guard<mutex> syncLock( syncMutex );
+
+	auto &sample  = samples[nextSample];
+	sample.local  = localSent + ( localReceived - localSent ) / 2;
+	sample.offset = static_cast<int64_t>( remoteTime - sample.local );
+	sample.rtt    = localReceived - localSent;
+
+	nextSample  = ( nextSample + 1 ) % CLOCK_SYNC_SAMPLES;
+	sampleCount = min<size_t>( sampleCount + 1, CLOCK_SYNC_SAMPLES );
+
+	Estimate();
+
+	// Every full window gives one point for the drift
+	if( nextSample == 0 )
+	{
+		EstimateDrift();
+	}
+}
+
+
+
+void ClockSync::Estimate()
+{
+	auto fastest = &samples[0];
+	for( size_t i = 1; i < sampleCount; i++ )
+	{
+		if( samples[i].rtt < fastest->rtt )
+		{
+			fastest = &samples[i];
+		}
+	}
+
+	baseLocal  = fastest->local;
+	baseOffset = fastest->offset;
+}
+
+
+
+void ClockSync::EstimateDrift()
+{
+	auto fastest = &samples[0];
+	for( size_t i = 1; i < sampleCount; i++ )
+	{
+		if( samples[i].rtt < fastest->rtt )
+		{
+			fastest = &samples[i];
+		}
+	}
+
+	minima[nextMinimum] = *fastest;
+	nextMinimum  = ( nextMinimum + 1 ) % CLOCK_SYNC_MINIMA;
+	minimumCount = min<size_t>( minimumCount + 1, CLOCK_SYNC_MINIMA );
+
+	if( minimumCount < CLOCK_SYNC_DRIFT_MINIMA )
+	{
+		return;
+	}
+
+	// Least squares, relative to the newest point to keep the numbers small
+	auto  &origin = *fastest;
+	double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+
+	for( size_t i = 0; i < minimumCount; i++ )
+	{
+		double x = static_cast<double>( static_cast<int64_t>( minima[i].local - origin.local ) );
+		double y = static_cast<double>( minima[i].offset - origin.offset );
+
+		sumX  += x;
+		sumY  += y;
+		sumXX += x * x;
+		sumXY += x * y;
+	}
+
+	double variance = sumXX - sumX * sumX / minimumCount;
+	if( variance <= 0.0 )
+	{
+		return;
+	}
+
+	drift = ( sumXY - sumX * sumY / minimumCount ) / variance;
+	drift = max( -CLOCK_SYNC_MAX_DRIFT, min( CLOCK_SYNC_MAX_DRIFT, drift ) );
+}
+
+
+
+bool ClockSync::Synchronized() const
+{
+	lock_guard<mutex> syncLock( syncMutex );
+	return sampleCount >= CLOCK_SYNC_HANDSHAKE;
+}
+
+
+
+int64_t ClockSync::Offset( uint64_t localTime ) const
+{
+	lock_guard<mutex> syncLock( syncMutex );
+	double elapsed = static_cast<double>( static_cast<int64_t>( localTime - baseLocal ) );
+	return baseOffset + static_cast<int64_t>( drift * elapsed );
+}
+
+
+
+double ClockSync::Drift() const
+{
+	lock_guard<mutex> syncLock( syncMutex );
+	return drift;
+}
+
+
+
+uint64_t ClockSync::ToLocal( uint64_t remoteTime ) const
+{
+	lock_guard<mutex> syncLock( syncMutex );
+
+	// Solve remote = local + baseOffset + drift * ( local - baseLocal )
+	double sinceBase = static_cast<double>( static_cast<int64_t>( remoteTime - baseLocal - baseOffset ) );
+	return baseLocal + static_cast<int64_t>( sinceBase / ( 1.0 + drift ) );
+}
+
+
+
+uint64_t ClockSync::ToRemote( uint64_t localTime ) const
+{
+	return localTime + Offset( localTime );
+}
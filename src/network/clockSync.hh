@@ -0,0 +1,82 @@
+#pragma once
+
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+
+// Pings answered before the offset is trusted, they go
+// out every CLOCK_SYNC_INTERVAL_MS right after connecting
+#define CLOCK_SYNC_HANDSHAKE   5
+#define CLOCK_SYNC_INTERVAL_MS 50
+
+// Ping samples the offset is taken from
+#define CLOCK_SYNC_SAMPLES 16
+
+// Fastest samples of the previous windows of CLOCK_SYNC_SAMPLES the
+// drift is fitted to, the fit needs at least CLOCK_SYNC_DRIFT_MINIMA
+#define CLOCK_SYNC_MINIMA       8
+#define CLOCK_SYNC_DRIFT_MINIMA 3
+
+// Drift beyond this is taken as noise, real clocks are
+// well within a few hundred parts per million
+#define CLOCK_SYNC_MAX_DRIFT 0.001
+
+
+// Estimates the remote end's clock from pings that it answers with its
+// own time. A sample assumes the pong was sent half way through the
+// round trip, so the samples with the shortest round trips are the most
+// accurate. The offset comes from the fastest recent sample, the drift
+// between the clocks from a line through the fastest samples of the
+// previous windows, as it only shows over longer times than the jitter
+// does. All times are in microseconds.
+class ClockSync
+{
+ public:
+	ClockSync();
+
+	// Local times of sending the ping and of receiving the pong
+	// and the remote time in the pong
+	void AddSample( uint64_t localSent, uint64_t remoteTime, uint64_t localReceived );
+
+	// True after the handshake
+	bool Synchronized() const;
+
+	// Remote time minus local time at the local time
+	int64_t Offset( uint64_t localTime ) const;
+
+	// How much faster the remote clock runs
+	double Drift() const;
+
+	uint64_t ToLocal( uint64_t remoteTime ) const;
+	uint64_t ToRemote( uint64_t localTime ) const;
+
+	void Reset();
+
+
+ private:
+	void Estimate();
+	void EstimateDrift();
+
+	struct Sample
+	{
+		uint64_t local;   // Middle of the round trip
+		int64_t  offset;
+		uint64_t rtt;
+	};
+
+	mutable std::mutex syncMutex;
+
+	Sample samples[CLOCK_SYNC_SAMPLES];
+	size_t sampleCount;
+	size_t nextSample;
+
+	Sample minima[CLOCK_SYNC_MINIMA];
+	size_t minimumCount;
+	size_t nextMinimum;
+
+	// offset = baseOffset + drift * ( local - baseLocal )
+	uint64_t baseLocal;
+	int64_t  baseOffset;
+	double   drift;
+};
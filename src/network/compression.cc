@@ -0,0 +1,295 @@
+#include "compression.hh"
+#include "packets.hh"
+#include "binaryStream.hh"
+#include "../events/event.hh"
+
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+
+using namespace std;
+
+
+// Shortest match that gets encoded
+#define MIN_MATCH 4
+
+// The block has to end with this many literals and the last match has
+// to start at least MATCH_LIMIT bytes before the end, like in LZ4
+#define LAST_LITERALS 5
+#define MATCH_LIMIT   12
+
+#define HASH_BITS   16
+#define MAX_OFFSET  65535
+
+// Length of the NETWORK_COMPRESSED packet header: length,
+// type, sub type and the length of the original packets
+#define COMPRESSED_HEADER_LENGTH ( 2 + 1 + 2 + 4 )
+
+
+namespace
+{
+	uint32_t Read32( const char *data )
+	{
+		uint32_t value;
+		memcpy( &value, data, sizeof( value ) );
+		return value;
+	}
+
+
+	uint32_t Hash( uint32_t sequence )
+	{
+		return ( sequence * 2654435761u ) >> ( 32 - HASH_BITS );
+	}
+
+
+	// Lengths that don't fit to the token continue in bytes of 255
+	void WriteLength( string &output, size_t length )
+	{
+		while( length >= 255 )
+		{
+			output.push_back( static_cast<char>( 255 ) );
+			length -= 255;
+		}
+		output.push_back( static_cast<char>( length ) );
+	}
+
+
+	bool ReadLength( const uint8_t *data, size_t length, size_t &offset, size_t &value )
+	{
+		uint8_t byte;
+		do
+		{
+			if( offset >= length )
+			{
+				return false;
+			}
+
+			byte   = data[offset++];
+			value += byte;
+		}
+		while( byte == 255 );
+
+		return true;
+	}
+
+
+	void WriteSequence(
+		string     &output,
+		const char *literals,
+		size_t      literalLength,
+		size_t      offset,
+		size_t      matchLength )
+	{
+		size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+
+		uint8_t token = static_cast<uint8_t>(
+			( min<size_t>( literalLength, 15 ) << 4 ) |
+			  min<size_t>( matchCode, 15 )
+		);
+		output.push_back( static_cast<char>( token ) );
+
+		if( literalLength >= 15 )
+		{
+			WriteLength( output, literalLength - 15 );
+		}
+		output.append( literals, literalLength );
+
+		// The last sequence has only the literals
+		if( !matchLength )
+		{
+			return;
+		}
+
+		output.push_back( static_cast<char>( offset & 0xff ) );
+		output.push_back( static_cast<char>( offset >> 8 ) );
+
+		if( matchCode >= 15 )
+		{
+			WriteLength( output, matchCode - 15 );
+		}
+	}
+}
+
+
+
+string Compress( const char *data, size_t length )
+{
+	string output;
+	output.reserve( length + length / 255 + 16 );
+
+	size_t anchor = 0;
+
+	if( length > MATCH_LIMIT )
+	{
+		vector<int32_t> table( 1 << HASH_BITS, -1 );
+
+		size_t position = 0;
+		while( position + MATCH_LIMIT < length )
+		{
+			auto sequence  = Read32( data + position );
+			auto &entry    = table[Hash( sequence )];
+			auto reference = entry;
+			entry          = static_cast<int32_t>( position );
+
+			if( reference < 0 ||
+			    position - reference > MAX_OFFSET ||
+			    Read32( data + reference ) != sequence )
+			{
+				position++;
+				continue;
+			}
+
+			size_t matchLength = MIN_MATCH;
+			while( position + matchLength + LAST_LITERALS < length &&
+			       data[reference + matchLength] == data[position + matchLength] )
+			{
+				matchLength++;
+			}
+
+			WriteSequence(
+				output,
+				data + anchor,
+				position - anchor,
+				position - reference,
+				matchLength
+			);
+
+			position += matchLength;
+			anchor    = position;
+		}
+	}
+
+	WriteSequence( output, data + anchor, length - anchor, 0, 0 );
+	return output;
+}
+
+
+
+bool Decompress( const char *data, size_t length, size_t originalLength, string &output )
+{
+	auto input = reinterpret_cast<const uint8_t*>( data );
+
+	output.resize( originalLength );
+	size_t written = 0;
+	size_t offset  = 0;
+
+	while( offset < length )
+	{
+		uint8_t token = input[offset++];
+
+		// Literals
+		size_t literalLength = token >> 4;
+		if( literalLength == 15 && !ReadLength( input, length, offset, literalLength ) )
+		{
+			return false;
+		}
+
+		if( literalLength > length - offset ||
+		    literalLength > originalLength - written )
+		{
+			return false;
+		}
+
+		memcpy( &output[written], data + offset, literalLength );
+		offset  += literalLength;
+		written += literalLength;
+
+		// The last sequence ends after the literals
+		if( offset == length )
+		{
+			break;
+		}
+
+		// Match
+		if( length - offset < 2 )
+		{
+			return false;
+		}
+
+		size_t matchOffset = input[offset] | ( input[offset + 1] << 8 );
+		offset += 2;
+
+		if( matchOffset == 0 || matchOffset > written )
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if( matchLength == 15 && !ReadLength( input, length, offset, matchLength ) )
+		{
+			return false;
+		}
+		matchLength += MIN_MATCH;
+
+		if( matchLength > originalLength - written )
+		{
+			return false;
+		}
+
+		// The match may overlap what it's copying, so go byte by byte
+		for( size_t i = 0; i < matchLength; i++ )
+		{
+			output[written + i] = output[written - matchOffset + i];
+		}
+		written += matchLength;
+	}
+
+	return written == originalLength;
+}
+
+
+
+string CompressPackets( const string &message )
+{
+	// The chunks are cut between packets, one longer than
+	// a chunk can't be compressed
+	if( LongestPacket( message ) > COMPRESSION_CHUNK_LENGTH )
+	{
+		return message;
+	}
+
+	string output;
+	output.reserve( message.size() );
+
+	for( auto &chunk : SplitPackets( message, COMPRESSION_CHUNK_LENGTH ) )
+	{
+		auto compressed = Compress( chunk.data(), chunk.size() );
+
+		// Not worth it
+		if( COMPRESSED_HEADER_LENGTH + compressed.size() >= chunk.size() ||
+		    COMPRESSED_HEADER_LENGTH + compressed.size() > USHRT_MAX )
+		{
+			output += chunk;
+			continue;
+		}
+
+		auto start = output.size();
+		output.resize( start + COMPRESSED_HEADER_LENGTH + compressed.size() );
+
+		BinaryWriter writer( &output[start], output.size() - start );
+		writer.WriteUint16( COMPRESSED_HEADER_LENGTH + compressed.size() );
+		writer.WriteUint8( NETWORK_EVENT );
+		writer.WriteUint16( NETWORK_COMPRESSED );
+		writer.WriteUint32( chunk.size() );
+		writer.WriteBytes( compressed );
+	}
+
+	return output;
+}
+
+
+
+bool DecompressPackets( const string &body, string &message )
+{
+	BinaryReader reader( body );
+	auto originalLength = reader.ReadUint32();
+
+	// Nothing bigger than a chunk gets compressed at once
+	if( reader.Failed() || originalLength > COMPRESSION_CHUNK_LENGTH )
+	{
+		return false;
+	}
+
+	return Decompress( reader.Position(), reader.Remaining(), originalLength, message );
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+// Messages shorter than this aren't worth compressing
+#define COMPRESSION_THRESHOLD 512
+
+// Most bytes of packets compressed into a single NETWORK_COMPRESSED
+// packet, small enough for the result to fit in a packet as well
+#define COMPRESSION_CHUNK_LENGTH 60000
+
+
+// Fast LZ77 compression producing the LZ4 block format. The ratio is
+// modest but it runs at memory speeds, which is what a join needs.
+std::string Compress( const char *data, size_t length );
+
+// Decompresses a block of exactly originalLength bytes into output.
+// Returns false if the block is malformed or of a different length.
+bool Decompress( const char *data, size_t length, size_t originalLength, std::string &output );
+
+
+// Wraps a message made of length prefixed packets into NETWORK_COMPRESSED
+// packets. Parts that don't get any smaller are left as they were, and a
+// message with a packet longer than a chunk is left as a whole.
+std::string CompressPackets( const std::string &message );
+
+// Unwraps the body of a NETWORK_COMPRESSED packet (after the sub type)
+// back to the packets it held
+bool DecompressPackets( const std::string &body, std::string &message );
@@ -0,0 +1,166 @@
+#include "connectionStatistics.hh"
+#include "binaryStream.hh"
+
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+
+ConnectionTelemetry::ConnectionTelemetry()
+	: bytesIn( 0 ),
+	  bytesOut( 0 ),
+	  packetsIn( 0 ),
+	  packetsOut( 0 ),
+	  pingsSent( 0 ),
+	  pongsReceived( 0 ),
+	  hasRtt( false ),
+	  rtt( 0.f ),
+	  jitter( 0.f ),
+	  lastRtt( 0.f )
+{
+}
+
+
+
+void ConnectionTelemetry::Received( size_t bytes, size_t packets )
+{
+	bytesIn   += bytes;
+	packetsIn += packets;
+}
+
+
+
+void ConnectionTelemetry::Sent( size_t bytes, size_t packets )
+{
+	bytesOut   += bytes;
+	packetsOut += packets;
+}
+
+
+
+string ConnectionTelemetry::NextPing()
+{
+	uint32_t sequence = static_cast<uint32_t>( pingsSent++ );
+	return PingPacket( sequence, TelemetryClock() );
+}
+
+
+
+void ConnectionTelemetry::PongReceived( uint64_t timestamp )
+{
+	auto now = TelemetryClock();
+	if( timestamp > now )
+	{
+		return;
+	}
+
+	pongsReceived++;
+	float sample = ( now - timestamp ) / 1000.f;
+
+	lock_guard<mutex> rttLock( rttMutex );
+	lastRtt = sample;
+
+	if( !hasRtt )
+	{
+		hasRtt = true;
+		rtt    = sample;
+		jitter = sample / 2.f;
+		return;
+	}
+
+	jitter += JITTER_GAIN * ( fabs( rtt - sample ) - jitter );
+	rtt    += RTT_GAIN * ( sample - rtt );
+}
+
+
+
+ConnectionStatistics ConnectionTelemetry::Statistics() const
+{
+	ConnectionStatistics statistics;
+	statistics.bytesIn       = bytesIn;
+	statistics.bytesOut      = bytesOut;
+	statistics.packetsIn     = packetsIn;
+	statistics.packetsOut    = packetsOut;
+	statistics.queueDepth    = 0;
+	statistics.pingsSent     = pingsSent;
+	statistics.pongsReceived = pongsReceived;
+
+	lock_guard<mutex> rttLock( rttMutex );
+	statistics.rtt     = rtt;
+	statistics.jitter  = jitter;
+	statistics.lastRtt = lastRtt;
+
+	return statistics;
+}
+
+
+
+uint64_t TelemetryClock()
+{
+	return chrono::duration_cast<chrono::microseconds>(
+		chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+
+
+string PingPacket( uint32_t sequence, uint64_t timestamp )
+{
+	string packet( 1 + 2 + PING_BODY_LENGTH, '\0' );
+
+	BinaryWriter writer( packet );
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_PING );
+	writer.WriteUint32( sequence );
+	writer.WriteUint64( timestamp );
+
+	return packet;
+}
+
+
+
+string PongPacket( uint32_t sequence, uint64_t timestamp, uint64_t localTime )
+{
+	string packet( 1 + 2 + PONG_BODY_LENGTH, '\0' );
+
+	BinaryWriter writer( packet );
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_PONG );
+	writer.WriteUint32( sequence );
+	writer.WriteUint64( timestamp );
+	writer.WriteUint64( localTime );
+
+	return packet;
+}
+
+
+
+bool ParsePingPacket(
+	const char   *data,
+	size_t        length,
+	EventSubType &subType,
+	uint32_t     &sequence,
+	uint64_t     &timestamp,
+	uint64_t     &remoteTime )
+{
+	if( length != 1 + 2 + PING_BODY_LENGTH && length != 1 + 2 + PONG_BODY_LENGTH )
+	{
+		return false;
+	}
+
+	BinaryReader reader( data, length );
+	auto type  = reader.ReadUint8();
+	subType    = static_cast<EventSubType>( reader.ReadUint16() );
+	sequence   = reader.ReadUint32();
+	timestamp  = reader.ReadUint64();
+	remoteTime = reader.Remaining() ? reader.ReadUint64() : 0;
+
+	if( type != NETWORK_EVENT )
+	{
+		return false;
+	}
+
+	return ( subType == NETWORK_PING && length == 1 + 2 + PING_BODY_LENGTH ) ||
+	       ( subType == NETWORK_PONG && length == 1 + 2 + PONG_BODY_LENGTH );
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "../events/event.hh"
+
+
+// Milliseconds between the pings both ends send
+#define PING_INTERVAL_MS 1000
+
+// Weights of a new sample in the smoothed round trip time
+// and in its mean deviation, the same as TCP uses
+#define RTT_GAIN    0.125f
+#define JITTER_GAIN 0.25f
+
+// Length of a ping and a pong after the type and sub type, the pong
+// carries the sequence and time of the ping and the answerer's time
+#define PING_BODY_LENGTH ( 4 + 8 )
+#define PONG_BODY_LENGTH ( 4 + 8 + 8 )
+
+
+// What has gone over a connection, see ConnectionTelemetry
+struct ConnectionStatistics
+{
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	uint64_t packetsIn;     // Frames and datagrams
+	uint64_t packetsOut;
+	size_t   queueDepth;    // Frames waiting for a flush
+	float    rtt;           // Smoothed round trip time in milliseconds
+	float    jitter;        // Mean deviation of the round trip time
+	float    lastRtt;       // The newest round trip time as it was measured
+	uint64_t pingsSent;
+	uint64_t pongsReceived;
+};
+
+
+
+// Counters of a single connection, updated from the I/O threads. The
+// round trip time comes from pings that carry the sender's clock and
+// get it echoed back in the pong, so the clocks don't need to agree.
+class ConnectionTelemetry
+{
+ public:
+	ConnectionTelemetry();
+
+	void Received( size_t bytes, size_t packets = 1 );
+	void Sent( size_t bytes, size_t packets = 1 );
+
+	// Returns the packet of the next ping, without the length prefix
+	std::string NextPing();
+
+	// Takes the time echoed in a pong
+	void PongReceived( uint64_t timestamp );
+
+	// Everything but the queue depth, which the write queue knows
+	ConnectionStatistics Statistics() const;
+
+
+ private:
+	std::atomic<uint64_t> bytesIn;
+	std::atomic<uint64_t> bytesOut;
+	std::atomic<uint64_t> packetsIn;
+	std::atomic<uint64_t> packetsOut;
+	std::atomic<uint64_t> pingsSent;
+	std::atomic<uint64_t> pongsReceived;
+
+	mutable std::mutex rttMutex;
+	bool               hasRtt;
+	float              rtt;
+	float              jitter;
+	float              lastRtt;
+};
+
+
+// Microseconds on a monotonic clock for the ping timestamps
+uint64_t TelemetryClock();
+
+// Build the packets without the length prefix
+std::string PingPacket( uint32_t sequence, uint64_t timestamp );
+std::string PongPacket( uint32_t sequence, uint64_t timestamp, uint64_t localTime );
+
+// Recognizes a ping or a pong packet without the length prefix,
+// remoteTime is the answerer's clock of a pong and 0 for a ping
+bool ParsePingPacket(
+	const char   *data,
+	size_t        length,
+	EventSubType &subType,
+	uint32_t     &sequence,
+	uint64_t     &timestamp,
+	uint64_t     &remoteTime
+);
@@ -3,6 +3,21 @@
 #include "../events/event.hh"
 
 #include <string>
+#include <cstdint>
+
+
+// Radius of the area around its viewpoint a client is sent
+// the world from, unless it asks for something else.
+#define DEFAULT_VIEW_RADIUS 100.f
+#define MAX_VIEW_RADIUS     1000.f
+
+
+// What a client tells it can do in its NETWORK_HELLO
+enum ClientCapabilities : uint32_t
+{
+	CAPABILITY_COMPRESSION    = 1 << 0, // Understands NETWORK_COMPRESSED packets
+	CAPABILITY_PACKED_OBJECTS = 1 << 1  // Understands OBJECT_PACKED packets
+};
 
 
 struct JoinEvent : public Event
@@ -37,3 +52,32 @@ struct PongEvent : public Event
 	std::string  msg;
 };
 
+
+// Where the client's UDP socket should bind, see ServerConnection::BindUdp()
+struct UdpBindEvent : public Event
+{
+	unsigned int clientId;
+	uint32_t     token;
+};
+
+
+struct ViewpointEvent : public Event
+{
+	unsigned int clientId;
+	float        x, y, z;
+	float        radius;
+};
+
+
+struct HelloEvent : public Event
+{
+	unsigned int clientId;
+	uint32_t     capabilities;
+};
+
+
+// Body of a NETWORK_COMPRESSED packet, see DecompressPackets()
+struct CompressedEvent : public Event
+{
+	std::string data;
+};
@@ -0,0 +1,268 @@
+#include "objectMessage.hh"
+#include "../world/objectEvents.hh"
+
+using namespace std;
+
+
+// Length, type and sub type in front of every packet
+#define PACKET_HEADER_LENGTH ( 2 + 1 + 2 )
+
+#define PACKED_KIND_BITS 2
+
+
+// What a packed event is
+enum PackedKind
+{
+	PACKED_CREATE = 0,
+	PACKED_DESTROY,
+	PACKED_UPDATE,
+	PACKED_PARENT_ADD
+};
+
+
+static_assert( PACKED_PARENT_ADD < ( 1 << PACKED_KIND_BITS ), "The packed kinds don't fit in their bits" );
+
+
+
+ObjectMessageWriter::ObjectMessageWriter( bool packed )
+	: packed( packed ), packetStart( string::npos ), previousId( 0 )
+{
+}
+
+
+
+void ObjectMessageWriter::Create( uint32_t id, WorldObjectType type, const string &data )
+{
+	if( packed )
+	{
+		auto writer = Pack( PACKED_CREATE, id, 1 + VarintLength( data.size() ) + data.size() );
+		writer.WriteUint8( type );
+		writer.WriteVarint( data.size() );
+		writer.WriteBytes( data );
+		return;
+	}
+
+	auto length = PACKET_HEADER_LENGTH + 1 + data.size();
+	BinaryWriter writer( Append( length ), length );
+
+	writer.WriteUint16( length );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_CREATE );
+	writer.WriteUint8( type );
+	writer.WriteBytes( data );
+}
+
+
+
+void ObjectMessageWriter::Destroy( uint32_t id )
+{
+	if( packed )
+	{
+		Pack( PACKED_DESTROY, id, 0 );
+		return;
+	}
+
+	auto length = PACKET_HEADER_LENGTH + 4;
+	BinaryWriter writer( Append( length ), length );
+
+	writer.WriteUint16( length );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_DESTROY );
+	writer.WriteUint32( id );
+}
+
+
+
+void ObjectMessageWriter::Update( uint32_t id, const string &data )
+{
+	if( packed )
+	{
+		auto writer = Pack( PACKED_UPDATE, id, VarintLength( data.size() ) + data.size() );
+		writer.WriteVarint( data.size() );
+		writer.WriteBytes( data );
+		return;
+	}
+
+	auto length = PACKET_HEADER_LENGTH + 4 + data.size();
+	BinaryWriter writer( Append( length ), length );
+
+	writer.WriteUint16( length );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_UPDATE );
+	writer.WriteUint32( id );
+	writer.WriteBytes( data );
+}
+
+
+
+void ObjectMessageWriter::ParentAdd( uint32_t id, uint32_t parentId )
+{
+	// The roots have a parent of 0, that takes a byte
+	if( packed )
+	{
+		Pack( PACKED_PARENT_ADD, id, VarintLength( parentId ) ).WriteVarint( parentId );
+		return;
+	}
+
+	auto length = PACKET_HEADER_LENGTH + 4 + 4;
+	BinaryWriter writer( Append( length ), length );
+
+	writer.WriteUint16( length );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_PARENT_ADD );
+	writer.WriteUint32( id );
+	writer.WriteUint32( parentId );
+}
+
+
+
+size_t ObjectMessageWriter::Length() const
+{
+	return message.size();
+}
+
+
+
+bool ObjectMessageWriter::Empty() const
+{
+	return message.empty();
+}
+
+
+
+string ObjectMessageWriter::Finish()
+{
+	Flush();
+
+	string finished;
+	finished.swap( message );
+	return finished;
+}
+
+
+
+BinaryWriter ObjectMessageWriter::Pack( unsigned int kind, uint32_t id, size_t length )
+{
+	// The header of the packet is written when it's full
+	if( packetStart != string::npos && message.size() - packetStart >= OBJECT_PACKED_MAX_LENGTH )
+	{
+		Flush();
+	}
+
+	if( packetStart == string::npos )
+	{
+		packetStart = message.size();
+		previousId  = 0;
+		Append( PACKET_HEADER_LENGTH );
+	}
+
+	// The difference wraps around, the reader adds it the same way
+	auto difference = ZigZagEncode( static_cast<int32_t>( id - previousId ) );
+	auto header     = static_cast<uint64_t>( difference ) << PACKED_KIND_BITS | kind;
+	previousId      = id;
+
+	auto headerLength = VarintLength( header );
+	BinaryWriter writer( Append( headerLength + length ), headerLength + length );
+	writer.WriteVarint( header );
+	return writer;
+}
+
+
+
+void ObjectMessageWriter::Flush()
+{
+	if( packetStart == string::npos )
+	{
+		return;
+	}
+
+	auto length = message.size() - packetStart;
+	BinaryWriter writer( &message[packetStart], PACKET_HEADER_LENGTH );
+
+	writer.WriteUint16( length );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_PACKED );
+
+	packetStart = string::npos;
+}
+
+
+
+char* ObjectMessageWriter::Append( size_t length )
+{
+	auto offset = message.size();
+	message.resize( offset + length );
+	return &message[offset];
+}
+
+
+
+bool UnpackObjectEvents( const string &body, vector<Event*> &events )
+{
+	BinaryReader reader( body );
+	uint32_t     id = 0;
+
+	uint64_t              header;
+	ObjectCreateEvent    *create;
+	ObjectDestroyEvent   *destroy;
+	ObjectUpdateEvent    *update;
+	ObjectParentAddEvent *parentAdd;
+	Event                *e;
+
+	while( reader.Remaining() )
+	{
+		// A difference has 32 bits at most
+		header = reader.ReadVarint();
+		if( reader.Failed() || header >> ( 32 + PACKED_KIND_BITS ) )
+		{
+			return false;
+		}
+
+		id += static_cast<uint32_t>( ZigZagDecode( static_cast<uint32_t>( header >> PACKED_KIND_BITS ) ) );
+
+		switch( header & ( ( 1 << PACKED_KIND_BITS ) - 1 ) )
+		{
+			case PACKED_CREATE:
+				create             = new ObjectCreateEvent();
+				create->subType    = OBJECT_CREATE;
+				create->objectType = static_cast<WorldObjectType>( reader.ReadUint8() );
+				create->data       = reader.ReadBytes( reader.ReadVarint() );
+				e = create;
+				break;
+
+			case PACKED_DESTROY:
+				destroy           = new ObjectDestroyEvent();
+				destroy->subType  = OBJECT_DESTROY;
+				destroy->objectId = id;
+				e = destroy;
+				break;
+
+			case PACKED_UPDATE:
+				update           = new ObjectUpdateEvent();
+				update->subType  = OBJECT_UPDATE;
+				update->objectId = id;
+				update->data     = reader.ReadBytes( reader.ReadVarint() );
+				e = update;
+				break;
+
+			default:
+				parentAdd           = new ObjectParentAddEvent();
+				parentAdd->subType  = OBJECT_PARENT_ADD;
+				parentAdd->objectId = id;
+				parentAdd->parentId = static_cast<uint32_t>( reader.ReadVarint() );
+				e = parentAdd;
+				break;
+		}
+
+		if( reader.Failed() )
+		{
+			delete e;
+			return false;
+		}
+
+		e->type = OBJECT_EVENT;
+		events.push_back( e );
+	}
+
+	return true;
+}
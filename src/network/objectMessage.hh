@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../events/event.hh"
+#include "../world/worldObjectTypes.hh"
+#include "binaryStream.hh"
+
+
+// Bytes of events packed into one OBJECT_PACKED packet before
+// the next ones go to a new packet
+#define OBJECT_PACKED_MAX_LENGTH 16384
+
+
+// Writes the object events the server sends into a message, either a
+// packet each or packed after each other into OBJECT_PACKED packets for
+// the clients that understand them. A packed event starts with a varint
+// of its kind in the lowest 2 bits and above them the zigzag of the
+// difference of its id to the id of the event before it. The data of
+// the creations and updates has a varint length in front, so an update
+// of a node next to the previous one has two bytes on top of its fields
+// instead of the nine of an OBJECT_UPDATE packet. Writing the events
+// sorted by id keeps the differences small.
+class ObjectMessageWriter
+{
+ public:
+	explicit ObjectMessageWriter( bool packed );
+
+	void Create( uint32_t id, WorldObjectType type, const std::string &data );
+	void Destroy( uint32_t id );
+	void Update( uint32_t id, const std::string &data );
+	void ParentAdd( uint32_t id, uint32_t parentId );
+
+	// Bytes of the message so far
+	size_t Length() const;
+	bool   Empty() const;
+
+	// Returns the message and starts a new one
+	std::string Finish();
+
+
+ private:
+	// Writes the header of a packed event, in a new packet if the one
+	// being packed is full, and gives the room for the length bytes
+	// of the rest of the event
+	BinaryWriter Pack( unsigned int kind, uint32_t id, size_t length );
+
+	// Ends the packet being packed
+	void Flush();
+
+	// Room for the given length at the end of the message
+	char* Append( size_t length );
+
+	bool        packed;
+	std::string message;
+	size_t      packetStart;
+	uint32_t    previousId;
+};
+
+
+// Unpacks the body of an OBJECT_PACKED packet (after the sub type) into
+// the object events they were written from, the caller gets their
+// ownership. Returns false if the body was broken, the events before
+// the broken one are appended all the same.
+bool UnpackObjectEvents( const std::string &body, std::vector<Event*> &events );
@@ -0,0 +1,201 @@
+#include "packetDecoder.hh"
+#include "networkEvents.hh"
+#include "../world/objectEvents.hh"
+
+using namespace std;
+
+
+namespace
+{
+	Event* ParseObjectCreate( BinaryReader &reader )
+	{
+		auto e        = new ObjectCreateEvent();
+		e->objectType = static_cast<WorldObjectType>( reader.ReadUint8() );
+		e->data       = reader.ReadRest();
+		return e;
+	}
+
+
+	Event* ParseObjectDestroy( BinaryReader &reader )
+	{
+		auto e      = new ObjectDestroyEvent();
+		e->objectId = reader.ReadUint32();
+		return e;
+	}
+
+
+	Event* ParseObjectUpdate( BinaryReader &reader )
+	{
+		auto e      = new ObjectUpdateEvent();
+		e->objectId = reader.ReadUint32();
+		e->data     = reader.ReadRest();
+		return e;
+	}
+
+
+	template<typename ParentEvent>
+	Event* ParseObjectParent( BinaryReader &reader )
+	{
+		auto e      = new ParentEvent();
+		e->objectId = reader.ReadUint32();
+		e->parentId = reader.ReadUint32();
+		return e;
+	}
+
+
+	template<typename ChildEvent>
+	Event* ParseObjectChild( BinaryReader &reader )
+	{
+		auto e      = new ChildEvent();
+		e->objectId = reader.ReadUint32();
+		e->childId  = reader.ReadUint32();
+		return e;
+	}
+
+
+	Event* ParseObjectSnapshot( BinaryReader &reader )
+	{
+		auto e  = new ObjectSnapshotEvent();
+		e->data = reader.ReadRest();
+		return e;
+	}
+
+
+	Event* ParseObjectUpdateBatch( BinaryReader &reader )
+	{
+		auto e  = new ObjectUpdateBatchEvent();
+		e->data = reader.ReadRest();
+		return e;
+	}
+
+
+	Event* ParseObjectPacked( BinaryReader &reader )
+	{
+		auto e  = new ObjectPackedEvent();
+		e->data = reader.ReadRest();
+		return e;
+	}
+
+
+	Event* ParseUdpBind( BinaryReader &reader )
+	{
+		auto e      = new UdpBindEvent();
+		e->clientId = reader.ReadUint32();
+		e->token    = reader.ReadUint32();
+		return e;
+	}
+
+
+	Event* ParseViewpoint( BinaryReader &reader )
+	{
+		auto e      = new ViewpointEvent();
+		e->clientId = 0;
+		e->x        = reader.ReadFloat();
+		e->y        = reader.ReadFloat();
+		e->z        = reader.ReadFloat();
+		e->radius   = reader.ReadFloat();
+		return e;
+	}
+
+
+	Event* ParseHello( BinaryReader &reader )
+	{
+		auto e          = new HelloEvent();
+		e->clientId     = 0;
+		e->capabilities = reader.ReadUint32();
+		return e;
+	}
+
+
+	Event* ParseCompressed( BinaryReader &reader )
+	{
+		auto e  = new CompressedEvent();
+		e->data = reader.ReadRest();
+		return e;
+	}
+}
+
+
+
+PacketDecoder::PacketDecoder()
+	: parsers( EVENT_TYPE_COUNT * EVENT_SUB_TYPE_COUNT )
+{
+	Register( OBJECT_EVENT,  OBJECT_CREATE,        ParseObjectCreate );
+	Register( OBJECT_EVENT,  OBJECT_DESTROY,       ParseObjectDestroy );
+	Register( OBJECT_EVENT,  OBJECT_UPDATE,        ParseObjectUpdate );
+	Register( OBJECT_EVENT,  OBJECT_PARENT_ADD,    ParseObjectParent<ObjectParentAddEvent> );
+	Register( OBJECT_EVENT,  OBJECT_PARENT_REMOVE, ParseObjectParent<ObjectParentRemoveEvent> );
+	Register( OBJECT_EVENT,  OBJECT_CHILD_ADD,     ParseObjectChild<ObjectChildAddEvent> );
+	Register( OBJECT_EVENT,  OBJECT_CHILD_REMOVE,  ParseObjectChild<ObjectChildRemoveEvent> );
+	Register( OBJECT_EVENT,  OBJECT_SNAPSHOT,      ParseObjectSnapshot );
+	Register( OBJECT_EVENT,  OBJECT_UPDATE_BATCH,  ParseObjectUpdateBatch );
+	Register( OBJECT_EVENT,  OBJECT_PACKED,        ParseObjectPacked );
+	Register( NETWORK_EVENT, NETWORK_UDP_BIND,     ParseUdpBind );
+	Register( NETWORK_EVENT, NETWORK_VIEWPOINT,    ParseViewpoint );
+	Register( NETWORK_EVENT, NETWORK_HELLO,        ParseHello );
+	Register( NETWORK_EVENT, NETWORK_COMPRESSED,   ParseCompressed );
+}
+
+
+
+size_t PacketDecoder::Index( EventType type, EventSubType subType ) const
+{
+	return static_cast<size_t>( type ) * EVENT_SUB_TYPE_COUNT + subType;
+}
+
+
+
+void PacketDecoder::Register( EventType type, EventSubType subType, Parser parser )
+{
+	parsers[Index( type, subType )] = parser;
+}
+
+
+
+bool PacketDecoder::Registered( EventType type, EventSubType subType ) const
+{
+	if( type >= EVENT_TYPE_COUNT || subType >= EVENT_SUB_TYPE_COUNT )
+	{
+		return false;
+	}
+
+	return static_cast<bool>( parsers[Index( type, subType )] );
+}
+
+
+
+Event* PacketDecoder::Decode( const char *data, size_t length ) const
+{
+	BinaryReader reader( data, length );
+
+	auto type    = static_cast<EventType>( reader.ReadUint8() );
+	auto subType = static_cast<EventSubType>( reader.ReadUint16() );
+
+	if( reader.Failed() || !Registered( type, subType ) )
+	{
+		return nullptr;
+	}
+
+	auto e = parsers[Index( type, subType )]( reader );
+	if( !e )
+	{
+		return nullptr;
+	}
+
+	if( reader.Failed() )
+	{
+		delete e;
+		return nullptr;
+	}
+
+	e->type    = type;
+	e->subType = subType;
+	return e;
+}
+
+
+
+Event* PacketDecoder::Decode( const string &packet ) const
+{
+	return Decode( packet.data(), packet.size() );
+}
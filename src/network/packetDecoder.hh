@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+#include "../events/event.hh"
+#include "binaryStream.hh"
+
+
+// Builds typed events from packets without the length prefix,
+// [type][sub type][body]. Every (type, sub type) pair has its own
+// parser in a table, the known packets are registered by default.
+class PacketDecoder
+{
+ public:
+	// Builds the event from the body, the reader is past the sub type
+	typedef std::function<Event*( BinaryReader& )> Parser;
+
+	PacketDecoder();
+
+	// Replaces the parser of the pair if there already is one
+	void Register( EventType type, EventSubType subType, Parser parser );
+	bool Registered( EventType type, EventSubType subType ) const;
+
+	// Returns nullptr for invalid, unknown and truncated packets,
+	// the caller gets the ownership of the event
+	Event* Decode( const char *data, size_t length ) const;
+	Event* Decode( const std::string &packet ) const;
+
+
+ private:
+	size_t Index( EventType type, EventSubType subType ) const;
+
+	std::vector<Parser> parsers;
+};
@@ -0,0 +1,84 @@
+#include "packets.hh"
+#include "binaryStream.hh"
+
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+
+vector<string> SplitPackets( const string &message, size_t maxLength )
+{
+	vector<string> chunks;
+
+	size_t chunkStart = 0;
+	size_t offset     = 0;
+
+	while( offset + sizeof( uint16_t ) <= message.size() )
+	{
+		// Peek the length of the next packet
+		auto packetLength = BinaryReader( message.data() + offset, sizeof( uint16_t ) ).ReadUint16();
+
+		// Malformed packet, stop here and keep what we have
+		if( packetLength < sizeof( uint16_t ) ||
+		    offset + packetLength > message.size() )
+		{
+			break;
+		}
+
+		// It would go out as a chunk longer than the caller can take
+		assert( packetLength <= maxLength );
+
+		// Close the current chunk if the packet doesn't fit in it anymore
+		if( offset > chunkStart &&
+		    offset + packetLength - chunkStart > maxLength )
+		{
+			chunks.push_back( message.substr( chunkStart, offset - chunkStart ) );
+			chunkStart = offset;
+		}
+
+		offset += packetLength;
+	}
+
+	if( offset > chunkStart )
+	{
+		chunks.push_back( message.substr( chunkStart, offset - chunkStart ) );
+	}
+
+	return chunks;
+}
+
+
+
+size_t LongestPacket( const string &message )
+{
+	size_t longest = 0;
+	size_t offset  = 0;
+
+	while( offset + sizeof( uint16_t ) <= message.size() )
+	{
+		auto packetLength = BinaryReader( message.data() + offset, sizeof( uint16_t ) ).ReadUint16();
+		if( packetLength < sizeof( uint16_t ) )
+		{
+			break;
+		}
+
+		longest = max<size_t>( longest, packetLength );
+		offset += packetLength;
+	}
+
+	return longest;
+}
+
+
+
+string LengthPrefixed( const string &packet )
+{
+	string prefixed( sizeof( uint16_t ) + packet.size(), '\0' );
+
+	BinaryWriter writer( prefixed );
+	writer.WriteUint16( prefixed.size() );
+	writer.WriteBytes( packet );
+
+	return prefixed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Largest payload we put into a single datagram, small
+// enough to stay under the usual MTU without fragmenting.
+#define MAX_DATAGRAM_PAYLOAD 1200
+
+// Length of the sequence number header of the snapshot datagrams
+#define DATAGRAM_HEADER_LENGTH sizeof( uint32_t )
+
+
+// Splits a message made of length prefixed packets into chunks of
+// at most maxLength bytes. Cuts are only made at packet boundaries,
+// so every packet has to fit in maxLength, which is asserted.
+std::vector<std::string> SplitPackets( const std::string &message, size_t maxLength );
+
+// Bytes of the longest of the length prefixed packets of a message
+size_t LongestPacket( const std::string &message );
+
+
+// The packet or the frame with its length in front, the length included
+std::string LengthPrefixed( const std::string &packet );
+
+
+// Is the sequence number a newer than b, taking wrap around into account
+inline bool IsNewerSequence( uint32_t a, uint32_t b )
+{
+	return static_cast<int32_t>( a - b ) > 0;
+}
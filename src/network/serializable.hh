@@ -2,31 +2,16 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <sstream>
+#include <cstdint>
+
+
+// Fields are sent as numbers, see WorldFieldId
+typedef uint8_t FieldId;
 
 
 class Serializable
 {
  public:
-	virtual std::string Serialize( std::vector<std::string> vars ) = 0;
+	virtual std::string Serialize( std::vector<FieldId> fields ) = 0;
 	virtual bool Unserialize( std::string data ) = 0;
 };
-
-
-
-// Few helpers:
-void SerializeUint8( std::stringstream &stream,  uint8_t value );
-void SerializeUint16( std::stringstream &stream, uint16_t value );
-void SerializeUint32( std::stringstream &stream, uint32_t value );
-void SerializeFloat( std::stringstream &stream,  float value );
-void SerializeDouble( std::stringstream &stream, double value );
-void SerializeString( std::stringstream &stream, const std::string& value );
-
-
-uint8_t  UnserializeUint8( std::stringstream &stream );
-uint16_t UnserializeUint16( std::stringstream &stream );
-uint32_t UnserializeUint32( std::stringstream &stream );
-float    UnserializeFloat( std::stringstream &stream );
-double   UnserializeDouble( std::stringstream &stream );
-std::string UnserializeString( std::stringstream &stream );
-
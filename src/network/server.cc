@@ -1,11 +1,14 @@
 #include "server.hh"
-#include "serializable.hh"
+#include "binaryStream.hh"
 #include "networkEvents.hh"
 #include "../logger.hh"
 
 #include <atomic>
 #include <memory>
+#include <random>
 #include <sstream>
+#include <iomanip>
+#include <cstring>
 
 using namespace std;
 
@@ -13,10 +16,33 @@ using namespace std;
 static atomic<unsigned int> clientIdCounter( 0 ); // Should be good enough.
 
 
-Client::Client( tcp::socket socket ) : m_socket( move( socket ) )
+Client::Client( tcp::socket socket, asio::io_service &ioService )
+	: m_socket( move( socket ) ),
+	  m_strand( ioService )
 {
+	static random_device tokenSource;
+
 	m_clientId = ++clientIdCounter;
 	memset( m_data, 0, maxLength );
+
+	// The writes are gathered and flushed explicitly,
+	// so there's nothing for Nagle to wait for
+	boost::system::error_code ec;
+	m_socket.set_option( tcp::no_delay( true ), ec );
+
+	m_udpBound      = false;
+	m_udpToken      = tokenSource();
+	m_udpSequence   = 0;
+	m_ackedSequence = 0;
+	m_hasAck        = false;
+	m_open          = true;
+}
+
+
+
+uint32_t Client::NextSequence()
+{
+	return ++m_udpSequence;
 }
 
 
@@ -25,113 +51,235 @@ void Client::SetRead()
 	auto self( shared_from_this() );
 	m_socket.async_read_some(
 		asio::buffer( m_data, maxLength ),
-		[this, self]( boost::system::error_code ec, size_t length )
+		m_strand.wrap( [this, self]( boost::system::error_code ec, size_t length )
 		{
-			char buffer[USHRT_MAX];
-
 			// Check for errors
 			if( ec.value() )
 			{
 				LOG_ERROR( "Client::Read() got error " << ec.value() << ": '" << ec.message() << "'" );
-
-				auto partEvent      = new PartEvent();
-				partEvent->type     = NETWORK_EVENT;
-				partEvent->subType  = NETWORK_PART;
-				partEvent->clientId = m_clientId;
-				eventQueue->AddEvent( partEvent );
-
-				m_socket.close();
+				Part();
 				return;
 			}
 
-			// Apped the received data to the readStream
-			readStream.write( m_data, length );
+			// Append the received data to what's left of the previous reads
+			m_readBuffer.append( m_data, length );
+			m_telemetry.Received( length, 0 );
 
-			// Read more if we don't have enough data even
-			// for the header alone
-			size_t streamLength = readStream.str().length();
-			if( streamLength < sizeof( unsigned short ) )
+			// A read may complete any number of frames, the client
+			// flushes several messages with a single write
+			size_t offset = 0;
+			while( m_readBuffer.size() - offset >= sizeof( uint16_t ) )
 			{
-				SetRead();
-				return;
+				BinaryReader frame( m_readBuffer.data() + offset, m_readBuffer.size() - offset );
+				auto frameLength = frame.ReadUint16();
+
+				if( frameLength < sizeof( uint16_t ) )
+				{
+					LOG_ERROR( "Client " << m_clientId << " sent a broken frame!" );
+					Part();
+					return;
+				}
+
+				// Wait for the rest of the frame
+				if( m_readBuffer.size() - offset < frameLength )
+				{
+					break;
+				}
+
+				auto payload       = frame.Position();
+				auto payloadLength = frameLength - sizeof( uint16_t );
+				offset += frameLength;
+				m_telemetry.Received( 0 );
+
+				// Pings are answered right here, not in the game loop
+				if( HandlePing( payload, payloadLength ) )
+				{
+					continue;
+				}
+
+				// Create the event
+				auto dataInEvent      = new DataInEvent();
+				dataInEvent->type     = NETWORK_EVENT;
+				dataInEvent->subType  = NETWORK_DATA_IN;
+				dataInEvent->clientId = m_clientId;
+				dataInEvent->data     = string( payload, payloadLength );
+				eventQueue->AddEvent( dataInEvent );
 			}
 
-			// Read the package byte count
-			size_t packetLength = UnserializeUint16( readStream );
-
-			// Reverse the reading point back and
-			// wait for more data if we don't have enough
-			if( streamLength < packetLength )
-			{
-				long pos = static_cast<long>( readStream.tellg() );
-				readStream.seekg( pos - sizeof( unsigned short ) );
-				SetRead();
-				return;
-			}
-
-			// We got all the data for the package!
-			readStream.read( buffer, packetLength-2 );
-			stringstream packetStream(
-				stringstream::in |
-				stringstream::out |
-				stringstream::binary
-			);
-			packetStream.write( buffer, packetLength-2 );
-
-			// Create the event
-			auto dataInEvent      = new DataInEvent();
-			dataInEvent->type     = NETWORK_EVENT;
-			dataInEvent->subType  = NETWORK_DATA_IN;
-			dataInEvent->clientId = m_clientId;
-			dataInEvent->data     = packetStream.str();
-			eventQueue->AddEvent( dataInEvent );
+			m_readBuffer.erase( 0, offset );
 
 			// Set this as a callback again
 			SetRead();
-		});
+		}));
 }
 
 
 
 void Client::Write( string msg )
 {
-	lock_guard<mutex> writeLock( writeMutex );
+	if( !m_open )
+	{
+		return;
+	}
+
+	if( m_writeQueue.Push( msg ) )
+	{
+		Flush();
+	}
+}
+
+
+
+void Client::Flush()
+{
+	auto self( shared_from_this() );
+	m_strand.post( [this, self]() { StartWrite(); } );
+}
+
+
+
+bool Client::IsOpen() const
+{
+	return m_open;
+}
 
 
-	if( !m_socket.is_open() )
+
+void Client::StartWrite()
+{
+	if( !m_writing.empty() || !m_open )
 	{
 		return;
 	}
 
-	boost::asio::streambuf request;
-	ostream requestStream( &request );
+	m_writing = m_writeQueue.Take();
+	if( m_writing.empty() )
+	{
+		return;
+	}
 
-	unsigned short msgLength = msg.length() + 2;
-	requestStream.write( reinterpret_cast<char*>( &msgLength ), 2 );
+	vector<asio::const_buffer> buffers;
+	buffers.reserve( m_writing.size() );
+	for( auto &frame : m_writing )
+	{
+		buffers.push_back( asio::buffer( frame ) );
+	}
+
+	// The frames stay in m_writing until the write is done with them
+	auto self( shared_from_this() );
+	asio::async_write(
+		m_socket,
+		buffers,
+		m_strand.wrap( [this, self]( boost::system::error_code ec, size_t length )
+		{
+			m_writeQueue.Written( m_writing, length );
+			m_writing.clear();
+
+			if( ec )
+			{
+				LOG_ERROR( "Writing to client " << m_clientId << " failed: '" << ec.message() << "'" );
+
+				// The read that's pending fails and parts the client
+				Close();
+				return;
+			}
+
+			// What was queued in the meantime
+			StartWrite();
+		})
+	);
+}
 
-	requestStream << msg;
 
-	try
+
+void Client::Part()
+{
+	auto partEvent      = new PartEvent();
+	partEvent->type     = NETWORK_EVENT;
+	partEvent->subType  = NETWORK_PART;
+	partEvent->clientId = m_clientId;
+	eventQueue->AddEvent( partEvent );
+
+	Close();
+}
+
+
+
+void Client::Close()
+{
+	m_open = false;
+
+	boost::system::error_code ec;
+	m_socket.close( ec );
+}
+
+
+
+void Client::Ping()
+{
+	// The clients get their packets length prefixed
+	Write( LengthPrefixed( m_telemetry.NextPing() ) );
+	StartWrite();
+}
+
+
+
+bool Client::HandlePing( const char *data, size_t length )
+{
+	EventSubType subType;
+	uint32_t     sequence;
+	uint64_t     timestamp, remoteTime;
+
+	if( !ParsePingPacket( data, length, subType, sequence, timestamp, remoteTime ) )
 	{
-		boost::asio::write( m_socket, request );
+		return false;
 	}
-	catch( ... )
+
+	if( subType == NETWORK_PONG )
 	{
-		LOG_ERROR( "Writing to client failed." );
+		m_telemetry.PongReceived( timestamp );
+		return true;
 	}
+
+	// Answer at once, the pong shouldn't wait for the tick. Our clock
+	// in it lets the client tell the tick times of the snapshots.
+	Write( LengthPrefixed( PongPacket( sequence, timestamp, TelemetryClock() ) ) );
+	StartWrite();
+	return true;
+}
+
+
+
+ConnectionStatistics Client::Statistics()
+{
+	auto statistics   = m_telemetry.Statistics();
+	auto written      = m_writeQueue.Statistics();
+	statistics.bytesOut   += written.bytes;
+	statistics.packetsOut += written.messages;
+	statistics.queueDepth  = m_writeQueue.Depth();
+	return statistics;
 }
 
 
 Server::Server()
 {
-	m_port     = 22001;
-	m_socket   = nullptr;
-	m_acceptor = nullptr;
+	m_port           = 22001;
+	m_coalesceWrites = COALESCE_WRITES;
+	m_ioService = nullptr;
+	m_socket    = nullptr;
+	m_acceptor  = nullptr;
+	m_udpSocket = nullptr;
+	m_pingTimer = nullptr;
+	m_accepted  = 0;
 }
 
 
 Server::Server( asio::io_service& ioService, short port )
 {
+	m_coalesceWrites = COALESCE_WRITES;
+	m_udpSocket = nullptr;
+	m_pingTimer = nullptr;
+	m_accepted  = 0;
 	Init( ioService, port );
 }
 
@@ -144,12 +292,23 @@ Server::~Server()
 
 void Server::Init( asio::io_service& ioService, short port )
 {
+	m_ioService = &ioService;
 	m_port     = port;
 	m_socket   = new asio::ip::tcp::socket( ioService );
 	m_acceptor = new asio::ip::tcp::acceptor(
 		ioService,
 		tcp::endpoint( tcp::v4(), port )
 	);
+
+	// The snapshot datagrams use the same port number
+	m_udpSocket = new asio::ip::udp::socket(
+		ioService,
+		udp::endpoint( udp::v4(), port )
+	);
+	ReceiveDatagram();
+
+	m_pingTimer = new asio::deadline_timer( ioService );
+	SchedulePing();
 }
 
 
@@ -164,14 +323,24 @@ void Server::Accept()
 		*m_socket,
 		[this]( boost::system::error_code ec )
 		{
+			// Take the socket and accept the next one right
+			// away, another I/O thread may pick that up
+			tcp::socket socket( move( *m_socket ) );
+			Accept();
+
 			if( !ec )
 			{
-				auto client = make_shared<Client>( move( *m_socket ) );
+				m_accepted++;
+
+				auto client = make_shared<Client>( move( socket ), *m_ioService );
 				client->SetEventQueue( eventQueue );
+				client->m_writeQueue.SetCoalescing( m_coalesceWrites );
 				client->SetRead();
-				clientListMutex.lock();
-				clientList[client->m_clientId] = client;
-				clientListMutex.unlock();
+				clients.Add( client->m_clientId, client );
+
+				// Don't make the new client wait for the next tick
+				SendUdpBind( client );
+				client->Flush();
 
 				auto joinEvent      = new JoinEvent();
 				joinEvent->type     = NETWORK_EVENT;
@@ -179,26 +348,285 @@ void Server::Accept()
 				joinEvent->clientId = client->m_clientId;
 				eventQueue->AddEvent( joinEvent );
 			}
+		}
+	);
+}
 
-			Accept();
+
+
+void Server::SendUdpBind( std::shared_ptr<Client> client )
+{
+	string packet( 2 + 1 + 2 + 4 + 4, '\0' );
+
+	// Tell the client who it is and the token it
+	// has to present when binding the UDP endpoint
+	BinaryWriter writer( packet );
+	writer.WriteUint16( packet.size() );
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_UDP_BIND );
+	writer.WriteUint32( client->m_clientId );
+	writer.WriteUint32( client->m_udpToken );
+
+	client->Write( packet );
+}
+
+
+
+void Server::ReceiveDatagram()
+{
+	m_udpSocket->async_receive_from(
+		asio::buffer( m_udpData, MAX_DATAGRAM_PAYLOAD ),
+		m_udpSender,
+		[this]( boost::system::error_code ec, size_t length )
+		{
+			if( ec == asio::error::operation_aborted )
+			{
+				return;
+			}
+
+			if( ec.value() )
+			{
+				LOG_ERROR( "Server::ReceiveDatagram() got error " << ec.value() << ": '" << ec.message() << "'" );
+				ReceiveDatagram();
+				return;
+			}
+
+			// Clients send their id and token, followed by the
+			// acknowledged snapshot sequence if any. They're read
+			// out of the buffer so the next datagram can be
+			// received while this one is handled.
+			BinaryReader reader( m_udpData, length );
+
+			auto     clientId = reader.ReadUint32();
+			auto     token    = reader.ReadUint32();
+			bool     hasAck   = reader.Remaining() >= sizeof( uint32_t );
+			uint32_t ack      = hasAck ? reader.ReadUint32() : 0;
+			auto     sender   = m_udpSender;
+			ReceiveDatagram();
+
+			if( reader.Failed() )
+			{
+				return;
+			}
+
+			auto client = clients.Find( clientId );
+			if( !client || client->m_udpToken != token )
+			{
+				return;
+			}
+
+			// On the client's strand, so the acks of datagrams handled
+			// by different threads can't overtake each other
+			client->m_strand.dispatch(
+				[this, client, sender, length, hasAck, ack]()
+				{
+					client->m_telemetry.Received( length );
+
+					{
+						lock_guard<mutex> udpLock( udpWriteMutex );
+						client->m_udpEndpoint = sender;
+						client->m_udpBound    = true;
+					}
+
+					if( hasAck && ( !client->m_hasAck || IsNewerSequence( ack, client->m_ackedSequence ) ) )
+					{
+						client->m_ackedSequence = ack;
+						client->m_hasAck        = true;
+					}
+				}
+			);
 		}
 	);
 }
 
 
 
-void Server::CleanBadConnections()
+void Server::WriteUnreliable( std::shared_ptr<Client> client, const string &msg, uint32_t sequence )
 {
-	lock_guard<mutex> clientListLock( clientListMutex );
-	for( auto it = clientList.begin(); it != clientList.end(); )
+	unique_lock<mutex> udpLock( udpWriteMutex );
+
+	// The datagrams are only cut between packets
+	if( !client->m_udpBound || LongestPacket( msg ) > MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH )
 	{
-		if( (*it).second )
+		udpLock.unlock();
+		client->Write( msg );
+		return;
+	}
+
+	// Every fragment of the message shares the sequence number,
+	// the receiver drops anything older than what it already has
+	auto chunks = SplitPackets( msg, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH );
+
+	for( auto &chunk : chunks )
+	{
+		string datagram( DATAGRAM_HEADER_LENGTH + chunk.size(), '\0' );
+
+		BinaryWriter writer( datagram );
+		writer.WriteUint32( sequence );
+		writer.WriteBytes( chunk );
+
+		boost::system::error_code ec;
+		auto sent = m_udpSocket->send_to( asio::buffer( datagram ), client->m_udpEndpoint, 0, ec );
+		client->m_telemetry.Sent( sent );
+
+		if( ec.value() )
 		{
-			it++;
-			continue;
+			LOG_ERROR( "Sending datagram to client " << client->m_clientId << " failed: '" << ec.message() << "'" );
+			return;
 		}
+	}
+}
 
-		clientList.erase( it );
+
+
+bool Server::UdpBound( std::shared_ptr<Client> client )
+{
+	lock_guard<mutex> udpLock( udpWriteMutex );
+	return client->m_udpBound;
+}
+
+
+
+void Server::Flush()
+{
+	auto all = clients.All();
+	for( auto &client : *all )
+	{
+		client->Flush();
+	}
+}
+
+
+
+void Server::SetCoalescing( bool coalesce )
+{
+	m_coalesceWrites = coalesce;
+
+	auto all = clients.All();
+	for( auto &client : *all )
+	{
+		client->m_writeQueue.SetCoalescing( coalesce );
+	}
+}
+
+
+
+void Server::SchedulePing()
+{
+	m_pingTimer->expires_from_now( boost::posix_time::milliseconds( PING_INTERVAL_MS ) );
+	m_pingTimer->async_wait(
+		[this]( boost::system::error_code ec )
+		{
+			if( ec )
+			{
+				return;
+			}
+
+			auto all = clients.All();
+			for( auto &client : *all )
+			{
+				if( !client->IsOpen() )
+				{
+					continue;
+				}
+
+				client->m_strand.post( [client]() { client->Ping(); } );
+			}
+
+			SchedulePing();
+		}
+	);
+}
+
+
+
+string Server::StatisticsDump()
+{
+	auto all = clients.All();
+
+	stringstream dump;
+	dump << fixed << setprecision( 1 );
+	dump << "client     rtt ms  jitter ms   in kB  packets  out kB  packets  queued  pings  pongs";
+
+	for( auto &client : *all )
+	{
+		auto statistics = client->Statistics();
+		dump << endl
+		     << setw( 6 ) << client->m_clientId
+		     << setw( 10 ) << statistics.rtt
+		     << setw( 11 ) << statistics.jitter
+		     << setw( 8 ) << statistics.bytesIn / 1024.f
+		     << setw( 9 ) << statistics.packetsIn
+		     << setw( 8 ) << statistics.bytesOut / 1024.f
+		     << setw( 9 ) << statistics.packetsOut
+		     << setw( 8 ) << statistics.queueDepth
+		     << setw( 7 ) << statistics.pingsSent
+		     << setw( 7 ) << statistics.pongsReceived;
+	}
+
+	return dump.str();
+}
+
+
+
+ConnectionStatistics Server::GetTotals()
+{
+	ConnectionStatistics total = {};
+	auto all = clients.All();
+	for( auto &client : *all )
+	{
+		auto statistics      = client->Statistics();
+		total.bytesIn       += statistics.bytesIn;
+		total.bytesOut      += statistics.bytesOut;
+		total.packetsIn     += statistics.packetsIn;
+		total.packetsOut    += statistics.packetsOut;
+		total.queueDepth    += statistics.queueDepth;
+		total.pingsSent     += statistics.pingsSent;
+		total.pongsReceived += statistics.pongsReceived;
+	}
+
+	return total;
+}
+
+
+
+uint64_t Server::AcceptedCount() const
+{
+	return m_accepted;
+}
+
+
+
+WriteStatistics Server::GetWriteStatistics()
+{
+	WriteStatistics total = {};
+
+	auto all = clients.All();
+	for( auto &client : *all )
+	{
+		auto statistics     = client->m_writeQueue.Statistics();
+		total.writes       += statistics.writes;
+		total.messages     += statistics.messages;
+		total.bytes        += statistics.bytes;
+		total.queuedMicros += statistics.queuedMicros;
+		total.uncompressed += statistics.uncompressed;
+		total.compressed   += statistics.compressed;
+	}
+
+	return total;
+}
+
+
+
+void Server::CleanBadConnections()
+{
+	auto all = clients.All();
+	for( auto &client : *all )
+	{
+		if( !client->IsOpen() )
+		{
+			clients.Remove( client->m_clientId );
+		}
 	}
 }
 
@@ -206,7 +634,12 @@ void Server::CleanBadConnections()
 
 std::shared_ptr<Client> Server::GetClient( unsigned int id )
 {
-	lock_guard<mutex> clientListLock( clientListMutex );
-	return clientList[id];
+	return clients.Find( id );
 }
 
+
+
+void Server::RemoveClient( unsigned int id )
+{
+	clients.Remove( id );
+}
@@ -9,6 +9,7 @@
 #include <memory>
 #include <utility>
 #include <mutex>
+#include <atomic>
 #include <sstream>
 
 #include <boost/asio.hpp>
@@ -16,8 +17,14 @@
 #include "../events/eventDispatcher.hh"
 #include "../events/eventFactory.hh"
 #include "networkEvents.hh"
+#include "packets.hh"
+#include "snapshot.hh"
+#include "writeQueue.hh"
+#include "connectionStatistics.hh"
+#include "clientRegistry.hh"
 
 using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
 using namespace boost;
 
 
@@ -26,21 +33,77 @@ struct Client
 	  public std::enable_shared_from_this<Client>
 {
  public:
-	Client( tcp::socket socket ) ;
+	Client( tcp::socket socket, asio::io_service &ioService );
 
 	void SetRead();
+
+	// Queues the message, it's sent on the next Flush()
+	// unless the writes aren't coalesced
 	void Write( std::string );
 
+	// Writes the queued messages asynchronously in the strand,
+	// one write at a time, returns right away
+	void Flush();
+
+	// False once the socket has been closed
+	bool IsOpen() const;
+
+	// Sends a ping right away, the pong gives the round trip time
+	void Ping();
+
+	ConnectionStatistics Statistics();
+
 	unsigned int m_clientId;
 	tcp::socket m_socket;
+
+	// Runs the handlers of this client one at a time
+	// whichever of the I/O threads picks them up
+	asio::io_service::strand m_strand;
+
 	enum { maxLength = 1024 };
 	char m_data[maxLength];
 	std::vector<std::string> m_received;
 
+	// Unreliable channel for the transform snapshots, usable
+	// once the client has told us where it listens to them
+	udp::endpoint m_udpEndpoint;
+	bool          m_udpBound;
+	uint32_t      m_udpToken;
+	uint32_t      m_udpSequence;
+
+	// Newest snapshot the client has acknowledged
+	// and the snapshots sent to it for delta encoding
+	std::atomic<uint32_t> m_ackedSequence;
+	std::atomic<bool>     m_hasAck;
+	SnapshotHistory       m_snapshots;
+
+	uint32_t NextSequence();
+
+	WriteQueue          m_writeQueue;
+	ConnectionTelemetry m_telemetry;
+
 
 private:
-	std::mutex writeMutex;
-	std::stringstream readStream;
+	// Answers pings and takes pongs without bothering the event queue,
+	// returns false if the frame was something else
+	bool HandlePing( const char *data, size_t length );
+
+	// Starts writing the queued frames unless a write is still going,
+	// it starts the next one when it's done. In the strand only.
+	void StartWrite();
+
+	// Tells the game the client is gone and closes the socket,
+	// in the strand only like everything else touching the socket
+	void Part();
+	void Close();
+
+	// Being written, empty if no write is going
+	std::vector<std::string> m_writing;
+
+	std::atomic<bool> m_open;
+
+	// Received bytes that don't make a whole frame yet
+	std::string m_readBuffer;
 };
 
 
@@ -56,17 +119,64 @@ class Server : public EventFactory
 
 	void Accept();
 
+	// Sends the message as datagrams with the given sequence number if the
+	// client has bound its UDP endpoint, otherwise falls back to the TCP stream.
+	// So does a message with a packet too long for a datagram.
+	void WriteUnreliable( std::shared_ptr<Client> client, const std::string &msg, uint32_t sequence );
+
+	// Has the client bound its UDP endpoint yet
+	bool UdpBound( std::shared_ptr<Client> client );
+
+	// Sends what has been written to the clients since the last flush
+	void Flush();
+
+	// Should the writes to the clients wait for a Flush()
+	void SetCoalescing( bool coalesce );
+
+	// Totals over the connected clients
+	WriteStatistics GetWriteStatistics();
+
+	// A line of ConnectionStatistics per connected client
+	std::string StatisticsDump();
+
+	// Sums of the ConnectionStatistics of the connected
+	// clients and the clients accepted so far
+	ConnectionStatistics GetTotals();
+	uint64_t             AcceptedCount() const;
+
+	// Null if there's no such client
 	std::shared_ptr<Client> GetClient( unsigned int id );
+
+	// Forgets the client, it's freed when nothing uses it anymore
+	void RemoveClient( unsigned int id );
+
+	// Removes the clients whose connections have been closed
 	void CleanBadConnections();
 
 
-	std::mutex clientListMutex;
-	std::map<unsigned int, std::shared_ptr<Client>> clientList;
+	ClientRegistry clients;
 
 
  private:
-	tcp::acceptor *m_acceptor;
-	tcp::socket   *m_socket;
+	void ReceiveDatagram();
+	void SendUdpBind( std::shared_ptr<Client> client );
+
+	// Pings every client each PING_INTERVAL_MS
+	void SchedulePing();
+
+	asio::io_service *m_ioService;
+	tcp::acceptor    *m_acceptor;
+	tcp::socket      *m_socket;
 	short          m_port;
+	bool           m_coalesceWrites;
+
+	asio::deadline_timer *m_pingTimer;
+
+	std::atomic<uint64_t> m_accepted;
+
+	udp::socket   *m_udpSocket;
+	udp::endpoint  m_udpSender;
+	std::mutex     udpWriteMutex;
+	char m_udpData[MAX_DATAGRAM_PAYLOAD];
 };
 
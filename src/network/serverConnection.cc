@@ -1,9 +1,10 @@
 #include "serverConnection.hh"
 #include "networkEvents.hh"
-#include "serializable.hh"
+#include "binaryStream.hh"
 #include "../logger.hh"
 
 #include <atomic>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <sstream>
@@ -14,15 +15,22 @@ using namespace std;
 
 ServerConnection::ServerConnection()
 {
-	m_port    = 22001;
-	m_socket  = nullptr;
-	connected = false;
+	m_port       = 22001;
+	m_socket     = nullptr;
+	m_udpSocket  = nullptr;
+	m_helloTimer = nullptr;
+	m_pingTimer  = nullptr;
+	connected    = false;
 }
 
 
 ServerConnection::ServerConnection( asio::io_service& ioService, std::string host, short port )
 {
-	m_socket = nullptr;
+	m_socket     = nullptr;
+	m_udpSocket  = nullptr;
+	m_helloTimer = nullptr;
+	m_pingTimer  = nullptr;
+	connected    = false;
 	Init( ioService, host, port );
 }
 
@@ -34,6 +42,12 @@ ServerConnection::~ServerConnection()
 		m_socket->close();
 		m_socket = nullptr;
 	}
+
+	if( m_udpSocket )
+	{
+		m_udpSocket->close();
+		m_udpSocket = nullptr;
+	}
 }
 
 
@@ -50,14 +64,33 @@ void ServerConnection::Init( asio::io_service& ioService, std::string host, shor
 	}
 
 	m_socket = new asio::ip::tcp::socket( ioService );
-}
 
+	if( m_udpSocket )
+	{
+		m_udpSocket->close();
+		delete m_udpSocket;
+	}
+
+	if( m_helloTimer )
+	{
+		m_helloTimer->cancel();
+		delete m_helloTimer;
+	}
 
-static stringstream readStream(
-	stringstream::in |
-	stringstream::out |
-	stringstream::binary
-);
+	if( m_pingTimer )
+	{
+		m_pingTimer->cancel();
+		delete m_pingTimer;
+	}
+
+	m_udpSocket    = new asio::ip::udp::socket( ioService );
+	m_helloTimer   = new asio::deadline_timer( ioService );
+	m_pingTimer    = new asio::deadline_timer( ioService );
+	m_udpReceived  = false;
+	m_lastSequence = 0;
+	m_readBuffer.clear();
+	m_clockSync.Reset();
+}
 
 
 void ServerConnection::SetRead()
@@ -67,12 +100,13 @@ void ServerConnection::SetRead()
 		asio::buffer( m_data, maxLength ),
 		[this, self]( boost::system::error_code ec, size_t length )
 		{
-			char buffer[USHRT_MAX];
-
-			// Check for errors
+			// Check for errors, cancelled reads are from Disconnect()
 			if( ec.value() )
 			{
-				LOG_ERROR( "Client::Read() got error " << ec.value() << ": '" << ec.message() << "'" );
+				if( ec != asio::error::operation_aborted )
+				{
+					LOG_ERROR( "Client::Read() got error " << ec.value() << ": '" << ec.message() << "'" );
+				}
 
 				auto partEvent      = new PartEvent();
 				partEvent->type     = NETWORK_EVENT;
@@ -80,55 +114,208 @@ void ServerConnection::SetRead()
 				partEvent->clientId = 0;
 				eventQueue->AddEvent( partEvent );
 
-				m_socket->close();
+				m_socket->close( ec );
 				return;
 			}
 
-			// Apped the received data to the readStream
-			readStream.write( m_data, length );
+			// Append the received data to what's left of the previous reads
+			m_readBuffer.append( m_data, length );
+			m_telemetry.Received( length, 0 );
+
+			// A read may complete any number of frames
+			size_t offset = 0;
+			while( m_readBuffer.size() - offset >= sizeof( uint16_t ) )
+			{
+				BinaryReader frame( m_readBuffer.data() + offset, m_readBuffer.size() - offset );
+				auto frameLength = frame.ReadUint16();
+
+				if( frameLength < sizeof( uint16_t ) )
+				{
+					LOG_ERROR( "ServerConnection::SetRead() got a broken frame!" );
+					m_socket->close( ec );
+					return;
+				}
+
+				// Wait for the rest of the frame
+				if( m_readBuffer.size() - offset < frameLength )
+				{
+					break;
+				}
+
+				auto payload       = frame.Position();
+				auto payloadLength = frameLength - sizeof( uint16_t );
+				offset += frameLength;
+				m_telemetry.Received( 0 );
+
+				// Pings are answered right here, not in the game loop
+				if( HandlePing( payload, payloadLength ) )
+				{
+					continue;
+				}
+
+				// Create the event
+				auto dataInEvent      = new DataInEvent();
+				dataInEvent->type     = NETWORK_EVENT;
+				dataInEvent->subType  = NETWORK_DATA_IN;
+				dataInEvent->clientId = 0;
+				dataInEvent->data     = string( payload, payloadLength );
+				eventQueue->AddEvent( dataInEvent );
+			}
+
+			m_readBuffer.erase( 0, offset );
+
+			// Set this as a callback again
+			SetRead();
+		}
+	);
+}
+
+
+
+void ServerConnection::BindUdp( uint32_t clientId, uint32_t token )
+{
+	if( !m_socket || !m_udpSocket )
+	{
+		return;
+	}
+
+	m_udpClientId  = clientId;
+	m_udpToken     = token;
+	m_udpReceived  = false;
+	m_lastSequence = 0;
+
+	// The server listens to the datagrams on the same address and port
+	boost::system::error_code ec;
+	auto serverAddress = m_socket->remote_endpoint( ec ).address();
+	if( !ec.value() )
+	{
+		m_udpSocket->open( udp::v4(), ec );
+	}
+
+	if( ec.value() )
+	{
+		LOG_ERROR( "ServerConnection::BindUdp() failed: '" << ec.message() << "'" );
+		return;
+	}
+
+	m_udpServerEndpoint = udp::endpoint( serverAddress, m_port );
+
+	ReceiveDatagram();
+	SendUdpHello();
+}
+
+
+
+void ServerConnection::AckSnapshot( uint32_t sequence )
+{
+	if( !m_udpSocket || !m_udpSocket->is_open() )
+	{
+		return;
+	}
+
+	string datagram( 3 * sizeof( uint32_t ), '\0' );
+
+	BinaryWriter writer( datagram );
+	writer.WriteUint32( m_udpClientId );
+	writer.WriteUint32( m_udpToken );
+	writer.WriteUint32( sequence );
+
+	SendDatagram( datagram );
+}
+
+
+
+void ServerConnection::SendUdpHello()
+{
+	// Keep repeating until the first snapshot gets
+	// through, the hello itself may get lost as well
+	if( m_udpReceived || !m_udpSocket->is_open() )
+	{
+		return;
+	}
+
+	string datagram( 2 * sizeof( uint32_t ), '\0' );
+
+	BinaryWriter writer( datagram );
+	writer.WriteUint32( m_udpClientId );
+	writer.WriteUint32( m_udpToken );
+
+	SendDatagram( datagram );
+
+	auto self( shared_from_this() );
+	m_helloTimer->expires_from_now( boost::posix_time::milliseconds( 250 ) );
+	m_helloTimer->async_wait(
+		[this, self]( boost::system::error_code ec )
+		{
+			if( !ec.value() )
+			{
+				SendUdpHello();
+			}
+		}
+	);
+}
+
+
+
+void ServerConnection::SendDatagram( const string &datagram )
+{
+	boost::system::error_code ec;
+	auto sent = m_udpSocket->send_to( asio::buffer( datagram ), m_udpServerEndpoint, 0, ec );
+	m_telemetry.Sent( sent );
+}
+
+
+
+void ServerConnection::ReceiveDatagram()
+{
+	auto self( shared_from_this() );
+	m_udpSocket->async_receive_from(
+		asio::buffer( m_udpData, MAX_DATAGRAM_PAYLOAD ),
+		m_udpSender,
+		[this, self]( boost::system::error_code ec, size_t length )
+		{
+			if( ec == asio::error::operation_aborted )
+			{
+				return;
+			}
+
+			if( ec.value() )
+			{
+				LOG_ERROR( "ServerConnection::ReceiveDatagram() got error " << ec.value() << ": '" << ec.message() << "'" );
+				ReceiveDatagram();
+				return;
+			}
 
-			// Read more if we don't have enough data even
-			// for the header alone
-			size_t streamLength = readStream.str().length();
-			if( streamLength < sizeof( unsigned short ) )
+			if( length < DATAGRAM_HEADER_LENGTH || m_udpSender != m_udpServerEndpoint )
 			{
-				SetRead();
+				ReceiveDatagram();
 				return;
 			}
 
-			// Read the package byte count
-			size_t packetLength = UnserializeUint16( readStream );
+			m_telemetry.Received( length );
 
-			// Reverse the reading point back and
-			// wait for more data if we don't have enough
-			if( streamLength < packetLength )
+			BinaryReader reader( m_udpData, length );
+			auto sequence = reader.ReadUint32();
+
+			// Drop anything older than the newest snapshot we've seen,
+			// fragments of the newest one share its sequence number
+			if( m_udpReceived && IsNewerSequence( m_lastSequence, sequence ) )
 			{
-				long pos = static_cast<long>( readStream.tellg() );
-				readStream.seekg( pos - sizeof( unsigned short ) );
-				SetRead();
+				ReceiveDatagram();
 				return;
 			}
 
-			// We got all the data for the package!
-			readStream.read( buffer, packetLength-2 );
-			stringstream packetStream(
-				stringstream::in |
-				stringstream::out |
-				stringstream::binary
-			);
-			packetStream.write( buffer, packetLength-2 );
+			m_udpReceived  = true;
+			m_lastSequence = sequence;
 
-			// Create the event
 			auto dataInEvent      = new DataInEvent();
 			dataInEvent->type     = NETWORK_EVENT;
 			dataInEvent->subType  = NETWORK_DATA_IN;
 			dataInEvent->clientId = 0;
-			dataInEvent->data     = packetStream.str();
+			dataInEvent->data     = reader.ReadRest();
 			eventQueue->AddEvent( dataInEvent );
 
-
-			// Set this as a callback again
-			SetRead();
+			ReceiveDatagram();
 		}
 	);
 }
@@ -140,17 +327,148 @@ void ServerConnection::Write( std::string msg )
 	if( !m_socket )
 		return;
 
-	lock_guard<mutex> writeLock( writeMutex );
+	if( m_writeQueue.Push( msg ) )
+	{
+		Flush();
+	}
+}
+
+
+
+void ServerConnection::Flush()
+{
+	if( !m_socket || !connected )
+		return;
+
+	if( !m_writeQueue.Flush( *m_socket ) )
+	{
+		LOG_ERROR( "Writing to the server failed." );
+	}
+}
+
+
+
+void ServerConnection::SetCoalescing( bool coalesce )
+{
+	m_writeQueue.SetCoalescing( coalesce );
+}
+
+
+
+WriteStatistics ServerConnection::GetWriteStatistics() const
+{
+	return m_writeQueue.Statistics();
+}
+
+
+
+ConnectionStatistics ServerConnection::GetStatistics()
+{
+	auto statistics   = m_telemetry.Statistics();
+	auto written      = m_writeQueue.Statistics();
+	statistics.bytesOut   += written.bytes;
+	statistics.packetsOut += written.messages;
+	statistics.queueDepth  = m_writeQueue.Depth();
+	return statistics;
+}
 
-	boost::asio::streambuf request;
-	ostream requestStream( &request );
 
-	unsigned short msgLength = msg.length() + 2;
-	requestStream.write( reinterpret_cast<char*>( &msgLength ), 2 );
 
-	requestStream << msg;
+uint64_t ServerConnection::LocalTime( uint64_t serverTime ) const
+{
+	if( !m_clockSync.Synchronized() )
+	{
+		return TelemetryClock();
+	}
 
-	boost::asio::write( *m_socket, request );
+	return m_clockSync.ToLocal( serverTime );
+}
+
+
+
+const ClockSync& ServerConnection::GetClockSync() const
+{
+	return m_clockSync;
+}
+
+
+
+void ServerConnection::SchedulePing()
+{
+	// Ping quickly until the clocks are in sync
+	auto interval = m_clockSync.Synchronized() ? PING_INTERVAL_MS : CLOCK_SYNC_INTERVAL_MS;
+
+	auto self( shared_from_this() );
+	m_pingTimer->expires_from_now( boost::posix_time::milliseconds( interval ) );
+	m_pingTimer->async_wait(
+		[this, self]( boost::system::error_code ec )
+		{
+			if( ec.value() || !m_socket->is_open() )
+			{
+				return;
+			}
+
+			Ping();
+			Flush();
+
+			SchedulePing();
+		}
+	);
+}
+
+
+
+void ServerConnection::Ping()
+{
+	// The server takes bare packets
+	Write( m_telemetry.NextPing() );
+}
+
+
+
+bool ServerConnection::HandlePing( const char *data, size_t length )
+{
+	// The server sends its pings as a packet sequence of one
+	BinaryReader reader( data, length );
+	auto packetLength = reader.ReadUint16();
+	if( reader.Failed() || packetLength != length )
+	{
+		return false;
+	}
+
+	EventSubType subType;
+	uint32_t     sequence;
+	uint64_t     timestamp, remoteTime;
+
+	if( !ParsePingPacket( reader.Position(), reader.Remaining(), subType, sequence, timestamp, remoteTime ) )
+	{
+		return false;
+	}
+
+	if( subType == NETWORK_PONG )
+	{
+		m_clockSync.AddSample( timestamp, remoteTime, TelemetryClock() );
+		m_telemetry.PongReceived( timestamp );
+		return true;
+	}
+
+	Write( PongPacket( sequence, timestamp, TelemetryClock() ) );
+	Flush();
+	return true;
+}
+
+
+
+void ServerConnection::SendHello( uint32_t capabilities )
+{
+	string packet( 1 + 2 + 4, '\0' );
+
+	BinaryWriter writer( packet );
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_HELLO );
+	writer.WriteUint32( capabilities );
+
+	Write( packet );
 }
 
 
@@ -185,8 +503,10 @@ void ServerConnection::Connect( asio::io_service& ioService )
 		throw boost::system::system_error( error );
 	}
 
-	// We managed to connect!
+	// We managed to connect! The writes are flushed
+	// explicitly so there's nothing for Nagle to wait for
 	connected = true;
+	m_socket->set_option( tcp::no_delay( true ), error );
 
 	// Create a join event
 	auto joinEvent      = new JoinEvent();
@@ -197,15 +517,32 @@ void ServerConnection::Connect( asio::io_service& ioService )
 
 	// Create the asynchronous reader
 	SetRead();
+	SchedulePing();
 }
 
 
 
 void ServerConnection::Disconnect()
 {
+	boost::system::error_code ec;
 	if( m_socket && connected )
 	{
-		m_socket->close();
+		m_socket->close( ec );
+	}
+
+	if( m_helloTimer )
+	{
+		m_helloTimer->cancel( ec );
+	}
+
+	if( m_pingTimer )
+	{
+		m_pingTimer->cancel( ec );
+	}
+
+	if( m_udpSocket )
+	{
+		m_udpSocket->close( ec );
 	}
 }
 
@@ -17,8 +17,13 @@
 #include "../events/eventDispatcher.hh"
 #include "../events/eventFactory.hh"
 #include "networkEvents.hh"
+#include "packets.hh"
+#include "writeQueue.hh"
+#include "connectionStatistics.hh"
+#include "clockSync.hh"
 
 using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
 using namespace boost;
 
 
@@ -35,12 +40,51 @@ public:
 	void Disconnect();
 	bool IsConnected();
 
+	// Queues the message, it's sent on the next Flush()
+	// unless the writes aren't coalesced
 	void Write( std::string msg );
+	void Flush();
+	void SetCoalescing( bool coalesce );
+
+	WriteStatistics GetWriteStatistics() const;
+
+	// Round trip time and traffic of both channels
+	ConnectionStatistics GetStatistics();
+
+	// The server's clock (TelemetryClock() on the server) in ours,
+	// the time of receiving until the clocks have been synchronized
+	uint64_t LocalTime( uint64_t serverTime ) const;
+
+	const ClockSync& GetClockSync() const;
+
+	// Tells the server what we can handle, see ClientCapabilities
+	void SendHello( uint32_t capabilities );
+
+	// Queues a ping besides the periodic ones
+	void Ping();
+
 	void SetRead();
 
+	// Binds the unreliable snapshot channel using the id
+	// and token the server gave us over the TCP stream
+	void BindUdp( uint32_t clientId, uint32_t token );
+
+	// Tells the server the snapshot arrived whole,
+	// so it can be used as the base of the deltas
+	void AckSnapshot( uint32_t sequence );
+
 
 
 private:
+	void ReceiveDatagram();
+	void SendUdpHello();
+	void SendDatagram( const std::string &datagram );
+
+	void SchedulePing();
+
+	// Answers pings and takes pongs, returns false for any other frame
+	bool HandlePing( const char *data, size_t length );
+
 	tcp::endpoint  m_endpoint;
 	tcp::socket   *m_socket;
 	std::string    m_host;
@@ -51,6 +95,24 @@ private:
 	enum { maxLength = 1024 };
 	char m_data[maxLength];
 
-	std::mutex writeMutex;
+	// Received bytes that don't make a whole frame yet
+	std::string m_readBuffer;
+
+	WriteQueue m_writeQueue;
+
+	ConnectionTelemetry   m_telemetry;
+	ClockSync             m_clockSync;
+	asio::deadline_timer *m_pingTimer;
+
+	// Unreliable snapshot channel
+	udp::socket          *m_udpSocket;
+	udp::endpoint         m_udpServerEndpoint;
+	udp::endpoint         m_udpSender;
+	asio::deadline_timer *m_helloTimer;
+	uint32_t              m_udpClientId;
+	uint32_t              m_udpToken;
+	uint32_t              m_lastSequence;
+	bool                  m_udpReceived;
+	char m_udpData[MAX_DATAGRAM_PAYLOAD];
 };
 
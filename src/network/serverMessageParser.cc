@@ -0,0 +1,216 @@
+#include "serverMessageParser.hh"
+#include "compression.hh"
+#include "objectMessage.hh"
+#include "networkEvents.hh"
+#include "../world/objectEvents.hh"
+#include "../logger.hh"
+
+using namespace std;
+
+
+ServerMessageParser::ServerMessageParser( EventHandler onEvent, TransformHandler onTransforms, TransformArraysHandler onTransformArrays )
+	: eventHandler( onEvent ),
+	  transformHandler( onTransforms ),
+	  transformArraysHandler( onTransformArrays ),
+	  snapshotCount( 0 ),
+	  decompressing( false )
+{
+}
+
+
+
+void ServerMessageParser::Reset()
+{
+	snapshotReceiver.Reset();
+	snapshotCount = 0;
+}
+
+
+
+size_t ServerMessageParser::SnapshotCount() const
+{
+	return snapshotCount;
+}
+
+
+
+void ServerMessageParser::Parse( const string &data, ServerConnection *connection )
+{
+	Parse( data.data(), data.size(), connection );
+}
+
+
+
+void ServerMessageParser::Parse( const char *data, size_t length, ServerConnection *connection )
+{
+	// One pass over the packets, each is decoded where it lies
+	BinaryReader reader( data, length );
+	while( reader.Remaining() >= sizeof( uint16_t ) )
+	{
+		auto packetLength = reader.ReadUint16();
+
+		// The rest can't be trusted if a length is off
+		if( packetLength < sizeof( uint16_t ) || packetLength - sizeof( uint16_t ) > reader.Remaining() )
+		{
+			LOG_ERROR( "Received a broken packet length(" << packetLength << ")!" );
+			return;
+		}
+
+		auto e = decoder.Decode( reader.Position(), packetLength - sizeof( uint16_t ) );
+		reader.Skip( packetLength - sizeof( uint16_t ) );
+
+		if( !e )
+		{
+			LOG_ERROR( "Received an invalid or unknown packet!" );
+			continue;
+		}
+
+		HandlePacket( e, connection );
+	}
+
+	if( reader.Remaining() )
+	{
+		LOG_ERROR( "Received " << reader.Remaining() << " bytes of a partial packet!" );
+	}
+}
+
+
+
+void ServerMessageParser::HandlePacket( Event *e, ServerConnection *connection )
+{
+	vector<NodeTransform> transforms;
+	uint32_t              snapshotSequence;
+	uint64_t              serverTime = 0;
+	string                decompressed;
+	vector<Event*>        events;
+
+	switch( e->subType )
+	{
+		// The object events go on as they are
+		case OBJECT_CREATE:
+		case OBJECT_DESTROY:
+		case OBJECT_UPDATE:
+		case OBJECT_PARENT_ADD:
+		case OBJECT_PARENT_REMOVE:
+		case OBJECT_CHILD_ADD:
+		case OBJECT_CHILD_REMOVE:
+			eventHandler( e );
+			return;
+
+
+		case OBJECT_SNAPSHOT:
+			if( snapshotReceiver.Receive( static_cast<ObjectSnapshotEvent*>( e )->data, transforms, snapshotSequence, serverTime ) )
+			{
+				snapshotCount++;
+				if( connection )
+				{
+					connection->AckSnapshot( snapshotSequence );
+				}
+			}
+
+			// Place the transforms at the server's tick time on our clock
+			if( transformHandler && !transforms.empty() )
+			{
+				transformHandler( transforms, connection ? connection->LocalTime( serverTime ) : TelemetryClock() );
+			}
+			break;
+
+
+		// Object events packed after each other, go on one by one
+		case OBJECT_PACKED:
+			if( !UnpackObjectEvents( static_cast<ObjectPackedEvent*>( e )->data, events ) )
+			{
+				LOG_ERROR( "Received broken packed object events!" );
+			}
+
+			for( auto unpacked : events )
+			{
+				eventHandler( unpacked );
+			}
+			break;
+
+
+		// Transforms sent over the reliable stream, in bulk
+		case OBJECT_UPDATE_BATCH:
+			HandleTransformBatch( static_cast<ObjectUpdateBatchEvent*>( e )->data, connection );
+			break;
+
+
+		case NETWORK_UDP_BIND:
+			if( connection )
+			{
+				auto bind = static_cast<UdpBindEvent*>( e );
+				connection->BindUdp( bind->clientId, bind->token );
+			}
+			break;
+
+
+		case NETWORK_COMPRESSED:
+			// The server never compresses twice
+			if( decompressing )
+			{
+				LOG_ERROR( "Received nested compressed packets!" );
+				break;
+			}
+
+			if( !DecompressPackets( static_cast<CompressedEvent*>( e )->data, decompressed ) )
+			{
+				LOG_ERROR( "Received broken compressed packets!" );
+				break;
+			}
+
+			decompressing = true;
+			Parse( decompressed, connection );
+			decompressing = false;
+			break;
+
+
+		default:
+			LOG_ERROR( ToString( "Handling event "
+			                     << EventSubTypeToStr( e->subType )
+			                     << " from the server not yet implemented!" ) );
+	}
+
+	delete e;
+}
+
+
+
+void ServerMessageParser::HandleTransformBatch( const string &body, ServerConnection *connection )
+{
+	BinaryReader    reader( body );
+	uint64_t        serverTime;
+	QuantizedArrays batch;
+
+	if( !DecodeTransformBatch( reader, serverTime, batch ) )
+	{
+		LOG_ERROR( "Received a broken transform batch!" );
+		return;
+	}
+
+	TransformArrays transforms;
+	DequantizeArrays( codec, batch, transforms );
+
+	auto sampleTime = connection ? connection->LocalTime( serverTime ) : TelemetryClock();
+
+	if( transformArraysHandler )
+	{
+		transformArraysHandler( transforms, sampleTime );
+		return;
+	}
+
+	if( !transformHandler )
+	{
+		return;
+	}
+
+	vector<NodeTransform> nodes( transforms.Size() );
+	for( size_t i = 0; i < nodes.size(); i++ )
+	{
+		nodes[i].id       = transforms.ids[i];
+		nodes[i].position = glm::vec3( transforms.x[i], transforms.y[i], transforms.z[i] );
+		nodes[i].rotation = glm::quat( transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i] );
+	}
+
+	transformHandler( nodes, sampleTime );
+}
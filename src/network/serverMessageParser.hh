@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../events/event.hh"
+#include "serverConnection.hh"
+#include "snapshot.hh"
+#include "transformBatch.hh"
+#include "packetDecoder.hh"
+
+
+// Turns the messages the server sends into object events and snapshot
+// updates. Shared by the game client and the headless bot, so neither
+// needs the other's globals.
+class ServerMessageParser
+{
+ public:
+	// Takes the ownership of the constructed events
+	typedef std::function<void( Event* )> EventHandler;
+
+	// Gets the transforms that changed in a snapshot and the time they
+	// were sampled at in microseconds of our TelemetryClock()
+	typedef std::function<void( const std::vector<NodeTransform>&, uint64_t )> TransformHandler;
+
+	// Gets the transforms of an OBJECT_UPDATE_BATCH as they were decoded,
+	// without it they go to the TransformHandler one by one
+	typedef std::function<void( const TransformArrays&, uint64_t )> TransformArraysHandler;
+
+	ServerMessageParser(
+		EventHandler           eventHandler,
+		TransformHandler       transformHandler,
+		TransformArraysHandler transformArraysHandler = nullptr
+	);
+
+	// Parses a message of length prefixed packets. The connection
+	// binds the snapshot channel and acks the snapshots, it may be null.
+	void Parse( const std::string &data, ServerConnection *connection );
+	void Parse( const char *data, size_t length, ServerConnection *connection );
+
+	// Forget the snapshots of the previous connection
+	void Reset();
+
+	// Number of completed snapshots so far
+	size_t SnapshotCount() const;
+
+
+ private:
+	// Takes the ownership of the event
+	void HandlePacket( Event *e, ServerConnection *connection );
+	void HandleTransformBatch( const std::string &body, ServerConnection *connection );
+
+	PacketDecoder          decoder;
+	EventHandler           eventHandler;
+	TransformHandler       transformHandler;
+	TransformArraysHandler transformArraysHandler;
+
+	// Dequantizes the transform batches
+	TransformCodec codec;
+
+	// Rebuilds the transform snapshots from the deltas
+	SnapshotReceiver snapshotReceiver;
+
+	std::atomic<size_t> snapshotCount;
+
+	// Parsing the packets unwrapped from NETWORK_COMPRESSED
+	bool decompressing;
+};
@@ -0,0 +1,477 @@
+#include "snapshot.hh"
+#include "binaryStream.hh"
+#include "packets.hh"
+#include "bitStream.hh"
+#include "../events/event.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+// Bytes in front of the entries of every OBJECT_SNAPSHOT packet:
+// length, type, sub type, sequence, server time, baseline
+// sequence, baseline flag, fragment index and fragment count.
+#define SNAPSHOT_HEADER_LENGTH ( 2 + 1 + 2 + 4 + 8 + 4 + 1 + 2 + 2 )
+
+
+namespace
+{
+	// Bits taken by a single entry with the given mask
+	size_t EntryBits( const TransformCodec &codec, uint8_t mask )
+	{
+		size_t bits = 32 + SNAPSHOT_MASK_BITS;
+
+		for( int i = 0; i < 3; i++ )
+		{
+			if( mask & ( 1 << i ) )
+			{
+				bits += codec.PositionBits();
+			}
+		}
+
+		if( mask & SNAPSHOT_ROTATION )
+		{
+			bits += codec.RotationBits();
+		}
+
+		return bits;
+	}
+
+
+	// Which components differ from the base, base may be null for new nodes
+	uint8_t EntryMask( const QuantizedTransform *node, const QuantizedTransform *base )
+	{
+		if( !node )
+		{
+			return SNAPSHOT_REMOVED;
+		}
+
+		if( !base )
+		{
+			return SNAPSHOT_POSITION_X | SNAPSHOT_POSITION_Y | SNAPSHOT_POSITION_Z | SNAPSHOT_ROTATION;
+		}
+
+		uint8_t mask = 0;
+		for( int i = 0; i < 3; i++ )
+		{
+			if( node->position[i] != base->position[i] )
+			{
+				mask |= 1 << i;
+			}
+		}
+
+		if( node->rotation != base->rotation )
+		{
+			mask |= SNAPSHOT_ROTATION;
+		}
+
+		return mask;
+	}
+
+
+	void EncodeEntry(
+		const TransformCodec     &codec,
+		BitWriter                &writer,
+		uint8_t                   mask,
+		const QuantizedTransform *node,
+		const QuantizedTransform *base )
+	{
+		static const QuantizedTransform zero = {};
+
+		if( mask & SNAPSHOT_REMOVED )
+		{
+			writer.Write( base->id, 32 );
+			writer.Write( mask, SNAPSHOT_MASK_BITS );
+			return;
+		}
+
+		if( !base )
+		{
+			base = &zero;
+		}
+
+		writer.Write( node->id, 32 );
+		writer.Write( mask, SNAPSHOT_MASK_BITS );
+
+		for( int i = 0; i < 3; i++ )
+		{
+			if( mask & ( 1 << i ) )
+			{
+				writer.Write( node->position[i] ^ base->position[i], codec.PositionBits() );
+			}
+		}
+
+		if( mask & SNAPSHOT_ROTATION )
+		{
+			writer.Write( node->rotation ^ base->rotation, codec.RotationBits() );
+		}
+	}
+
+
+	bool CompareId( const QuantizedTransform &node, uint32_t id )
+	{
+		return node.id < id;
+	}
+}
+
+
+
+QuantizedTransform QuantizeTransform( const TransformCodec &codec, const NodeTransform &transform )
+{
+	QuantizedTransform quantized;
+	quantized.id          = transform.id;
+	quantized.position[0] = codec.QuantizePosition( transform.position.x );
+	quantized.position[1] = codec.QuantizePosition( transform.position.y );
+	quantized.position[2] = codec.QuantizePosition( transform.position.z );
+	quantized.rotation    = codec.QuantizeRotation( transform.rotation );
+	return quantized;
+}
+
+
+
+NodeTransform DequantizeTransform( const TransformCodec &codec, const QuantizedTransform &transform )
+{
+	NodeTransform node;
+	node.id       = transform.id;
+	node.position = glm::vec3(
+		codec.DequantizePosition( transform.position[0] ),
+		codec.DequantizePosition( transform.position[1] ),
+		codec.DequantizePosition( transform.position[2] )
+	);
+	node.rotation = codec.DequantizeRotation( transform.rotation );
+	return node;
+}
+
+
+
+size_t SnapshotEntryBits(
+	const TransformCodec     &codec,
+	const QuantizedTransform *node,
+	const QuantizedTransform *base )
+{
+	auto mask = EntryMask( node, base );
+	if( !mask )
+	{
+		return 0;
+	}
+
+	return EntryBits( codec, mask );
+}
+
+
+
+SnapshotHistory::SnapshotHistory()
+{
+	Clear();
+}
+
+
+
+void SnapshotHistory::Store( uint32_t sequence, TransformSnapshotPtr snapshot )
+{
+	auto &entry    = entries[sequence % SNAPSHOT_HISTORY_LENGTH];
+	entry.sequence = sequence;
+	entry.snapshot = snapshot;
+}
+
+
+
+TransformSnapshotPtr SnapshotHistory::Find( uint32_t sequence ) const
+{
+	auto &entry = entries[sequence % SNAPSHOT_HISTORY_LENGTH];
+	if( entry.sequence != sequence )
+	{
+		return nullptr;
+	}
+
+	return entry.snapshot;
+}
+
+
+
+void SnapshotHistory::Clear()
+{
+	for( auto &entry : entries )
+	{
+		entry.sequence = 0;
+		entry.snapshot = nullptr;
+	}
+}
+
+
+
+string EncodeSnapshot(
+	const TransformCodec    &codec,
+	uint32_t                 sequence,
+	uint64_t                 serverTime,
+	const TransformSnapshot &current,
+	uint32_t                 baselineSequence,
+	const TransformSnapshot *baseline,
+	size_t                   maxPacketLength )
+{
+	static const TransformSnapshot emptySnapshot;
+
+	if( !baseline )
+	{
+		baseline = &emptySnapshot;
+	}
+
+	// Encode the entries first, the fragment count is
+	// needed in the headers before the entries
+	vector<string> fragments;
+	BitWriter      writer;
+
+	size_t maxEntryBits = ( maxPacketLength - SNAPSHOT_HEADER_LENGTH ) * 8;
+
+	auto node = current.begin();
+	auto base = baseline->begin();
+
+	while( node != current.end() || base != baseline->end() )
+	{
+		const QuantizedTransform *nodePtr = nullptr;
+		const QuantizedTransform *basePtr = nullptr;
+
+		if( base == baseline->end() ||
+		    ( node != current.end() && node->id < base->id ) )
+		{
+			nodePtr = &*node++;
+		}
+		else if( node == current.end() || base->id < node->id )
+		{
+			basePtr = &*base++;
+		}
+		else
+		{
+			nodePtr = &*node++;
+			basePtr = &*base++;
+		}
+
+		auto mask = EntryMask( nodePtr, basePtr );
+		if( !mask )
+		{
+			continue;
+		}
+
+		// Start a new fragment if the entry doesn't fit anymore
+		if( writer.BitCount() + EntryBits( codec, mask ) > maxEntryBits )
+		{
+			fragments.push_back( writer.Data() );
+			writer.Clear();
+		}
+
+		EncodeEntry( codec, writer, mask, nodePtr, basePtr );
+	}
+
+	// Always send at least one fragment so the client
+	// has something to acknowledge even if nothing moved
+	if( writer.BitCount() > 0 || fragments.empty() )
+	{
+		fragments.push_back( writer.Data() );
+	}
+
+
+	// Build the packets
+	size_t messageLength = 0;
+	for( auto &fragment : fragments )
+	{
+		messageLength += SNAPSHOT_HEADER_LENGTH + fragment.size();
+	}
+
+	string message( messageLength, '\0' );
+	BinaryWriter messageWriter( message );
+
+	uint16_t fragmentCount = static_cast<uint16_t>( fragments.size() );
+	for( uint16_t i = 0; i < fragmentCount; i++ )
+	{
+		messageWriter.WriteUint16( SNAPSHOT_HEADER_LENGTH + fragments[i].size() );
+		messageWriter.WriteUint8( OBJECT_EVENT );
+		messageWriter.WriteUint16( OBJECT_SNAPSHOT );
+		messageWriter.WriteUint32( sequence );
+		messageWriter.WriteUint64( serverTime );
+		messageWriter.WriteUint32( baselineSequence );
+		messageWriter.WriteUint8( baseline != &emptySnapshot );
+		messageWriter.WriteUint16( i );
+		messageWriter.WriteUint16( fragmentCount );
+		messageWriter.WriteBytes( fragments[i] );
+	}
+
+	return message;
+}
+
+
+
+SnapshotReceiver::SnapshotReceiver( const TransformCodec &transformCodec )
+	: codec( transformCodec )
+{
+	Reset();
+}
+
+
+
+void SnapshotReceiver::Reset()
+{
+	lock_guard<mutex> receiverLock( receiverMutex );
+
+	history.Clear();
+	assembling    = false;
+	hasCompleted  = false;
+	lastCompleted = 0;
+	state         = nullptr;
+	fragmentsReceived.clear();
+	changedIds.clear();
+	lastChangedIds.clear();
+}
+
+
+
+bool SnapshotReceiver::Receive(
+	const string          &body,
+	vector<NodeTransform> &changes,
+	uint32_t              &completedSequence,
+	uint64_t              &serverTime )
+{
+	lock_guard<mutex> receiverLock( receiverMutex );
+
+	// Header without the length, type and sub type
+	BinaryReader header( body );
+
+	auto packetSequence   = header.ReadUint32();
+	auto packetTime       = header.ReadUint64();
+	auto baselineSequence = header.ReadUint32();
+	auto hasBaseline      = header.ReadUint8();
+	auto fragmentIndex    = header.ReadUint16();
+	auto fragments        = header.ReadUint16();
+
+	if( header.Failed() || fragmentIndex >= fragments )
+	{
+		return false;
+	}
+
+	// Ignore anything older than what we've already got
+	if( hasCompleted && !IsNewerSequence( packetSequence, lastCompleted ) )
+	{
+		return false;
+	}
+
+	if( assembling && IsNewerSequence( sequence, packetSequence ) )
+	{
+		return false;
+	}
+
+	// Start assembling a new snapshot on top of its baseline
+	if( !assembling || sequence != packetSequence )
+	{
+		TransformSnapshotPtr baseline;
+		if( hasBaseline )
+		{
+			baseline = history.Find( baselineSequence );
+			if( !baseline )
+			{
+				return false;
+			}
+		}
+
+		assembling    = true;
+		sequence      = packetSequence;
+		fragmentCount = fragments;
+		fragmentsReceived.assign( fragments, false );
+		changedIds.clear();
+
+		state = baseline ?
+			make_shared<TransformSnapshot>( *baseline ) :
+			make_shared<TransformSnapshot>();
+	}
+
+	if( fragments != fragmentCount || fragmentsReceived[fragmentIndex] )
+	{
+		return false;
+	}
+
+	fragmentsReceived[fragmentIndex] = true;
+	serverTime = packetTime;
+
+
+	// Apply the entries
+	BitReader reader( header.Position(), header.Remaining() );
+
+	while( reader.BitsLeft() >= 32 + SNAPSHOT_MASK_BITS )
+	{
+		auto id   = reader.Read( 32 );
+		auto mask = reader.Read( SNAPSHOT_MASK_BITS );
+
+		auto node = lower_bound( state->begin(), state->end(), id, CompareId );
+
+		if( mask & SNAPSHOT_REMOVED )
+		{
+			if( node != state->end() && node->id == id )
+			{
+				state->erase( node );
+			}
+			continue;
+		}
+
+		if( node == state->end() || node->id != id )
+		{
+			QuantizedTransform newNode = {};
+			newNode.id = id;
+			node = state->insert( node, newNode );
+		}
+
+		for( int i = 0; i < 3; i++ )
+		{
+			if( mask & ( 1 << i ) )
+			{
+				node->position[i] ^= reader.Read( codec.PositionBits() );
+			}
+		}
+
+		if( mask & SNAPSHOT_ROTATION )
+		{
+			node->rotation ^= reader.Read( codec.RotationBits() );
+		}
+
+		if( reader.Failed() )
+		{
+			return false;
+		}
+
+		changes.push_back( DequantizeTransform( codec, *node ) );
+		changedIds.push_back( id );
+	}
+
+
+	// Wait for the rest of the fragments
+	if( find( fragmentsReceived.begin(), fragmentsReceived.end(), false ) != fragmentsReceived.end() )
+	{
+		return false;
+	}
+
+	// Nodes that moved in the previous snapshot but not in this one
+	// get their final transform again so they stop extrapolating
+	sort( changedIds.begin(), changedIds.end() );
+	for( auto id : lastChangedIds )
+	{
+		if( binary_search( changedIds.begin(), changedIds.end(), id ) )
+		{
+			continue;
+		}
+
+		auto node = lower_bound( state->begin(), state->end(), id, CompareId );
+		if( node != state->end() && node->id == id )
+		{
+			changes.push_back( DequantizeTransform( codec, *node ) );
+		}
+	}
+
+	history.Store( sequence, state );
+	lastChangedIds.swap( changedIds );
+	changedIds.clear();
+
+	assembling        = false;
+	hasCompleted      = true;
+	lastCompleted     = sequence;
+	completedSequence = sequence;
+
+	return true;
+}
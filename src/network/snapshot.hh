@@ -0,0 +1,152 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "transformCodec.hh"
+
+
+// How many snapshots are remembered for delta encoding,
+// acks older than this fall back to a full snapshot.
+#define SNAPSHOT_HISTORY_LENGTH 32
+
+
+// Bits of the per node mask telling which components were sent
+enum SnapshotFieldBits : uint8_t
+{
+	SNAPSHOT_POSITION_X = 1 << 0,
+	SNAPSHOT_POSITION_Y = 1 << 1,
+	SNAPSHOT_POSITION_Z = 1 << 2,
+	SNAPSHOT_ROTATION   = 1 << 3,
+	SNAPSHOT_REMOVED    = 1 << 4,
+
+	SNAPSHOT_MASK_BITS  = 5
+};
+
+
+struct NodeTransform
+{
+	uint32_t  id;
+	glm::vec3 position;
+	glm::quat rotation;
+};
+
+
+// Transform as it goes over the wire, see TransformCodec
+struct QuantizedTransform
+{
+	uint32_t id;
+	uint32_t position[3];
+	uint32_t rotation;
+};
+
+
+// Quantized transforms of the replicated nodes, sorted by id
+typedef std::vector<QuantizedTransform>          TransformSnapshot;
+typedef std::shared_ptr<const TransformSnapshot> TransformSnapshotPtr;
+
+
+QuantizedTransform QuantizeTransform( const TransformCodec &codec, const NodeTransform &transform );
+NodeTransform      DequantizeTransform( const TransformCodec &codec, const QuantizedTransform &transform );
+
+// Bits EncodeSnapshot spends on the node against the base, either may be null
+size_t SnapshotEntryBits(
+	const TransformCodec     &codec,
+	const QuantizedTransform *node,
+	const QuantizedTransform *base
+);
+
+
+
+// Remembers the last SNAPSHOT_HISTORY_LENGTH snapshots by sequence
+class SnapshotHistory
+{
+ public:
+	SnapshotHistory();
+
+	void Store( uint32_t sequence, TransformSnapshotPtr snapshot );
+
+	// Returns nullptr if the snapshot is unknown or already forgotten
+	TransformSnapshotPtr Find( uint32_t sequence ) const;
+
+	void Clear();
+
+
+ private:
+	struct Entry
+	{
+		uint32_t             sequence;
+		TransformSnapshotPtr snapshot;
+	};
+
+	Entry entries[SNAPSHOT_HISTORY_LENGTH];
+};
+
+
+
+// Encodes the difference between the current snapshot and the baseline
+// into OBJECT_SNAPSHOT packets of at most maxPacketLength bytes each.
+// Unchanged nodes are left out and the changed components are bit packed
+// XORed against the baseline. Without a baseline everything is sent.
+// The server time (TelemetryClock() of the tick) goes along so the
+// client can place the transforms on its timeline.
+std::string EncodeSnapshot(
+	const TransformCodec    &codec,
+	uint32_t                 sequence,
+	uint64_t                 serverTime,
+	const TransformSnapshot &current,
+	uint32_t                 baselineSequence,
+	const TransformSnapshot *baseline,
+	size_t                   maxPacketLength
+);
+
+
+
+// Client side counterpart of EncodeSnapshot, rebuilds the full snapshots
+// from the fragments and keeps the history the server deltas against.
+class SnapshotReceiver
+{
+ public:
+	SnapshotReceiver( const TransformCodec &codec = TransformCodec() );
+
+	// Decodes one OBJECT_SNAPSHOT packet body (the part after the sub type).
+	// The transforms of the nodes that changed are appended to changes and
+	// the server time of the snapshot is stored to serverTime. Returns true
+	// when the snapshot got complete, its sequence is then stored to
+	// completedSequence and it should be acknowledged.
+	bool Receive(
+		const std::string          &body,
+		std::vector<NodeTransform> &changes,
+		uint32_t                   &completedSequence,
+		uint64_t                   &serverTime
+	);
+
+	void Reset();
+
+
+ private:
+	std::mutex      receiverMutex;
+	SnapshotHistory history;
+	TransformCodec  codec;
+
+	// The snapshot being assembled
+	bool                       assembling;
+	uint32_t                   sequence;
+	uint16_t                   fragmentCount;
+	std::vector<bool>          fragmentsReceived;
+	std::shared_ptr<TransformSnapshot> state;
+	std::vector<uint32_t>      changedIds;
+
+	// Ids that changed in the previously completed snapshot
+	std::vector<uint32_t>      lastChangedIds;
+	bool                       hasCompleted;
+	uint32_t                   lastCompleted;
+};
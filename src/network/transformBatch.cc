@@ -0,0 +1,234 @@
+#include "transformBatch.hh"
+#include "../events/event.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+// Bytes in front of the arrays of every OBJECT_UPDATE_BATCH
+// packet: length, type, sub type, server time and count.
+#define TRANSFORM_BATCH_HEADER_LENGTH ( 2 + 1 + 2 + 8 + 2 )
+
+// Bytes per node: the id, the position and the rotation
+#define TRANSFORM_BATCH_NODE_LENGTH ( 4 + 3 * 4 + 4 )
+
+
+size_t TransformArrays::Size() const
+{
+	return ids.size();
+}
+
+
+
+void TransformArrays::Resize( size_t count )
+{
+	ids.resize( count );
+	x.resize( count );
+	y.resize( count );
+	z.resize( count );
+	qx.resize( count );
+	qy.resize( count );
+	qz.resize( count );
+	qw.resize( count );
+}
+
+
+
+void TransformArrays::Clear()
+{
+	Resize( 0 );
+}
+
+
+
+void TransformArrays::Append( uint32_t id, const glm::vec3 &position, const glm::quat &rotation )
+{
+	ids.push_back( id );
+	x.push_back( position.x );
+	y.push_back( position.y );
+	z.push_back( position.z );
+	qx.push_back( rotation.x );
+	qy.push_back( rotation.y );
+	qz.push_back( rotation.z );
+	qw.push_back( rotation.w );
+}
+
+
+
+size_t QuantizedArrays::Size() const
+{
+	return ids.size();
+}
+
+
+
+void QuantizedArrays::Resize( size_t count )
+{
+	ids.resize( count );
+	x.resize( count );
+	y.resize( count );
+	z.resize( count );
+	rotations.resize( count );
+}
+
+
+
+void QuantizedArrays::Clear()
+{
+	Resize( 0 );
+}
+
+
+
+void QuantizedArrays::Append( const QuantizedTransform &transform )
+{
+	ids.push_back( transform.id );
+	x.push_back( transform.position[0] );
+	y.push_back( transform.position[1] );
+	z.push_back( transform.position[2] );
+	rotations.push_back( transform.rotation );
+}
+
+
+
+QuantizedTransform QuantizedArrays::At( size_t index ) const
+{
+	QuantizedTransform transform;
+	transform.id          = ids[index];
+	transform.position[0] = x[index];
+	transform.position[1] = y[index];
+	transform.position[2] = z[index];
+	transform.rotation    = rotations[index];
+	return transform;
+}
+
+
+
+void QuantizeArrays( const TransformCodec &codec, const TransformArrays &transforms, QuantizedArrays &quantized )
+{
+	auto count = transforms.Size();
+	quantized.Resize( count );
+	if( !count )
+	{
+		return;
+	}
+
+	copy( transforms.ids.begin(), transforms.ids.end(), quantized.ids.begin() );
+
+	codec.QuantizePositions( &transforms.x[0], &quantized.x[0], count );
+	codec.QuantizePositions( &transforms.y[0], &quantized.y[0], count );
+	codec.QuantizePositions( &transforms.z[0], &quantized.z[0], count );
+	codec.QuantizeRotations(
+		&transforms.qx[0], &transforms.qy[0], &transforms.qz[0], &transforms.qw[0],
+		&quantized.rotations[0], count
+	);
+}
+
+
+
+void DequantizeArrays( const TransformCodec &codec, const QuantizedArrays &quantized, TransformArrays &transforms )
+{
+	auto count = quantized.Size();
+	transforms.Resize( count );
+	if( !count )
+	{
+		return;
+	}
+
+	copy( quantized.ids.begin(), quantized.ids.end(), transforms.ids.begin() );
+
+	codec.DequantizePositions( &quantized.x[0], &transforms.x[0], count );
+	codec.DequantizePositions( &quantized.y[0], &transforms.y[0], count );
+	codec.DequantizePositions( &quantized.z[0], &transforms.z[0], count );
+	codec.DequantizeRotations(
+		&quantized.rotations[0],
+		&transforms.qx[0], &transforms.qy[0], &transforms.qz[0], &transforms.qw[0], count
+	);
+}
+
+
+
+void AppendChanged( const TransformSnapshot &current, const TransformSnapshot *previous, QuantizedArrays &changed )
+{
+	auto base = previous ? previous->begin() : current.end();
+	auto end  = previous ? previous->end()   : current.end();
+
+	for( auto &node : current )
+	{
+		while( base != end && base->id < node.id )
+		{
+			++base;
+		}
+
+		bool same = base != end && base->id == node.id &&
+		            base->position[0] == node.position[0] &&
+		            base->position[1] == node.position[1] &&
+		            base->position[2] == node.position[2] &&
+		            base->rotation == node.rotation;
+
+		if( !same )
+		{
+			changed.Append( node );
+		}
+	}
+}
+
+
+
+string EncodeTransformBatch( uint64_t serverTime, const QuantizedArrays &transforms, size_t maxNodes )
+{
+	maxNodes = max<size_t>( 1, min<size_t>( maxNodes, TRANSFORM_BATCH_MAX_NODES ) );
+
+	auto count   = transforms.Size();
+	auto packets = ( count + maxNodes - 1 ) / maxNodes;
+
+	string message( packets * TRANSFORM_BATCH_HEADER_LENGTH + count * TRANSFORM_BATCH_NODE_LENGTH, '\0' );
+	BinaryWriter writer( message );
+
+	for( size_t first = 0; first < count; first += maxNodes )
+	{
+		auto nodes = min( maxNodes, count - first );
+
+		writer.WriteUint16( TRANSFORM_BATCH_HEADER_LENGTH + nodes * TRANSFORM_BATCH_NODE_LENGTH );
+		writer.WriteUint8( OBJECT_EVENT );
+		writer.WriteUint16( OBJECT_UPDATE_BATCH );
+		writer.WriteUint64( serverTime );
+		writer.WriteUint16( nodes );
+
+		writer.WriteUint32Array( &transforms.ids[first],       nodes );
+		writer.WriteUint32Array( &transforms.x[first],         nodes );
+		writer.WriteUint32Array( &transforms.y[first],         nodes );
+		writer.WriteUint32Array( &transforms.z[first],         nodes );
+		writer.WriteUint32Array( &transforms.rotations[first], nodes );
+	}
+
+	return message;
+}
+
+
+
+bool DecodeTransformBatch( BinaryReader &reader, uint64_t &serverTime, QuantizedArrays &transforms )
+{
+	serverTime = reader.ReadUint64();
+	auto count = reader.ReadUint16();
+
+	if( reader.Failed() || reader.Remaining() < size_t( count ) * TRANSFORM_BATCH_NODE_LENGTH )
+	{
+		return false;
+	}
+
+	transforms.Resize( count );
+	if( !count )
+	{
+		return true;
+	}
+
+	reader.ReadUint32Array( &transforms.ids[0],       count );
+	reader.ReadUint32Array( &transforms.x[0],         count );
+	reader.ReadUint32Array( &transforms.y[0],         count );
+	reader.ReadUint32Array( &transforms.z[0],         count );
+	reader.ReadUint32Array( &transforms.rotations[0], count );
+
+	return !reader.Failed();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "transformCodec.hh"
+#include "binaryStream.hh"
+#include "snapshot.hh"
+
+
+// Most nodes in a single OBJECT_UPDATE_BATCH packet, keeps
+// the packets within their 16 bit length
+#define TRANSFORM_BATCH_MAX_NODES 3000
+
+
+// Transforms of many nodes with an array per component, the way
+// TransformCodec quantizes them in bulk
+struct TransformArrays
+{
+	std::vector<uint32_t> ids;
+	std::vector<float>    x, y, z;
+	std::vector<float>    qx, qy, qz, qw;
+
+	size_t Size() const;
+	void   Resize( size_t count );
+	void   Clear();
+	void   Append( uint32_t id, const glm::vec3 &position, const glm::quat &rotation );
+};
+
+
+// Quantized counterpart of TransformArrays, as it goes on the wire
+struct QuantizedArrays
+{
+	std::vector<uint32_t> ids;
+	std::vector<uint32_t> x, y, z;
+	std::vector<uint32_t> rotations;
+
+	size_t Size() const;
+	void   Resize( size_t count );
+	void   Clear();
+	void   Append( const QuantizedTransform &transform );
+
+	QuantizedTransform At( size_t index ) const;
+};
+
+
+void QuantizeArrays( const TransformCodec &codec, const TransformArrays &transforms, QuantizedArrays &quantized );
+void DequantizeArrays( const TransformCodec &codec, const QuantizedArrays &quantized, TransformArrays &transforms );
+
+// The transforms of current that aren't the same in previous, both
+// sorted by id. Without previous all of them are appended.
+void AppendChanged( const TransformSnapshot &current, const TransformSnapshot *previous, QuantizedArrays &changed );
+
+
+
+// Encodes the transforms into OBJECT_UPDATE_BATCH packets of at most
+// maxNodes nodes each. After the server time and the count come the
+// ids, the three position components and the rotations each as an
+// array of their own, so both ends copy them in one go.
+std::string EncodeTransformBatch(
+	uint64_t               serverTime,
+	const QuantizedArrays &transforms,
+	size_t                 maxNodes = TRANSFORM_BATCH_MAX_NODES
+);
+
+// Decodes the body of one OBJECT_UPDATE_BATCH packet (the part after
+// the sub type), returns false if it was cut short
+bool DecodeTransformBatch( BinaryReader &reader, uint64_t &serverTime, QuantizedArrays &transforms );
@@ -0,0 +1,407 @@
+#include "transformCodec.hh"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+// SSE2 is there on every x86-64 and on the 32 bit builds that ask for it
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define TRANSFORM_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+
+// Range of the three smallest components of an unit quaternion
+#define QUAT_COMPONENT_LIMIT 0.707106781f
+
+
+namespace
+{
+	// The arrays are done in these steps, whatever is left over
+	// after the last full step goes one value at a time with the
+	// same math
+	const size_t batchStep = 4;
+
+
+	uint32_t QuantizeRotationLane( float x, float y, float z, float w, unsigned int componentBits, uint32_t maxComponent )
+	{
+		float length = sqrt( x * x + y * y + z * z + w * w );
+		if( length > 0.f )
+		{
+			x /= length;
+			y /= length;
+			z /= length;
+			w /= length;
+		}
+		else
+		{
+			x = y = z = 0.f;
+			w = 1.f;
+		}
+
+		// The largest is left out, the others in their order
+		uint32_t largest = 0;
+		float    best    = fabs( x ), value = x;
+		if( fabs( y ) > best ) { largest = 1; best = fabs( y ); value = y; }
+		if( fabs( z ) > best ) { largest = 2; best = fabs( z ); value = z; }
+		if( fabs( w ) > best ) { largest = 3; best = fabs( w ); value = w; }
+
+		float sign = value < 0.f ? -1.f : 1.f;
+		float components[3] = {
+			largest == 0 ? y : x,
+			largest <= 1 ? z : y,
+			largest <= 2 ? w : z
+		};
+
+		uint32_t packed = largest;
+		for( unsigned int i = 0; i < 3; i++ )
+		{
+			float normalized = ( components[i] * sign + QUAT_COMPONENT_LIMIT ) / ( 2.f * QUAT_COMPONENT_LIMIT );
+			normalized = max( 0.f, min( 1.f, normalized ) );
+
+			auto step = static_cast<uint32_t>( normalized * maxComponent + 0.5f );
+			packed |= step << ( 2 + i * componentBits );
+		}
+
+		return packed;
+	}
+
+
+	void DequantizeRotationLane( uint32_t value, unsigned int componentBits, uint32_t maxComponent, float &x, float &y, float &z, float &w )
+	{
+		uint32_t largest = value & 3;
+
+		float components[3];
+		float sum = 0.f;
+		for( unsigned int i = 0; i < 3; i++ )
+		{
+			float normalized = static_cast<float>( static_cast<int32_t>( ( value >> ( 2 + i * componentBits ) ) & maxComponent ) ) / maxComponent;
+			components[i] = normalized * 2.f * QUAT_COMPONENT_LIMIT - QUAT_COMPONENT_LIMIT;
+			sum += components[i] * components[i];
+		}
+
+		float big = sqrt( max( 0.f, 1.f - sum ) );
+
+		x = largest == 0 ? big : components[0];
+		y = largest == 0 ? components[0] : largest == 1 ? big : components[1];
+		z = largest <= 1 ? components[1] : largest == 2 ? big : components[2];
+		w = largest == 3 ? big : components[2];
+
+		float length = sqrt( x * x + y * y + z * z + w * w );
+		x /= length;
+		y /= length;
+		z /= length;
+		w /= length;
+	}
+
+
+#ifdef TRANSFORM_CODEC_SSE2
+	inline __m128 Select( __m128 mask, __m128 a, __m128 b )
+	{
+		return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+	}
+
+
+	inline __m128i Select( __m128i mask, __m128i a, __m128i b )
+	{
+		return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+	}
+
+
+	inline __m128 Abs( __m128 value )
+	{
+		return _mm_and_ps( value, _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) ) );
+	}
+#endif
+}
+
+
+TransformCodec::TransformCodec( float bound, float precision, unsigned int rotationBits )
+{
+	worldBound        = bound;
+	positionPrecision = precision;
+
+	// Without the asserts it's kept within them
+	assert( rotationBits >= TRANSFORM_MIN_ROTATION_BITS && rotationBits <= TRANSFORM_MAX_ROTATION_BITS );
+	componentBits = max( TRANSFORM_MIN_ROTATION_BITS, min( rotationBits, TRANSFORM_MAX_ROTATION_BITS ) );
+
+	// Enough bits to cover the whole -bound..bound range
+	auto steps   = static_cast<uint64_t>( ceil( 2.f * worldBound / positionPrecision ) );
+	assert( bound > 0.f && precision > 0.f && steps <= 0xffffffffu );
+
+	positionBits = 1;
+	while( positionBits < 32 && ( uint64_t( 1 ) << positionBits ) <= steps )
+	{
+		positionBits++;
+	}
+
+	maxPosition  = static_cast<uint32_t>( min<uint64_t>( steps, 0xffffffffu ) );
+	maxComponent = ( 1u << componentBits ) - 1;
+}
+
+
+
+unsigned int TransformCodec::PositionBits() const
+{
+	return positionBits;
+}
+
+
+
+unsigned int TransformCodec::RotationBits() const
+{
+	return 2 + 3 * componentBits;
+}
+
+
+
+float TransformCodec::PositionError() const
+{
+	return positionPrecision / 2.f;
+}
+
+
+
+float TransformCodec::RotationError() const
+{
+	return QUAT_COMPONENT_LIMIT / maxComponent;
+}
+
+
+
+uint32_t TransformCodec::QuantizePosition( float value ) const
+{
+	value = max( -worldBound, min( worldBound, value ) );
+	auto steps = floor( ( value + worldBound ) / positionPrecision + 0.5f );
+	return min( static_cast<uint32_t>( steps ), maxPosition );
+}
+
+
+
+float TransformCodec::DequantizePosition( uint32_t value ) const
+{
+	return value * positionPrecision - worldBound;
+}
+
+
+
+uint32_t TransformCodec::QuantizeRotation( const glm::quat &rotation ) const
+{
+	// The same lane the arrays are done with, so they give the same bits
+	return QuantizeRotationLane( rotation.x, rotation.y, rotation.z, rotation.w, componentBits, maxComponent );
+}
+
+
+
+glm::quat TransformCodec::DequantizeRotation( uint32_t value ) const
+{
+	float x, y, z, w;
+	DequantizeRotationLane( value, componentBits, maxComponent, x, y, z, w );
+	return glm::quat( w, x, y, z );
+}
+
+
+
+void TransformCodec::QuantizePositions( const float *values, uint32_t *quantized, size_t count ) const
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_CODEC_SSE2
+	// The clamped steps aren't negative, so truncating is the floor
+	auto bound     = _mm_set1_ps( worldBound );
+	auto lowest    = _mm_set1_ps( -worldBound );
+	auto precision = _mm_set1_ps( positionPrecision );
+	auto half      = _mm_set1_ps( 0.5f );
+	auto maxSteps  = _mm_set1_ps( static_cast<float>( maxPosition ) );
+
+	for( ; i + batchStep <= count; i += batchStep )
+	{
+		auto value = _mm_loadu_ps( values + i );
+		value = _mm_max_ps( lowest, _mm_min_ps( bound, value ) );
+
+		auto steps = _mm_add_ps( _mm_div_ps( _mm_add_ps( value, bound ), precision ), half );
+		steps = _mm_min_ps( steps, maxSteps );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( quantized + i ), _mm_cvttps_epi32( steps ) );
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		auto value = max( -worldBound, min( worldBound, values[i] ) );
+		auto steps = min( ( value + worldBound ) / positionPrecision + 0.5f, static_cast<float>( maxPosition ) );
+		quantized[i] = static_cast<uint32_t>( steps );
+	}
+}
+
+
+
+void TransformCodec::DequantizePositions( const uint32_t *quantized, float *values, size_t count ) const
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_CODEC_SSE2
+	// The steps fit in 31 bits, so they convert as signed
+	auto bound     = _mm_set1_ps( worldBound );
+	auto precision = _mm_set1_ps( positionPrecision );
+
+	for( ; i + batchStep <= count; i += batchStep )
+	{
+		auto steps = _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( quantized + i ) ) );
+		_mm_storeu_ps( values + i, _mm_sub_ps( _mm_mul_ps( steps, precision ), bound ) );
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		values[i] = static_cast<float>( static_cast<int32_t>( quantized[i] ) ) * positionPrecision - worldBound;
+	}
+}
+
+
+
+void TransformCodec::QuantizeRotations(
+	const float *x, const float *y, const float *z, const float *w,
+	uint32_t *quantized, size_t count ) const
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_CODEC_SSE2
+	auto zero     = _mm_setzero_ps();
+	auto one      = _mm_set1_ps( 1.f );
+	auto half     = _mm_set1_ps( 0.5f );
+	auto limit    = _mm_set1_ps( QUAT_COMPONENT_LIMIT );
+	auto range    = _mm_set1_ps( 2.f * QUAT_COMPONENT_LIMIT );
+	auto steps    = _mm_set1_ps( static_cast<float>( maxComponent ) );
+	auto signBit  = _mm_castsi128_ps( _mm_set1_epi32( static_cast<int>( 0x80000000u ) ) );
+
+	for( ; i + batchStep <= count; i += batchStep )
+	{
+		auto qx = _mm_loadu_ps( x + i );
+		auto qy = _mm_loadu_ps( y + i );
+		auto qz = _mm_loadu_ps( z + i );
+		auto qw = _mm_loadu_ps( w + i );
+
+		// Normalize, the zero length ones become the identity
+		auto length = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( qx, qx ), _mm_mul_ps( qy, qy ) ), _mm_mul_ps( qz, qz ) ), _mm_mul_ps( qw, qw ) ) );
+		auto valid = _mm_cmpgt_ps( length, zero );
+
+		qx = _mm_and_ps( valid, _mm_div_ps( qx, length ) );
+		qy = _mm_and_ps( valid, _mm_div_ps( qy, length ) );
+		qz = _mm_and_ps( valid, _mm_div_ps( qz, length ) );
+		qw = Select( valid, _mm_div_ps( qw, length ), one );
+
+		// Index and value of the largest, the first one wins the ties
+		auto best    = Abs( qx );
+		auto value   = qx;
+		auto largest = _mm_setzero_si128();
+
+		auto bigger = _mm_cmpgt_ps( Abs( qy ), best );
+		best    = Select( bigger, Abs( qy ), best );
+		value   = Select( bigger, qy, value );
+		largest = Select( _mm_castps_si128( bigger ), _mm_set1_epi32( 1 ), largest );
+
+		bigger  = _mm_cmpgt_ps( Abs( qz ), best );
+		best    = Select( bigger, Abs( qz ), best );
+		value   = Select( bigger, qz, value );
+		largest = Select( _mm_castps_si128( bigger ), _mm_set1_epi32( 2 ), largest );
+
+		bigger  = _mm_cmpgt_ps( Abs( qw ), best );
+		value   = Select( bigger, qw, value );
+		largest = Select( _mm_castps_si128( bigger ), _mm_set1_epi32( 3 ), largest );
+
+		// The three others in their order, flipped so the largest is positive
+		auto first  = _mm_castsi128_ps( _mm_cmpeq_epi32( largest, _mm_setzero_si128() ) );
+		auto second = _mm_castsi128_ps( _mm_cmplt_epi32( largest, _mm_set1_epi32( 2 ) ) );
+		auto third  = _mm_castsi128_ps( _mm_cmplt_epi32( largest, _mm_set1_epi32( 3 ) ) );
+		auto flip   = _mm_and_ps( _mm_cmplt_ps( value, zero ), signBit );
+
+		__m128 components[3] = {
+			Select( first,  qy, qx ),
+			Select( second, qz, qy ),
+			Select( third,  qw, qz )
+		};
+
+		auto packed = largest;
+		for( unsigned int c = 0; c < 3; c++ )
+		{
+			auto normalized = _mm_div_ps( _mm_add_ps( _mm_xor_ps( components[c], flip ), limit ), range );
+			normalized = _mm_max_ps( zero, _mm_min_ps( one, normalized ) );
+
+			auto step = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( normalized, steps ), half ) );
+			packed = _mm_or_si128( packed, _mm_sll_epi32( step, _mm_cvtsi32_si128( 2 + c * componentBits ) ) );
+		}
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( quantized + i ), packed );
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		quantized[i] = QuantizeRotationLane( x[i], y[i], z[i], w[i], componentBits, maxComponent );
+	}
+}
+
+
+
+void TransformCodec::DequantizeRotations(
+	const uint32_t *quantized,
+	float *x, float *y, float *z, float *w, size_t count ) const
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_CODEC_SSE2
+	auto zero   = _mm_setzero_ps();
+	auto one    = _mm_set1_ps( 1.f );
+	auto two    = _mm_set1_ps( 2.f );
+	auto limit  = _mm_set1_ps( QUAT_COMPONENT_LIMIT );
+	auto steps  = _mm_set1_ps( static_cast<float>( maxComponent ) );
+	auto mask   = _mm_set1_epi32( static_cast<int>( maxComponent ) );
+
+	for( ; i + batchStep <= count; i += batchStep )
+	{
+		auto packed  = _mm_loadu_si128( reinterpret_cast<const __m128i*>( quantized + i ) );
+		auto largest = _mm_and_si128( packed, _mm_set1_epi32( 3 ) );
+
+		__m128 components[3];
+		auto   sum = zero;
+		for( unsigned int c = 0; c < 3; c++ )
+		{
+			auto step       = _mm_and_si128( _mm_srl_epi32( packed, _mm_cvtsi32_si128( 2 + c * componentBits ) ), mask );
+			auto normalized = _mm_div_ps( _mm_cvtepi32_ps( step ), steps );
+
+			components[c] = _mm_sub_ps( _mm_mul_ps( _mm_mul_ps( normalized, two ), limit ), limit );
+			sum = _mm_add_ps( sum, _mm_mul_ps( components[c], components[c] ) );
+		}
+
+		auto big = _mm_sqrt_ps( _mm_max_ps( zero, _mm_sub_ps( one, sum ) ) );
+
+		auto isFirst  = _mm_castsi128_ps( _mm_cmpeq_epi32( largest, _mm_setzero_si128() ) );
+		auto isSecond = _mm_castsi128_ps( _mm_cmpeq_epi32( largest, _mm_set1_epi32( 1 ) ) );
+		auto isThird  = _mm_castsi128_ps( _mm_cmpeq_epi32( largest, _mm_set1_epi32( 2 ) ) );
+		auto isFourth = _mm_castsi128_ps( _mm_cmpeq_epi32( largest, _mm_set1_epi32( 3 ) ) );
+		auto upToTwo  = _mm_castsi128_ps( _mm_cmplt_epi32( largest, _mm_set1_epi32( 2 ) ) );
+
+		auto qx = Select( isFirst, big, components[0] );
+		auto qy = Select( isFirst, components[0], Select( isSecond, big, components[1] ) );
+		auto qz = Select( upToTwo, components[1], Select( isThird, big, components[2] ) );
+		auto qw = Select( isFourth, big, components[2] );
+
+		auto length = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( qx, qx ), _mm_mul_ps( qy, qy ) ), _mm_mul_ps( qz, qz ) ), _mm_mul_ps( qw, qw ) ) );
+
+		_mm_storeu_ps( x + i, _mm_div_ps( qx, length ) );
+		_mm_storeu_ps( y + i, _mm_div_ps( qy, length ) );
+		_mm_storeu_ps( z + i, _mm_div_ps( qz, length ) );
+		_mm_storeu_ps( w + i, _mm_div_ps( qw, length ) );
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		DequantizeRotationLane( quantized[i], componentBits, maxComponent, x[i], y[i], z[i], w[i] );
+	}
+}
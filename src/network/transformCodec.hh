@@ -0,0 +1,86 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+// Defaults shared by the server and the client, positions are
+// kept within +-TRANSFORM_WORLD_BOUND at TRANSFORM_POSITION_PRECISION
+// and each of the three smallest quaternion components gets
+// TRANSFORM_ROTATION_BITS bits. That's 21 bits per position component
+// and 32 per rotation, with the id and the mask a new node takes 132
+// bits in a snapshot, about 17 bytes.
+#define TRANSFORM_WORLD_BOUND        1024.f
+#define TRANSFORM_POSITION_PRECISION ( 1.f / 512.f )
+#define TRANSFORM_ROTATION_BITS      10
+
+// A rotation is packed in 32 bits, the index of the largest
+// component and the three others take at most 10 bits each
+#define TRANSFORM_MIN_ROTATION_BITS 1u
+#define TRANSFORM_MAX_ROTATION_BITS 10u
+
+
+// Quantizes positions to fixed point and rotations with the
+// smallest three encoding: the index of the largest component
+// followed by the three others, the largest is rebuilt from them.
+class TransformCodec
+{
+ public:
+	// The rotation bits have to be within TRANSFORM_MIN_ROTATION_BITS and
+	// TRANSFORM_MAX_ROTATION_BITS and the positions within 32 bits, it
+	// asserts on anything else instead of sending something else. A
+	// build without the asserts clamps the bits to the range.
+	TransformCodec(
+		float        worldBound        = TRANSFORM_WORLD_BOUND,
+		float        positionPrecision = TRANSFORM_POSITION_PRECISION,
+		unsigned int rotationBits      = TRANSFORM_ROTATION_BITS
+	);
+
+	// Bits needed for a single position component
+	unsigned int PositionBits() const;
+
+	// Bits needed for a whole rotation
+	unsigned int RotationBits() const;
+
+	// Largest error a position component or one of the three rotation
+	// components sent gets. The largest one is rebuilt from them, it
+	// and so the normalized quaternion may be up to three times off.
+	float PositionError() const;
+	float RotationError() const;
+
+	uint32_t QuantizePosition( float value ) const;
+	float    DequantizePosition( uint32_t value ) const;
+
+	uint32_t  QuantizeRotation( const glm::quat &rotation ) const;
+	glm::quat DequantizeRotation( uint32_t value ) const;
+
+	// The same for whole arrays, four values at a time with SSE2 where
+	// it's there. The rotations come as an array per component. The
+	// arrays give the same values as the one at a time functions, whether
+	// SSE2 is used or not, the rotations go through the same math.
+	void QuantizePositions( const float *values, uint32_t *quantized, size_t count ) const;
+	void DequantizePositions( const uint32_t *quantized, float *values, size_t count ) const;
+
+	void QuantizeRotations(
+		const float *x, const float *y, const float *z, const float *w,
+		uint32_t *quantized, size_t count
+	) const;
+	void DequantizeRotations(
+		const uint32_t *quantized,
+		float *x, float *y, float *z, float *w, size_t count
+	) const;
+
+
+ private:
+	float        worldBound;
+	float        positionPrecision;
+	unsigned int positionBits;
+	unsigned int componentBits;
+	uint32_t     maxPosition;
+	uint32_t     maxComponent;
+};
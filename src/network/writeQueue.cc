@@ -0,0 +1,202 @@
+#include "writeQueue.hh"
+#include "compression.hh"
+#include "packets.hh"
+
+using namespace std;
+
+
+WriteQueue::WriteQueue()
+	: coalescing( COALESCE_WRITES ),
+	  compression( false ),
+	  writes( 0 ),
+	  messages( 0 ),
+	  bytes( 0 ),
+	  queuedMicros( 0 ),
+	  uncompressed( 0 ),
+	  compressed( 0 ),
+	  backlog( 0 )
+{
+}
+
+
+
+void WriteQueue::SetCoalescing( bool coalesce )
+{
+	coalescing = coalesce;
+}
+
+
+
+bool WriteQueue::Coalescing() const
+{
+	return coalescing;
+}
+
+
+
+void WriteQueue::SetCompression( bool compress )
+{
+	compression = compress;
+}
+
+
+
+bool WriteQueue::Compression() const
+{
+	return compression;
+}
+
+
+
+float WriteQueue::CompressionRatio() const
+{
+	uint64_t input = uncompressed;
+	if( !input )
+	{
+		return 1.f;
+	}
+
+	return static_cast<float>( compressed ) / input;
+}
+
+
+
+bool WriteQueue::Push( const string &msg )
+{
+	string packed;
+	const string *message = &msg;
+
+	if( compression && msg.length() >= COMPRESSION_THRESHOLD )
+	{
+		packed  = CompressPackets( msg );
+		message = &packed;
+
+		uncompressed += msg.length();
+		compressed   += packed.length();
+	}
+
+	vector<string> parts;
+	if( message->length() > MAX_FRAME_PAYLOAD )
+	{
+		parts = SplitPackets( *message, MAX_FRAME_PAYLOAD );
+	}
+	else
+	{
+		parts.push_back( *message );
+	}
+
+	auto now = Clock::now();
+
+	lock_guard<mutex> queueLock( queueMutex );
+	for( auto &part : parts )
+	{
+		// Frames start with their length, the length included
+		frames.push_back( LengthPrefixed( part ) );
+		queuedAt.push_back( now );
+		backlog += frames.back().size();
+	}
+
+	return !coalescing;
+}
+
+
+
+bool WriteQueue::Flush( boost::asio::ip::tcp::socket &socket )
+{
+	lock_guard<mutex> flushLock( flushMutex );
+
+	auto flushing = Take();
+	if( flushing.empty() )
+	{
+		return true;
+	}
+
+	vector<boost::asio::const_buffer> buffers;
+	buffers.reserve( flushing.size() );
+
+	for( auto &frame : flushing )
+	{
+		buffers.push_back( boost::asio::buffer( frame ) );
+	}
+
+	boost::system::error_code ec;
+	auto length = boost::asio::write( socket, buffers, ec );
+
+	Written( flushing, length );
+	return !ec;
+}
+
+
+
+vector<string> WriteQueue::Take()
+{
+	vector<string>            taken;
+	vector<Clock::time_point> takenQueuedAt;
+	{
+		lock_guard<mutex> queueLock( queueMutex );
+		taken.swap( frames );
+		takenQueuedAt.swap( queuedAt );
+	}
+
+	auto now = Clock::now();
+	for( auto &queued : takenQueuedAt )
+	{
+		queuedMicros += chrono::duration_cast<chrono::microseconds>( now - queued ).count();
+	}
+
+	return taken;
+}
+
+
+
+void WriteQueue::Written( const vector<string> &taken, size_t length )
+{
+	size_t total = 0;
+	for( auto &frame : taken )
+	{
+		total += frame.size();
+	}
+
+	// What a failed write didn't get through is dropped all the same
+	writes++;
+	messages += taken.size();
+	bytes    += length;
+	backlog  -= total;
+}
+
+
+
+bool WriteQueue::Empty()
+{
+	lock_guard<mutex> queueLock( queueMutex );
+	return frames.empty();
+}
+
+
+
+size_t WriteQueue::Depth()
+{
+	lock_guard<mutex> queueLock( queueMutex );
+	return frames.size();
+}
+
+
+
+size_t WriteQueue::Backlog() const
+{
+	return static_cast<size_t>( backlog );
+}
+
+
+
+WriteStatistics WriteQueue::Statistics() const
+{
+	WriteStatistics statistics;
+	statistics.writes       = writes;
+	statistics.messages     = messages;
+	statistics.bytes        = bytes;
+	statistics.queuedMicros = queuedMicros;
+	statistics.uncompressed = uncompressed;
+	statistics.compressed   = compressed;
+	return statistics;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <climits>
+
+#include <boost/asio.hpp>
+
+
+// Are the writes gathered until an explicit flush by default
+#define COALESCE_WRITES true
+
+// Longest message that fits to a frame, the 16 bit length included
+#define MAX_FRAME_PAYLOAD ( USHRT_MAX - sizeof( uint16_t ) )
+
+
+// Totals of what a WriteQueue has sent
+struct WriteStatistics
+{
+	uint64_t writes;        // Gather writes done
+	uint64_t messages;      // Messages written
+	uint64_t bytes;         // Bytes written, frame headers included
+	uint64_t queuedMicros;  // Sum of the time the messages waited for a flush
+	uint64_t uncompressed;  // Bytes given to the compression
+	uint64_t compressed;    // What they compressed to
+};
+
+
+
+// Gathers the frames written to a connection so they go out with a
+// single gather write on Flush(), at the end of a tick or a batch of
+// events, instead of a write call per message. Without coalescing
+// every message is flushed right away. Flush() blocks, a connection
+// writing asynchronously takes the frames with Take() and tells when
+// the socket has taken them with Written().
+//
+// With compression on, messages of at least COMPRESSION_THRESHOLD bytes
+// are compressed before framing, see CompressPackets(). Messages too long
+// for a frame are split to several frames at packet boundaries.
+class WriteQueue
+{
+ public:
+	WriteQueue();
+
+	void SetCoalescing( bool coalesce );
+	bool Coalescing() const;
+
+	// Only for peers that said they can decompress
+	void SetCompression( bool compress );
+	bool Compression() const;
+
+	// Bytes sent per byte given, 1 without compression
+	float CompressionRatio() const;
+
+	// Frames the message and queues it, returns true when
+	// not coalescing and the message should be flushed now
+	bool Push( const std::string &msg );
+
+	// Writes all the queued frames, returns false if the write failed
+	bool Flush( boost::asio::ip::tcp::socket &socket );
+
+	// The queued frames for a write of its own, they count in the
+	// Backlog() until Written() is called with them and the bytes
+	// the write got through, all of them unless it failed
+	std::vector<std::string> Take();
+	void                     Written( const std::vector<std::string> &taken, size_t length );
+
+	bool Empty();
+
+	// Frames waiting for a flush
+	size_t Depth();
+
+	// Bytes queued or still being written, what the socket hasn't
+	// taken yet. Grows when the peer can't keep up with the writes.
+	size_t Backlog() const;
+
+	WriteStatistics Statistics() const;
+
+
+ private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<bool> coalescing;
+	std::atomic<bool> compression;
+
+	std::mutex                queueMutex;
+	std::vector<std::string>  frames;
+	std::vector<Clock::time_point> queuedAt;
+
+	// Keeps the blocking flushes in order
+	std::mutex flushMutex;
+
+	std::atomic<uint64_t> writes;
+	std::atomic<uint64_t> messages;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> queuedMicros;
+	std::atomic<uint64_t> uncompressed;
+	std::atomic<uint64_t> compressed;
+	std::atomic<uint64_t> backlog;
+};
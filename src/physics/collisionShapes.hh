@@ -33,3 +33,25 @@ struct CollisionShape
 	};
 };
 
+
+// Same type and the same size of that type
+inline bool operator==( const CollisionShape &a, const CollisionShape &b )
+{
+	if( a.type != b.type )
+	{
+		return false;
+	}
+
+	switch( a.type )
+	{
+		case COLLISION_SHAPE_SPHERE:
+			return a.sphere.size == b.sphere.size;
+
+		case COLLISION_SHAPE_AABB:
+			return a.aabb.x == b.aabb.x && a.aabb.y == b.aabb.y &&
+			       a.aabb.w == b.aabb.w && a.aabb.h == b.aabb.h;
+
+		default:
+			return true;
+	}
+}
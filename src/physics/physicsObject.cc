@@ -6,9 +6,6 @@
 using namespace std;
 
 
-#define SS_RW_BIN std::stringstream::in | std::stringstream::out | std::stringstream::binary
-
-
 PhysicsObject::PhysicsObject()
 {
 	type = PHYSICS_OBJECT_TYPE;
@@ -18,169 +15,44 @@ PhysicsObject::PhysicsObject()
 
 
 
-vector<string> PhysicsObject::GetDefaultFields()
+void PhysicsObject::SetVelocity( const glm::vec3 &newVelocity )
 {
-	auto fields = Entity::GetDefaultFields();
-	fields.push_back( "velocity" );
-	fields.push_back( "angVelocity" );
-	fields.push_back( "mass" );
-	fields.push_back( "collisionShape" );
-	return fields;
+	SetField( velocity, newVelocity, FIELD_VELOCITY );
 }
 
 
 
-bool PhysicsObject::SerializeField( std::string &fieldName, std::stringstream &stream )
+void PhysicsObject::SetAngularVelocity( const glm::quat &newAngularVelocity )
 {
-	stringstream  fieldStream( SS_RW_BIN );
-	unsigned char fieldDataLength = 0;
-	string        fieldDataString;
-
-	// Velocity
-	if( !fieldName.compare( "velocity" ) )
-	{
-		fieldStream << "velocity:";
-		SerializeFloat( fieldStream, velocity.x );
-		SerializeFloat( fieldStream, velocity.y );
-		SerializeFloat( fieldStream, velocity.z );
-	}
-
-	// Angular Velocity
-	else if( !fieldName.compare( "angVelocity" ) )
-	{
-		fieldStream << "angVelocity:";
-		SerializeFloat( fieldStream, angularVelocity.x );
-		SerializeFloat( fieldStream, angularVelocity.y );
-		SerializeFloat( fieldStream, angularVelocity.z );
-		SerializeFloat( fieldStream, angularVelocity.w );
-	}
-
-	// Mass
-	else if( !fieldName.compare( "mass" ) )
-	{
-		fieldStream << "mass:";
-		SerializeFloat( fieldStream, mass );
-	}
-
-	// Collision shape
-	else if( !fieldName.compare( "collisionShape" ) )
-	{
-		fieldStream << "collisionShape:";
-		SerializeUint8( fieldStream, collisionShape.type );
-		SerializeFloat( fieldStream, collisionShape.aabb.x );
-		SerializeFloat( fieldStream, collisionShape.aabb.y );
-		SerializeFloat( fieldStream, collisionShape.aabb.w );
-		SerializeFloat( fieldStream, collisionShape.aabb.h );
-	}
-
-	// No fitting field found?
-	else
-	{
-		return Entity::SerializeField( fieldName, stream );
-	}
-
-	// Handle the fieldStream to get the
-	// data as a string and the length of it.
-	fieldDataString = fieldStream.str();
-	fieldDataLength = fieldDataString.length();
-
-	// Do we have anything to serialize?
-	if( fieldDataLength <= 0 )
-	{
-		return false;
-	}
+	SetField( angularVelocity, newAngularVelocity, FIELD_ANGULAR_VELOCITY );
+}
 
-	// Write the header / amount of data:
-	SerializeUint8( stream, fieldDataLength );
 
-	// Write the data:
-	stream << fieldDataString;
 
-	return true;
+void PhysicsObject::SetMass( float newMass )
+{
+	SetField( mass, newMass, FIELD_MASS );
 }
 
 
 
-bool PhysicsObject::UnserializeField( std::string &fieldName, std::stringstream &stream )
+void PhysicsObject::SetCollisionShape( const CollisionShape &newCollisionShape )
 {
-	// Calculate the length
-	stream.seekp( 0, ios::end );
-	size_t streamLength = static_cast<size_t>( stream.tellp() );
-	stream.seekp( 0, ios::beg );
+	SetField( collisionShape, newCollisionShape, FIELD_COLLISION_SHAPE );
+}
 
-	// Velocity
-	if( !fieldName.compare( "velocity" ) )
-	{
-		if( streamLength != sizeof( velocity.x ) * 3 )
-		{
-			LOG_ERROR( ToString(
-				"UnserializeField failed for " << fieldName <<
-				", expected data to have length " << sizeof( velocity.x ) * 3 <<
-				" instead of " << streamLength << "!"
-			) );
-
-			return false;
-		}
-
-		velocity.x = UnserializeFloat( stream );
-		velocity.y = UnserializeFloat( stream );
-		velocity.z = UnserializeFloat( stream );
-	}
 
-	// Angular Velocity
-	else if( !fieldName.compare( "angVelocity" ) )
-	{
-		if( streamLength != sizeof( angularVelocity.x ) * 4 )
-		{
-			LOG_ERROR( ToString(
-				"UnserializeField failed for " << fieldName <<
-				", expected data to have length " << sizeof( angularVelocity.x ) * 3 <<
-				" instead of " << streamLength << "!"
-			) );
-
-			return false;
-		}
-
-		angularVelocity.x = UnserializeFloat( stream );
-		angularVelocity.y = UnserializeFloat( stream );
-		angularVelocity.z = UnserializeFloat( stream );
-		angularVelocity.w = UnserializeFloat( stream );
-	}
 
-	// Mass
-	else if( !fieldName.compare( "mass" ) )
-	{
-		mass = UnserializeFloat( stream );
-	}
+string PhysicsObject::Serialize( vector<FieldId> fields )
+{
+	return SerializeFields<PhysicsObjectFields>( *this, fields );
+}
 
-	// Collision Shape
-	else if( !fieldName.compare( "collisionShape" ) )
-	{
-		if( streamLength != sizeof( unsigned char ) + sizeof( collisionShape.aabb.x ) * 4 )
-		{
-			LOG_ERROR( ToString(
-				"UnserializeField failed for " << fieldName <<
-				", expected data to have length " << sizeof( collisionShape.aabb.x ) * 3 <<
-				" instead of " << streamLength << "!"
-			) );
-
-			return false;
-		}
-
-		collisionShape.type   = static_cast<CollisionShapeType>( UnserializeUint8( stream ) );
-		collisionShape.aabb.x = UnserializeFloat( stream );
-		collisionShape.aabb.y = UnserializeFloat( stream );
-		collisionShape.aabb.w = UnserializeFloat( stream );
-		collisionShape.aabb.h = UnserializeFloat( stream );
-	}
 
-	// No such field was found
-	else
-	{
-		return Entity::UnserializeField( fieldName, stream );
-	}
 
-	return true;
+bool PhysicsObject::Unserialize( string data )
+{
+	return UnserializeFields<PhysicsObjectFields>( *this, data );
 }
 
 
@@ -21,14 +21,56 @@ struct PhysicsObject : public Entity
 
 	PhysicsObject();
 
-	virtual std::vector<std::string> GetDefaultFields() override;
+	// Change the fields and mark them dirty
+	void SetVelocity( const glm::vec3 &newVelocity );
+	void SetAngularVelocity( const glm::quat &newAngularVelocity );
+	void SetMass( float newMass );
+	void SetCollisionShape( const CollisionShape &newCollisionShape );
 
-	virtual bool SerializeField( std::string&, std::stringstream& ) override;
-	virtual bool UnserializeField( std::string&, std::stringstream& ) override;
+	virtual std::string Serialize( std::vector<FieldId> fields={} ) override;
+	virtual bool Unserialize( std::string data ) override;
 };
 
 
 
+template<>
+struct FieldTraits<CollisionShape> : PlainFieldTraits<CollisionShape>
+{
+	static const size_t length = 1 + 4 * 4;
+
+	static void Write( BinaryWriter &writer, const CollisionShape &value )
+	{
+		writer.WriteUint8( value.type );
+		writer.WriteFloat( value.aabb.x );
+		writer.WriteFloat( value.aabb.y );
+		writer.WriteFloat( value.aabb.w );
+		writer.WriteFloat( value.aabb.h );
+	}
+
+	static CollisionShape Read( BinaryReader &reader )
+	{
+		CollisionShape value;
+		value.type   = static_cast<CollisionShapeType>( reader.ReadUint8() );
+		value.aabb.x = reader.ReadFloat();
+		value.aabb.y = reader.ReadFloat();
+		value.aabb.w = reader.ReadFloat();
+		value.aabb.h = reader.ReadFloat();
+		return value;
+	}
+};
+
+
+// The fields of a PhysicsObject on the wire
+typedef ExtendFields<
+	EntityFields,
+	WORLD_FIELD( PhysicsObject, velocity,        FIELD_VELOCITY ),
+	WORLD_FIELD( PhysicsObject, angularVelocity, FIELD_ANGULAR_VELOCITY ),
+	WORLD_FIELD( PhysicsObject, mass,            FIELD_MASS ),
+	WORLD_FIELD( PhysicsObject, collisionShape,  FIELD_COLLISION_SHAPE )
+>::type PhysicsObjectFields;
+
+
+
 // Collision checking
 bool Collides( const PhysicsObject&, const PhysicsObject& );
 
@@ -170,20 +170,22 @@ void EventHandlerGenerator()
 
 
 
-// Task to step time after time the I/O services,
-// generates itself again at the end
-void IoStepTask()
+// Runs the I/O service handlers until it's stopped, any number
+// of these may run at once as the clients have their strands
+void IoLoop()
 {
-	// Run one step
-	ioService.run_one();
-
-	// Generate the next task
-	Task *nextStep = new Task(
-		std::string( "IoStepTask" ),
-		IoStepTask
-	);
-
-	taskQueue.AddTask( nextStep );
+	for( ;; )
+	{
+		try
+		{
+			ioService.run();
+			break;
+		}
+		catch( std::exception &e )
+		{
+			LOG_ERROR( "I/O thread caught an exception: " << e.what() );
+		}
+	}
 }
 
 
@@ -299,11 +301,55 @@ int main( int argc, char **argv )
 	signal( SIGTERM, SignalHandler );
 	signal( SIGINT,  SignalHandler );
 
+	unsigned int ioThreadCount = max( 1u, hardwareThreads / 2 );
+
 
 	// Pass the event queue to the server
 	auto gameState = std::make_shared<ServerGameState>();
 	gameState->server.SetEventQueue( &eventQueue );
 
+	for( int i = 1; i < argc; i++ )
+	{
+		string arg = argv[i];
+
+		// Write every message right away instead of once per tick
+		if( arg == "--no-coalesce" )
+		{
+			gameState->server.SetCoalescing( false );
+		}
+
+		// Send uncompressed even to the clients that could decompress
+		else if( arg == "--no-compression" )
+		{
+			gameState->compressionEnabled = false;
+		}
+
+		// Bytes per second each client gets at most, the budget
+		// follows the client's link below that
+		else if( arg == "--client-bandwidth" && i + 1 < argc )
+		{
+			gameState->clientBandwidth = strtoul( argv[++i], nullptr, 10 );
+		}
+
+		// Populate the world for load testing
+		else if( arg == "--nodes" && i + 1 < argc )
+		{
+			gameState->testNodeCount = strtoul( argv[++i], nullptr, 10 );
+		}
+
+		// Listen elsewhere, behind a proxy for instance
+		else if( arg == "--port" && i + 1 < argc )
+		{
+			gameState->port = static_cast<short>( strtoul( argv[++i], nullptr, 10 ) );
+		}
+
+		// Threads running the network I/O
+		else if( arg == "--io-threads" && i + 1 < argc )
+		{
+			ioThreadCount = max( 1ul, strtoul( argv[++i], nullptr, 10 ) );
+		}
+	}
+
 	// Create object manager
 	objectManager = make_shared<ServerObjectManager>();
 	gameState->objectManager = objectManager;
@@ -338,14 +384,15 @@ int main( int argc, char **argv )
 	}
 
 
-	// Create a task to run the network io services
-	LOG( "Creating the network I/O tasker." );
+	// Create the threads to run the network I/O services
+	LOG( "Creating " << ioThreadCount << " network I/O threads." );
 
-	Task *ioTasker = new Task(
-		std::string( "IoStepTask" ),
-		IoStepTask
-	);
-	taskQueue.AddTask( ioTasker );
+	boost::asio::io_service::work ioWork( ioService );
+	vector<thread> ioThreads;
+	for( unsigned int i = 0; i < ioThreadCount; i++ )
+	{
+		ioThreads.emplace_back( IoLoop );
+	}
 
 
 	// Main loop
@@ -365,6 +412,12 @@ int main( int argc, char **argv )
 
 	LOG( "Main loop ended!" );
 
+	ioService.stop();
+	for( auto &ioThread : ioThreads )
+	{
+		ioThread.join();
+	}
+
 	Quit( 0, true );
 	gameState->Destroy();
 
@@ -0,0 +1,54 @@
+#include "relevance.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+vector<unsigned int> RelevantNodes(
+	const SpatialGrid &grid,
+	const ServerObjectManager &objects,
+	const glm::vec3 &viewpoint,
+	float radius,
+	const vector<unsigned int> &held
+)
+{
+	// One query out to the hysteresis, the hits are told apart by distance
+	vector<GridHit> hits;
+	grid.Query( viewpoint, radius * VIEW_RADIUS_HYSTERESIS, hits );
+
+	// Nodes just outside the radius stay if the client already has them
+	vector<unsigned int> ids;
+	ids.reserve( hits.size() );
+	for( auto &hit : hits )
+	{
+		if( hit.distanceSquared <= radius * radius || binary_search( held.begin(), held.end(), hit.id ) )
+		{
+			ids.push_back( hit.id );
+		}
+	}
+
+	sort( ids.begin(), ids.end() );
+
+	// The ancestors are needed for the nodes to be placed right. The walk
+	// up stops at one that's relevant itself, it brings its own ancestors.
+	auto found = ids.size();
+	for( size_t i = 0; i < found; i++ )
+	{
+		auto parent = objects.Parent( ids[i] );
+		while( parent != 0 && !binary_search( ids.begin(), ids.begin() + found, parent ) )
+		{
+			ids.push_back( parent );
+			parent = objects.Parent( parent );
+		}
+	}
+
+	// Siblings outside may have brought the same ancestors
+	if( ids.size() > found )
+	{
+		sort( ids.begin(), ids.end() );
+		ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+	}
+
+	return ids;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "spatialGrid.hh"
+#include "../managers/serverObjectManager.hh"
+
+
+// Nodes that are this much further than the view radius are dropped
+// from a client's view, so nodes on the edge don't keep flickering.
+#define VIEW_RADIUS_HYSTERESIS 1.1f
+
+
+// Sorted ids of the nodes a client at the viewpoint should have: the
+// ones within the radius, the held ones a bit past it and the ancestors
+// of all of those. held is what the client was given last, sorted.
+std::vector<unsigned int> RelevantNodes(
+	const SpatialGrid &grid,
+	const ServerObjectManager &objects,
+	const glm::vec3 &viewpoint,
+	float radius,
+	const std::vector<unsigned int> &held
+);
@@ -1,6 +1,6 @@
 #include "serverGameState.hh"
 
-#include "../network/serializable.hh"
+#include "../network/binaryStream.hh"
 #include "../world/objectEvents.hh"
 #include "../task.hh"
 #include "../logger.hh"
@@ -10,6 +10,11 @@
 
 #include <thread>
 #include <chrono>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
 #include <boost/asio.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
@@ -32,6 +37,16 @@ extern std::shared_ptr<ShaderProgramManager> shaderProgramManager;
 
 
 ServerGameState::ServerGameState()
+	: tickInterval( SERVER_TICK_INTERVAL ),
+	  clientBandwidth( CLIENT_MAX_BYTES_PER_SECOND ),
+	  compressionEnabled( true ),
+	  testNodeCount( 0 ),
+	  port( 22001 ),
+	  lastWriteStatistics(),
+	  lastTotals(),
+	  lastAccepted( 0 ),
+	  lastStatisticsLog( chrono::steady_clock::now() ),
+	  ticksSinceStatistics( 0 )
 {
 }
 
@@ -69,32 +84,51 @@ void ServerGameState::Create()
 
 	// Create the root node
 	auto rootNode = std::make_shared<WorldNode>();
-	objectManager->worldNodes.push_back( rootNode );
+	objectManager->AddNode( rootNode );
 
 
 	// Create a test entity
 	auto cubeEntity = make_shared<PhysicsObject>();
-	cubeEntity->parent = rootNode->id;
-	cubeEntity->material.color = { 1.0, 0.0, 1.0, 1.0 };
+	cubeEntity->SetMaterial( { { 1.0, 0.0, 1.0, 1.0 } } );
 	cubeEntity->position = { 1.0, 0.0, 0.0 };
-	cubeEntity->scale = { 1.f, 0.5f, 1.f };
+	cubeEntity->SetScale( { 1.f, 0.5f, 1.f } );
 	cubeEntity->UpdateModelMatrix();
 
 	objectManager->entities.push_back( cubeEntity );
-	objectManager->worldNodes.push_back( cubeEntity );
-	rootNode->children.push_back( cubeEntity );
+	objectManager->AddNode( cubeEntity );
+	objectManager->AddChild( rootNode, cubeEntity );
 
 	// Create other one
 	auto cubeEntity2 = make_shared<PhysicsObject>();
-	cubeEntity2->parent = rootNode->id;
-	cubeEntity2->material.color = { 0.0, 1.0, 1.0, 1.0 };
+	cubeEntity2->SetMaterial( { { 0.0, 1.0, 1.0, 1.0 } } );
 	cubeEntity2->position = { 2.2, 0.0, 0.0 };
-	cubeEntity2->scale = { 1.0, 1.0, 1.0 };
+	cubeEntity2->SetScale( { 1.0, 1.0, 1.0 } );
 	cubeEntity2->UpdateModelMatrix();
 
 	objectManager->entities.push_back( cubeEntity2 );
-	objectManager->worldNodes.push_back( cubeEntity2 );
-	cubeEntity->children.push_back( cubeEntity2 );
+	objectManager->AddNode( cubeEntity2 );
+	objectManager->AddChild( cubeEntity, cubeEntity2 );
+
+
+	// Scatter the test nodes within the default view of a client at the origin
+	mt19937 generator( 1 );
+	uniform_real_distribution<float> coordinate( -DEFAULT_VIEW_RADIUS / 2.f, DEFAULT_VIEW_RADIUS / 2.f );
+
+	for( size_t i = 0; i < testNodeCount; i++ )
+	{
+		auto testEntity = make_shared<Entity>();
+		testEntity->SetMaterial( { { 0.5, 0.5, 0.5, 1.0 } } );
+		testEntity->position = { coordinate( generator ), coordinate( generator ), coordinate( generator ) };
+		testEntity->UpdateModelMatrix();
+
+		objectManager->AddNode( testEntity );
+		objectManager->AddChild( rootNode, testEntity );
+	}
+
+	if( testNodeCount )
+	{
+		LOG( "Created " << testNodeCount << " test nodes." );
+	}
 }
 
 
@@ -125,12 +159,28 @@ void ServerGameState::Tick( std::chrono::milliseconds deltaTime )
 	}
 
 
-	// Stream to hold update message
-	std::stringstream messageStream(
-		stringstream::in |
-		stringstream::out |
-		stringstream::binary
-	);
+	// The transforms are stamped with the time of the tick for the
+	// clients to tell the speeds regardless of the delays on the way
+	auto tickTime = TelemetryClock();
+
+	// The other fields of the nodes that changed on this tick,
+	// serialized for the updates and sorted by id
+	vector<pair<unsigned int, string>> fieldUpdates;
+
+	// The clients as they were at the start of the tick, the joins
+	// and parts meanwhile don't wait for the tick to end
+	auto clients = server.clients.All();
+
+	// What gets sent to each client on this tick
+	struct ClientUpdate
+	{
+		std::shared_ptr<Client> client;
+		string                  objectMessage;
+		string                  snapshotMessage;
+		uint32_t                sequence;
+		bool                    reliableTransforms;
+	};
+	vector<ClientUpdate> updates;
 
 
 	// Enter critical section
@@ -145,102 +195,516 @@ void ServerGameState::Tick( std::chrono::milliseconds deltaTime )
 		objectManager->entities[1]->rotation.Update( objectManager->entities[1]->rotation.Get() * glm::inverse( rot*rot ) );
 	}
 
-	// Calculate the model matrices for all entities
-	// and generate an update event for each of them
-	// to be broadcasted to the clients.
-	for( auto& node : objectManager->worldNodes )
+	// Calculate the model matrices of the nodes that
+	// moved and gather their transforms to be
+	// broadcasted to the clients.
+	objectManager->UpdateTransforms();
+
+	// The destroyed nodes leave the grid, the clients that had them
+	// get them destroyed as they're no longer relevant
+	auto removed = objectManager->TakeRemovedNodes();
+	for( auto id : removed )
+	{
+		spatialGrid.Remove( id );
+	}
+
+	// Only the nodes whose matrices changed have moved in the grid,
+	// what stands still costs nothing here
+	for( auto node : objectManager->MovedNodes() )
+	{
+		auto &worldPosition = node->modelMatrix[3];
+		spatialGrid.Update( node->id, glm::vec3( worldPosition.x, worldPosition.y, worldPosition.z ) );
+	}
+
+	// Only what changed since the last tick gets quantized and
+	// serialized, the transforms go in the snapshots and the rest
+	// of the fields in updates over the reliable channel. Nodes
+	// that were added or removed have all of the transforms redone.
+	const FieldMask transformFields = FieldBit( FIELD_POSITION ) | FieldBit( FIELD_ROTATION );
+
+	bool rebuild = !removed.empty() || transforms.size() != objectManager->worldNodes.size();
+
+	changedTransforms.Clear();
+	changedSlots.clear();
+
+	// Only the nodes that marked themselves dirty are gone through
+	for( auto id : objectManager->TakeDirtyNodes() )
+	{
+		auto node = objectManager->Find( id );
+		if( !node )
+		{
+			continue;
+		}
+
+		auto dirty = node->TakeDirtyFields();
+
+		if( ( dirty & transformFields ) && !rebuild )
+		{
+			auto transform = lower_bound( transforms.begin(), transforms.end(), node->id,
+				[]( const QuantizedTransform &transform, unsigned int id )
+				{
+					return transform.id < id;
+				}
+			);
+
+			if( transform != transforms.end() && transform->id == node->id )
+			{
+				changedTransforms.Append( node->id, node->position.Get(), node->rotation.Get() );
+				changedSlots.push_back( transform - transforms.begin() );
+			}
+			else
+			{
+				rebuild = true;
+			}
+		}
+
+		if( dirty & ~transformFields )
+		{
+			fieldUpdates.push_back( { node->id, node->Serialize( FieldIds( dirty & ~transformFields ) ) } );
+		}
+	}
+
+	// The changed transforms are quantized in one go
+	if( rebuild )
 	{
-		if( node->parent == 0 )
+		changedTransforms.Clear();
+		for( auto& node : objectManager->worldNodes )
 		{
-			node->UpdateModelMatrix();
+			changedTransforms.Append( node->id, node->position.Get(), node->rotation.Get() );
 		}
+	}
+
+	QuantizeArrays( transformCodec, changedTransforms, quantizedTransforms );
 
-		// Broadcast position and rotation of each node to clients
-		std::stringstream stream(
-			stringstream::in |
-			stringstream::out |
-			stringstream::binary
+	if( rebuild )
+	{
+		transforms.resize( quantizedTransforms.Size() );
+		for( size_t i = 0; i < transforms.size(); i++ )
+		{
+			transforms[i] = quantizedTransforms.At( i );
+		}
+
+		sort( transforms.begin(), transforms.end(),
+			[]( const QuantizedTransform &a, const QuantizedTransform &b )
+			{
+				return a.id < b.id;
+			}
 		);
+	}
+	else
+	{
+		for( size_t i = 0; i < changedSlots.size(); i++ )
+		{
+			transforms[changedSlots[i]] = quantizedTransforms.At( i );
+		}
+	}
 
-		// Create packet body
-		SerializeUint8( stream, (uint8_t)OBJECT_EVENT );
-		SerializeUint16( stream, (uint16_t)OBJECT_UPDATE );
-		SerializeUint32( stream, (uint32_t)node->id );
-		stream << node->Serialize( { "position", "rotation" } );
+	sort( fieldUpdates.begin(), fieldUpdates.end() );
 
-		// Add packet length
-		auto packet = stream.str();
-		SerializeUint16( messageStream, packet.size()+2 );
-		messageStream << packet;
+	// Find out which nodes entered and left the area of each client
+	// and fill its bandwidth budget with the most important of the
+	// creations and transform changes.
+	{
+		lock_guard<mutex> clientViewsLock( clientViewsMutex );
+		for( auto &client : *clients )
+		{
+			auto viewIt = clientViews.find( client->m_clientId );
+			if( viewIt == clientViews.end() )
+			{
+				continue;
+			}
+
+			auto &view = viewIt->second;
+
+			// The round trip time grows and the stream backs up when
+			// the client's link can't take what it's sent
+			LinkState link;
+			link.hasAck        = client->m_hasAck;
+			link.ackedSequence = client->m_ackedSequence;
+			link.rtt           = client->m_telemetry.Statistics().lastRtt;
+			link.backlog       = client->m_writeQueue.Backlog();
+
+			view.scheduler.Adapt( link, deltaTime );
+			auto available = view.scheduler.Refill( deltaTime );
+
+			// The reliable stream may get compressed before it's sent
+			auto compression = client->m_writeQueue.CompressionRatio();
+
+			auto  relevant = RelevantNodes( spatialGrid, *objectManager, view.viewpoint, view.radius, view.relevant );
+			auto &previous = view.relevant;
+
+			vector<unsigned int> entered, left;
+			set_difference(
+				relevant.begin(), relevant.end(),
+				previous.begin(), previous.end(),
+				back_inserter( entered )
+			);
+			set_difference(
+				previous.begin(), previous.end(),
+				relevant.begin(), relevant.end(),
+				back_inserter( left )
+			);
+
+			for( auto id : left )
+			{
+				view.scheduler.Forget( id );
+			}
+
+			relevant.clear();
+			set_difference(
+				previous.begin(), previous.end(),
+				left.begin(), left.end(),
+				back_inserter( relevant )
+			);
+
+			ClientUpdate update;
+			update.client = client;
+
+			// The events are written sorted by id where they can be,
+			// the packed ones then take the least
+			ObjectMessageWriter objects( view.packedObjects );
+			for( auto id : left )
+			{
+				objects.Destroy( id );
+			}
+
+			// The changed fields of the nodes the client keeps, the
+			// ones created on this tick are sent as they are now
+			auto updateIt = fieldUpdates.begin();
+			for( auto id : relevant )
+			{
+				while( updateIt != fieldUpdates.end() && updateIt->first < id )
+				{
+					++updateIt;
+				}
+
+				if( updateIt != fieldUpdates.end() && updateIt->first == id )
+				{
+					objects.Update( id, updateIt->second );
+				}
+			}
+
+			// Create the nearest nodes first, the rest wait for later ticks
+			vector<unsigned int> created;
+
+			auto updateCost = static_cast<long>( objects.Length() * compression );
+			CreateMessage(
+				CreationOrder( entered, view.viewpoint ),
+				static_cast<long>( ( available - updateCost ) / compression ),
+				created,
+				objects
+			);
+
+			update.objectMessage = objects.Finish();
+
+			auto objectCost = static_cast<long>( update.objectMessage.size() * compression );
+
+			sort( created.begin(), created.end() );
+			previous.clear();
+			merge(
+				relevant.begin(), relevant.end(),
+				created.begin(), created.end(),
+				back_inserter( previous )
+			);
+
+			// Transforms of the nodes in the area
+			TransformSnapshot current;
+			current.reserve( previous.size() );
+
+			for( auto id : previous )
+			{
+				auto node = lower_bound( transforms.begin(), transforms.end(), id,
+					[]( const QuantizedTransform &transform, unsigned int id )
+					{
+						return transform.id < id;
+					}
+				);
+
+				if( node != transforms.end() && node->id == id )
+				{
+					current.push_back( *node );
+				}
+			}
+
+			update.sequence = client->NextSequence();
+
+			// Until the client's datagrams get through the transforms go
+			// over the stream, where everything arrives, as the batch of
+			// the ones that changed since the last tick. The datagrams
+			// carry the changes since the newest snapshot the client has
+			// acknowledged, everything since that gets sent again, so the
+			// schedule is made against the same snapshot to count the
+			// bytes they'll take.
+			update.reliableTransforms = !server.UdpBound( client );
+
+			uint32_t             baselineSequence = 0;
+			TransformSnapshotPtr baseline;
+			if( update.reliableTransforms )
+			{
+				baseline = client->m_snapshots.Find( update.sequence - 1 );
+			}
+			else if( client->m_hasAck )
+			{
+				baselineSequence = client->m_ackedSequence;
+				baseline         = client->m_snapshots.Find( baselineSequence );
+			}
+
+			auto clientSnapshot = view.scheduler.Schedule(
+				transformCodec,
+				current,
+				baseline.get(),
+				[this, &view]( unsigned int id )
+				{
+					return glm::length( spatialGrid.Position( id ) - view.viewpoint );
+				},
+				view.radius,
+				available - objectCost
+			);
+
+			if( update.reliableTransforms )
+			{
+				QuantizedArrays changed;
+				AppendChanged( *clientSnapshot, baseline.get(), changed );
+				update.snapshotMessage = EncodeTransformBatch( tickTime, changed );
+			}
+			else
+			{
+				update.snapshotMessage = EncodeSnapshot(
+					transformCodec,
+					update.sequence,
+					tickTime,
+					*clientSnapshot,
+					baselineSequence,
+					baseline.get(),
+					MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH
+				);
+
+				// The acknowledgements of the snapshots show what gets through
+				view.scheduler.Sent( update.sequence, update.snapshotMessage.size() );
+			}
+
+			client->m_snapshots.Store( update.sequence, clientSnapshot );
+			view.scheduler.Spend( objectCost + update.snapshotMessage.size() );
+
+			updates.push_back( update );
+		}
 	}
 
 	// Leave critical section
 	objectManager->managerMutex.unlock();
 
 
-	// Send the update message to every client
-	auto updateMessage = messageStream.str();
-
+	// The creations and destructions go over the reliable channel
+	// and the transforms over the unreliable one as only the newest
+	// of them matter.
+	for( auto &update : updates )
 	{
-		lock_guard<mutex> clientListLock( server.clientListMutex );
-		for( auto &client : server.clientList )
+		if( !update.objectMessage.empty() )
+		{
+			update.client->Write( update.objectMessage );
+		}
+
+		if( !update.reliableTransforms )
+		{
+			server.WriteUnreliable( update.client, update.snapshotMessage, update.sequence );
+		}
+		else if( !update.snapshotMessage.empty() )
 		{
-			client.second->Write( updateMessage );
+			update.client->Write( update.snapshotMessage );
 		}
 	}
 
-	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	// Everything written on this tick goes out with one write per client
+	server.Flush();
+	LogWriteStatistics();
+
+	std::this_thread::sleep_for( tickInterval );
+}
+
+
+
+void ServerGameState::LogWriteStatistics()
+{
+	ticksSinceStatistics++;
+
+	auto now = chrono::steady_clock::now();
+	if( now - lastStatisticsLog < chrono::seconds( WRITE_STATISTICS_INTERVAL ) )
+	{
+		return;
+	}
+
+	auto statistics = server.GetWriteStatistics();
+	auto writes     = statistics.writes   - min( statistics.writes,   lastWriteStatistics.writes );
+	auto messages   = statistics.messages - min( statistics.messages, lastWriteStatistics.messages );
+	auto queued     = statistics.queuedMicros - min( statistics.queuedMicros, lastWriteStatistics.queuedMicros );
+	auto input      = statistics.uncompressed - min( statistics.uncompressed, lastWriteStatistics.uncompressed );
+	auto output     = statistics.compressed   - min( statistics.compressed,   lastWriteStatistics.compressed );
+
+	if( messages > 0 )
+	{
+		LOG( "Writes per tick " << float( writes ) / ticksSinceStatistics
+		     << ", messages per write " << float( messages ) / max<uint64_t>( writes, 1 )
+		     << ", mean queue delay " << queued / 1000.f / messages << " ms" );
+	}
+
+	if( input > 0 )
+	{
+		LOG( "Compressed " << input / 1024 << " kB to " << output / 1024
+		     << " kB, ratio " << float( input ) / output );
+	}
+
+	// What the I/O threads got through
+	auto totals    = server.GetTotals();
+	auto accepted  = server.AcceptedCount();
+	auto seconds   = chrono::duration<float>( now - lastStatisticsLog ).count();
+	auto framesIn  = totals.packetsIn - min( totals.packetsIn, lastTotals.packetsIn );
+	auto bytesIn   = totals.bytesIn   - min( totals.bytesIn,   lastTotals.bytesIn );
+
+	if( framesIn > 0 || accepted > lastAccepted )
+	{
+		LOG( "Accepted " << ( accepted - lastAccepted ) / seconds << " clients/s, received "
+		     << framesIn / seconds << " packets/s, " << bytesIn / 1024.f / seconds << " kB/s" );
+	}
+
+	if( messages > 0 )
+	{
+		LOG( "Connections:" << endl << server.StatisticsDump() );
+	}
+
+	lastTotals           = totals;
+	lastAccepted         = accepted;
+	lastWriteStatistics  = statistics;
+	lastStatisticsLog    = now;
+	ticksSinceStatistics = 0;
 }
 
 
 
 void ServerGameState::SendScene( unsigned int clientId )
 {
+	// The nodes are sent on the following ticks as they
+	// enter the client's area, until the client tells
+	// its viewpoint it's looking from the origin.
+	lock_guard<mutex> clientViewsLock( clientViewsMutex );
+
+	auto &view     = clientViews[clientId];
+	view.viewpoint = glm::vec3( 0.f );
+	view.radius    = DEFAULT_VIEW_RADIUS;
+	view.relevant.clear();
+	view.scheduler.SetMaxBandwidth( clientBandwidth );
+}
+
+
+
+void ServerGameState::HandleViewpoint( unsigned int clientId, const ViewpointEvent &e )
+{
+	glm::vec3 viewpoint( e.x, e.y, e.z );
+	float     radius = e.radius;
+
+	if( !isfinite( viewpoint.x ) || !isfinite( viewpoint.y ) ||
+	    !isfinite( viewpoint.z ) || !isfinite( radius ) )
+	{
+		LOG_ERROR( "Client " << clientId << " sent an invalid viewpoint!" );
+		return;
+	}
+
+	lock_guard<mutex> clientViewsLock( clientViewsMutex );
+
+	auto view = clientViews.find( clientId );
+	if( view == clientViews.end() )
+	{
+		return;
+	}
+
+	view->second.viewpoint = viewpoint;
+	view->second.radius    = min( max( radius, 0.f ), MAX_VIEW_RADIUS );
+}
+
+
+
+void ServerGameState::HandleHello( unsigned int clientId, const HelloEvent &e )
+{
+	bool compress = compressionEnabled && ( e.capabilities & CAPABILITY_COMPRESSION );
+
 	auto client = server.GetClient( clientId );
 	if( !client )
 	{
 		return;
 	}
 
-	if( !objectManager.get() )
+	client->m_writeQueue.SetCompression( compress );
+	LOG( "Client " << clientId << ( compress ? " gets" : " doesn't get" ) << " compressed messages." );
+
+	bool packed = e.capabilities & CAPABILITY_PACKED_OBJECTS;
+
+	lock_guard<mutex> clientViewsLock( clientViewsMutex );
+
+	auto view = clientViews.find( clientId );
+	if( view != clientViews.end() )
 	{
-		return;
+		view->second.packedObjects = packed;
+		LOG( "Client " << clientId << ( packed ? " gets" : " doesn't get" ) << " packed object events." );
 	}
+}
 
-	lock_guard<mutex> lock{ objectManager->managerMutex };
 
-	std::stringstream messageStream(
-		stringstream::in |
-		stringstream::out |
-		stringstream::binary
-	);
 
-	for( auto& node : objectManager->worldNodes )
+vector<unsigned int> ServerGameState::CreationOrder( const vector<unsigned int> &ids, const glm::vec3 &viewpoint )
+{
+	vector<pair<float, unsigned int>> byDistance;
+	byDistance.reserve( ids.size() );
+	for( auto id : ids )
 	{
-		std::stringstream stream(
-			stringstream::in |
-			stringstream::out |
-			stringstream::binary
-		);
+		byDistance.push_back( { glm::length( spatialGrid.Position( id ) - viewpoint ), id } );
+	}
+	sort( byDistance.begin(), byDistance.end() );
+
+	// Put the ancestors that are being created too in front of the nodes
+	unordered_set<unsigned int> pending( ids.begin(), ids.end() );
+	vector<unsigned int> ordered, ancestors;
+	ordered.reserve( ids.size() );
+
+	for( auto &entry : byDistance )
+	{
+		auto id = entry.second;
+		while( id != 0 && pending.erase( id ) )
+		{
+			ancestors.push_back( id );
 
-		SerializeUint8( stream, (uint8_t)OBJECT_EVENT );	// Event type
-		SerializeUint16( stream, (uint16_t)OBJECT_CREATE ); // Event sub type
+			auto node = objectManager->Find( id );
+			id = node ? node->parent : 0;
+		}
+
+		ordered.insert( ordered.end(), ancestors.rbegin(), ancestors.rend() );
+		ancestors.clear();
+	}
+
+	return ordered;
+}
+
+
+
+void ServerGameState::CreateMessage(
+	const vector<unsigned int> &ids,
+	long                        byteLimit,
+	vector<unsigned int>       &created,
+	ObjectMessageWriter        &message )
+{
+	auto start = message.Length();
+
+	for( auto id : ids )
+	{
+		auto node = objectManager->Find( id );
+		if( !node )
+		{
+			continue;
+		}
 
 		switch( node->type )
 		{
 			case WORLD_NODE_OBJECT_TYPE:
-				SerializeUint8( stream, WORLD_NODE_OBJECT_TYPE );
-				stream << node->Serialize(); // Serialize all
-				break;
-
 			case ENTITY_OBJECT_TYPE:
-				SerializeUint8( stream, ENTITY_OBJECT_TYPE );
-				stream << node->Serialize();
-				break;
-
 			case PHYSICS_OBJECT_TYPE:
-				SerializeUint8( stream, PHYSICS_OBJECT_TYPE );
-				stream << node->Serialize();
 				break;
 
 			default:
@@ -248,34 +712,23 @@ void ServerGameState::SendScene( unsigned int clientId )
 				continue;
 		}
 
-		// Add packet length
-		auto packet = stream.str();
-		SerializeUint16( messageStream, packet.size()+2 );
-		messageStream << packet;
-	}
-
-	// Send hierarchy info
-	for( auto& node : objectManager->worldNodes )
-	{
-		std::stringstream stream(
-			stringstream::in |
-			stringstream::out |
-			stringstream::binary
-		);
+		// Stop when out of budget, though let at least one node
+		// through so a big one can't block the rest forever. The
+		// headers of the events aren't known before they're
+		// written, the data is most of it.
+		auto data = node->Serialize(); // Serialize all
+		auto used = static_cast<long>( message.Length() - start );
+		if( byteLimit <= 0 || ( !created.empty() && used + static_cast<long>( data.size() ) > byteLimit ) )
+		{
+			break;
+		}
 
-		SerializeUint8( stream, (uint8_t)OBJECT_EVENT );	    // Event type
-		SerializeUint16( stream, (uint16_t)OBJECT_PARENT_ADD ); // Event sub type
-		SerializeUint32( stream, node->id );
-		SerializeUint32( stream, node->parent );
+		// The ancestors are created first, the parent is there already
+		message.Create( node->id, node->type, data );
+		message.ParentAdd( node->id, node->parent );
 
-		// Add packet length
-		auto packet = stream.str();
-		SerializeUint16( messageStream, packet.size()+2 );
-		messageStream << packet;
+		created.push_back( node->id );
 	}
-
-	auto msg = messageStream.str();
-	client->Write( messageStream.str() );
 }
 
 
@@ -286,13 +739,6 @@ void ServerGameState::HandleEvent( Event *e )
 	PartEvent   *part;
 	DataInEvent *dataIn;
 
-	// Stream for manual package creation
-	std::stringstream stream(
-		stringstream::in |
-		stringstream::out |
-		stringstream::binary
-	);
-
 	if( e->type == NETWORK_EVENT )
 	{
 		switch( e->subType )
@@ -306,6 +752,10 @@ void ServerGameState::HandleEvent( Event *e )
 			case NETWORK_PART:
 				part = static_cast<PartEvent*>( e );
 				LOG( "Client " << part->clientId << " parted!" );
+				clientViewsMutex.lock();
+				clientViews.erase( part->clientId );
+				clientViewsMutex.unlock();
+				server.RemoveClient( part->clientId );
 				server.CleanBadConnections();
 				break;
 
@@ -349,53 +799,30 @@ _unhandled:
 
 void ServerGameState::HandleDataInEvent( DataInEvent *e )
 {
-	stringstream stream(
-		stringstream::in |
-		stringstream::out |
-		stringstream::binary
-	);
-	stream << e->data;
-
-
-	EventType type = static_cast<EventType>(
-		UnserializeUint8( stream )
-	);
-
-	// Check the type
-	if( type >= EVENT_TYPE_COUNT )
+	auto event = packetDecoder.Decode( e->data );
+	if( !event )
 	{
-		LOG_ERROR( "Received invalid type(" << static_cast<unsigned int>( type ) << ")!" );
+		LOG_ERROR( "Client " << e->clientId << " sent an invalid or unknown packet!" );
 		return;
 	}
 
-
-	EventSubType subType = static_cast<EventSubType>(
-		UnserializeUint16( stream )
-	);
-
-	// Check the the sub type
-	if( subType >= EVENT_SUB_TYPE_COUNT )
+	switch( event->subType )
 	{
-		LOG_ERROR( "Received invalid sub type(" << static_cast<unsigned int>( subType ) << ")!" );
-		return;
-	}
+		case NETWORK_VIEWPOINT:
+			HandleViewpoint( e->clientId, *static_cast<ViewpointEvent*>( event ) );
+			break;
 
-	// Copy the data to the dataStream
-	stringstream dataStream(
-		stringstream::in |
-		stringstream::out |
-		stringstream::binary
-	);
+		case NETWORK_HELLO:
+			HandleHello( e->clientId, *static_cast<HelloEvent*>( event ) );
+			break;
 
-	// Construct the event
-	switch( type )
-	{
-		case OBJECT_EVENT:
 		default:
-			LOG_ERROR( ToString( "Constructing event of type "
-			                     << EventTypeToStr( type )
-			                     << " not yet handled!" ) );
+			LOG_ERROR( ToString( "Handling event "
+			                     << EventSubTypeToStr( event->subType )
+			                     << " from a client not yet implemented!" ) );
 	}
+
+	delete event;
 }
 
 
@@ -406,7 +833,7 @@ bool ServerGameState::StartServer()
 	LOG( "Starting server..." );
 	try
 	{
-		server.Init( ioService, 22001 );
+		server.Init( ioService, port );
 		server.Accept();
 	}
 	catch( std::exception &e )
@@ -414,7 +841,7 @@ bool ServerGameState::StartServer()
 		LOG_ERROR( "Failed to start: " << e.what() );
 		return false;
 	}
-	LOG( "Server started! Port is " << 22001 << "." );
+	LOG( "Server started! Port is " << port << "." );
 
 	return true;
 }
@@ -3,16 +3,50 @@
 #include "../events/eventListener.hh"
 #include "../network/networkEvents.hh"
 #include "../network/server.hh"
+#include "../network/packetDecoder.hh"
+#include "../network/transformBatch.hh"
+#include "../network/objectMessage.hh"
 
 #include "../world/camera.hh"
 #include "../world/entity.hh"
 
 #include "../managers/serverObjectManager.hh"
 
+#include "spatialGrid.hh"
+#include "relevance.hh"
+#include "updateScheduler.hh"
+
+#include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <memory>
 
 
+// Milliseconds between the updates sent to the clients
+#define SERVER_TICK_INTERVAL 100
+
+// Seconds between the logged write statistics
+#define WRITE_STATISTICS_INTERVAL 10
+
+
+// The part of the world a client gets replicated
+struct ClientView
+{
+	glm::vec3 viewpoint;
+	float     radius;
+
+	// Nodes the client has been sent, sorted by id
+	std::vector<unsigned int> relevant;
+
+	// Keeps the updates within the client's bandwidth
+	UpdateScheduler scheduler;
+
+	// Told in its hello it understands OBJECT_PACKED
+	bool packedObjects = false;
+};
+
+
 class ServerGameState : public GameState, public EventListener
 {
  public:
@@ -31,6 +65,34 @@ class ServerGameState : public GameState, public EventListener
 
 	Server server;
 
+	// Quantizes the transforms in the snapshots
+	TransformCodec transformCodec;
+
+	// Turns what the clients send into events
+	PacketDecoder packetDecoder;
+
+	// World positions of the nodes for the area of interest queries
+	SpatialGrid spatialGrid;
+
+	std::map<unsigned int, ClientView> clientViews;
+	std::mutex                          clientViewsMutex;
+
+	// Time between the updates sent to the clients
+	std::chrono::milliseconds tickInterval;
+
+	// Bytes per second each client is sent at most, what it's
+	// sent adapts to its link under that
+	size_t clientBandwidth;
+
+	// Compress for the clients that can decompress
+	bool compressionEnabled;
+
+	// Extra nodes scattered around the origin on Create(), for load testing
+	size_t testNodeCount;
+
+	// Of the stream and the datagrams both
+	short port;
+
 	bool StartServer();
 
 
@@ -38,5 +100,38 @@ class ServerGameState : public GameState, public EventListener
 	// Event handling
 	void HandleDataInEvent( DataInEvent* );
 	void SendScene( unsigned int clientId );
+	void HandleViewpoint( unsigned int clientId, const ViewpointEvent &e );
+	void HandleHello( unsigned int clientId, const HelloEvent &e );
+	void LogWriteStatistics();
+
+	// Area of interest, expects managerMutex to be locked
+	std::vector<unsigned int> CreationOrder( const std::vector<unsigned int> &ids, const glm::vec3 &viewpoint );
+
+	// Writes the creations of the nodes in the given order into the
+	// message until byteLimit bytes were added, the ids of the ones
+	// that made it are appended to created
+	void CreateMessage(
+		const std::vector<unsigned int> &ids,
+		long                             byteLimit,
+		std::vector<unsigned int>       &created,
+		ObjectMessageWriter             &message
+	);
+
+	// Quantized transforms of all the nodes sorted by id, only the
+	// ones whose position or rotation changed are redone on a tick
+	TransformSnapshot transforms;
+
+	// The transforms to quantize on a tick, gathered to be done in bulk,
+	// and where in transforms they go
+	TransformArrays     changedTransforms;
+	QuantizedArrays     quantizedTransforms;
+	std::vector<size_t> changedSlots;
+
+	// For the write statistics logged now and then
+	WriteStatistics                       lastWriteStatistics;
+	ConnectionStatistics                  lastTotals;
+	uint64_t                              lastAccepted;
+	std::chrono::steady_clock::time_point lastStatisticsLog;
+	size_t                                ticksSinceStatistics;
 };
 
@@ -0,0 +1,198 @@
+#include "spatialGrid.hh"
+
+#include <cmath>
+
+using namespace std;
+
+
+SpatialGrid::SpatialGrid( float size ) : cellSize( size )
+{
+}
+
+
+
+SpatialGrid::CellKey SpatialGrid::KeyOf( int x, int y, int z ) const
+{
+	// 21 bits per axis is plenty for any sane world and cell size
+	const int64_t mask = ( 1 << 21 ) - 1;
+	return ( ( x & mask ) << 42 ) | ( ( y & mask ) << 21 ) | ( z & mask );
+}
+
+
+
+int SpatialGrid::CellCoordinate( float value ) const
+{
+	return static_cast<int>( floor( value / cellSize ) );
+}
+
+
+
+void SpatialGrid::AddToCell( unsigned int id, Entry &entry )
+{
+	auto &cell = cells[entry.cell];
+	entry.slot = cell.size();
+	cell.push_back( { id, entry.position } );
+}
+
+
+
+void SpatialGrid::RemoveFromCell( const Entry &entry )
+{
+	auto cell = cells.find( entry.cell );
+	if( cell == cells.end() )
+	{
+		return;
+	}
+
+	// Swap the last one to the freed slot
+	auto &occupants = cell->second;
+	auto  last      = occupants.back();
+	occupants[entry.slot] = last;
+	entries[last.id].slot = entry.slot;
+	occupants.pop_back();
+
+	if( occupants.empty() )
+	{
+		cells.erase( cell );
+	}
+}
+
+
+
+void SpatialGrid::Update( unsigned int id, const glm::vec3 &position )
+{
+	auto key = KeyOf(
+		CellCoordinate( position.x ),
+		CellCoordinate( position.y ),
+		CellCoordinate( position.z )
+	);
+
+	auto it = entries.find( id );
+	if( it == entries.end() )
+	{
+		auto &entry    = entries[id];
+		entry.position = position;
+		entry.cell     = key;
+		AddToCell( id, entry );
+		return;
+	}
+
+	auto &entry    = it->second;
+	entry.position = position;
+
+	if( entry.cell != key )
+	{
+		RemoveFromCell( entry );
+		entry.cell = key;
+		AddToCell( id, entry );
+	}
+	else
+	{
+		cells[key][entry.slot].position = position;
+	}
+}
+
+
+
+void SpatialGrid::Remove( unsigned int id )
+{
+	auto it = entries.find( id );
+	if( it == entries.end() )
+	{
+		return;
+	}
+
+	RemoveFromCell( it->second );
+	entries.erase( it );
+}
+
+
+
+void SpatialGrid::QueryCell( CellKey key, const glm::vec3 &center, float radius, vector<GridHit> &hits ) const
+{
+	auto cell = cells.find( key );
+	if( cell == cells.end() )
+	{
+		return;
+	}
+
+	for( auto &occupant : cell->second )
+	{
+		auto delta    = occupant.position - center;
+		auto distance = glm::dot( delta, delta );
+		if( distance <= radius * radius )
+		{
+			hits.push_back( { occupant.id, distance } );
+		}
+	}
+}
+
+
+
+void SpatialGrid::Query( const glm::vec3 &center, float radius, vector<GridHit> &hits ) const
+{
+	int minX = CellCoordinate( center.x - radius ), maxX = CellCoordinate( center.x + radius );
+	int minY = CellCoordinate( center.y - radius ), maxY = CellCoordinate( center.y + radius );
+	int minZ = CellCoordinate( center.z - radius ), maxZ = CellCoordinate( center.z + radius );
+
+	double cellCount = double( maxX - minX + 1 ) *
+	                   double( maxY - minY + 1 ) *
+	                   double( maxZ - minZ + 1 );
+
+	// For huge radiuses it's cheaper to go through the occupied cells
+	if( cellCount > cells.size() )
+	{
+		for( auto &cell : cells )
+		{
+			QueryCell( cell.first, center, radius, hits );
+		}
+		return;
+	}
+
+	// Distance along an axis from the center to the nearest side of the
+	// cell, zero in the cell the center is in
+	auto gap = [&]( int cell, float value )
+	{
+		float low = cell * cellSize;
+		return value < low ? low - value : value > low + cellSize ? value - low - cellSize : 0.f;
+	};
+
+	// The corners of the box are outside the sphere, their cells are skipped
+	float radiusSquared = radius * radius;
+	for( int x = minX; x <= maxX; x++ )
+	{
+		float dx = gap( x, center.x );
+		for( int y = minY; y <= maxY; y++ )
+		{
+			float dy = gap( y, center.y );
+			for( int z = minZ; z <= maxZ; z++ )
+			{
+				float dz = gap( z, center.z );
+				if( dx * dx + dy * dy + dz * dz <= radiusSquared )
+				{
+					QueryCell( KeyOf( x, y, z ), center, radius, hits );
+				}
+			}
+		}
+	}
+}
+
+
+
+glm::vec3 SpatialGrid::Position( unsigned int id ) const
+{
+	auto it = entries.find( id );
+	if( it == entries.end() )
+	{
+		return glm::vec3( 0.f );
+	}
+
+	return it->second.position;
+}
+
+
+
+size_t SpatialGrid::Size() const
+{
+	return entries.size();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+
+// About the view radius, smaller cells make a query look up
+// many more of them than it saves in distances
+#define SPATIAL_GRID_CELL_SIZE 64.f
+
+
+// A node a query found and its squared distance to the center
+struct GridHit
+{
+	unsigned int id;
+	float        distanceSquared;
+};
+
+
+// Uniform grid over the world positions of the nodes, used to
+// find the nodes near a point without going through all of them.
+// Keeps only the ids and the positions, the object manager owns the
+// nodes. The positions are also kept in the cells next to the ids, so
+// a query goes through the cells alone.
+class SpatialGrid
+{
+ public:
+	SpatialGrid( float cellSize = SPATIAL_GRID_CELL_SIZE );
+
+	// Inserts the node or moves it to the cell of its new position
+	void Update( unsigned int id, const glm::vec3 &position );
+	void Remove( unsigned int id );
+
+	// Appends the nodes within the radius of the center
+	void Query( const glm::vec3 &center, float radius, std::vector<GridHit> &hits ) const;
+
+	// Last position the node was updated with, zero if it isn't in the grid
+	glm::vec3 Position( unsigned int id ) const;
+
+	size_t Size() const;
+
+
+ private:
+	typedef int64_t CellKey;
+
+	struct Entry
+	{
+		glm::vec3 position;
+		CellKey   cell;
+		size_t    slot;
+	};
+
+	struct Occupant
+	{
+		unsigned int id;
+		glm::vec3    position;
+	};
+
+	CellKey KeyOf( int x, int y, int z ) const;
+	int     CellCoordinate( float value ) const;
+
+	void AddToCell( unsigned int id, Entry &entry );
+	void RemoveFromCell( const Entry &entry );
+
+	void QueryCell( CellKey key, const glm::vec3 &center, float radius, std::vector<GridHit> &hits ) const;
+
+	float cellSize;
+
+	std::unordered_map<unsigned int, Entry>            entries;
+	std::unordered_map<CellKey, std::vector<Occupant>> cells;
+};
@@ -0,0 +1,377 @@
+#include "updateScheduler.hh"
+#include "../network/packets.hh"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+
+namespace
+{
+	struct Candidate
+	{
+		const QuantizedTransform *node;
+		const QuantizedTransform *previous;
+		float                     priority;
+	};
+
+
+	// How far the previously sent transform is from the current one
+	float TransformError(
+		const TransformCodec     &codec,
+		const QuantizedTransform &node,
+		const QuantizedTransform &previous )
+	{
+		float error = 0.f;
+		for( int i = 0; i < 3; i++ )
+		{
+			float delta = codec.DequantizePosition( node.position[i] ) -
+			              codec.DequantizePosition( previous.position[i] );
+			error += delta * delta;
+		}
+		error = sqrt( error );
+
+		// Treat any turn like a small move
+		if( node.rotation != previous.rotation )
+		{
+			error += 0.5f;
+		}
+
+		return error;
+	}
+}
+
+
+
+float UpdatePriority( float distance, float radius, float error )
+{
+	float closeness = 1.f - min( distance / max( radius, 1.f ), 1.f );
+	return ( 0.1f + closeness ) * ( 1.f + error );
+}
+
+
+
+UpdateScheduler::UpdateScheduler( size_t bytesPerSecond )
+	: bandwidth( bytesPerSecond ),
+	  maxBandwidth( max<size_t>( bytesPerSecond, CLIENT_MAX_BYTES_PER_SECOND ) ),
+	  budget( 0 ),
+	  refilled( 0 ),
+	  spent( 0 ),
+	  sampling( false ),
+	  delivered( 0 ),
+	  sampleStart( 0 ),
+	  sampleSentAt( 0 ),
+	  fallingBehind( false ),
+	  minRtt( 0.f ),
+	  windowMinRtt( 0.f ),
+	  minRttAge( 0 ),
+	  probing( true ),
+	  sinceCut( CLIENT_CUT_INTERVAL_MS ),
+	  cutAt( 0 ),
+	  cutRtt( 0.f ),
+	  cutBacklog( 0 ),
+	  clock( 0 ),
+	  lastAck( 0 )
+{
+}
+
+
+
+void UpdateScheduler::SetBandwidth( size_t bytesPerSecond )
+{
+	bandwidth = bytesPerSecond;
+}
+
+
+
+size_t UpdateScheduler::Bandwidth() const
+{
+	return bandwidth;
+}
+
+
+
+void UpdateScheduler::SetMaxBandwidth( size_t bytesPerSecond )
+{
+	maxBandwidth = bytesPerSecond;
+	bandwidth    = min( bandwidth, maxBandwidth );
+}
+
+
+
+size_t UpdateScheduler::MaxBandwidth() const
+{
+	return maxBandwidth;
+}
+
+
+
+void UpdateScheduler::Adapt( const LinkState &link, chrono::milliseconds elapsed )
+{
+	clock += static_cast<long>( elapsed.count() );
+
+	// Of the snapshots before the acknowledged one, those sent earlier
+	// than it by more than the time since the last acknowledgement would
+	// have been acknowledged already if they had gotten through
+	if( link.hasAck && !unacked.empty() && !IsNewerSequence( unacked.front().sequence, link.ackedSequence ) )
+	{
+		auto acked = unacked.begin();
+		while( acked + 1 != unacked.end() && !IsNewerSequence( ( acked + 1 )->sequence, link.ackedSequence ) )
+		{
+			acked++;
+		}
+
+		auto since = acked->sentAt - ( clock - lastAck );
+		for( auto it = unacked.begin(); it <= acked; it++ )
+		{
+			if( it->sentAt >= since )
+			{
+				delivered += it->bytes;
+			}
+		}
+
+		auto ackedSentAt = acked->sentAt;
+		unacked.erase( unacked.begin(), acked + 1 );
+		lastAck = clock;
+
+		// The samples start from the first acknowledgement, the
+		// time before that is only the way there
+		if( !sampling )
+		{
+			sampling     = true;
+			delivered    = 0;
+			sampleStart  = clock;
+			sampleSentAt = ackedSentAt;
+		}
+		else if( clock - sampleStart >= CLIENT_THROUGHPUT_WINDOW_MS )
+		{
+			// A queue on the way keeps the link busy, what gets through then
+			// is what it can take, so the best sample is the link's rate
+			throughputs.push_back( delivered * 1000.f / ( clock - sampleStart ) );
+			if( throughputs.size() > CLIENT_THROUGHPUT_SAMPLES )
+			{
+				throughputs.pop_front();
+			}
+
+			// The snapshots sent over a while taking longer than that
+			// to get acknowledged have waited in a queue, of the ones
+			// sent before the last cut that's known already
+			fallingBehind =
+				ackedSentAt - sampleSentAt < ( clock - sampleStart ) * CLIENT_DELIVERY_SLACK &&
+				sampleSentAt >= cutAt;
+			delivered     = 0;
+			sampleStart   = clock;
+			sampleSentAt  = ackedSentAt;
+		}
+	}
+
+	// The lowest round trip time is the one with nothing queued
+	if( link.rtt > 0.f )
+	{
+		minRttAge += static_cast<long>( elapsed.count() );
+		if( windowMinRtt <= 0.f || link.rtt < windowMinRtt )
+		{
+			windowMinRtt = link.rtt;
+		}
+		if( minRtt <= 0.f || link.rtt < minRtt )
+		{
+			minRtt = link.rtt;
+		}
+		if( minRttAge >= CLIENT_MIN_RTT_WINDOW_MS )
+		{
+			minRtt       = windowMinRtt;
+			windowMinRtt = link.rtt;
+			minRttAge    = 0;
+		}
+	}
+
+	bool backedUp = link.backlog > bandwidth * CLIENT_MAX_BACKLOG_MS / 1000;
+	bool delayed  = link.rtt > 0.f && link.rtt > minRtt + CLIENT_RTT_SLACK_MS;
+
+	sinceCut += static_cast<long>( elapsed.count() );
+
+	if( backedUp || delayed || fallingBehind )
+	{
+		// Cut again only if the last one hasn't started to drain the queue
+		bool growing =
+			( backedUp && link.backlog >= cutBacklog ) ||
+			( delayed && link.rtt >= cutRtt ) ||
+			fallingBehind;
+
+		if( growing && sinceCut >= CLIENT_CUT_INTERVAL_MS )
+		{
+			// Under what gets through, so the queue drains
+			auto throughput = Throughput();
+			auto target     = throughput > 0 ? min( bandwidth, throughput ) : bandwidth;
+
+			bandwidth  = max<size_t>( static_cast<size_t>( target * CLIENT_BUDGET_DECREASE ), CLIENT_MIN_BYTES_PER_SECOND );
+			probing    = false;
+			sinceCut   = 0;
+			cutAt      = clock;
+			cutRtt     = link.rtt;
+			cutBacklog = link.backlog;
+		}
+	}
+	else
+	{
+		cutRtt     = 0.f;
+		cutBacklog = 0;
+
+		// Only a budget that runs out needs more
+		if( spent * 4 >= refilled * 3 )
+		{
+			auto rate     = probing ? CLIENT_BUDGET_PROBE : CLIENT_BUDGET_INCREASE;
+			auto increase = static_cast<size_t>( bandwidth * rate * elapsed.count() / 1000 );
+			bandwidth = min( bandwidth + max<size_t>( increase, 1 ), maxBandwidth );
+		}
+	}
+}
+
+
+
+size_t UpdateScheduler::Throughput() const
+{
+	float best = 0.f;
+	for( auto sample : throughputs )
+	{
+		best = max( best, sample );
+	}
+	return static_cast<size_t>( best );
+}
+
+
+
+long UpdateScheduler::Refill( chrono::milliseconds elapsed )
+{
+	long refill = static_cast<long>( bandwidth * elapsed.count() / 1000 );
+	budget   = min( budget + refill, refill * CLIENT_BUDGET_BURST );
+	refilled = refill;
+	spent    = 0;
+	return budget;
+}
+
+
+
+void UpdateScheduler::Spend( size_t bytes )
+{
+	budget -= static_cast<long>( bytes );
+	spent  += static_cast<long>( bytes );
+}
+
+
+
+void UpdateScheduler::Sent( uint32_t sequence, size_t bytes )
+{
+	unacked.push_back( { sequence, bytes, clock } );
+
+	// Older ones couldn't be baselines anymore either
+	if( unacked.size() > SNAPSHOT_HISTORY_LENGTH )
+	{
+		unacked.pop_front();
+	}
+}
+
+
+
+long UpdateScheduler::Budget() const
+{
+	return budget;
+}
+
+
+
+shared_ptr<TransformSnapshot> UpdateScheduler::Schedule(
+	const TransformCodec                 &codec,
+	const TransformSnapshot              &current,
+	const TransformSnapshot              *previous,
+	const function<float( unsigned int )> &distance,
+	float                                 radius,
+	long                                  byteLimit )
+{
+	static const TransformSnapshot emptySnapshot;
+
+	if( !previous )
+	{
+		previous = &emptySnapshot;
+	}
+
+	auto snapshot = make_shared<TransformSnapshot>();
+	snapshot->reserve( current.size() );
+
+	// Go through the current nodes, the ones that haven't
+	// changed since the last tick are simply carried over
+	vector<Candidate> candidates;
+
+	auto base = previous->begin();
+	for( auto &node : current )
+	{
+		while( base != previous->end() && base->id < node.id )
+		{
+			base++;
+		}
+
+		const QuantizedTransform *previousNode = nullptr;
+		if( base != previous->end() && base->id == node.id )
+		{
+			previousNode = &*base;
+		}
+
+		if( previousNode && !SnapshotEntryBits( codec, &node, previousNode ) )
+		{
+			snapshot->push_back( node );
+			priorities.erase( node.id );
+			continue;
+		}
+
+		float error = previousNode ? TransformError( codec, node, *previousNode ) : radius;
+		auto &priority = priorities[node.id];
+		priority += UpdatePriority( distance( node.id ), radius, error );
+
+		candidates.push_back( { &node, previousNode, priority } );
+	}
+
+	// Pick the most important ones that fit
+	sort( candidates.begin(), candidates.end(),
+		[]( const Candidate &a, const Candidate &b )
+		{
+			return a.priority > b.priority;
+		}
+	);
+
+	long bits = 0;
+	for( auto &candidate : candidates )
+	{
+		auto entryBits = static_cast<long>( SnapshotEntryBits( codec, candidate.node, candidate.previous ) );
+		if( ( bits + entryBits ) / 8 > byteLimit )
+		{
+			// Keep the old transform until there's room for the new one
+			if( candidate.previous )
+			{
+				snapshot->push_back( *candidate.previous );
+			}
+			continue;
+		}
+
+		bits += entryBits;
+		snapshot->push_back( *candidate.node );
+		priorities.erase( candidate.node->id );
+	}
+
+	sort( snapshot->begin(), snapshot->end(),
+		[]( const QuantizedTransform &a, const QuantizedTransform &b )
+		{
+			return a.id < b.id;
+		}
+	);
+
+	return snapshot;
+}
+
+
+
+void UpdateScheduler::Forget( unsigned int id )
+{
+	priorities.erase( id );
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "../network/snapshot.hh"
+
+
+// Bytes per second a client is sent at first
+#define CLIENT_BYTES_PER_SECOND ( 16 * 1024 )
+
+// Range the budget adapts to the client's link in
+#define CLIENT_MIN_BYTES_PER_SECOND ( 4 * 1024 )
+#define CLIENT_MAX_BYTES_PER_SECOND ( 512 * 1024 )
+
+// How many ticks worth of unused budget can be saved up
+#define CLIENT_BUDGET_BURST 2
+
+// The budget grows by this fraction per second while the link
+// keeps up and it's used, faster until the link first queues,
+// and is cut to this fraction of what got through when it does
+#define CLIENT_BUDGET_INCREASE 0.1f
+#define CLIENT_BUDGET_PROBE    1.f
+#define CLIENT_BUDGET_DECREASE 0.85f
+
+// Milliseconds of the budget that may wait in the write queue and
+// the round trip time over the lowest seen that still counts as
+// an empty queue on the way
+#define CLIENT_MAX_BACKLOG_MS 200
+#define CLIENT_RTT_SLACK_MS   25.f
+
+// Milliseconds at least between two cuts, the round trip time takes
+// about that long to show the effect of one
+#define CLIENT_CUT_INTERVAL_MS 1000
+
+// Milliseconds the lowest round trip time is taken over, an older
+// one goes in case the route has changed
+#define CLIENT_MIN_RTT_WINDOW_MS 10000
+
+// Milliseconds the acknowledged bytes are gathered over at least for
+// a throughput sample, the throughput is the best of the last ones
+#define CLIENT_THROUGHPUT_WINDOW_MS 500
+#define CLIENT_THROUGHPUT_SAMPLES   10
+
+// The acknowledgements of the snapshots sent over a while coming
+// in over a longer one than this fraction of it means they have
+// waited in a queue
+#define CLIENT_DELIVERY_SLACK 0.8f
+
+
+// What the server knows of the link to a client on a tick
+struct LinkState
+{
+	bool     hasAck;
+	uint32_t ackedSequence;  // Newest snapshot the client has acknowledged
+	float    rtt;            // Newest round trip time in milliseconds, 0 if not measured yet
+	size_t   backlog;        // Bytes the reliable stream hasn't gotten out yet
+};
+
+
+// Priority of updating a node on the client. Close nodes matter more
+// than far ones and the further off the client's copy is, the sooner
+// it should be corrected.
+float UpdatePriority( float distance, float radius, float error );
+
+
+
+// Fills a client's bandwidth budget with the most important changes.
+// Every changed node accumulates its priority on each tick it isn't
+// sent, so the far and slow ones get their turn too eventually.
+//
+// The budget follows the link of the client: it's cut back to a bit
+// under the best throughput the acknowledged snapshots have shown lately
+// as soon as the round trip time rises over the lowest one, the snapshots
+// get acknowledged slower than they're sent or the reliable stream backs
+// up, all meaning a queue is building up on the way, and grows again
+// slowly while none of them happens.
+class UpdateScheduler
+{
+ public:
+	UpdateScheduler( size_t bytesPerSecond = CLIENT_BYTES_PER_SECOND );
+
+	void   SetBandwidth( size_t bytesPerSecond );
+	size_t Bandwidth() const;
+
+	// The most the budget grows to
+	void   SetMaxBandwidth( size_t bytesPerSecond );
+	size_t MaxBandwidth() const;
+
+	// Adjusts the bandwidth to what the link has shown since the last tick
+	void Adapt( const LinkState &link, std::chrono::milliseconds elapsed );
+
+	// Bytes per second the acknowledged snapshots have taken lately
+	size_t Throughput() const;
+
+	// Adds the budget of the elapsed time, returns what's available
+	long Refill( std::chrono::milliseconds elapsed );
+
+	// Takes what was actually sent, the budget may go negative
+	void Spend( size_t bytes );
+	long Budget() const;
+
+	// The snapshot of the sequence took the bytes, counted as having
+	// gotten through once the client has acknowledged it or a later one
+	void Sent( uint32_t sequence, size_t bytes );
+
+	// Builds the snapshot to send: the transforms of the previous one
+	// with the most important changes picked in from the current ones,
+	// as many as fit in byteLimit. The previous snapshot is the one the
+	// snapshot will be encoded against, the newest the client has for
+	// sure, so the changes are counted as they'll be sent. Both
+	// snapshots are sorted by id and previous may be null. The distance
+	// callback gives the distance of a node from the client's viewpoint.
+	std::shared_ptr<TransformSnapshot> Schedule(
+		const TransformCodec                      &codec,
+		const TransformSnapshot                   &current,
+		const TransformSnapshot                   *previous,
+		const std::function<float( unsigned int )> &distance,
+		float                                      radius,
+		long                                       byteLimit
+	);
+
+	// The node isn't replicated to the client anymore
+	void Forget( unsigned int id );
+
+
+ private:
+	struct SentSnapshot
+	{
+		uint32_t sequence;
+		size_t   bytes;
+		long     sentAt;
+	};
+
+	size_t bandwidth;
+	size_t maxBandwidth;
+	long   budget;
+
+	// Of the last tick, to tell if the budget was used up
+	long refilled;
+	long spent;
+
+	std::deque<SentSnapshot> unacked;
+
+	// Acknowledged bytes gathered for the next sample since its start,
+	// when the newest snapshot acknowledged by then was sent
+	bool              sampling;
+	size_t            delivered;
+	long              sampleStart;
+	long              sampleSentAt;
+	std::deque<float> throughputs;
+
+	// The acknowledgements of the last sample came in slower than
+	// the snapshots were sent
+	bool fallingBehind;
+
+	// The lowest of the current window and of the one before
+	float minRtt;
+	float windowMinRtt;
+	long  minRttAge;
+
+	// Until the first cut the budget grows faster
+	bool probing;
+
+	// Milliseconds since the last cut, its time and what the link showed then
+	long   sinceCut;
+	long   cutAt;
+	float  cutRtt;
+	size_t cutBacklog;
+
+	// Milliseconds of the ticks adapted so far and of the last new acknowledgement
+	long clock;
+	long lastAck;
+
+	// Accumulated priorities of the nodes waiting to be sent
+	std::unordered_map<unsigned int, float> priorities;
+};
@@ -1,6 +1,10 @@
 #define GLM_FORCE_RADIANS
 #include "smooth.hh"
 
+#include <cmath>
+
+using namespace std;
+
 
 namespace smoothHelpers
 {
@@ -21,3 +25,111 @@ namespace smoothHelpers
 	}
 }
 
+
+
+
+InterpolationDelay::InterpolationDelay()
+	: fixedDelay( 0.f ),
+	  hasSample( false ),
+	  interval( 0.f ),
+	  transit( 0.f ),
+	  deviation( 0.f ),
+	  rendering( false ),
+	  delay( INTERPOLATION_MIN_DELAY_MS )
+{
+}
+
+
+
+void InterpolationDelay::SampleArrived( const TimePoint& sampleTime, const TimePoint& arrival )
+{
+	lock_guard<mutex> delayLock( delayMutex );
+
+	float sampleTransit = chrono::duration<float, milli>( arrival - sampleTime ).count();
+
+	if( !hasSample )
+	{
+		hasSample  = true;
+		lastSample = sampleTime;
+		transit    = sampleTransit;
+		deviation  = 0.f;
+		return;
+	}
+
+	deviation += INTERPOLATION_GAIN * ( fabs( sampleTransit - transit ) - deviation );
+	transit   += INTERPOLATION_GAIN * ( sampleTransit - transit );
+
+	// Fragments and late arrivals don't tell the interval
+	if( sampleTime <= lastSample )
+	{
+		return;
+	}
+
+	float sampleInterval = chrono::duration<float, milli>( sampleTime - lastSample ).count();
+	interval   = interval > 0.f ? interval + INTERPOLATION_GAIN * ( sampleInterval - interval ) : sampleInterval;
+	lastSample = sampleTime;
+}
+
+
+
+InterpolationDelay::TimePoint InterpolationDelay::RenderTime( const TimePoint& now )
+{
+	lock_guard<mutex> delayLock( delayMutex );
+
+	auto target = Target();
+
+	// Ease into the new delay so the motion doesn't jump
+	if( rendering && now > lastRender )
+	{
+		float step = INTERPOLATION_SLEW * chrono::duration<float, milli>( now - lastRender ).count();
+		delay += max( -step, min( step, target - delay ) );
+	}
+	else if( !rendering )
+	{
+		delay = target;
+	}
+
+	rendering  = true;
+	lastRender = now;
+
+	return now - chrono::duration_cast<TimePoint::duration>( chrono::duration<float, milli>( delay ) );
+}
+
+
+
+void InterpolationDelay::SetDelay( float milliseconds )
+{
+	lock_guard<mutex> delayLock( delayMutex );
+	fixedDelay = milliseconds;
+}
+
+
+
+float InterpolationDelay::Delay() const
+{
+	lock_guard<mutex> delayLock( delayMutex );
+	return delay;
+}
+
+
+
+float InterpolationDelay::TargetDelay() const
+{
+	lock_guard<mutex> delayLock( delayMutex );
+	return Target();
+}
+
+
+
+float InterpolationDelay::Target() const
+{
+	if( fixedDelay > 0.f )
+	{
+		return fixedDelay;
+	}
+
+	// The next sample should be there by the time the render
+	// time gets past the newest one
+	float target = interval + transit + INTERPOLATION_JITTER_FACTOR * deviation;
+	return max( INTERPOLATION_MIN_DELAY_MS, min( INTERPOLATION_MAX_DELAY_MS, target ) );
+}
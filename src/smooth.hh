@@ -3,8 +3,12 @@
 #define GLM_FORCE_RADIANS
 
 #include <iostream>
+#include <algorithm>
 #include <chrono>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -39,6 +43,14 @@ namespace smoothHelpers
 	inline AngleAxis Minus( const glm::quat& lhs, const glm::quat& rhs )
 	{
 		auto quatDelta = lhs * glm::inverse(rhs);
+
+		// q and -q are the same rotation, quantizing may flip the sign
+		// between updates so take the shortest way around.
+		if( quatDelta.w < 0.f )
+		{
+			quatDelta = -quatDelta;
+		}
+
 		return AngleAxis{ glm::angle( quatDelta ), glm::axis( quatDelta ) };;
 	}
 
@@ -51,11 +63,12 @@ namespace smoothHelpers
 	}
 
 
+	// The difference is applied from the left like Minus() takes it
 	template <>
 	inline glm::quat Plus( const glm::quat& lhs, const AngleAxis& rhs )
 	{
 		auto rot = glm::angleAxis( rhs.angle, rhs.axis );
-		return lhs * rot;
+		return rot * lhs;
 	}
 
 
@@ -74,17 +87,43 @@ namespace smoothHelpers
 	{
 		return lhs * rhs;
 	}
+
+
+	// Between two values, t from 0 to 1
+	template <typename T>
+	inline T Interpolate( const T& from, const T& to, float t )
+	{
+		return glm::mix( from, to, t );
+	}
+
+
+	// Between two rotations the shortest way around
+	template <>
+	inline glm::quat Interpolate( const glm::quat& from, const glm::quat& to, float t )
+	{
+		return glm::slerp( from, to, t );
+	}
 }
 
 
 
+// Samples each Smooth keeps for interpolating between
+#define SMOOTH_HISTORY_LENGTH 5
+
+// How far past the newest sample a Smooth extrapolates before holding still
+#define SMOOTH_MAX_EXTRAPOLATION_US 250000
+
+
+
 template <
 	typename T,
 	typename DeltaType=decltype( smoothHelpers::Minus( T{}, T{} ) )
 >
 struct Smooth
 {
-	typedef std::chrono::high_resolution_clock::time_point HiResTimePoint;
+	// Monotonic, the sample times come from the server's clock
+	// synchronized to ours and mustn't jump with the wall clock
+	typedef std::chrono::steady_clock::time_point HiResTimePoint;
 	typedef T ValueType;
 
 	Smooth( const T& startValue={} )
@@ -97,36 +136,141 @@ struct Smooth
 	Smooth& operator=( const T& startValue )
 	{
 		value = startValue;
-		guess = value;
+		Guess( value );
+		Changed();
 		return *this;
 	}
 
 
+	// Every new value sets the bit in the mask, for the
+	// owner to tell which of its values have changed. The
+	// first change is called when nothing in it was set.
+	void TrackChanges( std::atomic<uint32_t> *mask, uint32_t bit, std::function<void()> first = nullptr )
+	{
+		changedMask = mask;
+		changedBit  = bit;
+		firstChange = first;
+	}
+
+
+	// Every change of what Get() returns sets the bit in the
+	// mask, the interpolated and calculated values included
+	void TrackMoves( std::atomic<uint32_t> *mask, uint32_t bit )
+	{
+		movedMask = mask;
+		movedBit  = bit;
+	}
+
+
+	// Takes the value as of now
 	void Update( const T& newValue )
 	{
 		std::lock_guard<std::mutex> valueLock( mut );
-		auto currentTime = HiResTimePoint::clock::now();
-		auto deltaTime   = DeltaTime( currentTime );
-		DeltaType deltaValue = smoothHelpers::Minus( newValue, value );
+		Set( newValue, HiResTimePoint::clock::now() );
+		sampled      = false;
+		historyCount = 0;
+		Changed();
+	}
 
-		lastUpdate = currentTime;
-		speed = smoothHelpers::ScalarDivide( deltaValue, deltaTime );
 
-		value = newValue;
-		guess = newValue;
+	// Takes the value as of the time it was sampled at, so the
+	// speed doesn't depend on how long the delivery took. The
+	// samples are kept for Interpolate(), late ones included.
+	void Update( const T& newValue, const HiResTimePoint& sampleTime )
+	{
+		std::lock_guard<std::mutex> valueLock( mut );
+
+		// The first sample is only compared to the time of creation
+		if( !sampled )
+		{
+			speed        = DeltaType{};
+			lastUpdate   = sampleTime;
+			historyCount = 0;
+			sampled      = true;
+		}
+
+		Remember( newValue, sampleTime );
+		Changed();
+
+		if( sampleTime < lastUpdate )
+		{
+			return;
+		}
+
+		Set( newValue, sampleTime );
 	}
 
 
 	void Calculate( const float& stepMultiplier={1.f} )
+	{
+		Calculate( HiResTimePoint::clock::now(), stepMultiplier );
+	}
+
+
+	// Guesses the value at the given time
+	void Calculate( const HiResTimePoint& currentTime, const float& stepMultiplier={1.f} )
 	{
 		std::lock_guard<std::mutex> valueLock( mut );
-		auto deltaTime = DeltaTime( HiResTimePoint::clock::now() );
+		auto deltaTime = DeltaTime( currentTime );
 		auto sum = smoothHelpers::ScalarMultiply( speed, deltaTime*stepMultiplier );
-		guess    = smoothHelpers::Plus<ValueType>( value, sum );
+		Guess( smoothHelpers::Plus<ValueType>( value, sum ) );
+	}
+
+
+	// Sets the value to what it was at the render time, between the
+	// samples around it. Past the newest sample it's extrapolated for
+	// a while and then held. Returns false if the render time wasn't
+	// between two samples.
+	bool Interpolate( const HiResTimePoint& renderTime )
+	{
+		std::lock_guard<std::mutex> valueLock( mut );
+
+		if( historyCount == 0 )
+		{
+			Guess( value );
+			return false;
+		}
+
+		if( renderTime <= historyTimes[0] )
+		{
+			Guess( history[0] );
+			return false;
+		}
+
+		auto newest = historyCount - 1;
+		if( renderTime >= historyTimes[newest] )
+		{
+			if( newest == 0 )
+			{
+				Guess( history[newest] );
+				return false;
+			}
+
+			auto ahead = std::min<long long>(
+				std::chrono::duration_cast<std::chrono::microseconds>( renderTime - historyTimes[newest] ).count(),
+				SMOOTH_MAX_EXTRAPOLATION_US
+			);
+			auto span  = std::chrono::duration_cast<std::chrono::microseconds>( historyTimes[newest] - historyTimes[newest - 1] ).count();
+			auto delta = smoothHelpers::Minus( history[newest], history[newest - 1] );
+			Guess( smoothHelpers::Plus<ValueType>( history[newest], smoothHelpers::ScalarMultiply( delta, float( ahead ) / span ) ) );
+			return false;
+		}
+
+		size_t next = 1;
+		while( historyTimes[next] < renderTime )
+		{
+			next++;
+		}
+
+		auto previous = next - 1;
+		float t = std::chrono::duration<float>( renderTime - historyTimes[previous] ).count() /
+		          std::chrono::duration<float>( historyTimes[next] - historyTimes[previous] ).count();
+		Guess( smoothHelpers::Interpolate( history[previous], history[next], t ) );
+		return true;
 	}
 
 
-	inline T Get()
+	inline T Get() const
 	{
 		std::lock_guard<std::mutex> valueLock( mut );
 		return guess;
@@ -141,12 +285,105 @@ struct Smooth
 
 
  protected:
+	inline void Set( const T& newValue, const HiResTimePoint& time )
+	{
+		auto deltaTime = DeltaTime( time );
+		if( deltaTime > 0.f )
+		{
+			DeltaType deltaValue = smoothHelpers::Minus( newValue, value );
+			speed = smoothHelpers::ScalarDivide( deltaValue, deltaTime );
+		}
+
+		lastUpdate = time;
+		value = newValue;
+		Guess( newValue );
+	}
+
+
+	// Sets what Get() returns, marks it moved if it did
+	inline void Guess( const T& newGuess )
+	{
+		if( !( guess == newGuess ) )
+		{
+			guess = newGuess;
+			if( movedMask )
+			{
+				movedMask->fetch_or( movedBit );
+			}
+		}
+	}
+
+
+	// Keeps the samples sorted by time, dropping the oldest
+	inline void Remember( const T& newValue, const HiResTimePoint& time )
+	{
+		size_t position = historyCount;
+		while( position > 0 && historyTimes[position - 1] > time )
+		{
+			position--;
+		}
+
+		// Same sample again
+		if( position > 0 && historyTimes[position - 1] == time )
+		{
+			history[position - 1] = newValue;
+			return;
+		}
+
+		if( historyCount == SMOOTH_HISTORY_LENGTH )
+		{
+			// Older than everything we've got
+			if( position == 0 )
+			{
+				return;
+			}
+
+			std::move( history + 1, history + position, history );
+			std::move( historyTimes + 1, historyTimes + position, historyTimes );
+			position--;
+		}
+		else
+		{
+			std::move_backward( history + position, history + historyCount, history + historyCount + 1 );
+			std::move_backward( historyTimes + position, historyTimes + historyCount, historyTimes + historyCount + 1 );
+			historyCount++;
+		}
+
+		history[position]      = newValue;
+		historyTimes[position] = time;
+	}
+
+
+	inline void Changed()
+	{
+		if( changedMask && !changedMask->fetch_or( changedBit ) && firstChange )
+		{
+			firstChange();
+		}
+	}
+
+
 	inline float DeltaTime( const HiResTimePoint& currentTime )
 	{
-		return std::chrono::duration_cast<std::chrono::milliseconds>( currentTime - lastUpdate ).count() / 1000.f;
+		return std::chrono::duration_cast<std::chrono::microseconds>( currentTime - lastUpdate ).count() / 1000000.f;
 	}
 
 	HiResTimePoint lastUpdate = HiResTimePoint::clock::now();
+	bool sampled = false;
+
+	// Where the changes are marked, if anywhere
+	std::atomic<uint32_t> *changedMask = nullptr;
+	uint32_t               changedBit  = 0;
+	std::function<void()>  firstChange;
+
+	// Where the changes of the guess are marked, if anywhere
+	std::atomic<uint32_t> *movedMask = nullptr;
+	uint32_t               movedBit  = 0;
+
+	// The timed samples, oldest first
+	T              history[SMOOTH_HISTORY_LENGTH];
+	HiResTimePoint historyTimes[SMOOTH_HISTORY_LENGTH];
+	size_t         historyCount = 0;
 
 	T value;
 	T guess;
@@ -154,6 +391,71 @@ struct Smooth
 	mutable std::mutex mut;
 };
 
+
+
+
+// Render delay limits in milliseconds
+#define INTERPOLATION_MIN_DELAY_MS 50.f
+#define INTERPOLATION_MAX_DELAY_MS 500.f
+
+// Mean deviations of the transit time waited for on top of the mean
+#define INTERPOLATION_JITTER_FACTOR 3.f
+
+// Weight of a new sample in the averages
+#define INTERPOLATION_GAIN 0.1f
+
+// How much faster or slower than real time the render
+// time may run while the delay settles to a new value
+#define INTERPOLATION_SLEW 0.05f
+
+
+// Tells how far behind the newest samples the Smooths should be
+// interpolated. Adapts to the sample interval and to the mean and
+// jitter of the time from sampling to arrival, so the next sample is
+// usually there before the render time gets past the previous one.
+class InterpolationDelay
+{
+ public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	InterpolationDelay();
+
+	// A batch of samples taken at the sample time has arrived
+	void SampleArrived( const TimePoint& sampleTime, const TimePoint& arrival = TimePoint::clock::now() );
+
+	// Time to interpolate the Smooths to for a frame at now
+	TimePoint RenderTime( const TimePoint& now = TimePoint::clock::now() );
+
+	// Fixes the delay in milliseconds, 0 adapts it again
+	void SetDelay( float milliseconds );
+
+	// The delay in milliseconds the last render time was
+	// calculated with and the one it's heading to
+	float Delay() const;
+	float TargetDelay() const;
+
+
+ private:
+	float Target() const;
+
+	mutable std::mutex delayMutex;
+
+	float fixedDelay;
+
+	// Averages in milliseconds
+	bool      hasSample;
+	TimePoint lastSample;
+	float     interval;
+	float     transit;
+	float     deviation;
+
+	bool      rendering;
+	TimePoint lastRender;
+	float     delay;
+};
+
+
+
 // Explicit template instantiations:
 // (Helps to supress clang warnings)
 template struct Smooth<glm::vec3>;
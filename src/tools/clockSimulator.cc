@@ -0,0 +1,279 @@
+// Checks the clock synchronization and the timestamped transforms
+// against delays with synthetic jitter.
+//
+// usage: belowClockSim [seconds] [jitter ms ...]
+//
+// The server's clock runs ahead of the client's by an arbitrary offset
+// and drifts. Both ways of the pings and the snapshots get a base delay
+// and an exponentially distributed jitter of the given mean, so the
+// datagrams also get reordered. A node moves on a circle and the client
+// renders it at 60 frames per second, extrapolated from the transforms
+// placed at their time of receiving like before and at the server's
+// tick time mapped to the client's clock. The errors are against where
+// the node really is at the time of the frame. Interpolating between
+// the server stamped transforms at the adaptive delay is compared to
+// where the node was at the render time, the frames that had to be
+// extrapolated past the newest transform are counted too.
+
+#include "../network/clockSync.hh"
+#include "../smooth.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+
+#define SIM_OFFSET_US     123456789012LL
+#define SIM_DRIFT         0.0002
+#define SIM_BASE_DELAY_MS 30.0
+#define SIM_TICK_MS       100.0
+#define SIM_FRAME_MS      ( 1000.0 / 60.0 )
+#define SIM_PING_MS       1000.0
+#define SIM_RADIUS        10.f
+#define SIM_ANGULAR_SPEED 1.f
+
+
+namespace
+{
+	typedef Smooth<glm::vec3>::HiResTimePoint TimePoint;
+
+
+	struct Link
+	{
+		Link( double jitterMs, unsigned seed )
+			: random( seed ),
+			  jitter( jitterMs > 0.0 ? 1.0 / jitterMs : 1.0 ),
+			  jitterMs( jitterMs )
+		{
+		}
+
+		// One way delay in milliseconds
+		double Delay()
+		{
+			return SIM_BASE_DELAY_MS + ( jitterMs > 0.0 ? jitter( random ) : 0.0 );
+		}
+
+		mt19937                          random;
+		exponential_distribution<double> jitter;
+		double                           jitterMs;
+	};
+
+
+	// Server's clock in microseconds at the client's time in milliseconds
+	uint64_t ServerClock( double localMs )
+	{
+		return static_cast<uint64_t>( SIM_OFFSET_US + localMs * 1000.0 * ( 1.0 + SIM_DRIFT ) );
+	}
+
+
+	// Where the node is at the server time
+	glm::vec3 NodePosition( uint64_t serverTime )
+	{
+		float seconds = static_cast<float>( ( serverTime - SIM_OFFSET_US ) / 1000000.0 );
+		return glm::vec3(
+			sin( seconds * SIM_ANGULAR_SPEED ) * SIM_RADIUS,
+			0.f,
+			cos( seconds * SIM_ANGULAR_SPEED ) * SIM_RADIUS
+		);
+	}
+
+
+	TimePoint ToTimePoint( uint64_t micros )
+	{
+		return TimePoint{ chrono::microseconds( micros ) };
+	}
+
+
+	float Percentile( vector<float> values, float fraction )
+	{
+		if( values.empty() )
+		{
+			return 0.f;
+		}
+
+		auto nth = values.begin() + static_cast<size_t>( fraction * ( values.size() - 1 ) );
+		nth_element( values.begin(), nth, values.end() );
+		return *nth;
+	}
+
+
+	// Something arriving at the client
+	struct Arrival
+	{
+		double    at;           // Client milliseconds
+		bool      pong;
+		double    sentAt;       // Of the ping
+		uint64_t  serverTime;   // Of the pong or the snapshot
+		glm::vec3 position;
+
+		bool operator< ( const Arrival &other ) const
+		{
+			return at < other.at;
+		}
+	};
+
+
+	void Simulate( double seconds, double jitterMs )
+	{
+		Link link( jitterMs, 1234 );
+		ClockSync clockSync;
+
+		// Client milliseconds
+		double start = 1000000.0;
+		double end   = start + seconds * 1000.0;
+
+		// Everything that gets sent, sorted by the arrival
+		vector<Arrival> arrivals;
+
+		double nextPing = start;
+		int    pings    = 0;
+		for( double t = start; t < end; t = nextPing )
+		{
+			double toServer   = link.Delay();
+			double fromServer = link.Delay();
+
+			Arrival pong;
+			pong.at         = t + toServer + fromServer;
+			pong.pong       = true;
+			pong.sentAt     = t;
+			pong.serverTime = ServerClock( t + toServer );
+			arrivals.push_back( pong );
+
+			pings++;
+			nextPing = t + ( pings < CLOCK_SYNC_HANDSHAKE ? CLOCK_SYNC_INTERVAL_MS : SIM_PING_MS );
+		}
+
+		for( double t = start; t < end; t += SIM_TICK_MS )
+		{
+			Arrival snapshot;
+			snapshot.at         = t + link.Delay();
+			snapshot.pong       = false;
+			snapshot.serverTime = ServerClock( t );
+			snapshot.position   = NodePosition( snapshot.serverTime );
+			arrivals.push_back( snapshot );
+		}
+
+		sort( arrivals.begin(), arrivals.end() );
+
+
+		// The client
+		Smooth<glm::vec3> received( NodePosition( ServerClock( start ) ) );
+		Smooth<glm::vec3> stamped( NodePosition( ServerClock( start ) ) );
+		Smooth<glm::vec3> interpolated( NodePosition( ServerClock( start ) ) );
+		InterpolationDelay interpolation;
+
+		vector<float> receivedErrors, stampedErrors, interpolatedErrors, offsetErrors, delays;
+		size_t next = 0, extrapolated = 0;
+
+		for( double frame = start; frame < end; frame += SIM_FRAME_MS )
+		{
+			while( next < arrivals.size() && arrivals[next].at <= frame )
+			{
+				auto &arrival = arrivals[next++];
+				auto  localUs = static_cast<uint64_t>( arrival.at * 1000.0 );
+
+				if( arrival.pong )
+				{
+					clockSync.AddSample(
+						static_cast<uint64_t>( arrival.sentAt * 1000.0 ),
+						arrival.serverTime,
+						localUs
+					);
+					continue;
+				}
+
+				received.Update( arrival.position, ToTimePoint( localUs ) );
+
+				// Without the sync the time of receiving is all we know
+				auto sampled = clockSync.Synchronized() ?
+					clockSync.ToLocal( arrival.serverTime ) : localUs;
+				stamped.Update( arrival.position, ToTimePoint( sampled ) );
+				interpolated.Update( arrival.position, ToTimePoint( sampled ) );
+				interpolation.SampleArrived( ToTimePoint( sampled ), ToTimePoint( localUs ) );
+			}
+
+			// Leave the first second out, the clocks get in sync there
+			if( frame - start < 1000.0 )
+			{
+				continue;
+			}
+
+			auto frameUs   = static_cast<uint64_t>( frame * 1000.0 );
+			auto frameTime = ToTimePoint( frameUs );
+			auto truth     = NodePosition( ServerClock( frame ) );
+
+			received.Calculate( frameTime );
+			stamped.Calculate( frameTime );
+
+			receivedErrors.push_back( glm::length( received.Get() - truth ) * 100.f );
+			stampedErrors.push_back( glm::length( stamped.Get() - truth ) * 100.f );
+
+			auto renderTime = interpolation.RenderTime( frameTime );
+			auto renderMs   = chrono::duration<double, milli>( renderTime.time_since_epoch() ).count();
+			if( !interpolated.Interpolate( renderTime ) )
+			{
+				extrapolated++;
+			}
+
+			auto renderTruth = NodePosition( ServerClock( renderMs ) );
+			interpolatedErrors.push_back( glm::length( interpolated.Get() - renderTruth ) * 100.f );
+			delays.push_back( interpolation.Delay() );
+
+			double offsetError = static_cast<double>( clockSync.ToRemote( frameUs ) ) - ServerClock( frame );
+			offsetErrors.push_back( static_cast<float>( fabs( offsetError ) / 1000.0 ) );
+		}
+
+		cout << fixed << setprecision( 2 )
+		     << "jitter " << setw( 5 ) << jitterMs << " ms"
+		     << "  clock error ms: median " << Percentile( offsetErrors, 0.5f )
+		     << ", max " << Percentile( offsetErrors, 1.f )
+		     << ", drift " << setprecision( 0 ) << clockSync.Drift() * 1000000.0
+		     << " ppm (real " << SIM_DRIFT * 1000000.0 << ")" << endl
+		     << setprecision( 1 )
+		     << "  position error cm, stamped on receive: median " << Percentile( receivedErrors, 0.5f )
+		     << ", 95% " << Percentile( receivedErrors, 0.95f )
+		     << ", max " << Percentile( receivedErrors, 1.f ) << endl
+		     << "  position error cm, stamped by server:  median " << Percentile( stampedErrors, 0.5f )
+		     << ", 95% " << Percentile( stampedErrors, 0.95f )
+		     << ", max " << Percentile( stampedErrors, 1.f ) << endl
+		     << "  position error cm, interpolated:       median " << Percentile( interpolatedErrors, 0.5f )
+		     << ", 95% " << Percentile( interpolatedErrors, 0.95f )
+		     << ", max " << Percentile( interpolatedErrors, 1.f )
+		     << ", at delay ms median " << Percentile( delays, 0.5f )
+		     << ", extrapolated " << 100.f * extrapolated / max<size_t>( delays.size(), 1 ) << "% of frames" << endl;
+	}
+}
+
+
+
+int main( int argc, char **argv )
+{
+	double seconds = argc > 1 ? atof( argv[1] ) : 60.0;
+
+	vector<double> jitters;
+	for( int i = 2; i < argc; i++ )
+	{
+		jitters.push_back( atof( argv[i] ) );
+	}
+
+	if( jitters.empty() )
+	{
+		jitters = { 0.0, 5.0, 10.0, 20.0, 40.0 };
+	}
+
+	cout << "Node at " << SIM_RADIUS * SIM_ANGULAR_SPEED << " m/s, ticks every " << SIM_TICK_MS
+	     << " ms, base delay " << SIM_BASE_DELAY_MS << " ms, " << seconds << " s" << endl;
+
+	for( auto jitter : jitters )
+	{
+		Simulate( seconds, jitter );
+	}
+
+	return 0;
+}
@@ -0,0 +1,474 @@
+// Measures every codec the data takes on its way between the server and
+// the clients with the same numbers, objects and bytes per second, so a
+// change to one of them shows up against the rest:
+//
+// - the world objects written and read with all of their fields,
+//   and the updates of the transform alone
+// - the packets the server gets from the clients through the
+//   PacketDecoder, as HandleDataInEvent decodes them
+// - the messages of object packets through the ServerMessageParser,
+//   the creations of a join and the updates of a tick, in packets of
+//   their own and packed
+// - the transform snapshots, full and delta, and the batches
+// - the compression of a join
+//
+// usage: belowCodecBench [objects] [rounds]
+//
+// The bytes are the encoded ones on both ways. Everything is checked to
+// come back first, exits with 1 if any of it doesn't.
+
+#include "codecSamples.hh"
+#include "../network/packetDecoder.hh"
+#include "../network/serverMessageParser.hh"
+#include "../network/networkEvents.hh"
+#include "../network/snapshot.hh"
+#include "../network/transformBatch.hh"
+#include "../network/compression.hh"
+#include "../network/packets.hh"
+#include "../network/binaryStream.hh"
+#include "../network/objectMessage.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <functional>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	void Measure( const string &name, size_t objects, size_t bytes, int rounds, function<void()> pass )
+	{
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			pass();
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count() / rounds;
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 28 ) << name << ": "
+		     << setw( 8 ) << objects / seconds / 1e6 << " M objects/s, "
+		     << setw( 8 ) << bytes / seconds / ( 1024 * 1024 ) << " MB/s" << endl;
+	}
+
+
+	// Calls the handler with the body of every packet of the message
+	void ForEachPacket( const string &message, function<void( BinaryReader& )> handler )
+	{
+		BinaryReader reader( message );
+		while( reader.Remaining() >= sizeof( uint16_t ) )
+		{
+			auto length = reader.ReadUint16();
+
+			// Past the type and the sub type
+			BinaryReader body( reader.Position() + 3, length - sizeof( uint16_t ) - 3 );
+			handler( body );
+			reader.Skip( length - sizeof( uint16_t ) );
+		}
+	}
+
+
+	// Writes and reads the objects with all of their fields
+	template<typename Type>
+	bool MeasureObjects( const string &name, size_t count, int rounds )
+	{
+		vector<Type>   objects( count ), read( count );
+		vector<string> serialized( count );
+		size_t         bytes = 0;
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			Randomize( objects[i], generator );
+			serialized[i] = objects[i].Serialize();
+			bytes += serialized[i].size();
+
+			if( !read[i].Unserialize( serialized[i] ) )
+			{
+				cout << name << ": the fields didn't come back" << endl;
+				return false;
+			}
+		}
+
+		Measure( name + ", serialize", count, bytes, rounds,
+			[&]()
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					serialized[i] = objects[i].Serialize();
+				}
+			}
+		);
+
+		Measure( name + ", unserialize", count, bytes, rounds,
+			[&]()
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					read[i].Unserialize( serialized[i] );
+				}
+			}
+		);
+
+		return true;
+	}
+
+
+	// The position and the rotation alone, what most of the updates are
+	void MeasureTransformUpdates( size_t count, int rounds )
+	{
+		vector<WorldNode> nodes( count );
+		vector<string>    serialized( count );
+		size_t            bytes = 0;
+
+		const vector<FieldId> fields = { FIELD_POSITION, FIELD_ROTATION };
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			Randomize( nodes[i], generator );
+			serialized[i] = nodes[i].Serialize( fields );
+			bytes += serialized[i].size();
+		}
+
+		Measure( "transform, serialize", count, bytes, rounds,
+			[&]()
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					serialized[i] = nodes[i].Serialize( fields );
+				}
+			}
+		);
+
+		Measure( "transform, unserialize", count, bytes, rounds,
+			[&]()
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					nodes[i].Unserialize( serialized[i] );
+				}
+			}
+		);
+	}
+
+
+	// The viewpoints the clients send, decoded as HandleDataInEvent does
+	bool MeasureClientPackets( size_t count, int rounds )
+	{
+		uniform_real_distribution<float> place( -1000.f, 1000.f );
+
+		vector<string> packets( count );
+		size_t         bytes = 0;
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			packets[i] = ViewpointPacket( place( generator ), place( generator ), place( generator ), 100.f );
+			bytes += packets[i].size();
+		}
+
+		PacketDecoder decoder;
+		size_t        decoded = 0;
+
+		Measure( "viewpoint, decode", count, bytes, rounds,
+			[&]()
+			{
+				decoded = 0;
+				for( auto &packet : packets )
+				{
+					auto e = decoder.Decode( packet );
+					decoded += e && e->subType == NETWORK_VIEWPOINT;
+					delete e;
+				}
+			}
+		);
+
+		if( decoded != count )
+		{
+			cout << "Decoded " << decoded << " of the " << count << " viewpoints!" << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+
+	// Whole messages of object packets into events
+	bool MeasureServerMessages( size_t count, int rounds, bool packed )
+	{
+		auto join = JoinMessage( count, generator, packed );
+
+		// The server writes the updates of a tick sorted by id
+		ObjectMessageWriter message( packed );
+		for( size_t i = 0; i < count; i++ )
+		{
+			WorldNode node;
+			Randomize( node, generator );
+			message.Update( static_cast<uint32_t>( i + 1 ), node.Serialize( { FIELD_POSITION, FIELD_ROTATION } ) );
+		}
+		auto updates = message.Finish();
+
+		string name = packed ? ", packed" : "";
+
+		size_t events = 0;
+		ServerMessageParser parser(
+			[&events]( Event *e )
+			{
+				events++;
+				delete e;
+			},
+			nullptr
+		);
+
+		// The creations and the parents of every node but the first
+		parser.Parse( join, nullptr );
+		if( events != 2 * count - 1 )
+		{
+			cout << "Parsed " << events << " of the " << 2 * count - 1 << " events of the join" << name << "!" << endl;
+			return false;
+		}
+
+		events = 0;
+		parser.Parse( updates, nullptr );
+		if( events != count )
+		{
+			cout << "Parsed " << events << " of the " << count << " updates" << name << "!" << endl;
+			return false;
+		}
+
+		Measure( "join, parse" + name, 2 * count - 1, join.size(), rounds,
+			[&]()
+			{
+				parser.Parse( join, nullptr );
+			}
+		);
+
+		Measure( "updates, parse" + name, count, updates.size(), rounds,
+			[&]()
+			{
+				parser.Parse( updates, nullptr );
+			}
+		);
+
+		cout << fixed << setprecision( 2 )
+		     << "The updates" << name << " take " << double( updates.size() ) / count << " bytes each" << endl;
+		return true;
+	}
+
+
+	bool MeasureSnapshots( size_t count, int rounds )
+	{
+		TransformCodec codec;
+
+		const auto maxPacketLength = MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH;
+
+		// A chain of deltas, each against the one before it
+		vector<TransformSnapshot> states( 1, RandomSnapshot( codec, count, generator ) );
+		for( int round = 0; round < rounds; round++ )
+		{
+			states.push_back( MoveSnapshot( codec, states.back(), 10, generator ) );
+		}
+
+		string full;
+		Measure( "snapshot, encode full", count, EncodeSnapshot( codec, 1, 1, states[0], 0, nullptr, maxPacketLength ).size(), rounds,
+			[&]()
+			{
+				full = EncodeSnapshot( codec, 1, 1, states[0], 0, nullptr, maxPacketLength );
+			}
+		);
+
+		vector<string> deltas( rounds );
+		size_t         deltaBytes = 0;
+
+		for( int round = 0; round < rounds; round++ )
+		{
+			deltas[round] = EncodeSnapshot( codec, round + 2, round + 2, states[round + 1], round + 1, &states[round], maxPacketLength );
+			deltaBytes += deltas[round].size();
+		}
+
+		int round = 0;
+		Measure( "snapshot, encode delta", count, deltaBytes / rounds, rounds,
+			[&]()
+			{
+				deltas[round] = EncodeSnapshot( codec, round + 2, round + 2, states[round + 1], round + 1, &states[round], maxPacketLength );
+				round++;
+			}
+		);
+
+		SnapshotReceiver      receiver( codec );
+		vector<NodeTransform> changes;
+		size_t                completed = 0;
+
+		auto receive = [&]( const string &message )
+		{
+			ForEachPacket( message,
+				[&]( BinaryReader &body )
+				{
+					uint32_t sequence;
+					uint64_t serverTime;
+					completed += receiver.Receive( string( body.Position(), body.Remaining() ), changes, sequence, serverTime );
+				}
+			);
+		};
+
+		Measure( "snapshot, decode full", count, full.size(), rounds,
+			[&]()
+			{
+				receiver.Reset();
+				changes.clear();
+				receive( full );
+			}
+		);
+
+		// The deltas go in order after the full one they start from
+		round     = 0;
+		completed = 0;
+		Measure( "snapshot, decode delta", count, deltaBytes / rounds, rounds,
+			[&]()
+			{
+				changes.clear();
+				receive( deltas[round++] );
+			}
+		);
+
+		if( completed != size_t( rounds ) )
+		{
+			cout << "Completed " << completed << " of the " << rounds << " delta snapshots!" << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+
+	bool MeasureBatches( size_t count, int rounds )
+	{
+		TransformCodec  codec;
+		QuantizedArrays quantized;
+
+		AppendChanged( RandomSnapshot( codec, count, generator ), nullptr, quantized );
+
+		auto message = EncodeTransformBatch( 1, quantized );
+
+		Measure( "batch, encode", count, message.size(), rounds,
+			[&]()
+			{
+				message = EncodeTransformBatch( 1, quantized );
+			}
+		);
+
+		QuantizedArrays packet;
+		TransformArrays transforms;
+		size_t          decoded = 0;
+
+		Measure( "batch, decode", count, message.size(), rounds,
+			[&]()
+			{
+				decoded = 0;
+				ForEachPacket( message,
+					[&]( BinaryReader &body )
+					{
+						uint64_t serverTime;
+						if( DecodeTransformBatch( body, serverTime, packet ) )
+						{
+							DequantizeArrays( codec, packet, transforms );
+							decoded += transforms.Size();
+						}
+					}
+				);
+			}
+		);
+
+		if( decoded != count )
+		{
+			cout << "Decoded " << decoded << " of the " << count << " nodes of the batch!" << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+
+	// The bytes are the ones of the join before the compression
+	bool MeasureCompression( size_t count, int rounds )
+	{
+		auto join       = JoinMessage( count, generator );
+		auto compressed = CompressPackets( join );
+
+		Measure( "join, compress", count, join.size(), rounds,
+			[&]()
+			{
+				compressed = CompressPackets( join );
+			}
+		);
+
+		string decompressed, part;
+		Measure( "join, decompress", count, join.size(), rounds,
+			[&]()
+			{
+				decompressed.clear();
+				ForEachPacket( compressed,
+					[&]( BinaryReader &body )
+					{
+						if( DecompressPackets( string( body.Position(), body.Remaining() ), part ) )
+						{
+							decompressed += part;
+						}
+					}
+				);
+			}
+		);
+
+		if( decompressed != join )
+		{
+			cout << "The join came back different from the compression!" << endl;
+			return false;
+		}
+
+		cout << "The join of " << join.size() / 1024 << " kB was compressed to " << compressed.size() / 1024 << " kB" << endl;
+		return true;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 10000;
+	int    rounds = argc > 2 ? atoi( argv[2] ) : 20;
+
+	if( count < 2 || rounds < 1 )
+	{
+		cout << "usage: " << argv[0] << " [objects] [rounds]" << endl;
+		return 1;
+	}
+
+	Logger::GetInstance().SetQuiet( true );
+
+	bool ok = MeasureObjects<WorldNode>( "node", count, rounds ) &&
+	          MeasureObjects<Entity>( "entity", count, rounds ) &&
+	          MeasureObjects<PhysicsObject>( "physics object", count, rounds );
+
+	if( ok )
+	{
+		MeasureTransformUpdates( count, rounds );
+	}
+
+	ok = ok &&
+	     MeasureClientPackets( count, rounds ) &&
+	     MeasureServerMessages( count, rounds, false ) &&
+	     MeasureServerMessages( count, rounds, true ) &&
+	     MeasureSnapshots( count, rounds ) &&
+	     MeasureBatches( count, rounds ) &&
+	     MeasureCompression( count, rounds );
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,620 @@
+// Feeds arbitrary bytes to everything that reads what comes over the
+// network, so the codecs can be made faster without reading out of
+// their buffers. The first byte of an input picks what gets the rest:
+//
+// 0  a packet from a client as the server gets it in a DataInEvent:
+//    the ping check of Client::Read() and the PacketDecoder of
+//    ServerGameState::HandleDataInEvent()
+// 1  a message from the server through the ServerMessageParser into a
+//    ClientObjectManager, the way the bot handles them, with the object
+//    events in packets of their own or packed
+// 2  the fields of a WorldNode, 3 of an Entity, 4 of a PhysicsObject
+// 5  OBJECT_SNAPSHOT bodies into a SnapshotReceiver, each with a 16 bit
+//    length in front
+// 6  the body of an OBJECT_UPDATE_BATCH
+// 7  the body of a NETWORK_COMPRESSED
+//
+// Besides not crashing, what gets accepted has to come out the same when
+// it's written again: the fields of the objects, the batches and the
+// compressed packets. The object manager has to find all of its nodes by
+// their ids and compute their model matrices. Otherwise the input is
+// printed and the run aborted.
+//
+// usage: belowCodecFuzz [iterations] [seed]
+//        belowCodecFuzz --replay files...
+//        belowCodecFuzz --seeds directory
+//
+// Without a guided fuzzer the inputs are valid data of every target with
+// random mutations. The input that crashed is saved to codecFuzz-crash
+// for --replay. --seeds writes the valid inputs to the directory, for
+// starting a guided fuzzer with them.
+//
+// Best run with the sanitizers, with objects of their own:
+//
+//   make fuzz OBJDIR=obj/fuzz BINDIR=bin/fuzz
+//        CFLAGS="-Wall -std=c++11 -O1 -fsanitize=address,undefined"
+//
+// or with libFuzzer, which then brings the main function:
+//
+//   make fuzz CC="clang++ -g" OBJDIR=obj/libfuzzer BINDIR=bin/libfuzzer
+//        CFLAGS="-Wall -std=c++11 -O1 -fsanitize=fuzzer,address -DCODEC_FUZZER_LIBFUZZER"
+//   ./belowCodecFuzz corpus
+
+#include "codecSamples.hh"
+#include "../network/packetDecoder.hh"
+#include "../network/serverMessageParser.hh"
+#include "../network/networkEvents.hh"
+#include "../network/connectionStatistics.hh"
+#include "../network/snapshot.hh"
+#include "../network/transformBatch.hh"
+#include "../network/compression.hh"
+#include "../network/packets.hh"
+#include "../network/binaryStream.hh"
+#include "../network/objectMessage.hh"
+#include "../managers/clientObjectManager.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <csignal>
+#include <random>
+#include <functional>
+
+using namespace std;
+
+
+#if defined( __SANITIZE_ADDRESS__ )
+#define CODEC_FUZZER_SANITIZED
+#elif defined( __has_feature )
+#if __has_feature( address_sanitizer )
+#define CODEC_FUZZER_SANITIZED
+#endif
+#endif
+
+#ifdef CODEC_FUZZER_SANITIZED
+extern "C" void __sanitizer_set_death_callback( void ( *callback )() );
+#endif
+
+
+enum FuzzTarget
+{
+	FUZZ_CLIENT_PACKET = 0,
+	FUZZ_SERVER_MESSAGE,
+	FUZZ_WORLD_NODE,
+	FUZZ_ENTITY,
+	FUZZ_PHYSICS_OBJECT,
+	FUZZ_SNAPSHOTS,
+	FUZZ_TRANSFORM_BATCH,
+	FUZZ_COMPRESSED,
+
+	FUZZ_TARGET_COUNT
+};
+
+
+namespace
+{
+	// The input being run, saved if it crashes. Never freed, the
+	// leak checks run after the destructors of the globals.
+	string &currentInput = *new string;
+
+
+	void SaveInput( const string &path )
+	{
+		ofstream file( path, ios::binary );
+		file.write( currentInput.data(), currentInput.size() );
+	}
+
+
+	void SaveCrash()
+	{
+		SaveInput( "codecFuzz-crash" );
+	}
+
+
+	void HandleCrash( int signal )
+	{
+		SaveCrash();
+		std::signal( signal, SIG_DFL );
+		raise( signal );
+	}
+
+
+	// Something was accepted that doesn't hold together
+	void Fail( const string &reason )
+	{
+		cout << reason << ", the input was:" << hex << setfill( '0' );
+		for( size_t i = 0; i < currentInput.size(); i++ )
+		{
+			cout << ( i % 32 ? " " : "\n" ) << setw( 2 ) << int( uint8_t( currentInput[i] ) );
+		}
+		cout << dec << endl;
+
+		SaveCrash();
+		abort();
+	}
+
+
+	void FuzzClientPacket( const string &data )
+	{
+		static PacketDecoder decoder;
+
+		EventSubType subType;
+		uint32_t     sequence;
+		uint64_t     timestamp, remoteTime;
+
+		if( ParsePingPacket( data.data(), data.size(), subType, sequence, timestamp, remoteTime ) )
+		{
+			return;
+		}
+
+		auto e = decoder.Decode( data );
+		if( !e )
+		{
+			return;
+		}
+
+		// HandleDataInEvent casts them by the sub type
+		if( ( e->subType == NETWORK_VIEWPOINT && !dynamic_cast<ViewpointEvent*>( e ) ) ||
+		    ( e->subType == NETWORK_HELLO && !dynamic_cast<HelloEvent*>( e ) ) )
+		{
+			Fail( "A client packet was decoded to an event of another type" );
+		}
+
+		delete e;
+	}
+
+
+	void FuzzServerMessage( const string &data )
+	{
+		ClientObjectManager objects;
+		ServerMessageParser parser(
+			[&objects]( Event *e )
+			{
+				objects.HandleEvent( e );
+				delete e;
+			},
+			[&objects]( const vector<NodeTransform> &transforms, uint64_t sampleTime )
+			{
+				objects.ApplyTransforms( transforms, sampleTime );
+			},
+			[&objects]( const TransformArrays &transforms, uint64_t sampleTime )
+			{
+				objects.ApplyTransforms( transforms, sampleTime );
+			}
+		);
+
+		parser.Parse( data, nullptr );
+
+		// Whatever came, every node is found by its id
+		for( auto &node : objects.worldNodes )
+		{
+			if( objects.Find( node->id ) != node.get() )
+			{
+				Fail( "A node of the object manager wasn't found by its id" );
+			}
+		}
+
+		// Even a hierarchy going around in a circle gets its matrices
+		objects.UpdateTransforms();
+	}
+
+
+	// What was taken has to be written and read back the same. Read
+	// once more first, the empty names are read as the default ones.
+	template<typename Type>
+	void FuzzObject( const string &data )
+	{
+		Type object, read, copy;
+		if( !object.Unserialize( data ) )
+		{
+			return;
+		}
+
+		if( !read.Unserialize( object.Serialize() ) )
+		{
+			Fail( "The fields of an object weren't taken back" );
+		}
+
+		auto written = read.Serialize();
+		if( !copy.Unserialize( written ) || copy.Serialize() != written )
+		{
+			Fail( "The fields of an object didn't come back the same" );
+		}
+	}
+
+
+	void FuzzSnapshots( const string &data )
+	{
+		SnapshotReceiver      receiver;
+		vector<NodeTransform> changes;
+		uint32_t              sequence;
+		uint64_t              serverTime;
+
+		BinaryReader reader( data );
+		while( reader.Remaining() >= sizeof( uint16_t ) )
+		{
+			size_t length = reader.ReadUint16();
+			length = min( length, reader.Remaining() );
+
+			receiver.Receive( string( reader.Position(), length ), changes, sequence, serverTime );
+			reader.Skip( length );
+		}
+	}
+
+
+	void FuzzTransformBatch( const string &data )
+	{
+		TransformCodec  codec;
+		QuantizedArrays quantized;
+		TransformArrays transforms;
+		uint64_t        serverTime;
+
+		BinaryReader reader( data );
+		if( !DecodeTransformBatch( reader, serverTime, quantized ) || !quantized.Size() )
+		{
+			return;
+		}
+
+		DequantizeArrays( codec, quantized, transforms );
+
+		// Encoded again it's the same packet, past the length, the type and the sub type
+		auto read    = data.size() - reader.Remaining();
+		auto encoded = EncodeTransformBatch( serverTime, quantized );
+		if( encoded.compare( 2 + 1 + 2, string::npos, data, 0, read ) )
+		{
+			Fail( "A transform batch didn't come back the same" );
+		}
+	}
+
+
+	void FuzzCompressed( const string &data )
+	{
+		string message, decompressed;
+		if( !DecompressPackets( data, message ) )
+		{
+			return;
+		}
+
+		auto compressed = Compress( message.data(), message.size() );
+		if( !Decompress( compressed.data(), compressed.size(), message.size(), decompressed ) || decompressed != message )
+		{
+			Fail( "Decompressed packets didn't come back the same from the compression" );
+		}
+	}
+
+
+	void Run( const uint8_t *data, size_t length )
+	{
+		if( !length )
+		{
+			return;
+		}
+
+		currentInput.assign( reinterpret_cast<const char*>( data ), length );
+		string rest( currentInput, 1 );
+
+		switch( data[0] % FUZZ_TARGET_COUNT )
+		{
+			case FUZZ_CLIENT_PACKET:
+				FuzzClientPacket( rest );
+				break;
+
+			case FUZZ_SERVER_MESSAGE:
+				FuzzServerMessage( rest );
+				break;
+
+			case FUZZ_WORLD_NODE:
+				FuzzObject<WorldNode>( rest );
+				break;
+
+			case FUZZ_ENTITY:
+				FuzzObject<Entity>( rest );
+				break;
+
+			case FUZZ_PHYSICS_OBJECT:
+				FuzzObject<PhysicsObject>( rest );
+				break;
+
+			case FUZZ_SNAPSHOTS:
+				FuzzSnapshots( rest );
+				break;
+
+			case FUZZ_TRANSFORM_BATCH:
+				FuzzTransformBatch( rest );
+				break;
+
+			case FUZZ_COMPRESSED:
+				FuzzCompressed( rest );
+				break;
+		}
+	}
+
+
+	// The errors of every broken input would drown out the rest
+	void Silence()
+	{
+		Logger::GetInstance().SetQuiet( true );
+		cerr.rdbuf( nullptr );
+	}
+}
+
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t length )
+{
+	Run( data, length );
+	return 0;
+}
+
+
+
+#ifndef CODEC_FUZZER_LIBFUZZER
+
+namespace
+{
+	// The bodies of the packets of the message, past the type and the sub type
+	vector<string> PacketBodies( const string &message )
+	{
+		vector<string> bodies;
+
+		BinaryReader reader( message );
+		while( reader.Remaining() >= sizeof( uint16_t ) )
+		{
+			auto length = reader.ReadUint16();
+			bodies.push_back( string( reader.Position() + 3, length - sizeof( uint16_t ) - 3 ) );
+			reader.Skip( length - sizeof( uint16_t ) );
+		}
+
+		return bodies;
+	}
+
+
+	string Seed( FuzzTarget target, const string &data )
+	{
+		return string( 1, static_cast<char>( target ) ) + data;
+	}
+
+
+	// Valid data of every target
+	vector<string> Seeds()
+	{
+		mt19937        generator( 1 );
+		TransformCodec codec;
+		vector<string> seeds;
+
+		seeds.push_back( Seed( FUZZ_CLIENT_PACKET, ViewpointPacket( 1.f, 2.f, 3.f, 100.f ) ) );
+		seeds.push_back( Seed( FUZZ_CLIENT_PACKET, HelloPacket( 1 ) ) );
+		seeds.push_back( Seed( FUZZ_CLIENT_PACKET, PingPacket( 1, 2 ) ) );
+		seeds.push_back( Seed( FUZZ_CLIENT_PACKET, PongPacket( 1, 2, 3 ) ) );
+
+		WorldNode     node;
+		Entity        entity;
+		PhysicsObject object;
+		Randomize( node, generator );
+		Randomize( entity, generator );
+		Randomize( object, generator );
+
+		seeds.push_back( Seed( FUZZ_WORLD_NODE,     node.Serialize() ) );
+		seeds.push_back( Seed( FUZZ_WORLD_NODE,     node.Serialize( { FIELD_POSITION, FIELD_ROTATION } ) ) );
+		seeds.push_back( Seed( FUZZ_ENTITY,         entity.Serialize() ) );
+		seeds.push_back( Seed( FUZZ_ENTITY,         entity.Serialize( { FIELD_MATERIAL, FIELD_MESH } ) ) );
+		seeds.push_back( Seed( FUZZ_PHYSICS_OBJECT, object.Serialize() ) );
+		seeds.push_back( Seed( FUZZ_PHYSICS_OBJECT, object.Serialize( { FIELD_VELOCITY, FIELD_COLLISION_SHAPE } ) ) );
+
+		// A full snapshot and deltas on it
+		auto first     = RandomSnapshot( codec, 40, generator );
+		auto second    = MoveSnapshot( codec, first, 3, generator );
+		auto third     = MoveSnapshot( codec, second, 3, generator );
+		auto snapshots = EncodeSnapshot( codec, 1, 1, first, 0, nullptr, 200 ) +
+		                 EncodeSnapshot( codec, 2, 2, second, 1, &first, 200 ) +
+		                 EncodeSnapshot( codec, 3, 3, third, 2, &second, 200 );
+
+		string bodies;
+		for( auto &body : PacketBodies( snapshots ) )
+		{
+			string length( 2, '\0' );
+			BinaryWriter( length ).WriteUint16( body.size() );
+			bodies += length + body;
+		}
+		seeds.push_back( Seed( FUZZ_SNAPSHOTS, bodies ) );
+
+		QuantizedArrays changed;
+		AppendChanged( second, &first, changed );
+		auto batch = EncodeTransformBatch( 4, changed );
+		seeds.push_back( Seed( FUZZ_TRANSFORM_BATCH, PacketBodies( batch )[0] ) );
+
+		auto join       = JoinMessage( 20, generator );
+		auto compressed = CompressPackets( join );
+		seeds.push_back( Seed( FUZZ_COMPRESSED, PacketBodies( compressed )[0] ) );
+
+		// The server sends all of them mixed
+		node.id = 2;
+		seeds.push_back( Seed( FUZZ_SERVER_MESSAGE, join ) );
+		seeds.push_back( Seed( FUZZ_SERVER_MESSAGE, compressed ) );
+		seeds.push_back( Seed( FUZZ_SERVER_MESSAGE,
+			JoinMessage( 4, generator ) +
+			ObjectUpdatePacket( node, { FIELD_POSITION, FIELD_SCALE } ) +
+			ObjectParentAddPacket( 3, 2 ) +
+			snapshots +
+			batch +
+			ObjectDestroyPacket( 2 )
+		) );
+
+		// The same events packed, ids going both ways
+		ObjectMessageWriter packed( true );
+		packed.Update( 2, node.Serialize( { FIELD_POSITION, FIELD_SCALE } ) );
+		packed.ParentAdd( 3, 2 );
+		packed.Destroy( 1 );
+		seeds.push_back( Seed( FUZZ_SERVER_MESSAGE, JoinMessage( 20, generator, true ) ) );
+		seeds.push_back( Seed( FUZZ_SERVER_MESSAGE, JoinMessage( 4, generator, true ) + packed.Finish() ) );
+
+		return seeds;
+	}
+
+
+	void Mutate( string &input, mt19937 &generator )
+	{
+		static const uint8_t interesting[] = { 0, 1, 2, 0x7f, 0x80, 0xfe, 0xff };
+
+		auto   mutations = 1 + generator() % 8;
+		size_t offset, length;
+
+		for( size_t i = 0; i < mutations && input.size() > 1; i++ )
+		{
+			// The first byte stays, it's the target
+			offset = 1 + generator() % ( input.size() - 1 );
+			length = 1 + generator() % min<size_t>( 16, input.size() - offset );
+
+			switch( generator() % 6 )
+			{
+				case 0:
+					input[offset] ^= static_cast<char>( 1 << ( generator() % 8 ) );
+					break;
+
+				case 1:
+					input[offset] = static_cast<char>( interesting[generator() % sizeof( interesting )] );
+					break;
+
+				case 2:
+					input.resize( offset );
+					break;
+
+				case 3:
+					input.erase( offset, length );
+					break;
+
+				case 4:
+					for( size_t j = 0; j < length; j++ )
+					{
+						input.insert( input.begin() + offset, static_cast<char>( generator() ) );
+					}
+					break;
+
+				default:
+					input.insert( offset + generator() % ( input.size() - offset ), input.substr( offset, length ) );
+					break;
+			}
+		}
+	}
+
+
+	void InstallCrashHandlers()
+	{
+#ifdef CODEC_FUZZER_SANITIZED
+		__sanitizer_set_death_callback( SaveCrash );
+#else
+		std::signal( SIGSEGV, HandleCrash );
+		std::signal( SIGBUS,  HandleCrash );
+		std::signal( SIGFPE,  HandleCrash );
+		std::signal( SIGILL,  HandleCrash );
+#endif
+		std::signal( SIGABRT, HandleCrash );
+	}
+
+
+	bool ReadFile( const string &path, string &data )
+	{
+		ifstream file( path, ios::binary );
+		if( !file )
+		{
+			return false;
+		}
+
+		stringstream stream;
+		stream << file.rdbuf();
+		data = stream.str();
+		return true;
+	}
+
+
+	int Replay( int count, char *paths[] )
+	{
+		string data;
+		for( int i = 0; i < count; i++ )
+		{
+			if( !ReadFile( paths[i], data ) )
+			{
+				cout << "Can't read " << paths[i] << endl;
+				return 1;
+			}
+
+			Run( reinterpret_cast<const uint8_t*>( data.data() ), data.size() );
+			cout << paths[i] << ": ok" << endl;
+		}
+
+		return 0;
+	}
+
+
+	int WriteSeeds( const string &directory )
+	{
+		auto seeds = Seeds();
+		for( size_t i = 0; i < seeds.size(); i++ )
+		{
+			currentInput = seeds[i];
+			SaveInput( directory + "/seed-" + to_string( i ) );
+		}
+
+		cout << "Wrote " << seeds.size() << " seeds to " << directory << endl;
+		return 0;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	Silence();
+	InstallCrashHandlers();
+
+	if( argc > 1 && string( argv[1] ) == "--replay" )
+	{
+		return Replay( argc - 2, argv + 2 );
+	}
+
+	if( argc > 2 && string( argv[1] ) == "--seeds" )
+	{
+		return WriteSeeds( argv[2] );
+	}
+
+	size_t   iterations = argc > 1 ? strtoul( argv[1], nullptr, 10 ) : 1000000;
+	uint32_t seed       = argc > 2 ? strtoul( argv[2], nullptr, 10 ) : 1;
+
+	mt19937 generator( seed );
+	auto    seeds = Seeds();
+
+	// The seeds have to go through as they are
+	for( auto &input : seeds )
+	{
+		Run( reinterpret_cast<const uint8_t*>( input.data() ), input.size() );
+	}
+
+	string input;
+	for( size_t i = 0; i < iterations; i++ )
+	{
+		input = seeds[generator() % seeds.size()];
+		Mutate( input, generator );
+		Run( reinterpret_cast<const uint8_t*>( input.data() ), input.size() );
+
+		if( ( i + 1 ) % 100000 == 0 )
+		{
+			cout << i + 1 << " inputs" << endl;
+		}
+	}
+
+	cout << iterations << " inputs of " << seeds.size() << " seeds without a failure" << endl;
+	return 0;
+}
+
+#else
+
+extern "C" int LLVMFuzzerInitialize( int*, char*** )
+{
+	Silence();
+	return 0;
+}
+
+#endif
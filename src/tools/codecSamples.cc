@@ -0,0 +1,235 @@
+#include "codecSamples.hh"
+#include "../network/binaryStream.hh"
+#include "../network/objectMessage.hh"
+#include "../events/event.hh"
+
+using namespace std;
+
+
+namespace
+{
+	float RandomFloat( mt19937 &generator )
+	{
+		return uniform_real_distribution<float>( -1000.f, 1000.f )( generator );
+	}
+
+
+	NodeTransform RandomTransform( uint32_t id, mt19937 &generator )
+	{
+		uniform_real_distribution<float> component( -1.f, 1.f );
+
+		NodeTransform transform;
+		transform.id       = id;
+		transform.position = glm::vec3( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) );
+		transform.rotation = glm::normalize( glm::quat(
+			component( generator ), component( generator ), component( generator ), component( generator )
+		) );
+		return transform;
+	}
+}
+
+
+
+void Randomize( WorldNode &node, mt19937 &generator )
+{
+	node.id = generator();
+	node.position.Update( glm::vec3( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) ) );
+	node.rotation.Update( glm::quat( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) ) );
+	node.scale = glm::vec3( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) );
+}
+
+
+
+void Randomize( Entity &entity, mt19937 &generator )
+{
+	Randomize( static_cast<WorldNode&>( entity ), generator );
+	entity.material.color = glm::vec4( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) );
+	entity.mesh    = "mesh" + to_string( generator() % 100 );
+	entity.texture = "texture" + to_string( generator() % 100 );
+}
+
+
+
+void Randomize( PhysicsObject &object, mt19937 &generator )
+{
+	Randomize( static_cast<Entity&>( object ), generator );
+	object.velocity        = glm::vec3( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) );
+	object.angularVelocity = glm::quat( RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ), RandomFloat( generator ) );
+	object.mass            = RandomFloat( generator );
+	object.collisionShape.type   = COLLISION_SHAPE_AABB;
+	object.collisionShape.aabb.x = RandomFloat( generator );
+	object.collisionShape.aabb.y = RandomFloat( generator );
+	object.collisionShape.aabb.w = RandomFloat( generator );
+	object.collisionShape.aabb.h = RandomFloat( generator );
+}
+
+
+
+string ObjectCreatePacket( WorldNode &node )
+{
+	auto data = node.Serialize();
+
+	string packet( 2 + 1 + 2 + 1 + data.size(), '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint16( packet.size() );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_CREATE );
+	writer.WriteUint8( node.type );
+	writer.WriteBytes( data );
+
+	return packet;
+}
+
+
+
+string ObjectUpdatePacket( WorldNode &node, const vector<FieldId> &fields )
+{
+	auto data = node.Serialize( fields );
+
+	string packet( 2 + 1 + 2 + 4 + data.size(), '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint16( packet.size() );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_UPDATE );
+	writer.WriteUint32( node.id );
+	writer.WriteBytes( data );
+
+	return packet;
+}
+
+
+
+string ObjectParentAddPacket( uint32_t objectId, uint32_t parentId )
+{
+	string packet( 2 + 1 + 2 + 4 + 4, '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint16( packet.size() );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_PARENT_ADD );
+	writer.WriteUint32( objectId );
+	writer.WriteUint32( parentId );
+
+	return packet;
+}
+
+
+
+string ObjectDestroyPacket( uint32_t objectId )
+{
+	string packet( 2 + 1 + 2 + 4, '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint16( packet.size() );
+	writer.WriteUint8( OBJECT_EVENT );
+	writer.WriteUint16( OBJECT_DESTROY );
+	writer.WriteUint32( objectId );
+
+	return packet;
+}
+
+
+
+string ViewpointPacket( float x, float y, float z, float radius )
+{
+	string packet( 1 + 2 + 4 * 4, '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_VIEWPOINT );
+	writer.WriteFloat( x );
+	writer.WriteFloat( y );
+	writer.WriteFloat( z );
+	writer.WriteFloat( radius );
+
+	return packet;
+}
+
+
+
+string HelloPacket( uint32_t capabilities )
+{
+	string packet( 1 + 2 + 4, '\0' );
+	BinaryWriter writer( packet );
+
+	writer.WriteUint8( NETWORK_EVENT );
+	writer.WriteUint16( NETWORK_HELLO );
+	writer.WriteUint32( capabilities );
+
+	return packet;
+}
+
+
+
+TransformSnapshot RandomSnapshot( const TransformCodec &codec, size_t count, mt19937 &generator )
+{
+	TransformSnapshot snapshot;
+	snapshot.reserve( count );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		snapshot.push_back( QuantizeTransform( codec, RandomTransform( static_cast<uint32_t>( i + 1 ), generator ) ) );
+	}
+
+	return snapshot;
+}
+
+
+
+TransformSnapshot MoveSnapshot( const TransformCodec &codec, const TransformSnapshot &snapshot, size_t moved, mt19937 &generator )
+{
+	auto next = snapshot;
+	for( auto &node : next )
+	{
+		if( moved && generator() % moved == 0 )
+		{
+			node = QuantizeTransform( codec, RandomTransform( node.id, generator ) );
+		}
+	}
+
+	return next;
+}
+
+
+
+string JoinMessage( size_t count, mt19937 &generator, bool packed )
+{
+	ObjectMessageWriter message( packed );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		WorldNode     node;
+		Entity        entity;
+		PhysicsObject object;
+
+		WorldNode *created = &node;
+		auto       type    = generator() % 3;
+
+		if( type == 0 )
+		{
+			Randomize( node, generator );
+		}
+		else if( type == 1 )
+		{
+			Randomize( entity, generator );
+			created = &entity;
+		}
+		else
+		{
+			Randomize( object, generator );
+			created = &object;
+		}
+
+		created->id = static_cast<uint32_t>( i + 1 );
+		message.Create( created->id, created->type, created->Serialize() );
+	}
+
+	for( size_t i = 1; i < count; i++ )
+	{
+		message.ParentAdd( static_cast<uint32_t>( i + 1 ), static_cast<uint32_t>( generator() % i + 1 ) );
+	}
+
+	return message.Finish();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+#include "../world/worldNode.hh"
+#include "../world/entity.hh"
+#include "../physics/physicsObject.hh"
+#include "../network/snapshot.hh"
+#include "../network/transformCodec.hh"
+
+
+// Valid data of every codec built from random values, for what the
+// codec benchmark measures and what the fuzzer starts mutating from.
+// The packets come with their length in front unless told otherwise.
+
+void Randomize( WorldNode &node, std::mt19937 &generator );
+void Randomize( Entity &entity, std::mt19937 &generator );
+void Randomize( PhysicsObject &object, std::mt19937 &generator );
+
+std::string ObjectCreatePacket( WorldNode &node );
+std::string ObjectUpdatePacket( WorldNode &node, const std::vector<FieldId> &fields );
+std::string ObjectParentAddPacket( uint32_t objectId, uint32_t parentId );
+std::string ObjectDestroyPacket( uint32_t objectId );
+
+// What the clients send, without the length as the server
+// gets them in its DataInEvents
+std::string ViewpointPacket( float x, float y, float z, float radius );
+std::string HelloPacket( uint32_t capabilities );
+
+// Nodes with ids from 1 up at random places, sorted by id
+TransformSnapshot RandomSnapshot( const TransformCodec &codec, size_t count, std::mt19937 &generator );
+
+// The same nodes with about every moved-th one moved
+TransformSnapshot MoveSnapshot( const TransformCodec &codec, const TransformSnapshot &snapshot, size_t moved, std::mt19937 &generator );
+
+// What a join sends: the creations of the nodes with random
+// types followed by their parents, packed into OBJECT_PACKED
+// packets if asked to
+std::string JoinMessage( size_t count, std::mt19937 &generator, bool packed = false );
@@ -0,0 +1,308 @@
+// Measures how fast the packets the server and the clients exchange
+// are turned into events, with the PacketDecoder and with the
+// stringstream parsing it replaced. Then the same for whole messages
+// of object updates through the ServerMessageParser, against the loop
+// that cut the message with substr after every packet.
+//
+// usage: belowDecoderBench [packets] [rounds] [updates per message]
+
+#include "../network/packetDecoder.hh"
+#include "../network/serverMessageParser.hh"
+#include "streamSerialization.hh"
+#include "../network/networkEvents.hh"
+#include "../world/objectEvents.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <functional>
+#include <climits>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+namespace
+{
+	// A mix of what goes over the wire: mostly updates
+	// and parent links, some creations and viewpoints
+	vector<string> MakePackets( size_t count )
+	{
+		mt19937 random( 1 );
+		vector<string> packets;
+		packets.reserve( count );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			stringstream stream(
+				stringstream::in |
+				stringstream::out |
+				stringstream::binary
+			);
+
+			switch( random() % 8 )
+			{
+				case 0:
+					SerializeUint8( stream, (uint8_t)OBJECT_EVENT );
+					SerializeUint16( stream, (uint16_t)OBJECT_CREATE );
+					SerializeUint8( stream, 1 );
+					stream << "id:" << i << ";position:1.5,2.5,3.5;rotation:0,0,0,1;scale:1,1,1;";
+					break;
+
+				case 1:
+				case 2:
+					SerializeUint8( stream, (uint8_t)OBJECT_EVENT );
+					SerializeUint16( stream, (uint16_t)OBJECT_PARENT_ADD );
+					SerializeUint32( stream, i );
+					SerializeUint32( stream, 1 );
+					break;
+
+				case 3:
+					SerializeUint8( stream, (uint8_t)NETWORK_EVENT );
+					SerializeUint16( stream, (uint16_t)NETWORK_VIEWPOINT );
+					SerializeFloat( stream, 1.f );
+					SerializeFloat( stream, 2.f );
+					SerializeFloat( stream, 3.f );
+					SerializeFloat( stream, DEFAULT_VIEW_RADIUS );
+					break;
+
+				default:
+					SerializeUint8( stream, (uint8_t)OBJECT_EVENT );
+					SerializeUint16( stream, (uint16_t)OBJECT_UPDATE );
+					SerializeUint32( stream, i );
+					stream << "position:1.5,2.5,3.5;";
+					break;
+			}
+
+			packets.push_back( stream.str() );
+		}
+
+		return packets;
+	}
+
+
+	// How the packets were parsed before the decoder
+	Event* StreamDecode( const string &packet )
+	{
+		stringstream stream(
+			stringstream::in |
+			stringstream::out |
+			stringstream::binary
+		);
+		stream << packet;
+
+		auto type    = static_cast<EventType>( UnserializeUint8( stream ) );
+		auto subType = static_cast<EventSubType>( UnserializeUint16( stream ) );
+
+		if( type >= EVENT_TYPE_COUNT || subType >= EVENT_SUB_TYPE_COUNT )
+		{
+			return nullptr;
+		}
+
+		stringstream dataStream(
+			stringstream::in |
+			stringstream::out |
+			stringstream::binary
+		);
+
+		char buffer[USHRT_MAX];
+		size_t dataCount;
+
+		ObjectCreateEvent    *create;
+		ObjectUpdateEvent    *update;
+		ObjectParentAddEvent *parentAdd;
+		ViewpointEvent       *viewpoint;
+
+		switch( subType )
+		{
+			case OBJECT_CREATE:
+				create = new ObjectCreateEvent();
+				create->objectType = static_cast<WorldObjectType>( UnserializeUint8( stream ) );
+				dataCount = stream.str().length() - 4;
+				stream.read( buffer, dataCount );
+				dataStream.write( buffer, dataCount );
+				create->data = dataStream.str();
+				return create;
+
+			case OBJECT_UPDATE:
+				update = new ObjectUpdateEvent();
+				update->objectId = UnserializeUint32( stream );
+				dataCount = stream.str().length() - 7;
+				stream.read( buffer, dataCount );
+				dataStream.write( buffer, dataCount );
+				update->data = dataStream.str();
+				return update;
+
+			case OBJECT_PARENT_ADD:
+				parentAdd = new ObjectParentAddEvent();
+				parentAdd->objectId = UnserializeUint32( stream );
+				parentAdd->parentId = UnserializeUint32( stream );
+				return parentAdd;
+
+			case NETWORK_VIEWPOINT:
+				viewpoint = new ViewpointEvent();
+				viewpoint->x      = UnserializeFloat( stream );
+				viewpoint->y      = UnserializeFloat( stream );
+				viewpoint->z      = UnserializeFloat( stream );
+				viewpoint->radius = UnserializeFloat( stream );
+				return viewpoint;
+
+			default:
+				return nullptr;
+		}
+	}
+
+
+	// A message like the server sends on a busy tick
+	string MakeUpdateMessage( size_t count )
+	{
+		stringstream stream(
+			stringstream::in |
+			stringstream::out |
+			stringstream::binary
+		);
+
+		string body = "position:1.5,2.5,3.5;";
+		for( size_t i = 0; i < count; i++ )
+		{
+			SerializeUint16( stream, 2 + 1 + 2 + 4 + body.size() );
+			SerializeUint8( stream, (uint8_t)OBJECT_EVENT );
+			SerializeUint16( stream, (uint16_t)OBJECT_UPDATE );
+			SerializeUint32( stream, i );
+			stream << body;
+		}
+
+		return stream.str();
+	}
+
+
+	// How the messages were split before the single pass parser
+	size_t SubstrParse( const PacketDecoder &decoder, string data )
+	{
+		size_t decoded = 0;
+
+		while( data.size() > 0 )
+		{
+			stringstream stream(
+				stringstream::in |
+				stringstream::out |
+				stringstream::binary
+			);
+
+			stream << data;
+
+			auto packetLength = UnserializeUint16( stream );
+			if( packetLength > data.size() )
+			{
+				packetLength = data.size() >= 2 ? data.size() - 2 : 1;
+			}
+
+			auto currentPacket = data.substr( 2, packetLength-2 );
+			data = data.substr( packetLength );
+
+			auto e = decoder.Decode( currentPacket );
+			decoded += e != nullptr;
+			delete e;
+		}
+
+		return decoded;
+	}
+
+
+	void MeasureMessage( const string &name, size_t updates, int rounds, function<size_t()> parse )
+	{
+		size_t decoded = 0;
+
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			decoded += parse();
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 14 ) << name << ": "
+		     << seconds * 1e3 / rounds << " ms per " << updates << " update message"
+		     << ", " << decoded / seconds / 1e6 << " M packets/s" << endl;
+	}
+
+
+	template<typename Decode>
+	void Measure( const string &name, const vector<string> &packets, int rounds, Decode decode )
+	{
+		size_t decoded = 0;
+
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			for( auto &packet : packets )
+			{
+				auto e = decode( packet );
+				decoded += e != nullptr;
+				delete e;
+			}
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 14 ) << name << ": "
+		     << decoded / seconds / 1e6 << " M packets/s"
+		     << ", " << seconds * 1e9 / decoded << " ns per packet" << endl;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count   = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    rounds  = argc > 2 ? atoi( argv[2] ) : 10;
+	size_t updates = argc > 3 ? atoi( argv[3] ) : 10000;
+
+	auto packets = MakePackets( count );
+
+	PacketDecoder decoder;
+	Measure( "PacketDecoder", packets, rounds,
+		[&decoder]( const string &packet )
+		{
+			return decoder.Decode( packet );
+		}
+	);
+
+	Measure( "stringstream", packets, rounds, StreamDecode );
+
+
+	auto message = MakeUpdateMessage( updates );
+
+	size_t parsed = 0;
+	ServerMessageParser parser(
+		[&parsed]( Event *e )
+		{
+			parsed++;
+			delete e;
+		},
+		nullptr
+	);
+
+	MeasureMessage( "single pass", updates, rounds,
+		[&]()
+		{
+			parsed = 0;
+			parser.Parse( message, nullptr );
+			return parsed;
+		}
+	);
+
+	MeasureMessage( "substr", updates, rounds,
+		[&]()
+		{
+			return SubstrParse( decoder, message );
+		}
+	);
+
+	return 0;
+}
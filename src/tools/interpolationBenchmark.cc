@@ -0,0 +1,135 @@
+// Measures what the smoothing of the node transforms costs the client
+// per frame: extrapolating with Smooth::Calculate() like the client did
+// before, against interpolating between the buffered samples with
+// Smooth::Interpolate(). Also the cost of taking in a snapshot that
+// moved every node.
+//
+// usage: belowInterpBench [nodes] [frames]
+
+#include "../smooth.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+#define BENCH_TICK_MS 100
+
+
+namespace
+{
+	// The transforms of a WorldNode, allocated one by one like them
+	struct Node
+	{
+		Smooth<glm::vec3> position;
+		Smooth<glm::quat> rotation;
+	};
+
+
+	void Measure( const string &name, size_t nodes, int frames, function<void( int )> frame )
+	{
+		auto started = Clock::now();
+		for( int i = 0; i < frames; i++ )
+		{
+			frame( i );
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 12 ) << name << ": "
+		     << seconds * 1e3 / frames << " ms per frame"
+		     << ", " << seconds * 1e9 / frames / nodes << " ns per node" << endl;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    frames = argc > 2 ? atoi( argv[2] ) : 100;
+
+	mt19937 random( 1 );
+	uniform_real_distribution<float> place( -500.f, 500.f );
+	uniform_real_distribution<float> step( -1.f, 1.f );
+
+	vector<shared_ptr<Node>> nodes;
+	nodes.reserve( count );
+	for( size_t i = 0; i < count; i++ )
+	{
+		nodes.push_back( make_shared<Node>() );
+	}
+
+	// A full history of snapshots that moved every node
+	auto now   = Clock::now();
+	auto start = now - chrono::milliseconds( BENCH_TICK_MS * SMOOTH_HISTORY_LENGTH );
+
+	for( auto &node : nodes )
+	{
+		glm::vec3 position( place( random ), 0.f, place( random ) );
+		glm::quat rotation;
+
+		for( int sample = 0; sample < SMOOTH_HISTORY_LENGTH; sample++ )
+		{
+			auto time = start + chrono::milliseconds( BENCH_TICK_MS * sample );
+			position += glm::vec3( step( random ), 0.f, step( random ) );
+			rotation  = glm::angleAxis( step( random ), glm::vec3( 0.f, 1.f, 0.f ) ) * rotation;
+
+			node->position.Update( position, time );
+			node->rotation.Update( rotation, time );
+		}
+	}
+
+	cout << count << " nodes, " << sizeof( Node ) << " bytes of transforms per node" << endl;
+
+	Measure( "Calculate", count, frames,
+		[&]( int )
+		{
+			for( auto &node : nodes )
+			{
+				node->position.Calculate( 0.9f );
+				node->rotation.Calculate();
+			}
+		}
+	);
+
+	// Render times sweep over the buffered samples
+	InterpolationDelay interpolation;
+	interpolation.SetDelay( BENCH_TICK_MS * ( SMOOTH_HISTORY_LENGTH - 1 ) / 2.f );
+
+	Measure( "Interpolate", count, frames,
+		[&]( int frame )
+		{
+			auto renderTime = interpolation.RenderTime( now + chrono::milliseconds( frame ) );
+			for( auto &node : nodes )
+			{
+				node->position.Interpolate( renderTime );
+				node->rotation.Interpolate( renderTime );
+			}
+		}
+	);
+
+	// One snapshot per frame, newer than the buffered ones
+	Measure( "Update", count, frames,
+		[&]( int frame )
+		{
+			auto time = now + chrono::milliseconds( BENCH_TICK_MS * ( frame + 1 ) );
+			for( auto &node : nodes )
+			{
+				node->position.Update( node->position.Raw(), time );
+				node->rotation.Update( node->rotation.Raw(), time );
+			}
+		}
+	);
+
+	return 0;
+}
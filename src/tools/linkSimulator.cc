@@ -0,0 +1,366 @@
+// Replays the snapshot replication over a simulated throttled link
+// to see how the update scheduling copes with slow connections.
+//
+// usage: belowLinkSim [nodes] [link bytes/s] [budget bytes/s|adaptive] [loss %] [seconds] [stream bytes/s]
+//
+// A budget of 0 sends every change on every tick like the server
+// did before the scheduler. An adaptive one starts from the default
+// and follows the link like the server's does, from the acknowledged
+// snapshots, the round trip time of pings that wait in the same
+// queue as the datagrams and the backlog of the reliable stream.
+// It's printed every second to see it settle.
+//
+// The stream carries the given bytes per second besides the
+// snapshots, over the same link. The socket takes them as long as
+// its send buffer has room, the rest waits in the write queue.
+
+#include "../network/snapshot.hh"
+#include "../network/packets.hh"
+#include "../network/connectionStatistics.hh"
+#include "../server/updateScheduler.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+
+#define SIM_STEP_MS       10
+#define SIM_TICK_MS       100
+#define SIM_LATENCY_MS    50
+#define SIM_MAX_QUEUE_MS  2000
+#define SIM_VIEW_RADIUS   100.f
+
+// Bytes of the stream the socket takes ahead of the link
+#define SIM_SEND_BUFFER   ( 16 * 1024 )
+
+
+namespace
+{
+	struct SimNode
+	{
+		glm::vec3 position;
+		glm::vec3 velocity;
+	};
+
+
+	struct Datagram
+	{
+		double arrival;
+		string data;
+	};
+
+
+	// Link that sends bytesPerSecond and drops what would
+	// have to wait in the queue for too long
+	struct ThrottledLink
+	{
+		double bytesPerSecond;
+		double lossRate;
+		double freeAt;
+		size_t dropped;
+		deque<Datagram> inFlight;
+
+		void Send( double now, const string &data, mt19937 &random )
+		{
+			double start = max( now, freeAt );
+			if( start - now > SIM_MAX_QUEUE_MS / 1000.0 ||
+			    uniform_real_distribution<double>( 0, 1 )( random ) < lossRate )
+			{
+				dropped++;
+				return;
+			}
+
+			freeAt = start + data.size() / bytesPerSecond;
+			inFlight.push_back( { freeAt + SIM_LATENCY_MS / 1000.0, data } );
+		}
+
+		// Moves what the socket's send buffer has room for from the
+		// stream's backlog to the link, it's never dropped
+		void Stream( double now, size_t &backlog )
+		{
+			double room = SIM_SEND_BUFFER - QueueDelay( now ) * bytesPerSecond;
+			if( room <= 0.0 || !backlog )
+			{
+				return;
+			}
+
+			auto taken = min( backlog, static_cast<size_t>( room ) );
+			freeAt   = max( now, freeAt ) + taken / bytesPerSecond;
+			backlog -= taken;
+		}
+
+		double QueueDelay( double now ) const
+		{
+			return max( 0.0, freeAt - now );
+		}
+	};
+
+
+	float Percentile( vector<float> values, float fraction )
+	{
+		if( values.empty() )
+		{
+			return 0.f;
+		}
+
+		auto nth = values.begin() + static_cast<size_t>( fraction * ( values.size() - 1 ) );
+		nth_element( values.begin(), nth, values.end() );
+		return *nth;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t nodeCount  = argc > 1 ? atoi( argv[1] ) : 2000;
+	double linkRate   = argc > 2 ? atof( argv[2] ) : 32 * 1024;
+	bool   adaptive   = argc <= 3 || string( argv[3] ) == "adaptive";
+	size_t budget     = adaptive ? CLIENT_BYTES_PER_SECOND : atoi( argv[3] );
+	double lossRate   = argc > 4 ? atof( argv[4] ) / 100.0 : 0.0;
+	int    seconds    = argc > 5 ? atoi( argv[5] ) : 30;
+	double streamRate = argc > 6 ? atof( argv[6] ) : 0.0;
+
+	if( nodeCount < 1 || linkRate <= 0.0 || seconds < 1 || streamRate < 0.0 )
+	{
+		cout << "usage: " << argv[0] << " [nodes] [link bytes/s] [budget bytes/s|adaptive] [loss %] [seconds] [stream bytes/s]" << endl;
+		return 1;
+	}
+
+	mt19937 random( 1 );
+	uniform_real_distribution<float> place( -SIM_VIEW_RADIUS, SIM_VIEW_RADIUS );
+	uniform_real_distribution<float> speed( -5.f, 5.f );
+
+	// A fifth of the nodes keep moving around
+	vector<SimNode> world( nodeCount );
+	for( size_t i = 0; i < nodeCount; i++ )
+	{
+		world[i].position = glm::vec3( place( random ), 0.f, place( random ) );
+		if( i % 5 == 0 )
+		{
+			world[i].velocity = glm::vec3( speed( random ), 0.f, speed( random ) );
+		}
+	}
+
+	TransformCodec   codec;
+	UpdateScheduler  scheduler( budget );
+	SnapshotHistory  history;
+	SnapshotReceiver receiver( codec );
+	ThrottledLink    link{ linkRate, lossRate, 0.0, 0, {} };
+
+	// The client starts with everything, as if created over TCP
+	vector<glm::vec3> clientPositions;
+	for( auto &node : world )
+	{
+		clientPositions.push_back( node.position );
+	}
+
+	uint32_t sequence = 0;
+	uint32_t acked    = 0;
+	bool     hasAck   = false;
+	deque<pair<double, uint32_t>> acks;
+
+	size_t        bytesSent = 0;
+	vector<float> errors, queueDelays, backlogs;
+
+	// Written to the stream but not taken by the socket yet
+	size_t streamBacklog = 0;
+
+	float rtt = 0.f;
+	deque<pair<double, float>> pongs;
+
+	if( adaptive )
+	{
+		cout << "    s    budget kB/s   acked kB/s   rtt ms   queue ms   backlog kB" << endl;
+	}
+
+	for( int step = 0; step * SIM_STEP_MS < seconds * 1000; step++ )
+	{
+		double now = step * SIM_STEP_MS / 1000.0;
+
+		for( auto &node : world )
+		{
+			node.position += node.velocity * ( SIM_STEP_MS / 1000.f );
+			if( fabs( node.position.x ) > SIM_VIEW_RADIUS ) node.velocity.x = -node.velocity.x;
+			if( fabs( node.position.z ) > SIM_VIEW_RADIUS ) node.velocity.z = -node.velocity.z;
+		}
+
+		link.Stream( now, streamBacklog );
+
+		// A ping waits behind the datagrams queued before it and,
+		// as it goes over the stream, the stream's backlog
+		if( step % ( PING_INTERVAL_MS / SIM_STEP_MS ) == 0 )
+		{
+			float sample = ( link.QueueDelay( now ) + streamBacklog / linkRate + 2.0 * SIM_LATENCY_MS / 1000.0 ) * 1000.0;
+			pongs.push_back( { now + sample / 1000.0, sample } );
+		}
+
+		while( !pongs.empty() && pongs.front().first <= now )
+		{
+			rtt = pongs.front().second;
+			pongs.pop_front();
+		}
+
+		// Server tick
+		if( step % ( SIM_TICK_MS / SIM_STEP_MS ) == 0 )
+		{
+			TransformSnapshot current;
+			for( size_t i = 0; i < nodeCount; i++ )
+			{
+				NodeTransform transform{ static_cast<uint32_t>( i + 1 ), world[i].position, glm::quat() };
+				current.push_back( QuantizeTransform( codec, transform ) );
+			}
+
+			sequence++;
+			auto snapshot = make_shared<TransformSnapshot>( current );
+
+			if( adaptive )
+			{
+				// Only the stream goes through a write queue
+				LinkState state{ hasAck, acked, rtt, streamBacklog };
+				scheduler.Adapt( state, chrono::milliseconds( SIM_TICK_MS ) );
+			}
+
+			// Scheduled against what the snapshot is encoded against
+			auto baseline = hasAck ? history.Find( acked ) : nullptr;
+
+			// The stream is written on every tick whatever the budget,
+			// like the updates of the fields, and takes from it
+			auto written = static_cast<size_t>( streamRate * SIM_TICK_MS / 1000.0 );
+			streamBacklog += written;
+			bytesSent     += written;
+
+			if( budget > 0 )
+			{
+				auto available = scheduler.Refill( chrono::milliseconds( SIM_TICK_MS ) ) - static_cast<long>( written );
+				scheduler.Spend( written );
+				snapshot = scheduler.Schedule(
+					codec,
+					current,
+					baseline.get(),
+					[&world]( unsigned int id )
+					{
+						return glm::length( world[id - 1].position );
+					},
+					SIM_VIEW_RADIUS,
+					available
+				);
+			}
+
+			auto message = EncodeSnapshot(
+				codec,
+				sequence,
+				static_cast<uint64_t>( now * 1000000.0 ),
+				*snapshot,
+				acked,
+				baseline.get(),
+				MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH
+			);
+
+			history.Store( sequence, snapshot );
+			scheduler.Spend( message.size() );
+			scheduler.Sent( sequence, message.size() );
+
+			for( auto &datagram : SplitPackets( message, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH ) )
+			{
+				bytesSent += datagram.size() + DATAGRAM_HEADER_LENGTH;
+				link.Send( now, datagram, random );
+			}
+
+			queueDelays.push_back( link.QueueDelay( now ) * 1000.f );
+			backlogs.push_back( streamBacklog / 1024.f );
+
+			if( adaptive && step % ( 1000 / SIM_STEP_MS ) == 0 )
+			{
+				cout << fixed << setprecision( 1 )
+				     << setw( 5 ) << now
+				     << setw( 15 ) << scheduler.Bandwidth() / 1024.0
+				     << setw( 13 ) << scheduler.Throughput() / 1024.0
+				     << setw( 9 ) << rtt
+				     << setw( 11 ) << link.QueueDelay( now ) * 1000.0
+				     << setw( 13 ) << streamBacklog / 1024.0 << endl;
+			}
+		}
+
+		// Client receives
+		while( !link.inFlight.empty() && link.inFlight.front().arrival <= now )
+		{
+			auto data = link.inFlight.front().data;
+			link.inFlight.pop_front();
+
+			size_t offset = 0;
+			while( offset + 5 <= data.size() )
+			{
+				uint16_t length;
+				memcpy( &length, data.data() + offset, sizeof( length ) );
+				if( length < 5 || offset + length > data.size() )
+				{
+					break;
+				}
+
+				vector<NodeTransform> changes;
+				uint32_t completed;
+				uint64_t serverTime;
+				if( receiver.Receive( data.substr( offset + 5, length - 5 ), changes, completed, serverTime ) )
+				{
+					acks.push_back( { now + SIM_LATENCY_MS / 1000.0, completed } );
+				}
+
+				for( auto &change : changes )
+				{
+					clientPositions[change.id - 1] = change.position;
+				}
+
+				offset += length;
+			}
+		}
+
+		// Server receives the acks
+		while( !acks.empty() && acks.front().first <= now )
+		{
+			if( !hasAck || IsNewerSequence( acks.front().second, acked ) )
+			{
+				acked  = acks.front().second;
+				hasAck = true;
+			}
+			acks.pop_front();
+		}
+
+		// How far off the client is for the nodes close to the viewer
+		if( step % ( SIM_TICK_MS / SIM_STEP_MS ) == 0 )
+		{
+			for( size_t i = 0; i < nodeCount; i++ )
+			{
+				if( glm::length( world[i].position ) < SIM_VIEW_RADIUS * 0.25f )
+				{
+					errors.push_back( glm::length( world[i].position - clientPositions[i] ) );
+				}
+			}
+		}
+	}
+
+	cout << fixed << setprecision( 2 )
+	     << "nodes " << nodeCount
+	     << ", link " << linkRate / 1024 << " kB/s"
+	     << ", budget " << ( adaptive ? "adaptive, " + to_string( scheduler.Bandwidth() / 1024 ) + " kB/s in the end" :
+	                          budget ? to_string( budget / 1024 ) + " kB/s" : string( "none" ) )
+	     << ", loss " << lossRate * 100 << "%"
+	     << ", stream " << streamRate / 1024 << " kB/s" << endl
+	     << "sent " << bytesSent / 1024.0 / seconds << " kB/s"
+	     << ", dropped " << link.dropped << " datagrams" << endl
+	     << "queue delay ms: median " << Percentile( queueDelays, 0.5f )
+	     << ", 95% " << Percentile( queueDelays, 0.95f ) << endl
+	     << "stream backlog kB: median " << Percentile( backlogs, 0.5f )
+	     << ", 95% " << Percentile( backlogs, 0.95f ) << endl
+	     << "error of near nodes: median " << Percentile( errors, 0.5f )
+	     << ", 95% " << Percentile( errors, 0.95f ) << endl;
+
+	return 0;
+}
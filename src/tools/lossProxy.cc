@@ -0,0 +1,349 @@
+// Sits between the clients and a server on loopback to test the
+// unreliable channel of the snapshots: the TCP stream is passed on as
+// it is, the datagrams both ways get dropped, delayed and reordered.
+//
+// usage: belowLossProxy [server port] [loss %] [reorder %] [delay ms]
+//
+// Start the server on another port (belowServer --port 22002) and the
+// clients as usual, the proxy listens on the port they connect to. A
+// reordered datagram waits PROXY_REORDER_MS more than the delay, so
+// the ones sent after it overtake it. What was passed on, dropped and
+// reordered is printed every few seconds.
+
+#include <boost/asio.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <map>
+
+using namespace std;
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+using namespace boost;
+
+
+// Port the clients connect to
+#define PROXY_PORT 22001
+
+// Milliseconds a reordered datagram waits on top of the delay,
+// more than a tick so the next snapshot gets there first
+#define PROXY_REORDER_MS 150
+
+#define PROXY_REPORT_INTERVAL 5
+#define PROXY_BUFFER_LENGTH   65536
+
+
+namespace
+{
+	struct Counts
+	{
+		size_t passed    = 0;
+		size_t dropped   = 0;
+		size_t reordered = 0;
+	};
+
+
+	// A client's TCP connection and the one made to the server for it,
+	// whatever comes in on either is written to the other
+	class StreamSession : public std::enable_shared_from_this<StreamSession>
+	{
+	 public:
+		StreamSession( tcp::socket socket, asio::io_service &ioService )
+			: client( move( socket ) ),
+			  server( ioService )
+		{
+		}
+
+		void Start( const tcp::endpoint &serverEndpoint )
+		{
+			auto self( shared_from_this() );
+			server.async_connect(
+				serverEndpoint,
+				[this, self]( boost::system::error_code ec )
+				{
+					if( ec )
+					{
+						cout << "Connecting to the server failed: " << ec.message() << endl;
+						Close();
+						return;
+					}
+
+					Pump( client, server, toServer );
+					Pump( server, client, toClient );
+				}
+			);
+		}
+
+
+	 private:
+		void Pump( tcp::socket &from, tcp::socket &to, char *buffer )
+		{
+			auto self( shared_from_this() );
+			from.async_read_some(
+				asio::buffer( buffer, PROXY_BUFFER_LENGTH ),
+				[this, self, &from, &to, buffer]( boost::system::error_code ec, size_t length )
+				{
+					if( ec )
+					{
+						Close();
+						return;
+					}
+
+					asio::async_write(
+						to,
+						asio::buffer( buffer, length ),
+						[this, self, &from, &to, buffer]( boost::system::error_code ec, size_t )
+						{
+							if( ec )
+							{
+								Close();
+								return;
+							}
+
+							Pump( from, to, buffer );
+						}
+					);
+				}
+			);
+		}
+
+		void Close()
+		{
+			boost::system::error_code ec;
+			client.close( ec );
+			server.close( ec );
+		}
+
+		tcp::socket client;
+		tcp::socket server;
+
+		char toServer[PROXY_BUFFER_LENGTH];
+		char toClient[PROXY_BUFFER_LENGTH];
+	};
+
+
+	// The datagrams of a client go to the server from a socket
+	// of their own, so the server can tell the clients apart
+	struct DatagramPeer
+	{
+		DatagramPeer( asio::io_service &ioService, const udp::endpoint &client )
+			: socket( ioService, udp::endpoint( udp::v4(), 0 ) ),
+			  client( client )
+		{
+		}
+
+		udp::socket   socket;
+		udp::endpoint client;
+		udp::endpoint sender;
+		char          data[PROXY_BUFFER_LENGTH];
+	};
+
+
+	class LossProxy
+	{
+	 public:
+		LossProxy( asio::io_service &ioService, unsigned short serverPort, float loss, float reorder, long delay )
+			: ioService( ioService ),
+			  acceptor( ioService, tcp::endpoint( tcp::v4(), PROXY_PORT ) ),
+			  accepted( ioService ),
+			  datagrams( ioService, udp::endpoint( udp::v4(), PROXY_PORT ) ),
+			  reportTimer( ioService ),
+			  serverStream( asio::ip::address_v4::loopback(), serverPort ),
+			  serverDatagrams( asio::ip::address_v4::loopback(), serverPort ),
+			  loss( loss ),
+			  reorder( reorder ),
+			  delay( delay ),
+			  random( 1 )
+		{
+			Accept();
+			ReceiveFromClient();
+			ScheduleReport();
+		}
+
+
+	 private:
+		void Accept()
+		{
+			acceptor.async_accept(
+				accepted,
+				[this]( boost::system::error_code ec )
+				{
+					if( !ec )
+					{
+						make_shared<StreamSession>( move( accepted ), ioService )->Start( serverStream );
+					}
+
+					accepted = tcp::socket( ioService );
+					Accept();
+				}
+			);
+		}
+
+
+		void ReceiveFromClient()
+		{
+			datagrams.async_receive_from(
+				asio::buffer( clientData, PROXY_BUFFER_LENGTH ),
+				clientSender,
+				[this]( boost::system::error_code ec, size_t length )
+				{
+					if( !ec )
+					{
+						auto &peer = peers[clientSender];
+						if( !peer )
+						{
+							peer.reset( new DatagramPeer( ioService, clientSender ) );
+							ReceiveFromServer( peer.get() );
+						}
+
+						Forward( peer->socket, serverDatagrams, string( clientData, length ), toServer );
+					}
+
+					ReceiveFromClient();
+				}
+			);
+		}
+
+
+		void ReceiveFromServer( DatagramPeer *peer )
+		{
+			peer->socket.async_receive_from(
+				asio::buffer( peer->data, PROXY_BUFFER_LENGTH ),
+				peer->sender,
+				[this, peer]( boost::system::error_code ec, size_t length )
+				{
+					if( !ec && peer->sender == serverDatagrams )
+					{
+						// From the port the clients sent theirs to
+						Forward( datagrams, peer->client, string( peer->data, length ), toClient );
+					}
+
+					ReceiveFromServer( peer );
+				}
+			);
+		}
+
+
+		// Drops the datagram or sends it after the delay
+		void Forward( udp::socket &socket, const udp::endpoint &to, string data, Counts &counts )
+		{
+			uniform_real_distribution<float> chance( 0.f, 100.f );
+
+			if( chance( random ) < loss )
+			{
+				counts.dropped++;
+				return;
+			}
+
+			auto wait = delay;
+			if( chance( random ) < reorder )
+			{
+				wait += PROXY_REORDER_MS;
+				counts.reordered++;
+			}
+			counts.passed++;
+
+			auto timer    = make_shared<asio::deadline_timer>( ioService, posix_time::milliseconds( wait ) );
+			auto datagram = make_shared<string>( move( data ) );
+			timer->async_wait(
+				[timer, datagram, &socket, to]( const boost::system::error_code &ec )
+				{
+					if( !ec )
+					{
+						boost::system::error_code ignored;
+						socket.send_to( asio::buffer( *datagram ), to, 0, ignored );
+					}
+				}
+			);
+		}
+
+
+		void ScheduleReport()
+		{
+			reportTimer.expires_from_now( posix_time::seconds( PROXY_REPORT_INTERVAL ) );
+			reportTimer.async_wait(
+				[this]( const boost::system::error_code &ec )
+				{
+					if( ec )
+					{
+						return;
+					}
+
+					cout << "clients " << peers.size()
+					     << ", to the server: passed " << toServer.passed
+					     << ", dropped " << toServer.dropped
+					     << ", reordered " << toServer.reordered
+					     << "; to the clients: passed " << toClient.passed
+					     << ", dropped " << toClient.dropped
+					     << ", reordered " << toClient.reordered << endl;
+
+					ScheduleReport();
+				}
+			);
+		}
+
+
+		asio::io_service &ioService;
+
+		tcp::acceptor acceptor;
+		tcp::socket   accepted;
+
+		udp::socket   datagrams;
+		udp::endpoint clientSender;
+		char          clientData[PROXY_BUFFER_LENGTH];
+
+		map<udp::endpoint, unique_ptr<DatagramPeer>> peers;
+
+		asio::deadline_timer reportTimer;
+
+		tcp::endpoint serverStream;
+		udp::endpoint serverDatagrams;
+
+		float   loss;
+		float   reorder;
+		long    delay;
+		mt19937 random;
+
+		Counts toServer;
+		Counts toClient;
+	};
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	int   serverPort = argc > 1 ? atoi( argv[1] ) : PROXY_PORT + 1;
+	float loss       = argc > 2 ? static_cast<float>( atof( argv[2] ) ) : 10.f;
+	float reorder    = argc > 3 ? static_cast<float>( atof( argv[3] ) ) : 10.f;
+	long  delay      = argc > 4 ? atol( argv[4] ) : 20;
+
+	if( serverPort < 1 || serverPort > 65535 || serverPort == PROXY_PORT ||
+	    loss < 0.f || reorder < 0.f || delay < 0 )
+	{
+		cout << "usage: " << argv[0] << " [server port] [loss %] [reorder %] [delay ms]" << endl;
+		return 1;
+	}
+
+	try
+	{
+		asio::io_service ioService;
+		LossProxy proxy( ioService, static_cast<unsigned short>( serverPort ), loss, reorder, delay );
+
+		cout << "Passing port " << PROXY_PORT << " on to " << serverPort
+		     << " with " << loss << "% lost and " << reorder << "% reordered datagrams, "
+		     << delay << " ms delay" << endl;
+
+		ioService.run();
+	}
+	catch( std::exception &e )
+	{
+		cout << "Failed: " << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+// Measures what the object events of the server cost a ClientObjectManager
+// as the count of its nodes grows: every one of them looks its node up by
+// the id. The nodes are created, placed under the ones created before
+// them, updated a tick at a time in a random order with the position and
+// the rotation, moved by a snapshot and destroyed.
+//
+// usage: belowManagerBench [nodes] [rounds]
+//
+// Checks that the manager ends up with every node and every update in
+// place first, exits with 1 if it doesn't.
+
+#include "codecSamples.hh"
+#include "../managers/clientObjectManager.hh"
+#include "../world/objectEvents.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	// The events of a kind, owned here as the manager leaves them be
+	template<typename EventType>
+	vector<unique_ptr<EventType>> MakeEvents( size_t count, EventSubType subType )
+	{
+		vector<unique_ptr<EventType>> events( count );
+		for( auto &e : events )
+		{
+			e.reset( new EventType() );
+			e->type    = OBJECT_EVENT;
+			e->subType = subType;
+		}
+		return events;
+	}
+
+
+	template<typename EventType>
+	void Handle( ClientObjectManager &objects, const vector<unique_ptr<EventType>> &events )
+	{
+		for( auto &e : events )
+		{
+			objects.HandleEvent( e.get() );
+		}
+	}
+
+
+	class Timer
+	{
+	 public:
+		void Measure( function<void()> pass )
+		{
+			auto started = Clock::now();
+			pass();
+			seconds += chrono::duration<double>( Clock::now() - started ).count();
+		}
+
+		void Report( const string &name, size_t events, int rounds ) const
+		{
+			cout << fixed << setprecision( 2 )
+			     << setw( 10 ) << name << ": "
+			     << setw( 8 ) << seconds * 1e3 / rounds << " ms per "
+			     << events << " events, "
+			     << setw( 6 ) << events * rounds / seconds / 1e6 << " M events/s" << endl;
+		}
+
+	 private:
+		double seconds = 0.0;
+	};
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    rounds = argc > 2 ? atoi( argv[2] ) : 5;
+
+	if( count < 2 || rounds < 1 )
+	{
+		cout << "usage: " << argv[0] << " [nodes] [rounds]" << endl;
+		return 1;
+	}
+
+	Logger::GetInstance().SetQuiet( true );
+
+	auto creates = MakeEvents<ObjectCreateEvent>( count, OBJECT_CREATE );
+	auto parents = MakeEvents<ObjectParentAddEvent>( count - 1, OBJECT_PARENT_ADD );
+	auto updates = MakeEvents<ObjectUpdateEvent>( count, OBJECT_UPDATE );
+	auto destroy = MakeEvents<ObjectDestroyEvent>( count, OBJECT_DESTROY );
+
+	vector<NodeTransform> snapshot( count );
+	vector<uint32_t>      ids( count );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		ids[i] = static_cast<uint32_t>( i + 1 );
+
+		Entity entity;
+		Randomize( entity, generator );
+		entity.id = ids[i];
+
+		creates[i]->objectType = ENTITY_OBJECT_TYPE;
+		creates[i]->data       = entity.Serialize();
+
+		// Fresh ones, the updates have to change the nodes
+		Randomize( entity, generator );
+		snapshot[i].id       = ids[i];
+		snapshot[i].position = entity.position.Get();
+		snapshot[i].rotation = entity.rotation.Get();
+	}
+
+	for( size_t i = 1; i < count; i++ )
+	{
+		parents[i - 1]->objectId = ids[i];
+		parents[i - 1]->parentId = ids[generator() % i];
+	}
+
+	// The server sends the updates sorted by id, but the ids
+	// of the nodes aren't in any order in the manager
+	shuffle( ids.begin(), ids.end(), generator );
+	for( size_t i = 0; i < count; i++ )
+	{
+		WorldNode node;
+		Randomize( node, generator );
+		updates[i]->objectId = ids[i];
+		updates[i]->data     = node.Serialize( { FIELD_POSITION, FIELD_ROTATION } );
+		destroy[i]->objectId = ids[count - 1 - i];
+	}
+
+	Timer creating, parenting, updating, applying, destroying;
+	uint64_t sampleTime = 0;
+
+	for( int round = 0; round < rounds; round++ )
+	{
+		ClientObjectManager objects;
+
+		creating.Measure( [&](){ Handle( objects, creates ); } );
+		parenting.Measure( [&](){ Handle( objects, parents ); } );
+		updating.Measure( [&](){ Handle( objects, updates ); } );
+
+		if( round == 0 )
+		{
+			auto node = objects.Find( updates[0]->objectId );
+			if( objects.worldNodes.size() != count || objects.entities.size() != count || !node )
+			{
+				cout << "The manager has " << objects.worldNodes.size() << " of the " << count << " nodes!" << endl;
+				return 1;
+			}
+
+			WorldNode updated;
+			updated.Unserialize( updates[0]->data );
+			if( node->position.Raw() != updated.position.Raw() )
+			{
+				cout << "The updates didn't reach the nodes!" << endl;
+				return 1;
+			}
+		}
+
+		applying.Measure( [&](){ objects.ApplyTransforms( snapshot, sampleTime += 100000 ); } );
+
+		destroying.Measure( [&](){ Handle( objects, destroy ); } );
+
+		if( !objects.worldNodes.empty() || !objects.entities.empty() )
+		{
+			cout << "The manager has " << objects.worldNodes.size() << " nodes left!" << endl;
+			return 1;
+		}
+	}
+
+	creating.Report( "create", count, rounds );
+	parenting.Report( "parent", count - 1, rounds );
+	updating.Report( "update", count, rounds );
+	applying.Report( "snapshot", count, rounds );
+	destroying.Report( "destroy", count, rounds );
+
+	return 0;
+}
@@ -0,0 +1,505 @@
+// Checks that the world objects come back the same from their
+// serialization and measures it against the text field names it
+// replaced, by the size of the data and by the time taken.
+//
+// usage: belowSerialBench [nodes] [rounds]
+//
+// The round trips go through every type with random values, with all
+// the fields and with a part of them, and data cut short has to
+// be refused, which logs an error for every cut, so leave stderr out.
+// Exits with 1 if any of them fails. The comparison is on the updates
+// of the position and the rotation, and on all the fields of a node.
+// The primitives are measured on their own too, a message of the id,
+// the position and the rotation of every node written and read with
+// the stringstream helpers and with BinaryWriter and BinaryReader.
+
+#include "../world/worldNode.hh"
+#include "../world/entity.hh"
+#include "../physics/physicsObject.hh"
+#include "../network/binaryStream.hh"
+#include "streamSerialization.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <functional>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+#define SS_RW_BIN std::stringstream::in | std::stringstream::out | std::stringstream::binary
+
+
+namespace
+{
+	// How a field was written before: [length][name:][data]
+	void LegacySerializeField( const string &name, WorldNode &node, stringstream &stream )
+	{
+		stringstream fieldStream( SS_RW_BIN );
+		fieldStream << name << ":";
+
+		if( !name.compare( "id" ) )
+		{
+			SerializeUint32( fieldStream, node.id );
+		}
+		else if( !name.compare( "position" ) )
+		{
+			auto pos = node.position.Get();
+			SerializeFloat( fieldStream, pos.x );
+			SerializeFloat( fieldStream, pos.y );
+			SerializeFloat( fieldStream, pos.z );
+		}
+		else if( !name.compare( "rotation" ) )
+		{
+			auto rot = node.rotation.Get();
+			SerializeFloat( fieldStream, rot.x );
+			SerializeFloat( fieldStream, rot.y );
+			SerializeFloat( fieldStream, rot.z );
+			SerializeFloat( fieldStream, rot.w );
+		}
+		else if( !name.compare( "scale" ) )
+		{
+			SerializeFloat( fieldStream, node.scale.x );
+			SerializeFloat( fieldStream, node.scale.y );
+			SerializeFloat( fieldStream, node.scale.z );
+		}
+
+		auto field = fieldStream.str();
+		SerializeUint8( stream, static_cast<uint8_t>( field.length() ) );
+		stream << field;
+	}
+
+
+	string LegacySerialize( WorldNode &node, const vector<string> &names )
+	{
+		stringstream dataStream( SS_RW_BIN );
+		for( auto &name : names )
+		{
+			LegacySerializeField( name, node, dataStream );
+		}
+
+		stringstream headerStream( SS_RW_BIN );
+		SerializeUint8( headerStream, static_cast<uint8_t>( names.size() ) );
+		return headerStream.str() + dataStream.str();
+	}
+
+
+	// And read back by the name
+	bool LegacyUnserialize( WorldNode &node, const string &data )
+	{
+		stringstream dataStream( SS_RW_BIN );
+		dataStream << data;
+
+		uint8_t fieldCount = UnserializeUint8( dataStream );
+		for( int i = 0; i < fieldCount; i++ )
+		{
+			uint8_t fieldLength = UnserializeUint8( dataStream );
+
+			string fieldName;
+			if( !getline( dataStream, fieldName, ':' ) )
+			{
+				return false;
+			}
+
+			stringstream fieldStream( SS_RW_BIN );
+			uint8_t fieldDataLength = fieldLength - fieldName.length() - 1;
+			if( fieldDataLength > 0 )
+			{
+				char buffer[256];
+				dataStream.read( buffer, fieldDataLength );
+				fieldStream.write( buffer, fieldDataLength );
+			}
+
+			fieldStream.seekp( 0, ios::end );
+			size_t streamLength = static_cast<size_t>( fieldStream.tellp() );
+			fieldStream.seekp( 0, ios::beg );
+
+			if( !fieldName.compare( "id" ) && streamLength == 4 )
+			{
+				node.id = UnserializeUint32( fieldStream );
+			}
+			else if( !fieldName.compare( "position" ) && streamLength == 12 )
+			{
+				glm::vec3 pos;
+				pos.x = UnserializeFloat( fieldStream );
+				pos.y = UnserializeFloat( fieldStream );
+				pos.z = UnserializeFloat( fieldStream );
+				node.position.Update( pos );
+			}
+			else if( !fieldName.compare( "rotation" ) && streamLength == 16 )
+			{
+				glm::quat rot{};
+				rot.x = UnserializeFloat( fieldStream );
+				rot.y = UnserializeFloat( fieldStream );
+				rot.z = UnserializeFloat( fieldStream );
+				rot.w = UnserializeFloat( fieldStream );
+				node.rotation.Update( rot );
+			}
+			else if( !fieldName.compare( "scale" ) && streamLength == 12 )
+			{
+				node.scale.x = UnserializeFloat( fieldStream );
+				node.scale.y = UnserializeFloat( fieldStream );
+				node.scale.z = UnserializeFloat( fieldStream );
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	mt19937 random( 1 );
+
+	float RandomFloat()
+	{
+		return uniform_real_distribution<float>( -1000.f, 1000.f )( random );
+	}
+
+
+	void Randomize( WorldNode &node )
+	{
+		node.id = random();
+		node.position.Update( glm::vec3( RandomFloat(), RandomFloat(), RandomFloat() ) );
+		node.rotation.Update( glm::quat( RandomFloat(), RandomFloat(), RandomFloat(), RandomFloat() ) );
+		node.scale = glm::vec3( RandomFloat(), RandomFloat(), RandomFloat() );
+	}
+
+
+	void Randomize( Entity &entity )
+	{
+		Randomize( static_cast<WorldNode&>( entity ) );
+		entity.material.color = glm::vec4( RandomFloat(), RandomFloat(), RandomFloat(), RandomFloat() );
+		entity.mesh    = "mesh" + to_string( random() % 100 );
+		entity.texture = "texture" + to_string( random() % 100 );
+	}
+
+
+	void Randomize( PhysicsObject &object )
+	{
+		Randomize( static_cast<Entity&>( object ) );
+		object.velocity        = glm::vec3( RandomFloat(), RandomFloat(), RandomFloat() );
+		object.angularVelocity = glm::quat( RandomFloat(), RandomFloat(), RandomFloat(), RandomFloat() );
+		object.mass            = RandomFloat();
+		object.collisionShape.type   = COLLISION_SHAPE_AABB;
+		object.collisionShape.aabb.x = RandomFloat();
+		object.collisionShape.aabb.y = RandomFloat();
+		object.collisionShape.aabb.w = RandomFloat();
+		object.collisionShape.aabb.h = RandomFloat();
+	}
+
+
+	bool Same( const WorldNode &a, const WorldNode &b )
+	{
+		return a.id == b.id &&
+		       a.position.Get() == b.position.Get() &&
+		       a.rotation.Get() == b.rotation.Get() &&
+		       a.scale == b.scale;
+	}
+
+
+	bool Same( const Entity &a, const Entity &b )
+	{
+		return Same( static_cast<const WorldNode&>( a ), static_cast<const WorldNode&>( b ) ) &&
+		       a.material.color == b.material.color &&
+		       a.mesh == b.mesh &&
+		       a.texture == b.texture;
+	}
+
+
+	bool Same( const PhysicsObject &a, const PhysicsObject &b )
+	{
+		return Same( static_cast<const Entity&>( a ), static_cast<const Entity&>( b ) ) &&
+		       a.velocity == b.velocity &&
+		       a.angularVelocity == b.angularVelocity &&
+		       a.mass == b.mass &&
+		       a.collisionShape.type == b.collisionShape.type &&
+		       a.collisionShape.aabb.x == b.collisionShape.aabb.x &&
+		       a.collisionShape.aabb.y == b.collisionShape.aabb.y &&
+		       a.collisionShape.aabb.w == b.collisionShape.aabb.w &&
+		       a.collisionShape.aabb.h == b.collisionShape.aabb.h;
+	}
+
+
+	// All the fields, only the transform, and every cut
+	// of the data, which must not be taken
+	template<typename Type, typename Fields>
+	bool RoundTrip( const string &name, int count )
+	{
+		for( int i = 0; i < count; i++ )
+		{
+			Type original, copy;
+			Randomize( original );
+
+			auto data = original.Serialize();
+			if( !copy.Unserialize( data ) || !Same( original, copy ) )
+			{
+				cout << name << ": the fields didn't come back the same" << endl;
+				return false;
+			}
+
+			if( 1 + Fields::Length( original ) != data.size() )
+			{
+				cout << name << ": the length of the fields was " << 1 + Fields::Length( original )
+				     << " bytes instead of " << data.size() << endl;
+				return false;
+			}
+
+			Type moved;
+			moved.Unserialize( data );
+			Randomize( original );
+			if( !moved.Unserialize( original.Serialize( { FIELD_POSITION, FIELD_ROTATION } ) ) ||
+			    moved.position.Get() != original.position.Get() ||
+			    moved.rotation.Get() != original.rotation.Get() ||
+			    moved.id != copy.id || moved.scale != copy.scale )
+			{
+				cout << name << ": the transform update didn't come back the same" << endl;
+				return false;
+			}
+
+			for( size_t length = 0; length < data.size(); length++ )
+			{
+				Type cut;
+				if( cut.Unserialize( data.substr( 0, length ) ) )
+				{
+					cout << name << ": took data cut to " << length << " of " << data.size() << " bytes" << endl;
+					return false;
+				}
+			}
+		}
+
+		cout << name << ": " << count << " round trips ok, "
+		     << Type().Serialize().size() << " bytes with all the fields" << endl;
+		return true;
+	}
+
+
+	// Returns the nanoseconds per node
+	double Measure( const string &name, size_t nodes, int rounds, function<void()> pass )
+	{
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			pass();
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+		auto perNode = seconds * 1e9 / rounds / nodes;
+
+		cout << fixed << setprecision( 1 )
+		     << setw( 22 ) << name << ": "
+		     << perNode << " ns per node" << endl;
+
+		return perNode;
+	}
+
+
+	// Bytes of the id, the position and the rotation
+	const size_t transformLength = 4 + 3 * 4 + 4 * 4;
+
+
+	struct Transform
+	{
+		uint32_t  id;
+		glm::vec3 position;
+		glm::quat rotation;
+	};
+
+
+	bool Same( const Transform &a, const Transform &b )
+	{
+		return a.id == b.id && a.position == b.position && a.rotation == b.rotation;
+	}
+
+
+	void MeasurePrimitives( const vector<WorldNode> &nodes, int rounds )
+	{
+		auto count = nodes.size();
+
+		vector<Transform> transforms( count ), streamRead( count ), binaryRead( count );
+		for( size_t i = 0; i < count; i++ )
+		{
+			transforms[i].id       = nodes[i].id;
+			transforms[i].position = nodes[i].position.Get();
+			transforms[i].rotation = nodes[i].rotation.Get();
+		}
+
+		string streamMessage, binaryMessage;
+
+		auto streamWrite = Measure( "stream, write", count, rounds,
+			[&]()
+			{
+				stringstream stream( SS_RW_BIN );
+				for( auto &transform : transforms )
+				{
+					SerializeUint32( stream, transform.id );
+					SerializeFloat( stream, transform.position.x );
+					SerializeFloat( stream, transform.position.y );
+					SerializeFloat( stream, transform.position.z );
+					SerializeFloat( stream, transform.rotation.x );
+					SerializeFloat( stream, transform.rotation.y );
+					SerializeFloat( stream, transform.rotation.z );
+					SerializeFloat( stream, transform.rotation.w );
+				}
+				streamMessage = stream.str();
+			}
+		);
+
+		auto binaryWrite = Measure( "binary, write", count, rounds,
+			[&]()
+			{
+				binaryMessage.assign( count * transformLength, '\0' );
+				BinaryWriter writer( binaryMessage );
+				for( auto &transform : transforms )
+				{
+					writer.WriteUint32( transform.id );
+					writer.WriteFloat( transform.position.x );
+					writer.WriteFloat( transform.position.y );
+					writer.WriteFloat( transform.position.z );
+					writer.WriteFloat( transform.rotation.x );
+					writer.WriteFloat( transform.rotation.y );
+					writer.WriteFloat( transform.rotation.z );
+					writer.WriteFloat( transform.rotation.w );
+				}
+			}
+		);
+
+		auto streamReadTime = Measure( "stream, read", count, rounds,
+			[&]()
+			{
+				stringstream stream( SS_RW_BIN );
+				stream << streamMessage;
+				for( auto &transform : streamRead )
+				{
+					transform.id         = UnserializeUint32( stream );
+					transform.position.x = UnserializeFloat( stream );
+					transform.position.y = UnserializeFloat( stream );
+					transform.position.z = UnserializeFloat( stream );
+					transform.rotation.x = UnserializeFloat( stream );
+					transform.rotation.y = UnserializeFloat( stream );
+					transform.rotation.z = UnserializeFloat( stream );
+					transform.rotation.w = UnserializeFloat( stream );
+				}
+			}
+		);
+
+		auto binaryReadTime = Measure( "binary, read", count, rounds,
+			[&]()
+			{
+				BinaryReader reader( binaryMessage );
+				for( auto &transform : binaryRead )
+				{
+					transform.id         = reader.ReadUint32();
+					transform.position.x = reader.ReadFloat();
+					transform.position.y = reader.ReadFloat();
+					transform.position.z = reader.ReadFloat();
+					transform.rotation.x = reader.ReadFloat();
+					transform.rotation.y = reader.ReadFloat();
+					transform.rotation.z = reader.ReadFloat();
+					transform.rotation.w = reader.ReadFloat();
+				}
+			}
+		);
+
+		bool same = streamMessage == binaryMessage;
+		for( size_t i = 0; i < count && same; i++ )
+		{
+			same = Same( transforms[i], streamRead[i] ) && Same( transforms[i], binaryRead[i] );
+		}
+
+		cout << setprecision( 1 )
+		     << "Binary against stream: " << streamWrite / binaryWrite << "x writing, "
+		     << streamReadTime / binaryReadTime << "x reading"
+		     << ( same ? "" : ", THE DATA DIFFERS" ) << endl;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    rounds = argc > 2 ? atoi( argv[2] ) : 10;
+
+	Logger::GetInstance().SetQuiet( true );
+
+	bool ok = RoundTrip<WorldNode, WorldNodeFields>( "WorldNode", 1000 ) &&
+	          RoundTrip<Entity, EntityFields>( "Entity", 1000 ) &&
+	          RoundTrip<PhysicsObject, PhysicsObjectFields>( "PhysicsObject", 1000 );
+
+	if( !ok )
+	{
+		return 1;
+	}
+
+
+	vector<WorldNode> nodes( count );
+	for( auto &node : nodes )
+	{
+		Randomize( node );
+	}
+
+	vector<string> legacyNames = { "position", "rotation" };
+	vector<FieldId> fields     = { FIELD_POSITION, FIELD_ROTATION };
+
+	vector<string> legacyFull = { "id", "position", "rotation", "scale" };
+
+	cout << "Update of the position and rotation: "
+	     << LegacySerialize( nodes[0], legacyNames ).size() << " bytes with the names, "
+	     << nodes[0].Serialize( fields ).size() << " with the ids" << endl
+	     << "Node with all the fields: "
+	     << LegacySerialize( nodes[0], legacyFull ).size() << " bytes with the names, "
+	     << nodes[0].Serialize().size() << " with the ids" << endl;
+
+	vector<string> legacyData( count ), data( count );
+
+	Measure( "names, serialize", count, rounds,
+		[&]()
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				legacyData[i] = LegacySerialize( nodes[i], legacyNames );
+			}
+		}
+	);
+
+	Measure( "ids, serialize", count, rounds,
+		[&]()
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				data[i] = nodes[i].Serialize( fields );
+			}
+		}
+	);
+
+	Measure( "names, unserialize", count, rounds,
+		[&]()
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				LegacyUnserialize( nodes[i], legacyData[i] );
+			}
+		}
+	);
+
+	Measure( "ids, unserialize", count, rounds,
+		[&]()
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				nodes[i].Unserialize( data[i] );
+			}
+		}
+	);
+
+	MeasurePrimitives( nodes, rounds );
+
+	return 0;
+}
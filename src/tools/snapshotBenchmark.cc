@@ -0,0 +1,266 @@
+// Measures the bytes the transform snapshots take per tick: every node
+// sent in full against the changes since the snapshot the client has
+// acknowledged, with a part of the nodes moving and the rest standing
+// still. The acknowledgements get back to the server some ticks late
+// like over a real link. Then they stop getting through for longer than
+// the server remembers its snapshots, so the baseline gets too old and
+// the snapshots fall back to full ones, until they get through again.
+//
+// usage: belowSnapshotBench [nodes] [moving fraction] [ticks] [ack delay in ticks]
+//
+// The snapshots go through a SnapshotReceiver on the way, the client's
+// transforms are checked against the server's after every phase, exits
+// with 1 if they differ.
+
+#include "../network/snapshot.hh"
+#include "../network/packets.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <deque>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+
+#define WORLD_EXTENT 500.f
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	struct Bytes
+	{
+		size_t total;
+		size_t ticks;
+
+		double PerTick() const
+		{
+			return ticks ? double( total ) / ticks : 0.0;
+		}
+	};
+
+
+	// Bytes on the wire, the datagram headers included
+	size_t WireBytes( const string &message )
+	{
+		size_t bytes = 0;
+		for( auto &datagram : SplitPackets( message, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH ) )
+		{
+			bytes += datagram.size() + DATAGRAM_HEADER_LENGTH;
+		}
+		return bytes;
+	}
+
+
+	// Feeds the packets of the message to the receiver like the client
+	// does, returns the sequence it completed or the one it had
+	uint32_t Receive( SnapshotReceiver &receiver, const string &message, vector<NodeTransform> &client, uint32_t completed )
+	{
+		size_t offset = 0;
+		while( offset + 5 <= message.size() )
+		{
+			uint16_t length;
+			memcpy( &length, message.data() + offset, sizeof( length ) );
+			if( length < 5 || offset + length > message.size() )
+			{
+				break;
+			}
+
+			vector<NodeTransform> changes;
+			uint64_t serverTime;
+			receiver.Receive( message.substr( offset + 5, length - 5 ), changes, completed, serverTime );
+
+			for( auto &change : changes )
+			{
+				client[change.id - 1] = change;
+			}
+
+			offset += length;
+		}
+
+		return completed;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count    = argc > 1 ? atoi( argv[1] ) : 2000;
+	float  fraction = argc > 2 ? atof( argv[2] ) : 0.05f;
+	int    ticks    = argc > 3 ? atoi( argv[3] ) : 100;
+	int    ackDelay = argc > 4 ? atoi( argv[4] ) : 2;
+
+	if( count < 1 || fraction < 0.f || fraction > 1.f || ticks < 1 || ackDelay < 0 || ackDelay >= SNAPSHOT_HISTORY_LENGTH )
+	{
+		cout << "usage: " << argv[0] << " [nodes] [moving fraction] [ticks] [ack delay in ticks]" << endl;
+		return 1;
+	}
+
+	uniform_real_distribution<float> place( -WORLD_EXTENT, WORLD_EXTENT );
+	uniform_real_distribution<float> speed( -0.5f, 0.5f );
+	uniform_real_distribution<float> chance( 0.f, 1.f );
+
+	TransformCodec codec;
+
+	// The moving ones go straight and turn around the vertical axis
+	vector<NodeTransform> world( count );
+	vector<glm::vec3>     velocities( count, glm::vec3( 0.f ) );
+	vector<float>         angles( count, 0.f );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		world[i].id       = static_cast<uint32_t>( i + 1 );
+		world[i].position = glm::vec3( place( generator ), place( generator ), place( generator ) );
+		world[i].rotation = glm::quat();
+
+		if( chance( generator ) < fraction )
+		{
+			velocities[i] = glm::vec3( speed( generator ), speed( generator ), speed( generator ) );
+		}
+	}
+
+	SnapshotHistory  history;
+	SnapshotReceiver receiver( codec );
+
+	vector<NodeTransform> client( count );
+	TransformSnapshot     current;
+
+	uint32_t sequence  = 0;
+	uint32_t acked     = 0;
+	uint32_t completed = 0;
+	bool     hasAck    = false;
+
+	// Sequences the client has completed, on their way back
+	deque<uint32_t> acks;
+
+	Bytes full = {}, delta = {}, stale = {}, fallback = {};
+
+	// Sends a tick, the acknowledgements get through
+	// ackDelay ticks later while the link lets them
+	auto tick = [&]( bool acksGetThrough )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			if( velocities[i] != glm::vec3( 0.f ) )
+			{
+				world[i].position += velocities[i];
+				angles[i]         += 0.05f;
+				world[i].rotation  = glm::angleAxis( angles[i], glm::vec3( 0.f, 1.f, 0.f ) );
+			}
+		}
+
+		current.clear();
+		for( auto &node : world )
+		{
+			current.push_back( QuantizeTransform( codec, node ) );
+		}
+
+		sequence++;
+
+		// Everything, as it went without a baseline
+		full.total += WireBytes( EncodeSnapshot( codec, sequence, 0, current, 0, nullptr, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH ) );
+		full.ticks++;
+
+		// The changes since the acknowledged one, if it's still remembered
+		auto baseline = hasAck ? history.Find( acked ) : nullptr;
+		auto message  = EncodeSnapshot(
+			codec,
+			sequence,
+			0,
+			current,
+			acked,
+			baseline.get(),
+			MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH
+		);
+
+		// Before the first acknowledgement there's no baseline either
+		if( hasAck )
+		{
+			auto &bytes = !baseline ? fallback : acksGetThrough ? delta : stale;
+			bytes.total += WireBytes( message );
+			bytes.ticks++;
+		}
+
+		history.Store( sequence, make_shared<TransformSnapshot>( current ) );
+
+		completed = Receive( receiver, message, client, completed );
+		acks.push_back( completed );
+
+		while( acks.size() > static_cast<size_t>( ackDelay ) )
+		{
+			if( acksGetThrough && acks.front() != 0 )
+			{
+				acked  = acks.front();
+				hasAck = true;
+			}
+			acks.pop_front();
+		}
+	};
+
+	auto check = [&]( const string &phase )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			auto expected = DequantizeTransform( codec, current[i] );
+			if( client[i].id != expected.id ||
+			    client[i].position != expected.position ||
+			    client[i].rotation != expected.rotation )
+			{
+				cout << "The transform of the node " << i + 1 << " differs after " << phase << "!" << endl;
+				return false;
+			}
+		}
+		return true;
+	};
+
+	for( int i = 0; i < ticks; i++ )
+	{
+		tick( true );
+	}
+
+	if( !check( "the acknowledged ticks" ) )
+	{
+		return 1;
+	}
+
+	// Long enough for the acknowledged one to be forgotten
+	for( int i = 0; i < SNAPSHOT_HISTORY_LENGTH + ticks; i++ )
+	{
+		tick( false );
+	}
+
+	// The first acknowledgement makes the deltas small again
+	for( int i = 0; i < ackDelay + 1 + ticks; i++ )
+	{
+		tick( true );
+	}
+
+	if( !check( "the baseline got too old" ) )
+	{
+		return 1;
+	}
+
+	cout << count << " nodes, " << fraction * 100.f << "% moving, acknowledged "
+	     << ackDelay << " ticks late, " << ticks << " ticks" << endl
+	     << fixed << setprecision( 1 )
+	     << "              full: " << full.PerTick() << " bytes per tick" << endl
+	     << "             delta: " << delta.PerTick() << " bytes per tick, "
+	     << 100.0 * delta.PerTick() / full.PerTick() << "% of full, "
+	     << delta.ticks << " ticks" << endl
+	     << "  delta, acks lost: " << stale.PerTick() << " bytes per tick, "
+	     << 100.0 * stale.PerTick() / full.PerTick() << "% of full, "
+	     << stale.ticks << " ticks" << endl
+	     << "  baseline too old: " << fallback.PerTick() << " bytes per tick, "
+	     << 100.0 * fallback.PerTick() / full.PerTick() << "% of full, "
+	     << fallback.ticks << " ticks" << endl;
+
+	return 0;
+}
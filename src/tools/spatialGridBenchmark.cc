@@ -0,0 +1,165 @@
+// Measures what the area of interest costs the server per tick: the
+// moved nodes put in their new cells of the grid after the model
+// matrices were computed, and then the relevant nodes found for every
+// client, with the ones it had the tick before kept a bit past the
+// radius. The nodes are spread over a flat world two kilometers
+// across, one in ten of them under another one close to it, and the
+// clients wander through it a little each tick.
+//
+// usage: belowGridBench [nodes] [clients] [moving fraction] [rounds]
+
+#include "../managers/serverObjectManager.hh"
+#include "../network/networkEvents.hh"
+#include "../server/spatialGrid.hh"
+#include "../server/relevance.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+#define WORLD_EXTENT 1000.f
+#define WORLD_HEIGHT 50.f
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	double Since( Clock::time_point started )
+	{
+		return chrono::duration<double, milli>( Clock::now() - started ).count();
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count    = argc > 1 ? atoi( argv[1] ) : 100000;
+	size_t clients  = argc > 2 ? atoi( argv[2] ) : 1000;
+	float  fraction = argc > 3 ? atof( argv[3] ) : 0.1f;
+	int    rounds   = argc > 4 ? atoi( argv[4] ) : 10;
+
+	if( count < 1 || clients < 1 || fraction < 0.f || fraction > 1.f || rounds < 1 )
+	{
+		cout << "usage: " << argv[0] << " [nodes] [clients] [moving fraction] [rounds]" << endl;
+		return 1;
+	}
+
+	Logger::GetInstance().SetQuiet( true );
+
+	uniform_real_distribution<float> across( -WORLD_EXTENT, WORLD_EXTENT );
+	uniform_real_distribution<float> up( -WORLD_HEIGHT, WORLD_HEIGHT );
+	uniform_real_distribution<float> offset( -5.f, 5.f );
+	uniform_real_distribution<float> step( -1.f, 1.f );
+	uniform_real_distribution<float> chance( 0.f, 1.f );
+
+	ServerObjectManager objects;
+	SpatialGrid         grid;
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		auto node = make_shared<WorldNode>();
+		objects.AddNode( node );
+
+		if( i > 0 && i % 10 == 0 )
+		{
+			node->position = glm::vec3( offset( generator ), offset( generator ), offset( generator ) );
+			objects.AddChild( objects.worldNodes[generator() % i], node );
+		}
+		else
+		{
+			node->position = glm::vec3( across( generator ), up( generator ), across( generator ) );
+		}
+	}
+
+	vector<glm::vec3>            viewpoints( clients );
+	vector<vector<unsigned int>> relevant( clients );
+
+	for( auto &viewpoint : viewpoints )
+	{
+		viewpoint = glm::vec3( across( generator ), 0.f, across( generator ) );
+	}
+
+	// As the server's tick does it after the model matrices
+	auto updateGrid = [&]()
+	{
+		for( auto node : objects.MovedNodes() )
+		{
+			auto &worldPosition = node->modelMatrix[3];
+			grid.Update( node->id, glm::vec3( worldPosition.x, worldPosition.y, worldPosition.z ) );
+		}
+	};
+
+	auto findRelevant = [&]()
+	{
+		size_t total = 0;
+		for( size_t c = 0; c < clients; c++ )
+		{
+			relevant[c] = RelevantNodes( grid, objects, viewpoints[c], DEFAULT_VIEW_RADIUS, relevant[c] );
+			total += relevant[c].size();
+		}
+		return total;
+	};
+
+	// Everything goes in the grid on the first tick
+	objects.UpdateTransforms();
+	updateGrid();
+	findRelevant();
+
+	cout << count << " nodes, " << clients << " clients, "
+	     << fraction * 100.f << "% moving, " << rounds << " rounds" << endl;
+
+	double computing = 0.0, updating = 0.0, finding = 0.0;
+	size_t moved = 0, found = 0;
+
+	for( int round = 0; round < rounds; round++ )
+	{
+		for( auto &node : objects.worldNodes )
+		{
+			if( chance( generator ) < fraction )
+			{
+				node->position = node->position.Get() + glm::vec3( step( generator ), 0.f, step( generator ) );
+			}
+		}
+
+		for( auto &viewpoint : viewpoints )
+		{
+			viewpoint += glm::vec3( step( generator ), 0.f, step( generator ) );
+		}
+
+		auto started = Clock::now();
+		objects.UpdateTransforms();
+		computing += Since( started );
+
+		started   = Clock::now();
+		updateGrid();
+		updating  += Since( started );
+		moved     += objects.MovedNodes().size();
+
+		started   = Clock::now();
+		found     += findRelevant();
+		finding   += Since( started );
+	}
+
+	cout << fixed << setprecision( 2 )
+	     << "model matrices: " << computing / rounds << " ms per tick" << endl
+	     << "   grid update: " << updating / rounds << " ms per tick, "
+	     << moved / rounds << " nodes moved" << endl
+	     << "relevant nodes: " << finding / rounds << " ms per tick, "
+	     << finding * 1e3 / rounds / clients << " us per client, "
+	     << found / rounds / clients << " nodes each" << endl
+	     << "         total: " << ( computing + updating + finding ) / rounds << " ms per tick" << endl;
+
+	return 0;
+}
@@ -1,4 +1,4 @@
-#include "serializable.hh"
+#include "streamSerialization.hh"
 
 using namespace std;
 
@@ -22,6 +22,12 @@ void SerializeUint32( stringstream &stream, uint32_t value )
 }
 
 
+void SerializeUint64( stringstream &stream, uint64_t value )
+{
+	stream.write( reinterpret_cast<char*>( &value ), 8 );
+}
+
+
 void SerializeFloat( stringstream &stream, float value )
 {
 	stream.write( reinterpret_cast<char*>( &value ), sizeof( float ) );
@@ -73,6 +79,14 @@ uint32_t UnserializeUint32( stringstream &stream )
 }
 
 
+uint64_t UnserializeUint64( stringstream &stream )
+{
+	uint64_t value;
+	stream.read( reinterpret_cast<char*>( &value ), 8 );
+	return value;
+}
+
+
 float UnserializeFloat( stringstream &stream )
 {
 	float value;
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <cstdint>
+
+
+// The stringstream helpers the messages were built with before
+// BinaryWriter and BinaryReader, the benchmarks compare against them.
+void SerializeUint8( std::stringstream &stream,  uint8_t value );
+void SerializeUint16( std::stringstream &stream, uint16_t value );
+void SerializeUint32( std::stringstream &stream, uint32_t value );
+void SerializeUint64( std::stringstream &stream, uint64_t value );
+void SerializeFloat( std::stringstream &stream,  float value );
+void SerializeDouble( std::stringstream &stream, double value );
+void SerializeString( std::stringstream &stream, const std::string& value );
+
+
+uint8_t  UnserializeUint8( std::stringstream &stream );
+uint16_t UnserializeUint16( std::stringstream &stream );
+uint32_t UnserializeUint32( std::stringstream &stream );
+uint64_t UnserializeUint64( std::stringstream &stream );
+float    UnserializeFloat( std::stringstream &stream );
+double   UnserializeDouble( std::stringstream &stream );
+std::string UnserializeString( std::stringstream &stream );
@@ -0,0 +1,326 @@
+// Measures what the transforms of a tick cost with a node at a time
+// against the arrays of TransformBatch: quantizing, encoding into the
+// packets, decoding them and applying the transforms to the nodes of
+// a ClientObjectManager. The snapshots are full ones, without a
+// baseline, so both ways carry every node.
+//
+// usage: belowBatchBench [nodes] [rounds]
+//
+// First checks that the arrays are quantized the same with SSE2 as
+// without, that they come back the same from the packets and that
+// they are within a step of the one at a time quantizing. Exits with
+// 1 if any of them fails.
+
+#include "../network/transformBatch.hh"
+#include "../network/snapshot.hh"
+#include "../network/packets.hh"
+#include "../network/binaryStream.hh"
+#include "../managers/clientObjectManager.hh"
+#include "../events/event.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	void Measure( const string &name, size_t nodes, int rounds, function<void()> pass )
+	{
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			pass();
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 22 ) << name << ": "
+		     << seconds * 1e3 / rounds << " ms per tick, "
+		     << setprecision( 1 ) << seconds * 1e9 / rounds / nodes << " ns per node" << endl;
+	}
+
+
+	// Calls the handler with the body of every packet of the message
+	void ForEachPacket( const string &message, function<void( BinaryReader& )> handler )
+	{
+		BinaryReader reader( message );
+		while( reader.Remaining() >= sizeof( uint16_t ) )
+		{
+			auto length = reader.ReadUint16();
+
+			// Past the type and the sub type
+			BinaryReader body( reader.Position() + 3, length - sizeof( uint16_t ) - 3 );
+			handler( body );
+			reader.Skip( length - sizeof( uint16_t ) );
+		}
+	}
+
+
+	bool Same( const QuantizedArrays &a, const QuantizedArrays &b )
+	{
+		return a.ids == b.ids && a.x == b.x && a.y == b.y && a.z == b.z && a.rotations == b.rotations;
+	}
+
+
+	// The arrays one value at a time go the way without SSE2
+	bool CheckArrays( const TransformCodec &codec, const TransformArrays &transforms, const QuantizedArrays &quantized )
+	{
+		TransformArrays dequantized;
+		DequantizeArrays( codec, quantized, dequantized );
+
+		size_t positionDifferences = 0, rotationDifferences = 0, further = 0;
+
+		for( size_t i = 0; i < transforms.Size(); i++ )
+		{
+			uint32_t position, rotation;
+			codec.QuantizePositions( &transforms.x[i], &position, 1 );
+			codec.QuantizeRotations( &transforms.qx[i], &transforms.qy[i], &transforms.qz[i], &transforms.qw[i], &rotation, 1 );
+
+			float x, qx, qy, qz, qw;
+			codec.DequantizePositions( &quantized.x[i], &x, 1 );
+			codec.DequantizeRotations( &quantized.rotations[i], &qx, &qy, &qz, &qw, 1 );
+
+			if( position != quantized.x[i] || rotation != quantized.rotations[i] ||
+			    x != dequantized.x[i] || qx != dequantized.qx[i] || qy != dequantized.qy[i] ||
+			    qz != dequantized.qz[i] || qw != dequantized.qw[i] )
+			{
+				cout << "Node " << i << " came out different without SSE2!" << endl;
+				return false;
+			}
+
+			// Against a node at a time
+			NodeTransform node{
+				transforms.ids[i],
+				glm::vec3( transforms.x[i], transforms.y[i], transforms.z[i] ),
+				glm::quat( transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i] )
+			};
+			auto single = QuantizeTransform( codec, node );
+
+			for( int c = 0; c < 3; c++ )
+			{
+				uint32_t batched = c == 0 ? quantized.x[i] : c == 1 ? quantized.y[i] : quantized.z[i];
+				if( single.position[c] != batched )
+				{
+					positionDifferences++;
+					further += max( single.position[c], batched ) - min( single.position[c], batched ) > 1;
+				}
+			}
+
+			if( single.rotation != quantized.rotations[i] )
+			{
+				rotationDifferences++;
+
+				// The same rotation may come out with a step off in a component
+				auto a = codec.DequantizeRotation( single.rotation );
+				auto b = codec.DequantizeRotation( quantized.rotations[i] );
+				further += fabs( glm::dot( a, b ) ) < cos( 2.f * codec.RotationError() );
+			}
+		}
+
+		cout << "Against a node at a time: " << positionDifferences << " position components and "
+		     << rotationDifferences << " rotations a step off" << endl;
+
+		if( further )
+		{
+			cout << further << " values were further off!" << endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    rounds = argc > 2 ? atoi( argv[2] ) : 20;
+
+	Logger::GetInstance().SetQuiet( true );
+
+	TransformCodec codec;
+
+	uniform_real_distribution<float> place( -1000.f, 1000.f );
+	uniform_real_distribution<float> component( -1.f, 1.f );
+
+	TransformArrays transforms;
+	vector<NodeTransform> nodes( count );
+	for( size_t i = 0; i < count; i++ )
+	{
+		nodes[i].id       = static_cast<uint32_t>( i + 1 );
+		nodes[i].position = glm::vec3( place( generator ), place( generator ), place( generator ) );
+		nodes[i].rotation = glm::normalize( glm::quat( component( generator ), component( generator ), component( generator ), component( generator ) ) );
+
+		transforms.Append( nodes[i].id, nodes[i].position, nodes[i].rotation );
+	}
+
+
+	// Check the arrays and the packets first
+	QuantizedArrays quantized;
+	QuantizeArrays( codec, transforms, quantized );
+
+	if( !CheckArrays( codec, transforms, quantized ) )
+	{
+		return 1;
+	}
+
+	auto batchMessage = EncodeTransformBatch( 1, quantized );
+
+	QuantizedArrays decoded, packet;
+	bool            failed = false;
+	ForEachPacket( batchMessage,
+		[&]( BinaryReader &body )
+		{
+			uint64_t serverTime;
+			failed |= !DecodeTransformBatch( body, serverTime, packet );
+			for( size_t i = 0; i < packet.Size(); i++ )
+			{
+				decoded.Append( packet.At( i ) );
+			}
+		}
+	);
+
+	if( failed || !Same( quantized, decoded ) )
+	{
+		cout << "The transforms came back different from the batch!" << endl;
+		return 1;
+	}
+
+
+	TransformSnapshot snapshot;
+	for( auto &node : nodes )
+	{
+		snapshot.push_back( QuantizeTransform( codec, node ) );
+	}
+
+	auto snapshotMessage = EncodeSnapshot( codec, 1, 1, snapshot, 0, nullptr, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH );
+
+	cout << count << " nodes, full snapshot " << snapshotMessage.size() / 1024 << " kB, batch "
+	     << batchMessage.size() / 1024 << " kB" << endl;
+
+
+	// Server side
+	Measure( "node, quantize", count, rounds,
+		[&]()
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				snapshot[i] = QuantizeTransform( codec, nodes[i] );
+			}
+		}
+	);
+
+	Measure( "batch, quantize", count, rounds,
+		[&]()
+		{
+			QuantizeArrays( codec, transforms, quantized );
+		}
+	);
+
+	uint32_t sequence = 1;
+	Measure( "snapshot, encode", count, rounds,
+		[&]()
+		{
+			snapshotMessage = EncodeSnapshot( codec, ++sequence, 1, snapshot, 0, nullptr, MAX_DATAGRAM_PAYLOAD - DATAGRAM_HEADER_LENGTH );
+		}
+	);
+
+	Measure( "batch, encode", count, rounds,
+		[&]()
+		{
+			batchMessage = EncodeTransformBatch( 1, quantized );
+		}
+	);
+
+
+	// Client side
+	SnapshotReceiver      receiver( codec );
+	vector<NodeTransform> changes;
+	changes.reserve( count );
+
+	Measure( "snapshot, decode", count, rounds,
+		[&]()
+		{
+			receiver.Reset();
+			changes.clear();
+			ForEachPacket( snapshotMessage,
+				[&]( BinaryReader &body )
+				{
+					uint32_t completed;
+					uint64_t serverTime;
+					receiver.Receive( string( body.Position(), body.Remaining() ), changes, completed, serverTime );
+				}
+			);
+		}
+	);
+
+	TransformArrays received;
+	size_t          decodedCount = 0;
+
+	Measure( "batch, decode", count, rounds,
+		[&]()
+		{
+			decodedCount = 0;
+			ForEachPacket( batchMessage,
+				[&]( BinaryReader &body )
+				{
+					uint64_t serverTime;
+					DecodeTransformBatch( body, serverTime, packet );
+					DequantizeArrays( codec, packet, received );
+					decodedCount += received.Size();
+				}
+			);
+		}
+	);
+
+	if( changes.size() != count || decodedCount != count )
+	{
+		cout << "Decoded " << changes.size() << " and " << decodedCount << " of the " << count << " nodes!" << endl;
+		return 1;
+	}
+
+
+	// Into the nodes, both ways look the nodes up the same way
+	TransformArrays batchTransforms;
+	DequantizeArrays( codec, quantized, batchTransforms );
+
+	ClientObjectManager objects;
+	for( auto &node : nodes )
+	{
+		auto worldNode = make_shared<WorldNode>();
+		worldNode->id = node.id;
+		objects.AddNode( worldNode );
+	}
+
+	uint64_t sampleTime = 0;
+	Measure( "node, apply", count, rounds,
+		[&]()
+		{
+			objects.ApplyTransforms( changes, sampleTime += 100000 );
+		}
+	);
+
+	Measure( "batch, apply", count, rounds,
+		[&]()
+		{
+			objects.ApplyTransforms( batchTransforms, sampleTime += 100000 );
+		}
+	);
+
+	return 0;
+}
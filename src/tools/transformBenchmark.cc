@@ -0,0 +1,183 @@
+// Measures what the model matrices of a tick cost: recursing from the
+// roots through UpdateModelMatrix() of the nodes as the game states did
+// against the TransformSystem of an object manager, with from all to
+// none of the nodes moved, the moved ones gathered from the nodes and
+// the matrices written back to them. Also its pass over the arrays
+// alone with all of them computed, the order redone first or not.
+// The nodes are put under random ones created before them, the tree
+// is a few dozen levels deep.
+//
+// usage: belowTransformBench [nodes] [rounds]
+//
+// First checks that the matrices come out the same both ways, also
+// after some of the nodes have moved, exits with 1 if they don't.
+
+#include "../managers/serverObjectManager.hh"
+#include "../world/transformSystem.hh"
+#include "../logger.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+
+namespace
+{
+	mt19937 generator( 1 );
+
+
+	void Measure( const string &name, size_t nodes, int rounds, function<void()> pass )
+	{
+		auto started = Clock::now();
+		for( int round = 0; round < rounds; round++ )
+		{
+			pass();
+		}
+		auto seconds = chrono::duration<double>( Clock::now() - started ).count();
+
+		cout << fixed << setprecision( 2 )
+		     << setw( 22 ) << name << ": "
+		     << seconds * 1e3 / rounds << " ms per tick, "
+		     << setprecision( 1 ) << seconds * 1e9 / rounds / nodes << " ns per node" << endl;
+	}
+
+
+	// The sums of the products differ in the last bits between the two
+	bool Close( const glm::mat4 &a, const glm::mat4 &b )
+	{
+		for( int c = 0; c < 4; c++ )
+		{
+			for( int r = 0; r < 4; r++ )
+			{
+				if( fabs( a[c][r] - b[c][r] ) > 1e-4f * ( 1.f + fabs( a[c][r] ) ) )
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	size_t count  = argc > 1 ? atoi( argv[1] ) : 100000;
+	int    rounds = argc > 2 ? atoi( argv[2] ) : 20;
+
+	if( count < 1 || rounds < 1 )
+	{
+		cout << "usage: " << argv[0] << " [nodes] [rounds]" << endl;
+		return 1;
+	}
+
+	Logger::GetInstance().SetQuiet( true );
+
+	uniform_real_distribution<float> coordinate( -10.f, 10.f );
+	uniform_real_distribution<float> angle( -3.14159f, 3.14159f );
+	uniform_real_distribution<float> scale( 0.9f, 1.1f );
+
+	ServerObjectManager objects;
+	TransformSystem     system;
+
+	vector<TransformHandle> handles( count );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		auto node = make_shared<WorldNode>();
+		node->position = glm::vec3( coordinate( generator ), coordinate( generator ), coordinate( generator ) );
+		node->rotation = glm::angleAxis( angle( generator ), glm::normalize( glm::vec3( coordinate( generator ), coordinate( generator ), 1.f ) ) );
+		node->scale    = glm::vec3( scale( generator ), scale( generator ), scale( generator ) );
+
+		objects.AddNode( node );
+
+		handles[i] = system.Add();
+		system.SetLocal( handles[i], node->position.Get(), node->rotation.Get(), node->scale );
+
+		if( i > 0 )
+		{
+			auto parent = generator() % i;
+			objects.AddChild( objects.worldNodes[parent], node );
+			system.SetParent( handles[i], handles[parent] );
+		}
+	}
+
+	auto recursive = [&]()
+	{
+		for( auto& node : objects.worldNodes )
+		{
+			if( node->parent == 0 )
+			{
+				node->UpdateModelMatrix();
+			}
+		}
+	};
+
+	// About one in every, a random one each time, the
+	// moved ones take their subtrees along
+	auto move = [&]( size_t every )
+	{
+		for( size_t i = generator() % every; i < count; i += every )
+		{
+			objects.worldNodes[i]->position = glm::vec3( coordinate( generator ), coordinate( generator ), coordinate( generator ) );
+		}
+	};
+
+	// The first rounds sort the hierarchies, the
+	// ones after only redo what was moved
+	vector<glm::mat4> computed( count );
+	for( int round = 0; round < 3; round++ )
+	{
+		objects.UpdateTransforms();
+		for( size_t i = 0; i < count; i++ )
+		{
+			computed[i] = objects.worldNodes[i]->modelMatrix;
+		}
+
+		system.Update();
+		recursive();
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			auto &expected = objects.worldNodes[i]->modelMatrix;
+			if( !Close( expected, computed[i] ) || ( round == 0 && !Close( expected, system.World( handles[i] ) ) ) )
+			{
+				cout << "The matrix of the node " << i << " differs!" << endl;
+				return 1;
+			}
+		}
+
+		move( 7 );
+	}
+
+	cout << count << " nodes, " << rounds << " rounds" << endl;
+
+	Measure( "UpdateModelMatrix", count, rounds, recursive );
+
+	for( size_t every : { 1, 10, 100, 1000 } )
+	{
+		Measure( "1 in " + to_string( every ) + " moved", count, rounds, [&](){ move( every ); objects.UpdateTransforms(); } );
+	}
+	Measure( "none moved", count, rounds, [&](){ objects.UpdateTransforms(); } );
+
+	// Everything is under the first one
+	auto root = objects.worldNodes[0];
+	Measure( "arrays, root moved", count, rounds, [&](){ system.SetLocal( handles[0], root->position.Get(), root->rotation.Get(), root->scale ); system.Update(); } );
+
+	// As the first tick after the hierarchy has changed
+	auto last = handles[count - 1];
+	Measure( "arrays, sorted", count, rounds, [&](){ system.SetParent( last, system.Parent( last ) ); system.Update(); } );
+
+	return 0;
+}
@@ -0,0 +1,217 @@
+// Checks the accuracy and the size of the TransformCodec: random
+// positions and rotations go through it with the defaults and with a
+// smaller world, a coarser precision and fewer rotation bits, one at a
+// time and in arrays, with SSE2 where it's there. The largest errors
+// have to stay within what the codec says it keeps them, both ways have
+// to give the same bits and values, a rotation and its negation have to come
+// back as the same one and the positions out of the world are clamped
+// to its bound. The defaults have to take the bits of a snapshot entry
+// the comments in transformCodec.hh tell.
+//
+// usage: belowCodecCheck [samples] [seed]
+//
+// Prints the largest errors of each codec, exits with 1 if any check
+// doesn't hold.
+
+#include "../network/transformCodec.hh"
+#include "../network/snapshot.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <random>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+
+// Bits and bytes of a new node in a snapshot with the defaults
+#define DEFAULT_ENTRY_BITS  132
+#define DEFAULT_ENTRY_BYTES 17
+
+
+namespace
+{
+	mt19937 generator;
+
+	bool failed = false;
+
+
+	void Check( bool condition, const string &what )
+	{
+		if( !condition )
+		{
+			cout << "FAILED: " << what << endl;
+			failed = true;
+		}
+	}
+
+
+	// Uniform over the rotations
+	glm::quat RandomRotation()
+	{
+		normal_distribution<float> normal;
+
+		glm::quat q( normal( generator ), normal( generator ), normal( generator ), normal( generator ) );
+		return glm::normalize( q );
+	}
+
+
+	// Largest difference of a component, with the sign of b
+	// turned to the one of a first as q and -q are the same
+	float RotationDifference( const glm::quat &a, const glm::quat &b )
+	{
+		float sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.f ? -1.f : 1.f;
+		return max(
+			max( fabs( a.x - sign * b.x ), fabs( a.y - sign * b.y ) ),
+			max( fabs( a.z - sign * b.z ), fabs( a.w - sign * b.w ) )
+		);
+	}
+
+
+	void CheckCodec( const string &name, const TransformCodec &codec, float bound, size_t samples )
+	{
+		uniform_real_distribution<float> inside( -bound, bound );
+
+		// The step itself is rounded to a float on the way back
+		float positionLimit = codec.PositionError() + 2.f * bound * FLT_EPSILON;
+
+		// As transformCodec.hh has it for the rebuilt component
+		float rotationLimit = 3.f * codec.RotationError() + 1e-5f;
+
+		float positionError = 0.f, rotationError = 0.f, negatedError = 0.f;
+
+		vector<float>    values( samples ), positions( samples ), singlePositions( samples );
+		vector<uint32_t> quantized( samples ), singleQuantized( samples ), singleRotations( samples );
+		vector<glm::quat> singleDecoded( samples );
+
+		vector<float> x( samples ), y( samples ), z( samples ), w( samples );
+		vector<float> rx( samples ), ry( samples ), rz( samples ), rw( samples );
+
+		for( size_t i = 0; i < samples; i++ )
+		{
+			values[i] = inside( generator );
+
+			singleQuantized[i] = codec.QuantizePosition( values[i] );
+			singlePositions[i] = codec.DequantizePosition( singleQuantized[i] );
+			positionError = max( positionError, fabs( singlePositions[i] - values[i] ) );
+
+			auto q = RandomRotation();
+			x[i] = q.x;
+			y[i] = q.y;
+			z[i] = q.z;
+			w[i] = q.w;
+
+			singleRotations[i] = codec.QuantizeRotation( q );
+			singleDecoded[i]   = codec.DequantizeRotation( singleRotations[i] );
+			rotationError = max( rotationError, RotationDifference( q, singleDecoded[i] ) );
+
+			// The same rotation, it must come back within the same limit
+			auto negated = codec.QuantizeRotation( -q );
+			negatedError = max( negatedError, RotationDifference( q, codec.DequantizeRotation( negated ) ) );
+		}
+
+		// Any that differ between a value at a time and the arrays
+		size_t differences = 0;
+
+		codec.QuantizePositions( values.data(), quantized.data(), samples );
+		codec.DequantizePositions( quantized.data(), positions.data(), samples );
+
+		float arrayPositionError = 0.f;
+		for( size_t i = 0; i < samples; i++ )
+		{
+			arrayPositionError = max( arrayPositionError, fabs( positions[i] - values[i] ) );
+			differences += quantized[i] != singleQuantized[i] || positions[i] != singlePositions[i];
+		}
+
+		codec.QuantizeRotations( x.data(), y.data(), z.data(), w.data(), quantized.data(), samples );
+		codec.DequantizeRotations( quantized.data(), rx.data(), ry.data(), rz.data(), rw.data(), samples );
+
+		float arrayRotationError = 0.f;
+		for( size_t i = 0; i < samples; i++ )
+		{
+			glm::quat decoded( rw[i], rx[i], ry[i], rz[i] );
+			arrayRotationError = max( arrayRotationError, RotationDifference( glm::quat( w[i], x[i], y[i], z[i] ), decoded ) );
+
+			auto &single = singleDecoded[i];
+			differences += quantized[i] != singleRotations[i] ||
+			               decoded.x != single.x || decoded.y != single.y || decoded.z != single.z || decoded.w != single.w;
+		}
+
+		cout << name << ": " << codec.PositionBits() << " bits per position component, "
+		     << codec.RotationBits() << " per rotation" << endl
+		     << scientific << setprecision( 2 )
+		     << "  position error " << positionError << ", arrays " << arrayPositionError
+		     << ", limit " << codec.PositionError() << endl
+		     << "  rotation error " << rotationError << ", negated " << negatedError
+		     << ", arrays " << arrayRotationError << ", limit " << rotationLimit << endl
+		     << defaultfloat
+		     << "  " << differences << " values differ between one at a time and the arrays" << endl;
+
+		Check( positionError <= positionLimit, name + " position error" );
+		Check( arrayPositionError <= positionLimit, name + " position error of the arrays" );
+		Check( rotationError <= rotationLimit, name + " rotation error" );
+		Check( negatedError <= rotationLimit, name + " rotation error of the negated rotations" );
+		Check( arrayRotationError <= rotationLimit, name + " rotation error of the arrays" );
+		Check( differences == 0, name + " one at a time against the arrays" );
+
+		// A rotation and its negation are the same bits, the largest is kept positive
+		auto q = RandomRotation();
+		Check( codec.QuantizeRotation( q ) == codec.QuantizeRotation( -q ), name + " negated rotation encoding" );
+
+		// Out of the world they stop at its edges
+		Check( fabs( codec.DequantizePosition( codec.QuantizePosition( 4.f * bound ) ) - bound ) <= positionLimit, name + " clamping above the bound" );
+		Check( fabs( codec.DequantizePosition( codec.QuantizePosition( -4.f * bound ) ) + bound ) <= positionLimit, name + " clamping below the bound" );
+		Check( codec.QuantizePosition( bound ) < ( uint64_t( 1 ) << codec.PositionBits() ), name + " position bits" );
+	}
+}
+
+
+
+int main( int argc, char *argv[] )
+{
+	int      samples = argc > 1 ? atoi( argv[1] ) : 1000000;
+	uint32_t seed    = argc > 2 ? atoi( argv[2] ) : 1;
+
+	if( samples < 1 )
+	{
+		cout << "usage: " << argv[0] << " [samples] [seed]" << endl;
+		return 1;
+	}
+
+	generator.seed( seed );
+
+	TransformCodec codec;
+	CheckCodec( "defaults", codec, TRANSFORM_WORLD_BOUND, samples );
+	CheckCodec( "256 at 1/64, 7 bit components", TransformCodec( 256.f, 1.f / 64.f, 7 ), 256.f, samples );
+
+	// A new node has its id, the mask and everything else
+	QuantizedTransform node = QuantizeTransform( codec, { 1, glm::vec3( 1.f, 2.f, 3.f ), RandomRotation() } );
+	auto bits = SnapshotEntryBits( codec, &node, nullptr );
+
+	cout << "snapshot entry of a new node: " << bits << " bits, "
+	     << ( bits + 7 ) / 8 << " bytes" << endl;
+
+	Check( codec.PositionBits() == 21, "default position bits" );
+	Check( codec.RotationBits() == 32, "default rotation bits" );
+	Check( bits == DEFAULT_ENTRY_BITS, "bits of a new node" );
+	Check( ( bits + 7 ) / 8 == DEFAULT_ENTRY_BYTES, "bytes of a new node" );
+
+	// Unchanged it's left out, a rotation alone is the id, the mask and the rotation
+	Check( SnapshotEntryBits( codec, &node, &node ) == 0, "bits of an unchanged node" );
+
+	auto turned = node;
+	turned.rotation = codec.QuantizeRotation( RandomRotation() );
+	Check( turned.rotation == node.rotation || SnapshotEntryBits( codec, &turned, &node ) == 32 + SNAPSHOT_MASK_BITS + codec.RotationBits(), "bits of a turned node" );
+
+	if( failed )
+	{
+		return 1;
+	}
+
+	cout << "All checks passed" << endl;
+	return 0;
+}
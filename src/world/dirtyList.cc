@@ -0,0 +1,21 @@
+#include "dirtyList.hh"
+
+using namespace std;
+
+
+void DirtyList::Push( unsigned int id )
+{
+	lock_guard<std::mutex> lock( mutex );
+	ids.push_back( id );
+}
+
+
+
+vector<unsigned int> DirtyList::Take()
+{
+	vector<unsigned int> taken;
+
+	lock_guard<std::mutex> lock( mutex );
+	taken.swap( ids );
+	return taken;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+
+// Ids of the nodes that have changed since the last Take(). A node
+// pushes its id when the first of its fields changes, so the changed
+// ones are found without going through all of them. An id may be
+// there twice if the node changed again while it was being taken.
+class DirtyList
+{
+ public:
+	void Push( unsigned int id );
+
+	std::vector<unsigned int> Take();
+
+
+ private:
+	std::mutex                mutex;
+	std::vector<unsigned int> ids;
+};
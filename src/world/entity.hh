@@ -8,6 +8,12 @@ struct Material
 };
 
 
+inline bool operator==( const Material &a, const Material &b )
+{
+	return a.color == b.color;
+}
+
+
 struct Entity : public WorldNode
 {
 	Entity();
@@ -16,10 +22,39 @@ struct Entity : public WorldNode
 	std::string texture;
 	Material    material;
 
-	// For serialization and unserialization:
-	virtual bool SerializeField( std::string &fieldName, std::stringstream &stream ) override;
-	virtual bool UnserializeField( std::string &fieldName, std::stringstream &stream  ) override;
+	// Change the fields and mark them dirty
+	void SetMesh( const std::string &newMesh );
+	void SetTexture( const std::string &newTexture );
+	void SetMaterial( const Material &newMaterial );
+
+	virtual std::string Serialize( std::vector<FieldId> fields={} ) override;
+	virtual bool Unserialize( std::string data ) override;
+};
+
 
-	virtual std::vector<std::string> GetDefaultFields() override;
+
+template<>
+struct FieldTraits<Material> : PlainFieldTraits<Material>
+{
+	static const size_t length = FieldTraits<glm::vec4>::length;
+
+	static void Write( BinaryWriter &writer, const Material &value )
+	{
+		FieldTraits<glm::vec4>::Write( writer, value.color );
+	}
+
+	static Material Read( BinaryReader &reader )
+	{
+		return Material{ FieldTraits<glm::vec4>::Read( reader ) };
+	}
 };
 
+
+// The fields of an Entity on the wire
+typedef ExtendFields<
+	WorldNodeFields,
+	WORLD_FIELD( Entity, material, FIELD_MATERIAL ),
+	WORLD_FIELD( Entity, texture,  FIELD_TEXTURE ),
+	WORLD_FIELD( Entity, mesh,     FIELD_MESH )
+>::type EntityFields;
+
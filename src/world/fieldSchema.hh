@@ -0,0 +1,503 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "../network/serializable.hh"
+#include "../network/binaryStream.hh"
+#include "../logger.hh"
+#include "../smooth.hh"
+
+
+// Numbers of the fields on the wire, each type has a list
+// of the ones it has. The values must stay the same between
+// the server and the clients.
+enum WorldFieldId : FieldId
+{
+	FIELD_ID = 0,
+	FIELD_POSITION,
+	FIELD_ROTATION,
+	FIELD_SCALE,
+	FIELD_MATERIAL,
+	FIELD_TEXTURE,
+	FIELD_MESH,
+	FIELD_VELOCITY,
+	FIELD_ANGULAR_VELOCITY,
+	FIELD_MASS,
+	FIELD_COLLISION_SHAPE,
+
+	FIELD_ID_COUNT
+};
+
+
+// A bit for each field, for telling which of them have changed
+typedef uint32_t FieldMask;
+
+static_assert( FIELD_ID_COUNT <= 32, "The fields don't fit in a FieldMask" );
+
+
+inline FieldMask FieldBit( FieldId id )
+{
+	return FieldMask( 1 ) << id;
+}
+
+
+// The ids of the fields in the mask, in the order of the ids
+inline std::vector<FieldId> FieldIds( FieldMask mask )
+{
+	std::vector<FieldId> ids;
+	for( FieldId id = 0; id < FIELD_ID_COUNT; id++ )
+	{
+		if( mask & FieldBit( id ) )
+		{
+			ids.push_back( id );
+		}
+	}
+	return ids;
+}
+
+
+
+// How a type of member is written and read, specialized for each
+// type the fields have. Value is what goes over the wire, Get() and
+// Store() take it from the member and put it back. length is the
+// bytes a value takes, 0 for the ones that tell their own length.
+template<typename T>
+struct FieldTraits;
+
+
+// For the members that are the value themselves
+template<typename T>
+struct PlainFieldTraits
+{
+	typedef T Value;
+
+	static const T& Get( const T &member )
+	{
+		return member;
+	}
+
+	static void Store( T &member, const T &value )
+	{
+		member = value;
+	}
+
+	static size_t Length( const T& )
+	{
+		return FieldTraits<T>::length;
+	}
+};
+
+
+template<>
+struct FieldTraits<uint32_t> : PlainFieldTraits<uint32_t>
+{
+	static const size_t length = 4;
+
+	static void Write( BinaryWriter &writer, uint32_t value )
+	{
+		writer.WriteUint32( value );
+	}
+
+	static uint32_t Read( BinaryReader &reader )
+	{
+		return reader.ReadUint32();
+	}
+};
+
+
+template<>
+struct FieldTraits<float> : PlainFieldTraits<float>
+{
+	static const size_t length = 4;
+
+	static void Write( BinaryWriter &writer, float value )
+	{
+		writer.WriteFloat( value );
+	}
+
+	static float Read( BinaryReader &reader )
+	{
+		return reader.ReadFloat();
+	}
+};
+
+
+template<>
+struct FieldTraits<glm::vec3> : PlainFieldTraits<glm::vec3>
+{
+	static const size_t length = 3 * 4;
+
+	static void Write( BinaryWriter &writer, const glm::vec3 &value )
+	{
+		writer.WriteFloat( value.x );
+		writer.WriteFloat( value.y );
+		writer.WriteFloat( value.z );
+	}
+
+	static glm::vec3 Read( BinaryReader &reader )
+	{
+		glm::vec3 value;
+		value.x = reader.ReadFloat();
+		value.y = reader.ReadFloat();
+		value.z = reader.ReadFloat();
+		return value;
+	}
+};
+
+
+template<>
+struct FieldTraits<glm::vec4> : PlainFieldTraits<glm::vec4>
+{
+	static const size_t length = 4 * 4;
+
+	static void Write( BinaryWriter &writer, const glm::vec4 &value )
+	{
+		writer.WriteFloat( value.x );
+		writer.WriteFloat( value.y );
+		writer.WriteFloat( value.z );
+		writer.WriteFloat( value.w );
+	}
+
+	static glm::vec4 Read( BinaryReader &reader )
+	{
+		glm::vec4 value;
+		value.x = reader.ReadFloat();
+		value.y = reader.ReadFloat();
+		value.z = reader.ReadFloat();
+		value.w = reader.ReadFloat();
+		return value;
+	}
+};
+
+
+template<>
+struct FieldTraits<glm::quat> : PlainFieldTraits<glm::quat>
+{
+	static const size_t length = 4 * 4;
+
+	static void Write( BinaryWriter &writer, const glm::quat &value )
+	{
+		writer.WriteFloat( value.x );
+		writer.WriteFloat( value.y );
+		writer.WriteFloat( value.z );
+		writer.WriteFloat( value.w );
+	}
+
+	static glm::quat Read( BinaryReader &reader )
+	{
+		glm::quat value{};
+		value.x = reader.ReadFloat();
+		value.y = reader.ReadFloat();
+		value.z = reader.ReadFloat();
+		value.w = reader.ReadFloat();
+		return value;
+	}
+};
+
+
+// The strings are names of meshes and textures, up to 255 characters
+// with the length in front. An empty one is read as the default one.
+template<>
+struct FieldTraits<std::string> : PlainFieldTraits<std::string>
+{
+	static const size_t length = 0;
+
+	static size_t Length( const std::string &value )
+	{
+		return 1 + std::min<size_t>( value.size(), 255 );
+	}
+
+	static void Write( BinaryWriter &writer, const std::string &value )
+	{
+		writer.WriteString( value );
+	}
+
+	static std::string Read( BinaryReader &reader )
+	{
+		auto value = reader.ReadString();
+		return value.empty() ? std::string{ "default" } : value;
+	}
+};
+
+
+// Smoothed members send their current value and take
+// the received one as a new sample
+template<typename T>
+struct FieldTraits<Smooth<T>>
+{
+	typedef T Value;
+
+	static const size_t length = FieldTraits<T>::length;
+
+	static T Get( const Smooth<T> &member )
+	{
+		return member.Get();
+	}
+
+	static void Store( Smooth<T> &member, const T &value )
+	{
+		member.Update( value );
+	}
+
+	static size_t Length( const T &value )
+	{
+		return FieldTraits<T>::Length( value );
+	}
+
+	static void Write( BinaryWriter &writer, const T &value )
+	{
+		FieldTraits<T>::Write( writer, value );
+	}
+
+	static T Read( BinaryReader &reader )
+	{
+		return FieldTraits<T>::Read( reader );
+	}
+};
+
+
+
+// A member of Object sent with the id. A value that was cut
+// short leaves the member as it was, a value that was taken
+// marks the field of the object changed.
+template<typename Object, typename Member, Member Object::*member, FieldId fieldId>
+struct Field
+{
+	typedef FieldTraits<Member> Traits;
+
+	static const FieldId id = fieldId;
+
+	static size_t Length( const Object &object )
+	{
+		return Traits::Length( Traits::Get( object.*member ) );
+	}
+
+	static void Write( const Object &object, BinaryWriter &writer )
+	{
+		Traits::Write( writer, Traits::Get( object.*member ) );
+	}
+
+	static void Read( Object &object, BinaryReader &reader )
+	{
+		auto value = Traits::Read( reader );
+		if( !reader.Failed() )
+		{
+			Traits::Store( object.*member, value );
+			object.MarkDirty( id );
+		}
+	}
+};
+
+// The Field of the member, declared with its class and its id
+#define WORLD_FIELD( Object, member, id ) Field<Object, decltype( Object::member ), &Object::member, id>
+
+
+
+// The fields of a type. Picking a field by its id unrolls to a
+// chain of compares of constants and writing all of them to
+// straight code, there are no calls through pointers per field.
+template<typename... Fields>
+struct FieldList;
+
+
+template<>
+struct FieldList<>
+{
+	static const size_t count = 0;
+
+	static std::vector<FieldId> Ids()
+	{
+		return {};
+	}
+
+	template<typename Object>
+	static size_t FieldLength( const Object&, FieldId )
+	{
+		return 0;
+	}
+
+	template<typename Object>
+	static bool Write( const Object&, FieldId, BinaryWriter& )
+	{
+		return false;
+	}
+
+	template<typename Object>
+	static bool Read( Object&, FieldId, BinaryReader& )
+	{
+		return false;
+	}
+
+	template<typename Object>
+	static void WriteAll( const Object&, BinaryWriter& )
+	{
+	}
+
+	template<typename Object>
+	static size_t Length( const Object& )
+	{
+		return 0;
+	}
+};
+
+
+template<typename Head, typename... Tail>
+struct FieldList<Head, Tail...>
+{
+	static const size_t count = 1 + sizeof...( Tail );
+
+	static std::vector<FieldId> Ids()
+	{
+		return { FieldId( Head::id ), FieldId( Tail::id )... };
+	}
+
+	// Bytes the field takes with its id, 0 if there's no such field
+	template<typename Object>
+	static size_t FieldLength( const Object &object, FieldId id )
+	{
+		if( id == Head::id )
+		{
+			return 1 + Head::Length( object );
+		}
+
+		return FieldList<Tail...>::FieldLength( object, id );
+	}
+
+	// Writes the id and the data of the field,
+	// returns false if there's no such field
+	template<typename Object>
+	static bool Write( const Object &object, FieldId id, BinaryWriter &writer )
+	{
+		if( id == Head::id )
+		{
+			writer.WriteUint8( id );
+			Head::Write( object, writer );
+			return true;
+		}
+
+		return FieldList<Tail...>::Write( object, id, writer );
+	}
+
+	// Reads the data of the field, returns false if there's no such field
+	template<typename Object>
+	static bool Read( Object &object, FieldId id, BinaryReader &reader )
+	{
+		if( id == Head::id )
+		{
+			Head::Read( object, reader );
+			return true;
+		}
+
+		return FieldList<Tail...>::Read( object, id, reader );
+	}
+
+	template<typename Object>
+	static void WriteAll( const Object &object, BinaryWriter &writer )
+	{
+		writer.WriteUint8( Head::id );
+		Head::Write( object, writer );
+		FieldList<Tail...>::WriteAll( object, writer );
+	}
+
+	// Bytes all the fields take with their ids
+	template<typename Object>
+	static size_t Length( const Object &object )
+	{
+		return 1 + Head::Length( object ) + FieldList<Tail...>::Length( object );
+	}
+};
+
+
+// The fields of the base type followed by the given ones
+template<typename Base, typename... Fields>
+struct ExtendFields;
+
+template<typename... BaseFields, typename... Fields>
+struct ExtendFields<FieldList<BaseFields...>, Fields...>
+{
+	typedef FieldList<BaseFields..., Fields...> type;
+};
+
+
+
+// A serialized object is the count of the fields followed by the id and
+// the data of every field. No fields means all of the type's fields.
+// The lengths of the fields are known, so the data is written straight
+// into a string of the right size.
+template<typename List, typename Object>
+std::string SerializeFields( const Object &object, const std::vector<FieldId> &fields )
+{
+	if( fields.empty() )
+	{
+		std::string serialized( 1 + List::Length( object ), '\0' );
+		BinaryWriter writer( serialized );
+		writer.WriteUint8( static_cast<uint8_t>( List::count ) );
+		List::WriteAll( object, writer );
+		return serialized;
+	}
+
+	size_t length = 1;
+	for( auto id : fields )
+	{
+		length += List::FieldLength( object, id );
+	}
+
+	std::string serialized( length, '\0' );
+	BinaryWriter writer( serialized );
+	writer.WriteUint8( 0 );
+
+	uint8_t fieldCount = 0;
+	for( auto id : fields )
+	{
+		if( !List::Write( object, id, writer ) )
+		{
+			LOG_ERROR( "Serialize failed because field " << int( id ) << " isn't one of type " << int( object.type ) << "!" );
+			continue;
+		}
+
+		fieldCount++;
+	}
+
+	serialized[0] = static_cast<char>( fieldCount );
+	return serialized;
+}
+
+
+template<typename List, typename Object>
+bool UnserializeFields( Object &object, const std::string &data )
+{
+	BinaryReader reader( data.data(), data.size() );
+
+	uint8_t fieldCount = reader.ReadUint8();
+
+	for( int i = 0; i < fieldCount && !reader.Failed(); i++ )
+	{
+		auto id = reader.ReadUint8();
+		if( reader.Failed() )
+		{
+			break;
+		}
+
+		if( !List::Read( object, id, reader ) )
+		{
+			LOG_ERROR( "Unserialize failed because field " << int( id ) << " is not known for type " << int( object.type ) << "!" );
+			return false;
+		}
+	}
+
+	if( reader.Failed() )
+	{
+		LOG_ERROR( "Unserialize failed, the data of type " << int( object.type ) << " was cut short!" );
+		return false;
+	}
+
+	return true;
+}
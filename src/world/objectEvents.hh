@@ -52,3 +52,23 @@ struct ObjectChildRemoveEvent : public Event
 	unsigned int childId;
 };
 
+
+// Body of an OBJECT_SNAPSHOT packet, see SnapshotReceiver
+struct ObjectSnapshotEvent : public Event
+{
+	std::string data;
+};
+
+
+// Body of an OBJECT_UPDATE_BATCH packet, see DecodeTransformBatch()
+struct ObjectUpdateBatchEvent : public Event
+{
+	std::string data;
+};
+
+
+// Body of an OBJECT_PACKED packet, see UnpackObjectEvents()
+struct ObjectPackedEvent : public Event
+{
+	std::string data;
+};
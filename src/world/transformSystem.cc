@@ -0,0 +1,334 @@
+#include "transformSystem.hh"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+
+namespace
+{
+	// translate( position ) * toMat4( rotation ) * scale( scale )
+	// written out, without the two matrix multiplies
+	void Compose( const glm::vec3 &p, const glm::quat &q, const glm::vec3 &s, glm::mat4 &m )
+	{
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+		m[0] = glm::vec4( ( 1.f - 2.f * ( yy + zz ) ) * s.x, 2.f * ( xy + wz ) * s.x, 2.f * ( xz - wy ) * s.x, 0.f );
+		m[1] = glm::vec4( 2.f * ( xy - wz ) * s.y, ( 1.f - 2.f * ( xx + zz ) ) * s.y, 2.f * ( yz + wx ) * s.y, 0.f );
+		m[2] = glm::vec4( 2.f * ( xz + wy ) * s.z, 2.f * ( yz - wx ) * s.z, ( 1.f - 2.f * ( xx + yy ) ) * s.z, 0.f );
+		m[3] = glm::vec4( p.x, p.y, p.z, 1.f );
+	}
+
+
+	// parent * local, both have 0, 0, 0, 1 as their last row
+	// so that's all the product has there too
+	void MultiplyAffine( const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out )
+	{
+		for( int c = 0; c < 4; c++ )
+		{
+			for( int r = 0; r < 3; r++ )
+			{
+				out[c][r] = a[0][r] * b[c][0] + a[1][r] * b[c][1] + a[2][r] * b[c][2];
+			}
+			out[c][3] = 0.f;
+		}
+
+		out[3][0] += a[3][0];
+		out[3][1] += a[3][1];
+		out[3][2] += a[3][2];
+		out[3][3]  = 1.f;
+	}
+}
+
+
+
+TransformSystem::TransformSystem()
+	: count( 0 ), sorted( true )
+{
+}
+
+
+
+TransformHandle TransformSystem::Add()
+{
+	TransformHandle handle;
+	if( !freeHandles.empty() )
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<TransformHandle>( indices.size() );
+		indices.push_back( TRANSFORM_NONE );
+	}
+
+	// A root at the end keeps the order
+	auto index = static_cast<uint32_t>( handles.size() );
+	indices[handle] = index;
+
+	positions.push_back( glm::vec3( 0.f ) );
+	rotations.push_back( glm::quat() );
+	scales.push_back( glm::vec3( 1.f ) );
+	parents.push_back( TRANSFORM_NONE );
+	worlds.push_back( glm::mat4() );
+	handles.push_back( handle );
+	dirty.push_back( 1 );
+	ends.push_back( index + 1 );
+
+	count++;
+	return handle;
+}
+
+
+
+void TransformSystem::Remove( TransformHandle handle )
+{
+	// Stays in the arrays until the next Sort()
+	handles[indices[handle]] = TRANSFORM_NONE;
+	indices[handle] = TRANSFORM_NONE;
+	freeHandles.push_back( handle );
+
+	count--;
+	sorted = false;
+}
+
+
+
+void TransformSystem::SetParent( TransformHandle handle, TransformHandle parent )
+{
+	parents[indices[handle]] = parent != TRANSFORM_NONE ? indices[parent] : TRANSFORM_NONE;
+	sorted = false;
+}
+
+
+
+TransformHandle TransformSystem::Parent( TransformHandle handle ) const
+{
+	auto parent = parents[indices[handle]];
+	return parent != TRANSFORM_NONE ? handles[parent] : TRANSFORM_NONE;
+}
+
+
+
+void TransformSystem::SetLocal( TransformHandle handle, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale )
+{
+	auto index = indices[handle];
+
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index]    = scale;
+	dirty[index]     = 1;
+}
+
+
+
+const glm::mat4& TransformSystem::World( TransformHandle handle ) const
+{
+	return worlds[indices[handle]];
+}
+
+
+
+void TransformSystem::Update()
+{
+	updated.clear();
+
+	if( !sorted )
+	{
+		Sort();
+	}
+
+	auto   flags = dirty.data();
+	size_t i     = 0;
+
+	while( i < count )
+	{
+		// To the next marked one, past the subtrees that stood still
+		auto next = static_cast<const uint8_t*>( memchr( flags + i, 1, count - i ) );
+		if( !next )
+		{
+			break;
+		}
+
+		// Its parent is up to date, everything under it comes right after it
+		i = next - flags;
+		for( auto end = ends[i]; i < end; i++ )
+		{
+			if( parents[i] == TRANSFORM_NONE )
+			{
+				Compose( positions[i], rotations[i], scales[i], worlds[i] );
+			}
+			else
+			{
+				glm::mat4 local;
+				Compose( positions[i], rotations[i], scales[i], local );
+				MultiplyAffine( worlds[parents[i]], local, worlds[i] );
+			}
+
+			dirty[i] = 0;
+			updated.push_back( handles[i] );
+		}
+	}
+}
+
+
+
+const vector<TransformHandle>& TransformSystem::Updated() const
+{
+	return updated;
+}
+
+
+
+size_t TransformSystem::Size() const
+{
+	return count;
+}
+
+
+
+void TransformSystem::Sort()
+{
+	auto total = static_cast<uint32_t>( handles.size() );
+
+	// The children of the removed ones are roots now
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		if( handles[i] != TRANSFORM_NONE && parents[i] != TRANSFORM_NONE && handles[parents[i]] == TRANSFORM_NONE )
+		{
+			parents[i] = TRANSFORM_NONE;
+		}
+	}
+
+	// The children of each one after each other, the ones
+	// of the index i start at first[i] and end at first[i + 1]
+	vector<uint32_t> first( total + 1, 0 );
+	vector<uint32_t> children( total );
+
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		if( handles[i] != TRANSFORM_NONE && parents[i] != TRANSFORM_NONE )
+		{
+			first[parents[i] + 1]++;
+		}
+	}
+
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		first[i + 1] += first[i];
+	}
+
+	vector<uint32_t> next( first.begin(), first.end() - 1 );
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		if( handles[i] != TRANSFORM_NONE && parents[i] != TRANSFORM_NONE )
+		{
+			children[next[parents[i]]++] = i;
+		}
+	}
+
+	// Depth first from the roots, each one before its subtree
+	vector<uint32_t> order;
+	vector<uint32_t> stack;
+	vector<bool>     visited( total, false );
+
+	order.reserve( count );
+
+	auto visit = [&]( uint32_t root )
+	{
+		stack.push_back( root );
+		while( !stack.empty() )
+		{
+			auto i = stack.back();
+			stack.pop_back();
+
+			if( visited[i] )
+			{
+				continue;
+			}
+
+			visited[i] = true;
+			order.push_back( i );
+
+			// Backwards, so they come out in their order
+			for( auto c = first[i + 1]; c > first[i]; c-- )
+			{
+				stack.push_back( children[c - 1] );
+			}
+		}
+	};
+
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		if( handles[i] != TRANSFORM_NONE && parents[i] == TRANSFORM_NONE )
+		{
+			visit( i );
+		}
+	}
+
+	// What's left is under itself, the roots never reach it
+	for( uint32_t i = 0; i < total; i++ )
+	{
+		if( handles[i] != TRANSFORM_NONE && !visited[i] )
+		{
+			parents[i] = TRANSFORM_NONE;
+			visit( i );
+		}
+	}
+
+	// Into the new order, the parents to their new indices
+	vector<uint32_t> moved( total, TRANSFORM_NONE );
+	for( uint32_t i = 0; i < order.size(); i++ )
+	{
+		moved[order[i]] = i;
+	}
+
+	vector<glm::vec3>       newPositions( order.size() );
+	vector<glm::quat>       newRotations( order.size() );
+	vector<glm::vec3>       newScales( order.size() );
+	vector<uint32_t>        newParents( order.size() );
+	vector<glm::mat4>       newWorlds( order.size() );
+	vector<TransformHandle> newHandles( order.size() );
+
+	for( uint32_t i = 0; i < order.size(); i++ )
+	{
+		auto from = order[i];
+
+		newPositions[i] = positions[from];
+		newRotations[i] = rotations[from];
+		newScales[i]    = scales[from];
+		newParents[i]   = parents[from] != TRANSFORM_NONE ? moved[parents[from]] : TRANSFORM_NONE;
+		newWorlds[i]    = worlds[from];
+		newHandles[i]   = handles[from];
+
+		indices[handles[from]] = i;
+	}
+
+	positions.swap( newPositions );
+	rotations.swap( newRotations );
+	scales.swap( newScales );
+	parents.swap( newParents );
+	worlds.swap( newWorlds );
+	handles.swap( newHandles );
+
+	// The children come after their parents, so their subtrees
+	// have ended by the time the one of the parent is extended
+	ends.assign( order.size(), 0 );
+	for( auto i = static_cast<uint32_t>( order.size() ); i-- > 0; )
+	{
+		ends[i] = max( ends[i], i + 1 );
+		if( parents[i] != TRANSFORM_NONE )
+		{
+			ends[parents[i]] = max( ends[parents[i]], ends[i] );
+		}
+	}
+
+	// Moved under another parent, a transform has a new world matrix
+	dirty.assign( order.size(), 1 );
+
+	sorted = true;
+}
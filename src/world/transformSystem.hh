@@ -0,0 +1,89 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+
+// Names a transform for as long as it's in the system, the
+// arrays move under it but the handle stays the same
+typedef uint32_t TransformHandle;
+
+// Handle of no transform, the parent of the roots
+#define TRANSFORM_NONE UINT32_MAX
+
+
+// Keeps the local transforms of the nodes, their parents and the world
+// matrices in arrays of their own, one element per transform, ordered
+// so that every subtree comes right after its root. Update() then goes
+// through them once from the start, the matrix of a parent is always
+// done before its children read it, instead of recursing through the
+// nodes. The order is redone before the next Update() when the
+// hierarchy has changed, adding a root keeps it.
+//
+// Only the transforms set since the last Update() and their subtrees
+// are computed again, a subtree being the elements from its root up
+// to its end. The rest are passed over with a memchr() of their flags,
+// so a world that mostly stands still costs about what moves in it.
+class TransformSystem
+{
+ public:
+	TransformSystem();
+
+	// A new root with the identity transform
+	TransformHandle Add();
+
+	// The children of the transform become roots
+	void Remove( TransformHandle handle );
+
+	// TRANSFORM_NONE makes it a root. A parent under the
+	// transform itself makes it a root too.
+	void            SetParent( TransformHandle handle, TransformHandle parent );
+	TransformHandle Parent( TransformHandle handle ) const;
+
+	// Marks the transform and its subtree for the next Update()
+	void SetLocal( TransformHandle handle, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale );
+
+	// Up to date after Update()
+	const glm::mat4& World( TransformHandle handle ) const;
+
+	// Computes the world matrices of the marked transforms and their
+	// subtrees, all of them after the hierarchy has changed
+	void Update();
+
+	// Handles of the transforms the last Update() computed
+	const std::vector<TransformHandle>& Updated() const;
+
+	size_t Size() const;
+
+
+ private:
+	// Puts the transforms in order again and drops the removed ones
+	void Sort();
+
+	// Indices of the arrays by the handles
+	std::vector<uint32_t> indices;
+	std::vector<TransformHandle> freeHandles;
+
+	// By the index, a removed transform has no handle until the next Sort()
+	std::vector<glm::vec3>       positions;
+	std::vector<glm::quat>       rotations;
+	std::vector<glm::vec3>       scales;
+	std::vector<uint32_t>        parents;
+	std::vector<glm::mat4>       worlds;
+	std::vector<TransformHandle> handles;
+	std::vector<uint8_t>         dirty;
+
+	// Where the subtree of the index ends, past its last element
+	std::vector<uint32_t> ends;
+
+	std::vector<TransformHandle> updated;
+
+	size_t count;
+	bool   sorted;
+};
@@ -5,12 +5,16 @@
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <atomic>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include "../network/serializable.hh"
 #include "worldObjectTypes.hh"
+#include "fieldSchema.hh"
+#include "transformSystem.hh"
+#include "dirtyList.hh"
 #include "../smooth.hh"
 
 
@@ -21,23 +25,40 @@ struct WorldNode: public Serializable
 
 	 WorldObjectType type;
 
-	// For serialization and unserialization:
-	virtual std::string Serialize( std::vector<std::string> vars={} );
+	// For serialization and unserialization of the fields
+	// of the type, no fields means all of them
+	virtual std::string Serialize( std::vector<FieldId> fields={} );
 	virtual bool Unserialize( std::string data );
 
-	virtual bool SerializeField( std::string &fieldName, std::stringstream &stream );
-	virtual bool UnserializeField( std::string &fieldName, std::stringstream &stream  );
-
-	// Returns vector of the default fields to serialize
-	virtual std::vector<std::string> GetDefaultFields();
-
 	// For node and entity identification:
 	unsigned int id;
 
 	// Update the model matrix:
 	// - Updates childrens recursively.
+	// - For the nodes outside of an object manager, the managers
+	//   compute the ones of their nodes in their TransformSystem.
 	virtual void UpdateModelMatrix( WorldNode *parent=nullptr );
 
+	// The fields changed since the last TakeDirtyFields(). The
+	// smoothed members mark themselves, the rest are changed
+	// through the setters.
+	void      MarkDirty( FieldId field );
+	FieldMask DirtyFields() const;
+	FieldMask TakeDirtyFields();
+
+	// The id goes to the list whenever the first field changes after
+	// TakeDirtyFields(), and right away if some have already. nullptr
+	// stops it.
+	void TrackDirty( DirtyList *list );
+
+	// Which of the position, rotation and scale have changed
+	// since the last TakeMovedFields(), the interpolated values
+	// of the smoothed ones included. For the object managers to
+	// recompute the model matrices of only the nodes that moved.
+	FieldMask TakeMovedFields();
+
+	void SetScale( const glm::vec3 &newScale );
+
 	Smooth<glm::vec3> position;
 	Smooth<glm::quat> rotation;
 	glm::vec3 scale;
@@ -45,5 +66,39 @@ struct WorldNode: public Serializable
 
 	unsigned int parent;
 	std::vector<std::shared_ptr<WorldNode>> children;
+
+	// In the TransformSystem of the manager the node is
+	// added to, TRANSFORM_NONE until then
+	TransformHandle transform;
+
+
+ protected:
+	// Sets the member and marks the field, if the value changed
+	template<typename T>
+	void SetField( T &member, const T &value, FieldId field )
+	{
+		if( !( member == value ) )
+		{
+			member = value;
+			MarkDirty( field );
+		}
+	}
+
+	std::atomic<FieldMask> dirtyFields;
+	std::atomic<FieldMask> movedFields;
+
+
+ private:
+	void FirstChange();
+
+	std::atomic<DirtyList*> dirtyList;
 };
 
+
+// The fields of a WorldNode on the wire
+typedef FieldList<
+	WORLD_FIELD( WorldNode, id,       FIELD_ID ),
+	WORLD_FIELD( WorldNode, position, FIELD_POSITION ),
+	WORLD_FIELD( WorldNode, rotation, FIELD_ROTATION ),
+	WORLD_FIELD( WorldNode, scale,    FIELD_SCALE )
+> WorldNodeFields;